@@ -33,6 +33,7 @@ class ElfFileImpl : public ElfFile {
 
   [[nodiscard]] ErrorMessageOr<ModuleSymbols> LoadSymbols() override;
   [[nodiscard]] ErrorMessageOr<uint64_t> GetLoadBias() const override;
+  [[nodiscard]] ErrorMessageOr<std::vector<LoadSegment>> GetLoadSegments() const override;
   [[nodiscard]] bool HasSymtab() const override;
   [[nodiscard]] bool HasDebugInfo() const override;
   [[nodiscard]] bool Is64Bit() const override;
@@ -196,6 +197,27 @@ ErrorMessageOr<uint64_t> ElfFileImpl<ElfT>::GetLoadBias() const {
   return min_vaddr;
 }
 
+template <typename ElfT>
+ErrorMessageOr<std::vector<ElfFile::LoadSegment>> ElfFileImpl<ElfT>::GetLoadSegments() const {
+  const llvm::object::ELFFile<ElfT>* elf_file = object_file_->getELFFile();
+
+  llvm::Expected<typename ElfT::PhdrRange> range = elf_file->program_headers();
+  if (!range) {
+    return ErrorMessage(absl::StrFormat(
+        "Unable to get load segments of ELF file: \"%s\". No program headers found.",
+        file_path_.string()));
+  }
+
+  std::vector<LoadSegment> load_segments;
+  for (const typename ElfT::Phdr& phdr : range.get()) {
+    if (phdr.p_type != llvm::ELF::PT_LOAD) {
+      continue;
+    }
+    load_segments.push_back(LoadSegment{phdr.p_offset, phdr.p_vaddr, phdr.p_filesz});
+  }
+  return load_segments;
+}
+
 template <typename ElfT>
 bool ElfFileImpl<ElfT>::HasSymtab() const {
   return has_symtab_section_;
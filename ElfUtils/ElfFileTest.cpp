@@ -86,6 +86,23 @@ TEST(ElfFile, CalculateLoadBiasNoProgramHeaders) {
                             test_elf_file.string()));
 }
 
+TEST(ElfFile, GetLoadSegments) {
+  const std::filesystem::path test_elf_file =
+      orbit_base::GetExecutableDir() / "testdata" / "hello_world_static_elf";
+  auto elf_file = ElfFile::Create(test_elf_file);
+  ASSERT_TRUE(elf_file) << elf_file.error().message();
+
+  const auto load_segments = elf_file.value()->GetLoadSegments();
+  ASSERT_TRUE(load_segments) << load_segments.error().message();
+  ASSERT_EQ(load_segments.value().size(), 4);
+  EXPECT_EQ(load_segments.value()[1].offset, 0x1000);
+  EXPECT_EQ(load_segments.value()[1].vaddr, 0x401000);
+  EXPECT_EQ(load_segments.value()[1].file_size, 0x7b4e1);
+  EXPECT_EQ(load_segments.value()[3].offset, 0xa3060);
+  EXPECT_EQ(load_segments.value()[3].vaddr, 0x4a4060);
+  EXPECT_EQ(load_segments.value()[3].file_size, 0x5270);
+}
+
 TEST(ElfFile, HasSymtab) {
   const std::filesystem::path executable_dir = orbit_base::GetExecutableDir();
   const std::filesystem::path elf_with_symbols_path =
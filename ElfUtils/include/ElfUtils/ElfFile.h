@@ -19,6 +19,13 @@ namespace orbit_elf_utils {
 
 class ElfFile {
  public:
+  // A PT_LOAD program header: file_size bytes at offset in the file are loaded at vaddr.
+  struct LoadSegment {
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t file_size;
+  };
+
   ElfFile() = default;
   virtual ~ElfFile() = default;
 
@@ -38,6 +45,9 @@ class ElfFile {
   // This method returns load bias for the elf-file if program headers are
   // available. This should be the case for all loadable elf-files.
   [[nodiscard]] virtual ErrorMessageOr<uint64_t> GetLoadBias() const = 0;
+  // Returns the PT_LOAD program headers, which translate between the addresses of symbols and
+  // offsets in the file. The two only coincide if vaddr and offset of the segment are equal.
+  [[nodiscard]] virtual ErrorMessageOr<std::vector<LoadSegment>> GetLoadSegments() const = 0;
   [[nodiscard]] virtual bool HasSymtab() const = 0;
   [[nodiscard]] virtual bool HasDebugInfo() const = 0;
   [[nodiscard]] virtual bool Is64Bit() const = 0;
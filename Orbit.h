@@ -7,8 +7,11 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <cstring>
 
+#include "OrbitApiEvents.h"
+
 // Orbit Manual Instrumentation API (header-only)
 //
 // While dynamic instrumentation is one of Orbit's core features, manual instrumentation can also be
@@ -27,6 +30,10 @@
 // ORBIT_FLOAT: Graph float values.
 // ORBIT_DOUBLE: Graph double values.
 //
+// Interned names:
+// ORBIT_SCOPE, ORBIT_START, ORBIT_START_ASYNC and the graph macros above have an "_INTERNED"
+// variant taking a string literal as name. See "ORBIT_SCOPE_INTERNED" below.
+//
 // Colors:
 // Note that all of the macros above have a "_WITH_COLOR" variant that allow users to specify
 // a custom color for time slices, async strings and graph elements. A set of predefined colors can
@@ -37,16 +44,21 @@
 // The manual instrumentation macros call empty "ORBIT_STUB" functions that Orbit dynamically
 // instruments. For manual instrumentation to appear in your Orbit capture, make sure that symbols
 // have been loaded for the manually instrumented modules.
+// Alternatively, processes that link OrbitProducer can bring up a ManualInstrumentationProducer
+// (see OrbitProducer/ManualInstrumentationProducer.h). While a capture is running, the macros then
+// record events in-process and the stubs are not called.
 //
 // Performance:
 // On Linux/Stadia, our current dynamic instrumentation implementation, which relies on uprobes and
 // uretprobes, incur some non-negligible overhead (>5us per instrumented function call). Please
 // note that instrumenting too many functions will possibly cause some noticeable performance
 // degradation. Reducing overhead is our highest priority and we are actively working on a new
-// implementation that should be at least one order of magnitude faster.
+// implementation that should be at least one order of magnitude faster. Events recorded through
+// a ManualInstrumentationProducer don't incur the cost of uprobes.
 //
 // Integration:
 // To integrate the manual instrumentation API in your code base, simply include this header file.
+// It needs OrbitApiEvents.h, which is next to it.
 //
 // Please note that this feature is still considered "experimental".
 
@@ -171,6 +183,65 @@
 #define ORBIT_ASYNC_STRING(str, id) orbit_api::AsyncString(str, id, orbit::Color::kAuto)
 #define ORBIT_ASYNC_STRING_WITH_COLOR(str, id, col) orbit_api::AsyncString(str, id, col)
 
+// ORBIT_SCOPE_INTERNED, ORBIT_START_INTERNED, ORBIT_START_ASYNC_INTERNED, ORBIT_[type]_INTERNED:
+// Variants of the macros above for names that are string literals.
+//
+// Overview:
+// Instead of copying the name into every event, these macros only send a 64-bit id of the name,
+// computed at compile time. The name itself is sent on the first use of the macro and then again
+// periodically, so that captures started later can still resolve it. This makes each event cheaper
+// to produce and lifts the "kMaxEventStringSize" limit on the name, which is recommended for hot
+// code like per-frame scopes of a game loop.
+//
+// Note:
+// "name" must be a string literal (or any other string with static storage duration whose content
+// doesn't change). Events produced before the name was first sent during a capture will show up in
+// Orbit once the name is received.
+//
+// Example usage:
+//
+// void GameLoop() {
+//   ORBIT_SCOPE_INTERNED("GameLoop: Update the state of all the entities of the world");
+//   for (Entity& entity : entities_) entity.Update();
+//   ORBIT_UINT64_INTERNED("GameLoop: Number of entities", entities_.size());
+// }
+//
+#define ORBIT_SCOPE_INTERNED(name) ORBIT_SCOPE_INTERNED_WITH_COLOR(name, orbit::Color::kAuto)
+#define ORBIT_SCOPE_INTERNED_WITH_COLOR(name, col) \
+  orbit_api::Scope ORBIT_VAR(ORBIT_INTERNED_NAME(name), col)
+#define ORBIT_START_INTERNED(name) ORBIT_START_INTERNED_WITH_COLOR(name, orbit::Color::kAuto)
+#define ORBIT_START_INTERNED_WITH_COLOR(name, col) \
+  orbit_api::Start(ORBIT_INTERNED_NAME(name), col)
+#define ORBIT_START_ASYNC_INTERNED(name, id) \
+  ORBIT_START_ASYNC_INTERNED_WITH_COLOR(name, id, orbit::Color::kAuto)
+#define ORBIT_START_ASYNC_INTERNED_WITH_COLOR(name, id, col) \
+  orbit_api::StartAsync(ORBIT_INTERNED_NAME(name), id, col)
+
+#define ORBIT_INT_INTERNED(name, val) ORBIT_INT_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+#define ORBIT_INT64_INTERNED(name, val) \
+  ORBIT_INT64_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+#define ORBIT_UINT_INTERNED(name, val) \
+  ORBIT_UINT_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+#define ORBIT_UINT64_INTERNED(name, val) \
+  ORBIT_UINT64_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+#define ORBIT_FLOAT_INTERNED(name, val) \
+  ORBIT_FLOAT_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+#define ORBIT_DOUBLE_INTERNED(name, val) \
+  ORBIT_DOUBLE_INTERNED_WITH_COLOR(name, val, orbit::Color::kAuto)
+
+#define ORBIT_INT_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackInt, ORBIT_INTERNED_NAME(name), val, col)
+#define ORBIT_INT64_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackInt64, ORBIT_INTERNED_NAME(name), val, col)
+#define ORBIT_UINT_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackUint, ORBIT_INTERNED_NAME(name), val, col)
+#define ORBIT_UINT64_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackUint64, ORBIT_INTERNED_NAME(name), val, col)
+#define ORBIT_FLOAT_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackFloat, ORBIT_INTERNED_NAME(name), val, col)
+#define ORBIT_DOUBLE_INTERNED_WITH_COLOR(name, val, col) \
+  ORBIT_TRACK(orbit_api::kTrackDouble, ORBIT_INTERNED_NAME(name), val, col)
+
 // ORBIT_[type]: Graph variables.
 //
 // Overview:
@@ -239,109 +310,27 @@
 #define ORBIT_FLOAT_WITH_COLOR(name, value, color)
 #define ORBIT_DOUBLE_WITH_COLOR(name, value, color)
 
-#endif
-
-// NOTE: Do not use any of the code below directly.
-namespace orbit {
-
-// Material Design Colors #500
-enum class Color : uint32_t {
-  kAuto = 0x00000000,
-  kRed = 0xf44336ff,
-  kPink = 0xe91e63ff,
-  kPurple = 0x9c27b0ff,
-  kDeepPurple = 0x673ab7ff,
-  kIndigo = 0x3f51b5ff,
-  kBlue = 0x2196f3ff,
-  kLightBlue = 0x03a9f4ff,
-  kCyan = 0x00bcd4ff,
-  kTeal = 0x009688ff,
-  kGreen = 0x4caf50ff,
-  kLightGreen = 0x8bc34aff,
-  kLime = 0xcddc39ff,
-  kYellow = 0xffeb3bff,
-  kAmber = 0xffc107ff,
-  kOrange = 0xff9800ff,
-  kDeepOrange = 0xff5722ff,
-  kBrown = 0x795548ff,
-  kGrey = 0x9e9e9eff,
-  kBlueGrey = 0x607d8bff
-};
-
-}  // namespace orbit
+#define ORBIT_SCOPE_INTERNED(name)
+#define ORBIT_START_INTERNED(name)
+#define ORBIT_START_ASYNC_INTERNED(name, id)
+#define ORBIT_INT_INTERNED(name, value)
+#define ORBIT_INT64_INTERNED(name, value)
+#define ORBIT_UINT_INTERNED(name, value)
+#define ORBIT_UINT64_INTERNED(name, value)
+#define ORBIT_FLOAT_INTERNED(name, value)
+#define ORBIT_DOUBLE_INTERNED(name, value)
+
+#define ORBIT_SCOPE_INTERNED_WITH_COLOR(name, color)
+#define ORBIT_START_INTERNED_WITH_COLOR(name, color)
+#define ORBIT_START_ASYNC_INTERNED_WITH_COLOR(name, id, color)
+#define ORBIT_INT_INTERNED_WITH_COLOR(name, value, color)
+#define ORBIT_INT64_INTERNED_WITH_COLOR(name, value, color)
+#define ORBIT_UINT_INTERNED_WITH_COLOR(name, value, color)
+#define ORBIT_UINT64_INTERNED_WITH_COLOR(name, value, color)
+#define ORBIT_FLOAT_INTERNED_WITH_COLOR(name, value, color)
+#define ORBIT_DOUBLE_INTERNED_WITH_COLOR(name, value, color)
 
-namespace orbit_api {
-constexpr uint8_t kVersion = 1;
-
-enum EventType : uint8_t {
-  kNone = 0,
-  kScopeStart = 1,
-  kScopeStop = 2,
-  kScopeStartAsync = 3,
-  kScopeStopAsync = 4,
-  kTrackInt = 5,
-  kTrackInt64 = 6,
-  kTrackUint = 7,
-  kTrackUint64 = 8,
-  kTrackFloat = 9,
-  kTrackDouble = 10,
-  kString = 11,
-};
-
-constexpr size_t kMaxEventStringSize = 34;
-struct Event {
-  uint8_t version;                 // 1
-  uint8_t type;                    // 1
-  char name[kMaxEventStringSize];  // 34
-  orbit::Color color;              // 4
-  uint64_t data;                   // 8
-};
-
-union EncodedEvent {
-  EncodedEvent(orbit_api::EventType type, const char* name = nullptr, uint64_t data = 0,
-               orbit::Color color = orbit::Color::kAuto) {
-    static_assert(sizeof(EncodedEvent) == 48, "orbit_api::EncodedEvent should be 48 bytes.");
-    static_assert(sizeof(Event) == 48, "orbit_api::Event should be 48 bytes.");
-    event.version = kVersion;
-    event.type = static_cast<uint8_t>(type);
-    memset(event.name, 0, kMaxEventStringSize);
-    if (name != nullptr) {
-      std::strncpy(event.name, name, kMaxEventStringSize - 1);
-      event.name[kMaxEventStringSize - 1] = 0;
-    }
-    event.data = data;
-    event.color = color;
-  }
-
-  EncodedEvent(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5) {
-    args[0] = a0;
-    args[1] = a1;
-    args[2] = a2;
-    args[3] = a3;
-    args[4] = a4;
-    args[5] = a5;
-  }
-  Event event;
-  uint64_t args[6];
-};
-
-template <typename Dest, typename Source>
-inline Dest Encode(const Source& source) {
-  static_assert(sizeof(Source) <= sizeof(Dest), "orbit_api::Encode destination type is too small");
-  Dest dest = 0;
-  std::memcpy(&dest, &source, sizeof(Source));
-  return dest;
-}
-
-template <typename Dest, typename Source>
-inline Dest Decode(const Source& source) {
-  static_assert(sizeof(Dest) <= sizeof(Source), "orbit_api::Decode destination type is too big");
-  Dest dest = 0;
-  std::memcpy(&dest, &source, sizeof(Dest));
-  return dest;
-}
-
-}  // namespace orbit_api
+#endif
 
 #if ORBIT_API_ENABLED
 
@@ -361,6 +350,35 @@ inline Dest Decode(const Source& source) {
 
 namespace orbit_api {
 
+// Name of an event, interned in a static variable created by the ORBIT_INTERNED_NAME macro.
+class InternedName {
+ public:
+  constexpr explicit InternedName(const char* name) : name_(name), id_(HashName(name)) {}
+
+  [[nodiscard]] const char* GetName() const { return name_; }
+  [[nodiscard]] uint64_t GetId() const { return id_; }
+
+  // Returns true if the name needs to be sent before the next event using it. This is the case on
+  // the first use and then every kRegistrationPeriod uses.
+  [[nodiscard]] bool NeedsRegistration() const {
+    return num_uses_.fetch_add(1, std::memory_order_relaxed) % kRegistrationPeriod == 0;
+  }
+
+ private:
+  static constexpr uint32_t kRegistrationPeriod = 64;
+
+  const char* name_;
+  uint64_t id_;
+  mutable std::atomic<uint32_t> num_uses_{0};
+};
+
+// The lambda makes sure that "name" has static storage duration, as it can't be captured.
+#define ORBIT_INTERNED_NAME(name)                                  \
+  ([]() -> const orbit_api::InternedName& {                        \
+    static orbit_api::InternedName orbit_interned_name_var(name); \
+    return orbit_interned_name_var;                                \
+  }())
+
 // Used to prevent compiler from stripping out empty function.
 #define ORB_NOOP           \
   do {                     \
@@ -378,6 +396,38 @@ ORBIT_STUB void TrackValue(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uin
 // NOTE: Do not use these directly, use corresponding macros instead.
 #ifndef ORBIT_API_INTERNAL_IMPL
 
+using StubFunction = void (*)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+
+inline void EmitStart(const EncodedEvent& e) {
+  const InProcessProducerCallbacks* callbacks =
+      in_process_producer_callbacks.load(std::memory_order_acquire);
+  if (callbacks != nullptr) {
+    callbacks->start(e);
+    return;
+  }
+  Start(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+}
+
+inline void EmitStop(const EncodedEvent& e) {
+  const InProcessProducerCallbacks* callbacks =
+      in_process_producer_callbacks.load(std::memory_order_acquire);
+  if (callbacks != nullptr) {
+    callbacks->stop();
+    return;
+  }
+  Stop(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+}
+
+inline void EmitEvent(const EncodedEvent& e, StubFunction stub) {
+  const InProcessProducerCallbacks* callbacks =
+      in_process_producer_callbacks.load(std::memory_order_acquire);
+  if (callbacks != nullptr) {
+    callbacks->record(e);
+    return;
+  }
+  stub(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+}
+
 // Default values.
 constexpr const char* kNameNullPtr = nullptr;
 constexpr uint64_t kDataZero = 0;
@@ -385,22 +435,22 @@ constexpr orbit::Color kColorAuto = orbit::Color::kAuto;
 
 inline void Start(const char* name, orbit::Color color) {
   EncodedEvent e(EventType::kScopeStart, name, kDataZero, color);
-  Start(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+  EmitStart(e);
 }
 
 inline void Stop() {
   EncodedEvent e(EventType::kScopeStop);
-  Stop(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+  EmitStop(e);
 }
 
 inline void StartAsync(const char* name, uint64_t id, orbit::Color color) {
   EncodedEvent e(EventType::kScopeStartAsync, name, id, color);
-  StartAsync(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+  EmitEvent(e, StartAsync);
 }
 
 inline void StopAsync(uint64_t id) {
   EncodedEvent e(EventType::kScopeStopAsync, kNameNullPtr, id, kColorAuto);
-  StopAsync(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+  EmitEvent(e, StopAsync);
 }
 
 inline void AsyncString(const char* str, uint64_t id, orbit::Color color) {
@@ -411,14 +461,43 @@ inline void AsyncString(const char* str, uint64_t id, orbit::Color color) {
     EncodedEvent e(EventType::kString, kNameNullPtr, id, color);
     std::strncpy(e.event.name, str, chunk_size);
     e.event.name[chunk_size] = 0;
-    TrackValue(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+    EmitEvent(e, TrackValue);
     str += chunk_size;
   }
 }
 
 inline void TrackValue(EventType type, const char* name, uint64_t value, orbit::Color color) {
   EncodedEvent e(type, name, value, color);
-  TrackValue(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+  EmitEvent(e, TrackValue);
+}
+
+inline void RegisterNameIfNeeded(const InternedName& name) {
+  if (!name.NeedsRegistration()) return;
+  ForEachNameRegistrationEvent(name.GetName(), name.GetId(), [](const EncodedEvent& e) {
+    EmitEvent(e, TrackValue);
+  });
+}
+
+inline void Start(const InternedName& name, orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  EncodedEvent e(EventType::kScopeStart, kNameNullPtr, kDataZero, color);
+  SetNameId(&e.event, name.GetId());
+  EmitStart(e);
+}
+
+inline void StartAsync(const InternedName& name, uint64_t id, orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  EncodedEvent e(EventType::kScopeStartAsync, kNameNullPtr, id, color);
+  SetNameId(&e.event, name.GetId());
+  EmitEvent(e, StartAsync);
+}
+
+inline void TrackValue(EventType type, const InternedName& name, uint64_t value,
+                       orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  EncodedEvent e(type, kNameNullPtr, value, color);
+  SetNameId(&e.event, name.GetId());
+  EmitEvent(e, TrackValue);
 }
 
 #else
@@ -429,11 +508,15 @@ void StartAsync(const char* name, uint64_t id, orbit::Color color);
 void StopAsync(uint64_t id);
 void AsyncString(const char* str, uint64_t id, orbit::Color color);
 void TrackValue(EventType type, const char* name, uint64_t value, orbit::Color color);
+void Start(const InternedName& name, orbit::Color color);
+void StartAsync(const InternedName& name, uint64_t id, orbit::Color color);
+void TrackValue(EventType type, const InternedName& name, uint64_t value, orbit::Color color);
 
 #endif  // ORBIT_API_INTERNAL_IMPL
 
 struct Scope {
   Scope(const char* name, orbit::Color color) { Start(name, color); }
+  Scope(const InternedName& name, orbit::Color color) { Start(name, color); }
   ~Scope() { Stop(); }
 };
 
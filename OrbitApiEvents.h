@@ -0,0 +1,186 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_API_EVENTS_H_
+#define ORBIT_API_EVENTS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <cstring>
+
+// Encoding of the events of the manual instrumentation API (see Orbit.h), shared with the code that
+// records and decodes them. Unlike Orbit.h, this header doesn't define the API functions, so it can
+// be included by code that defines them out of line (see OrbitBase/Tracing.h) or that doesn't use
+// the API itself, like OrbitProducer.
+//
+// NOTE: Do not use any of the code below directly.
+namespace orbit {
+
+// Material Design Colors #500
+enum class Color : uint32_t {
+  kAuto = 0x00000000,
+  kRed = 0xf44336ff,
+  kPink = 0xe91e63ff,
+  kPurple = 0x9c27b0ff,
+  kDeepPurple = 0x673ab7ff,
+  kIndigo = 0x3f51b5ff,
+  kBlue = 0x2196f3ff,
+  kLightBlue = 0x03a9f4ff,
+  kCyan = 0x00bcd4ff,
+  kTeal = 0x009688ff,
+  kGreen = 0x4caf50ff,
+  kLightGreen = 0x8bc34aff,
+  kLime = 0xcddc39ff,
+  kYellow = 0xffeb3bff,
+  kAmber = 0xffc107ff,
+  kOrange = 0xff9800ff,
+  kDeepOrange = 0xff5722ff,
+  kBrown = 0x795548ff,
+  kGrey = 0x9e9e9eff,
+  kBlueGrey = 0x607d8bff
+};
+
+}  // namespace orbit
+
+namespace orbit_api {
+constexpr uint8_t kVersion = 1;
+
+enum EventType : uint8_t {
+  kNone = 0,
+  kScopeStart = 1,
+  kScopeStop = 2,
+  kScopeStartAsync = 3,
+  kScopeStopAsync = 4,
+  kTrackInt = 5,
+  kTrackInt64 = 6,
+  kTrackUint = 7,
+  kTrackUint64 = 8,
+  kTrackFloat = 9,
+  kTrackDouble = 10,
+  kString = 11,
+  kNameRegistration = 12,
+};
+
+constexpr size_t kMaxEventStringSize = 34;
+struct Event {
+  uint8_t version;                 // 1
+  uint8_t type;                    // 1
+  char name[kMaxEventStringSize];  // 34
+  orbit::Color color;              // 4
+  uint64_t data;                   // 8
+};
+
+union EncodedEvent {
+  EncodedEvent(orbit_api::EventType type, const char* name = nullptr, uint64_t data = 0,
+               orbit::Color color = orbit::Color::kAuto) {
+    static_assert(sizeof(EncodedEvent) == 48, "orbit_api::EncodedEvent should be 48 bytes.");
+    static_assert(sizeof(Event) == 48, "orbit_api::Event should be 48 bytes.");
+    event.version = kVersion;
+    event.type = static_cast<uint8_t>(type);
+    memset(event.name, 0, kMaxEventStringSize);
+    if (name != nullptr) {
+      std::strncpy(event.name, name, kMaxEventStringSize - 1);
+      event.name[kMaxEventStringSize - 1] = 0;
+    }
+    event.data = data;
+    event.color = color;
+  }
+
+  EncodedEvent(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5) {
+    args[0] = a0;
+    args[1] = a1;
+    args[2] = a2;
+    args[3] = a3;
+    args[4] = a4;
+    args[5] = a5;
+  }
+  Event event;
+  uint64_t args[6];
+};
+
+template <typename Dest, typename Source>
+inline Dest Encode(const Source& source) {
+  static_assert(sizeof(Source) <= sizeof(Dest), "orbit_api::Encode destination type is too small");
+  Dest dest = 0;
+  std::memcpy(&dest, &source, sizeof(Source));
+  return dest;
+}
+
+template <typename Dest, typename Source>
+inline Dest Decode(const Source& source) {
+  static_assert(sizeof(Dest) <= sizeof(Source), "orbit_api::Decode destination type is too big");
+  Dest dest = 0;
+  std::memcpy(&dest, &source, sizeof(Dest));
+  return dest;
+}
+
+// Interned names: instead of the name itself, the "name" field of an event can hold the 64-bit id
+// of a name that is sent separately, in chunks, by kNameRegistration events. Such a "name" field
+// starts with kNameIdMarker, followed by the id.
+//
+// A kNameRegistration event holds the id of the name in "data" and a chunk of the name in "name".
+// "color" holds the offset of the chunk in the name, with kLastNameChunkFlag set on the last chunk.
+constexpr char kNameIdMarker = '\x01';
+constexpr uint32_t kLastNameChunkFlag = 0x80000000;
+
+// FNV-1a hash, computed at compile time for string literals.
+constexpr uint64_t HashName(const char* name) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const char* c = name; *c != 0; ++c) {
+    hash = (hash ^ static_cast<uint8_t>(*c)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+inline void SetNameId(Event* event, uint64_t name_id) {
+  static_assert(sizeof(name_id) + 2 <= kMaxEventStringSize, "orbit_api::Event name is too small");
+  event->name[0] = kNameIdMarker;
+  std::memcpy(&event->name[1], &name_id, sizeof(name_id));
+  event->name[1 + sizeof(name_id)] = 0;
+}
+
+inline bool HasNameId(const Event& event) { return event.name[0] == kNameIdMarker; }
+
+inline uint64_t GetNameId(const Event& event) {
+  uint64_t name_id = 0;
+  std::memcpy(&name_id, &event.name[1], sizeof(name_id));
+  return name_id;
+}
+
+// Calls "emit(event)" for each kNameRegistration event needed to send "name".
+template <typename EmitFunction>
+inline void ForEachNameRegistrationEvent(const char* name, uint64_t name_id, EmitFunction emit) {
+  constexpr size_t kChunkSize = kMaxEventStringSize - 1;
+  const size_t size = strlen(name);
+  size_t offset = 0;
+  do {
+    const size_t chunk_size = size - offset < kChunkSize ? size - offset : kChunkSize;
+    const bool is_last_chunk = offset + chunk_size == size;
+    const uint32_t encoded_offset =
+        static_cast<uint32_t>(offset) | (is_last_chunk ? kLastNameChunkFlag : 0);
+    EncodedEvent e(EventType::kNameRegistration, nullptr, name_id,
+                   static_cast<orbit::Color>(encoded_offset));
+    std::memcpy(e.event.name, name + offset, chunk_size);
+    emit(e);
+    offset += chunk_size;
+  } while (offset < size);
+}
+
+// Callbacks of an in-process producer of manual instrumentation events (see
+// OrbitProducer/ManualInstrumentationProducer.h). The producer installs them while a capture is
+// running, in which case events are recorded in-process instead of going through the ORBIT_STUB
+// functions of Orbit.h, avoiding the cost of a uprobe per event.
+struct InProcessProducerCallbacks {
+  void (*start)(const EncodedEvent& event);
+  void (*stop)();
+  // All other events, which don't have a duration.
+  void (*record)(const EncodedEvent& event);
+};
+
+inline std::atomic<const InProcessProducerCallbacks*> in_process_producer_callbacks{nullptr};
+
+}  // namespace orbit_api
+
+#endif  // ORBIT_API_EVENTS_H_
@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 #include "OrbitBase/Tracing.h"
 
 static orbit_api::Event Decode(uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5,
@@ -29,3 +31,54 @@ TEST(OrbitApi, Encoding) {
   EXPECT_EQ(strlen(decoded_event.name), orbit_api::kMaxEventStringSize - 1);
   EXPECT_TRUE(initial_string.find(decoded_event.name) != std::string::npos);
 }
+
+TEST(OrbitApi, NameIdEncoding) {
+  constexpr uint64_t kNameId = orbit_api::HashName("A name that is longer than kMaxEventStringSize");
+  static_assert(kNameId != orbit_api::HashName("Another name"));
+
+  orbit_api::EncodedEvent e(orbit_api::kScopeStart);
+  EXPECT_FALSE(orbit_api::HasNameId(e.event));
+  orbit_api::SetNameId(&e.event, kNameId);
+  auto decoded_event = Decode(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+
+  EXPECT_EQ(decoded_event.type, orbit_api::kScopeStart);
+  EXPECT_TRUE(orbit_api::HasNameId(decoded_event));
+  EXPECT_EQ(orbit_api::GetNameId(decoded_event), kNameId);
+}
+
+TEST(OrbitApi, NameRegistrationEvents) {
+  const std::string name(100, 'x');
+  constexpr uint64_t kNameId = 42;
+
+  std::string registered_name;
+  size_t num_events = 0;
+  bool last_chunk_seen = false;
+  orbit_api::ForEachNameRegistrationEvent(
+      name.c_str(), kNameId, [&](const orbit_api::EncodedEvent& e) {
+        auto event = Decode(e.args[0], e.args[1], e.args[2], e.args[3], e.args[4], e.args[5]);
+        EXPECT_EQ(event.type, orbit_api::kNameRegistration);
+        EXPECT_EQ(event.data, kNameId);
+        EXPECT_FALSE(last_chunk_seen);
+        const auto encoded_offset = static_cast<uint32_t>(event.color);
+        EXPECT_EQ(encoded_offset & ~orbit_api::kLastNameChunkFlag, registered_name.size());
+        last_chunk_seen = (encoded_offset & orbit_api::kLastNameChunkFlag) != 0;
+        registered_name.append(event.name);
+        ++num_events;
+      });
+
+  EXPECT_TRUE(last_chunk_seen);
+  EXPECT_EQ(registered_name, name);
+  EXPECT_EQ(num_events, 4);
+}
+
+TEST(OrbitApi, InternedNameIsRegisteredPeriodically) {
+  orbit_api::InternedName name("name");
+  EXPECT_EQ(name.GetId(), orbit_api::HashName("name"));
+
+  size_t num_registrations = 0;
+  for (size_t i = 0; i < 1000; ++i) {
+    if (name.NeedsRegistration()) ++num_registrations;
+  }
+  EXPECT_GT(num_registrations, 1);
+  EXPECT_LT(num_registrations, 100);
+}
@@ -4,21 +4,131 @@
 
 #include "OrbitBase/Tracing.h"
 
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+
+#include <algorithm>
 #include <memory>
 #include <vector>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Profiling.h"
-#include "OrbitBase/ThreadPool.h"
 #include "OrbitBase/ThreadUtils.h"
 
 using orbit_base::TracingListener;
 using orbit_base::TracingScope;
 using orbit_base::TracingTimerCallback;
 
+namespace {
+
+// Single-producer, single-consumer ring buffer of TracingScopes. The producer is the instrumented
+// thread owning the buffer, the consumer is the thread of the TracingListener.
+class ScopeBuffer {
+ public:
+  static constexpr uint64_t kCapacity = 1024;
+
+  ScopeBuffer() : scopes_(kCapacity, TracingScope(orbit_api::kNone)) {}
+
+  // Called from the owning thread only. Returns true if the buffer just became half full, in which
+  // case the listener should be woken up before the buffer overflows.
+  bool Push(const TracingScope& scope) {
+    const uint64_t write_index = write_index_.load(std::memory_order_relaxed);
+    const uint64_t size = write_index - read_index_.load(std::memory_order_acquire);
+    if (size == kCapacity) {
+      num_dropped_scopes_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    scopes_[write_index % kCapacity] = scope;
+    write_index_.store(write_index + 1, std::memory_order_release);
+    return size + 1 == kCapacity / 2;
+  }
+
+  // Called from the listener thread only.
+  void PopAll(std::vector<TracingScope>* scopes) {
+    uint64_t read_index = read_index_.load(std::memory_order_relaxed);
+    const uint64_t write_index = write_index_.load(std::memory_order_acquire);
+    for (; read_index < write_index; ++read_index) {
+      scopes->push_back(scopes_[read_index % kCapacity]);
+    }
+    read_index_.store(write_index, std::memory_order_release);
+  }
+
+  // Drops the scopes that were not consumed by a previous listener. Must not be called while a
+  // listener thread is running.
+  void Discard() {
+    read_index_.store(write_index_.load(std::memory_order_acquire), std::memory_order_release);
+    num_dropped_scopes_ = 0;
+  }
+
+  [[nodiscard]] uint64_t TakeNumDroppedScopes() { return num_dropped_scopes_.exchange(0); }
+
+  void SetThreadExited() { thread_exited_ = true; }
+  [[nodiscard]] bool HasThreadExited() const { return thread_exited_; }
+
+ private:
+  std::vector<TracingScope> scopes_;
+  std::atomic<uint64_t> write_index_ = 0;
+  std::atomic<uint64_t> read_index_ = 0;
+  std::atomic<uint64_t> num_dropped_scopes_ = 0;
+  std::atomic<bool> thread_exited_ = false;
+};
+
+// Registers the buffer of the current thread on construction and flags it on thread exit, so that
+// the listener can release it once it has been drained.
+class ThreadLocalScopeBuffer {
+ public:
+  ThreadLocalScopeBuffer();
+  ~ThreadLocalScopeBuffer() { buffer_->SetThreadExited(); }
+
+  [[nodiscard]] ScopeBuffer* Get() const { return buffer_.get(); }
+
+ private:
+  std::shared_ptr<ScopeBuffer> buffer_ = std::make_shared<ScopeBuffer>();
+};
+
+// Set on the listener thread, whose own scopes (e.g. from the user callback) are ignored to prevent
+// a feedback loop.
+thread_local bool is_listener_thread = false;
+
+// The scope is emitted at "end" for synchronous scopes and at "begin" for all other events.
+[[nodiscard]] uint64_t GetEmissionTimestamp(const TracingScope& scope) {
+  return scope.encoded_event.event.type == orbit_api::kScopeStart ? scope.end : scope.begin;
+}
+
+}  // namespace
+
 ABSL_CONST_INIT static absl::Mutex global_tracing_mutex(absl::kConstInit);
 ABSL_CONST_INIT static TracingListener* global_tracing_listener = nullptr;
 
+// The listener thread sleeps while the buffers are empty, increasingly long, and is woken up early
+// when a buffer fills up or when the listener stops.
+ABSL_CONST_INIT static absl::Mutex listener_wakeup_mutex(absl::kConstInit);
+ABSL_CONST_INIT static bool listener_wakeup_requested ABSL_GUARDED_BY(listener_wakeup_mutex) =
+    false;
+
+static void WakeUpListener() {
+  absl::MutexLock lock(&listener_wakeup_mutex);
+  listener_wakeup_requested = true;
+}
+
+static void WaitForListenerWakeUp(absl::Duration timeout) {
+  absl::MutexLock lock(&listener_wakeup_mutex);
+  listener_wakeup_mutex.AwaitWithTimeout(absl::Condition(&listener_wakeup_requested), timeout);
+  listener_wakeup_requested = false;
+}
+
+// Protected by global_tracing_mutex. Intentionally leaked, as threads can still exit while static
+// objects are being destroyed.
+static std::vector<std::shared_ptr<ScopeBuffer>>& GetScopeBuffers() {
+  static auto* scope_buffers = new std::vector<std::shared_ptr<ScopeBuffer>>();
+  return *scope_buffers;
+}
+
+ThreadLocalScopeBuffer::ThreadLocalScopeBuffer() {
+  absl::MutexLock lock(&global_tracing_mutex);
+  GetScopeBuffers().push_back(buffer_);
+}
+
 namespace orbit_base {
 
 TracingScope::TracingScope(orbit_api::EventType type, const char* name, uint64_t data,
@@ -26,43 +136,97 @@ TracingScope::TracingScope(orbit_api::EventType type, const char* name, uint64_t
     : encoded_event(type, name, data, color) {}
 
 TracingListener::TracingListener(TracingTimerCallback callback) {
-  constexpr size_t kMinNumThreads = 1;
-  constexpr size_t kMaxNumThreads = 1;
-  thread_pool_ = ThreadPool::Create(kMinNumThreads, kMaxNumThreads, absl::Milliseconds(500));
-  thread_pool_->EnableAutoProfiling(false);  // To prevent feedback loop.
   user_callback_ = std::move(callback);
 
-  // Activate listener (only one listener instance is supported).
-  absl::MutexLock lock(&global_tracing_mutex);
-  CHECK(!IsActive());
-  global_tracing_listener = this;
-  active_ = true;
+  {
+    // Activate listener (only one listener instance is supported).
+    absl::MutexLock lock(&global_tracing_mutex);
+    CHECK(!IsActive());
+    for (const std::shared_ptr<ScopeBuffer>& buffer : GetScopeBuffers()) {
+      buffer->Discard();
+    }
+    global_tracing_listener = this;
+    active_ = true;
+  }
+
+  thread_ = std::thread([this] { Run(); });
 }
 
 TracingListener::~TracingListener() {
-  // Purge deferred scopes.
-  thread_pool_->Shutdown();
-  thread_pool_->Wait();
+  // Deactivate listener and purge remaining scopes.
+  active_ = false;
+  exit_requested_ = true;
+  WakeUpListener();
+  thread_.join();
 
-  // Deactivate listener.
   absl::MutexLock lock(&global_tracing_mutex);
-  CHECK(IsActive());
-  active_ = false;
+  CHECK(global_tracing_listener == this);
   global_tracing_listener = nullptr;
+
+  const uint64_t num_dropped_scopes = GetNumDroppedScopes();
+  if (num_dropped_scopes > 0) {
+    ERROR("Dropped %lu introspection scopes because of full thread buffers", num_dropped_scopes);
+  }
+}
+
+void TracingListener::Run() {
+  is_listener_thread = true;
+  SetCurrentThreadName("TracingListener");
+
+  const absl::Duration kMinSleepOnEmptyBuffers = absl::Milliseconds(1);
+  const absl::Duration kMaxSleepOnEmptyBuffers = absl::Milliseconds(32);
+  absl::Duration sleep_on_empty_buffers = kMinSleepOnEmptyBuffers;
+  std::vector<TracingScope> scopes;
+  while (!exit_requested_) {
+    if (ProcessScopes(&scopes) > 0) {
+      sleep_on_empty_buffers = kMinSleepOnEmptyBuffers;
+      continue;
+    }
+    WaitForListenerWakeUp(sleep_on_empty_buffers);
+    sleep_on_empty_buffers = std::min(2 * sleep_on_empty_buffers, kMaxSleepOnEmptyBuffers);
+  }
+  ProcessScopes(&scopes);
+}
+
+size_t TracingListener::ProcessScopes(std::vector<TracingScope>* scopes) {
+  scopes->clear();
+  {
+    absl::MutexLock lock(&global_tracing_mutex);
+    std::vector<std::shared_ptr<ScopeBuffer>>& buffers = GetScopeBuffers();
+    auto buffer_it = buffers.begin();
+    while (buffer_it != buffers.end()) {
+      ScopeBuffer* buffer = buffer_it->get();
+      // Check before draining, as a thread that has exited can't add scopes anymore.
+      const bool thread_exited = buffer->HasThreadExited();
+      buffer->PopAll(scopes);
+      num_dropped_scopes_ += buffer->TakeNumDroppedScopes();
+      buffer_it = thread_exited ? buffers.erase(buffer_it) : buffer_it + 1;
+    }
+  }
+
+  // Scopes are consumed one thread at a time. Restore the order in which they were emitted across
+  // threads, at least within a batch, e.g. for async scopes started and stopped on different
+  // threads.
+  std::stable_sort(scopes->begin(), scopes->end(),
+                   [](const TracingScope& lhs, const TracingScope& rhs) {
+                     return GetEmissionTimestamp(lhs) < GetEmissionTimestamp(rhs);
+                   });
+  for (const TracingScope& scope : *scopes) {
+    user_callback_(scope);
+  }
+  return scopes->size();
 }
 
 }  // namespace orbit_base
 
 void TracingListener::DeferScopeProcessing(const TracingScope& scope) {
-  // User callback is called from a worker thread to
+  // Scopes are only buffered here, the user callback is called from the listener thread to
   // minimize contention on the instrumented threads.
-  absl::MutexLock lock(&global_tracing_mutex);
-  if (!IsActive()) return;
-  global_tracing_listener->thread_pool_->Schedule([scope]() {
-    absl::MutexLock lock(&global_tracing_mutex);
-    if (!IsActive()) return;
-    global_tracing_listener->user_callback_(scope);
-  });
+  if (!IsActive() || is_listener_thread) return;
+  thread_local ThreadLocalScopeBuffer thread_local_buffer;
+  if (thread_local_buffer.Get()->Push(scope)) {
+    WakeUpListener();
+  }
 }
 
 #ifdef ORBIT_API_INTERNAL_IMPL
@@ -109,6 +273,9 @@ void StopAsync(uint64_t id) {
 void AsyncString(const char* str, uint64_t id, orbit::Color color) {
   if (str == nullptr) return;
   TracingScope scope(orbit_api::kString, /*name*/ nullptr, id, color);
+  scope.begin = MonotonicTimestampNs();
+  scope.end = scope.begin;
+  scope.tid = static_cast<uint32_t>(orbit_base::GetCurrentThreadId());
   auto& e = scope.encoded_event;
   constexpr size_t chunk_size = kMaxEventStringSize - 1;
   const char* end = str + strlen(str);
@@ -127,6 +294,46 @@ void TrackValue(orbit_api::EventType type, const char* name, uint64_t value, orb
   TracingListener::DeferScopeProcessing(scope);
 }
 
+static void RegisterNameIfNeeded(const InternedName& name) {
+  if (!name.NeedsRegistration()) return;
+  TracingScope scope(orbit_api::kNameRegistration);
+  scope.begin = MonotonicTimestampNs();
+  scope.end = scope.begin;
+  scope.tid = static_cast<uint32_t>(orbit_base::GetCurrentThreadId());
+  ForEachNameRegistrationEvent(name.GetName(), name.GetId(), [&scope](const EncodedEvent& e) {
+    scope.encoded_event = e;
+    TracingListener::DeferScopeProcessing(scope);
+  });
+}
+
+void Start(const InternedName& name, orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  auto& scope = GetThreadLocalScopes().emplace_back(
+      TracingScope(orbit_api::kScopeStart, /*name*/ nullptr, /*data*/ 0, color));
+  SetNameId(&scope.encoded_event.event, name.GetId());
+  scope.begin = MonotonicTimestampNs();
+}
+
+void StartAsync(const InternedName& name, uint64_t id, orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  TracingScope scope(orbit_api::kScopeStartAsync, /*name*/ nullptr, id, color);
+  SetNameId(&scope.encoded_event.event, name.GetId());
+  scope.begin = MonotonicTimestampNs();
+  scope.end = scope.begin;
+  scope.tid = static_cast<uint32_t>(orbit_base::GetCurrentThreadId());
+  TracingListener::DeferScopeProcessing(scope);
+}
+
+void TrackValue(orbit_api::EventType type, const InternedName& name, uint64_t value,
+                orbit::Color color) {
+  RegisterNameIfNeeded(name);
+  TracingScope scope(type, /*name*/ nullptr, value, color);
+  SetNameId(&scope.encoded_event.event, name.GetId());
+  scope.begin = MonotonicTimestampNs();
+  scope.tid = static_cast<uint32_t>(orbit_base::GetCurrentThreadId());
+  TracingListener::DeferScopeProcessing(scope);
+}
+
 }  // namespace orbit_api
 
 #endif
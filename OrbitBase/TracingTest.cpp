@@ -4,14 +4,18 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "OrbitBase/Profiling.h"
 #include "OrbitBase/ThreadUtils.h"
 #include "OrbitBase/Tracing.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/notification.h"
 
 using orbit_base::TracingListener;
 using orbit_base::TracingScope;
@@ -53,3 +57,63 @@ TEST(Tracing, Scopes) {
     EXPECT_EQ(pair.second.size(), kNumExpectedScopesPerThread);
   }
 }
+
+TEST(Tracing, DropsScopesWhenThreadBufferIsFull) {
+  constexpr size_t kNumScopes = 4096;
+
+  absl::Notification scopes_emitted;
+  std::atomic<size_t> num_received_scopes = 0;
+  uint64_t num_dropped_scopes = 0;
+  {
+    TracingListener tracing_listener([&](const TracingScope& /*scope*/) {
+      // Block the listener thread until all scopes were emitted, so that the buffer fills up.
+      scopes_emitted.WaitForNotification();
+      ++num_received_scopes;
+    });
+
+    std::thread thread([&scopes_emitted] {
+      for (size_t i = 0; i < kNumScopes; ++i) {
+        ORBIT_SCOPE("TEST_ORBIT_SCOPE");
+      }
+      scopes_emitted.Notify();
+    });
+    thread.join();
+
+    // Each scope is eventually either received or counted as dropped.
+    while (num_received_scopes + tracing_listener.GetNumDroppedScopes() < kNumScopes) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    num_dropped_scopes = tracing_listener.GetNumDroppedScopes();
+  }
+
+  EXPECT_GT(num_dropped_scopes, 0);
+  EXPECT_EQ(num_received_scopes + num_dropped_scopes, kNumScopes);
+}
+
+TEST(Tracing, InternedScopes) {
+  constexpr const char* kName = "A scope name that is longer than kMaxEventStringSize";
+
+  std::vector<TracingScope> scopes;
+  {
+    TracingListener tracing_listener(
+        [&scopes](const TracingScope& scope) { scopes.emplace_back(scope); });
+    std::thread thread([] { ORBIT_SCOPE_INTERNED(kName); });
+    thread.join();
+  }
+
+  // The name is registered in chunks before the scope using it.
+  ASSERT_GE(scopes.size(), 2);
+  std::string registered_name;
+  for (size_t i = 0; i + 1 < scopes.size(); ++i) {
+    const orbit_api::Event& event = scopes[i].encoded_event.event;
+    EXPECT_EQ(event.type, orbit_api::kNameRegistration);
+    EXPECT_EQ(event.data, orbit_api::HashName(kName));
+    registered_name.append(event.name);
+  }
+  EXPECT_EQ(registered_name, kName);
+
+  const orbit_api::Event& scope_event = scopes.back().encoded_event.event;
+  EXPECT_EQ(scope_event.type, orbit_api::kScopeStart);
+  ASSERT_TRUE(orbit_api::HasNameId(scope_event));
+  EXPECT_EQ(orbit_api::GetNameId(scope_event), orbit_api::HashName(kName));
+}
@@ -5,8 +5,12 @@
 #ifndef ORBIT_BASE_TRACING_H_
 #define ORBIT_BASE_TRACING_H_
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #define ORBIT_API_INTERNAL_IMPL
 // NOTE: Orbit.h will be moved to its own
@@ -31,18 +35,33 @@ struct TracingScope {
 
 using TracingTimerCallback = std::function<void(const TracingScope& scope)>;
 
+// TracingListener receives the scopes produced by the ORBIT_* macros of all threads of the process
+// and calls the user callback for each of them. Each instrumented thread writes its scopes into its
+// own lock-free, fixed-size ring buffer, so that the instrumented threads never wait for each other
+// or for the callback. A single listener thread drains those buffers in batches and calls the
+// callback. When a ring buffer is full, new scopes of that thread are dropped and counted.
 class TracingListener {
  public:
   explicit TracingListener(TracingTimerCallback callback);
   ~TracingListener();
 
   static void DeferScopeProcessing(const TracingScope& scope);
-  [[nodiscard]] inline static bool IsActive() { return active_; }
+  [[nodiscard]] inline static bool IsActive() { return active_.load(std::memory_order_relaxed); }
+
+  // Number of scopes that were dropped because the buffer of their thread was full.
+  [[nodiscard]] uint64_t GetNumDroppedScopes() const {
+    return num_dropped_scopes_.load(std::memory_order_relaxed);
+  }
 
  private:
+  void Run();
+  size_t ProcessScopes(std::vector<TracingScope>* scopes);
+
   TracingTimerCallback user_callback_ = nullptr;
-  std::unique_ptr<ThreadPool> thread_pool_ = {};
-  inline static bool active_ = false;
+  std::thread thread_;
+  std::atomic<bool> exit_requested_ = false;
+  std::atomic<uint64_t> num_dropped_scopes_ = 0;
+  inline static std::atomic<bool> active_ = false;
 };
 
 }  // namespace orbit_base
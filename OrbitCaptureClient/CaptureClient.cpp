@@ -12,10 +12,19 @@
 #include "OrbitClientData/ProcessData.h"
 #include "absl/flags/flag.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 
 ABSL_DECLARE_FLAG(uint16_t, sampling_rate);
 ABSL_DECLARE_FLAG(bool, frame_pointer_unwinding);
+ABSL_DECLARE_FLAG(bool, hybrid_unwinding);
+ABSL_DECLARE_FLAG(bool, repair_leaf_frames);
 ABSL_DECLARE_FLAG(bool, thread_state);
+ABSL_DECLARE_FLAG(bool, limit_scheduler_events_to_target);
+ABSL_DECLARE_FLAG(uint32_t, max_ring_buffers_memory_mb);
+ABSL_DECLARE_FLAG(uint32_t, stack_dump_size);
+ABSL_DECLARE_FLAG(bool, adaptive_stack_dump_copy);
+ABSL_DECLARE_FLAG(uint32_t, gpu_sampling_period_frames);
+ABSL_DECLARE_FLAG(uint32_t, max_gpu_timestamps_per_frame);
 
 using orbit_client_protos::FunctionInfo;
 
@@ -36,6 +45,35 @@ static CaptureOptions::InstrumentedFunction::FunctionType InstrumentedFunctionTy
   }
 }
 
+// Hybrid unwinding only unwinds with DWARF the callchains through modules in which frame-pointer
+// validation found functions without frame pointers. Without any validated module, it would
+// silently fall back to frame-pointer unwinding.
+static ErrorMessageOr<void> CheckModulesAreValidatedForHybridUnwinding(
+    const ProcessData& process, const orbit_client_data::ModuleManager& module_manager) {
+  std::vector<std::string> not_validated_module_paths;
+  size_t num_validated_modules = 0;
+  for (const auto& [module_path, unused_memory_space] : process.GetMemoryMap()) {
+    const ModuleData* module = module_manager.GetModuleByPath(module_path);
+    if (module != nullptr && module->is_frame_pointer_validated()) {
+      ++num_validated_modules;
+    } else {
+      not_validated_module_paths.push_back(module_path);
+    }
+  }
+  if (num_validated_modules == 0) {
+    return ErrorMessage(
+        "Hybrid unwinding needs the modules of the target process to be validated for frame "
+        "pointers. Start Orbit with --enable_frame_pointer_validator and validate the modules "
+        "from the Modules view first.");
+  }
+  if (!not_validated_module_paths.empty()) {
+    LOG("Warning: Callstacks through these modules are only unwound with frame pointers, as "
+        "they were not validated for frame pointers: %s",
+        absl::StrJoin(not_validated_module_paths, ", "));
+  }
+  return outcome::success();
+}
+
 ErrorMessageOr<void> CaptureClient::StartCapture(
     ThreadPool* thread_pool, const ProcessData& process,
     const orbit_client_data::ModuleManager& module_manager,
@@ -49,6 +87,11 @@ ErrorMessageOr<void> CaptureClient::StartCapture(
         "running/stopping.");
   }
 
+  if (absl::GetFlag(FLAGS_hybrid_unwinding) && absl::GetFlag(FLAGS_sampling_rate) != 0) {
+    ErrorMessageOr<void> result = CheckModulesAreValidatedForHybridUnwinding(process, module_manager);
+    if (result.has_error()) return result.error();
+  }
+
   state_ = State::kStarting;
 
   // TODO(168797897) Here a copy of the process is created. The loaded modules of this process were
@@ -95,7 +138,15 @@ void CaptureClient::Capture(ProcessData&& process,
     capture_options->set_unwinding_method(CaptureOptions::kUndefined);
   } else {
     capture_options->set_sampling_rate(sampling_rate);
-    if (absl::GetFlag(FLAGS_frame_pointer_unwinding)) {
+    if (absl::GetFlag(FLAGS_hybrid_unwinding)) {
+      capture_options->set_unwinding_method(CaptureOptions::kHybrid);
+      for (const auto& [module_path, unused_memory_space] : process.GetMemoryMap()) {
+        const ModuleData* module = module_manager.GetModuleByPath(module_path);
+        if (module != nullptr && module->has_functions_without_frame_pointers()) {
+          capture_options->add_modules_without_frame_pointers(module_path);
+        }
+      }
+    } else if (absl::GetFlag(FLAGS_frame_pointer_unwinding)) {
       capture_options->set_unwinding_method(CaptureOptions::kFramePointers);
     } else {
       capture_options->set_unwinding_method(CaptureOptions::kDwarf);
@@ -103,7 +154,17 @@ void CaptureClient::Capture(ProcessData&& process,
   }
 
   capture_options->set_trace_thread_state(absl::GetFlag(FLAGS_thread_state));
+  capture_options->set_limit_scheduler_events_to_target(
+      absl::GetFlag(FLAGS_limit_scheduler_events_to_target));
+  capture_options->set_max_ring_buffers_memory_mb(absl::GetFlag(FLAGS_max_ring_buffers_memory_mb));
+  capture_options->set_stack_dump_size(absl::GetFlag(FLAGS_stack_dump_size));
+  capture_options->set_adaptive_stack_dump_copy(absl::GetFlag(FLAGS_adaptive_stack_dump_copy));
+  capture_options->set_repair_leaf_frames(absl::GetFlag(FLAGS_repair_leaf_frames));
   capture_options->set_trace_gpu_driver(true);
+  capture_options->set_gpu_command_buffer_sampling_period_frames(
+      absl::GetFlag(FLAGS_gpu_sampling_period_frames));
+  capture_options->set_max_gpu_timestamps_per_frame(
+      absl::GetFlag(FLAGS_max_gpu_timestamps_per_frame));
   for (const auto& [absolute_address, function] : selected_functions) {
     CaptureOptions::InstrumentedFunction* instrumented_function =
         capture_options->add_instrumented_functions();
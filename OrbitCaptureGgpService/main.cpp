@@ -26,7 +26,26 @@ ABSL_FLAG(std::string, log_directory, "",
           "Path to locate debug file. By default only stdout is used for logs");
 ABSL_FLAG(uint16_t, sampling_rate, 1000, "Frequency of callstack sampling in samples per second");
 ABSL_FLAG(bool, frame_pointer_unwinding, false, "Use frame pointers for unwinding");
+ABSL_FLAG(bool, hybrid_unwinding, false,
+          "Use frame pointers for unwinding, and DWARF information only for the samples in modules "
+          "found without frame pointers by frame-pointer validation");
+ABSL_FLAG(bool, repair_leaf_frames, false,
+          "With frame-pointer or hybrid unwinding, add the callers that callchains miss when "
+          "samples fall into prologues, epilogues, or leaf functions without frames");
 ABSL_FLAG(bool, thread_state, false, "Collect thread states");
+ABSL_FLAG(bool, limit_scheduler_events_to_target, false,
+          "Only record context switches and thread state changes of the target process");
+ABSL_FLAG(uint32_t, max_ring_buffers_memory_mb, 0,
+          "Maximum memory used by the kernel ring buffers of the capture (0 means no limit)");
+ABSL_FLAG(uint32_t, stack_dump_size, 0,
+          "Bytes of the stack copied with each sample when unwinding with DWARF, in hybrid "
+          "mode, or when repairing leaf frames (0 means the default, at most 65000)");
+ABSL_FLAG(bool, adaptive_stack_dump_copy, false,
+          "Only keep as much of each stack dump as unwinding the same thread previously needed");
+ABSL_FLAG(uint32_t, gpu_sampling_period_frames, 1,
+          "Only record GPU command buffer timings in one frame out of this many");
+ABSL_FLAG(uint32_t, max_gpu_timestamps_per_frame, 0,
+          "Maximum number of GPU timestamps written per frame (0 means no limit)");
 
 namespace {
 
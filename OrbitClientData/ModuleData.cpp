@@ -18,6 +18,23 @@ bool ModuleData::is_loaded() const {
   return is_loaded_;
 }
 
+bool ModuleData::has_functions_without_frame_pointers() const {
+  absl::MutexLock lock(&mutex_);
+  return has_functions_without_frame_pointers_;
+}
+
+bool ModuleData::is_frame_pointer_validated() const {
+  absl::MutexLock lock(&mutex_);
+  return is_frame_pointer_validated_;
+}
+
+void ModuleData::set_has_functions_without_frame_pointers(
+    bool has_functions_without_frame_pointers) {
+  absl::MutexLock lock(&mutex_);
+  has_functions_without_frame_pointers_ = has_functions_without_frame_pointers;
+  is_frame_pointer_validated_ = true;
+}
+
 void ModuleData::UpdateIfChanged(ModuleInfo info) {
   absl::MutexLock lock(&mutex_);
 
@@ -36,6 +53,8 @@ void ModuleData::UpdateIfChanged(ModuleInfo info) {
   if (all_module_properties_matching) return;
 
   LOG("Module %s changed.", file_path());
+  has_functions_without_frame_pointers_ = false;
+  is_frame_pointer_validated_ = false;
 
   if (!is_loaded_) return;
 
@@ -39,6 +39,8 @@ TEST(ModuleData, Constructor) {
   EXPECT_EQ(module.load_bias(), load_bias);
   EXPECT_FALSE(module.is_loaded());
   EXPECT_TRUE(module.GetFunctions().empty());
+  EXPECT_FALSE(module.has_functions_without_frame_pointers());
+  EXPECT_FALSE(module.is_frame_pointer_validated());
 }
 
 TEST(ModuleData, LoadSymbols) {
@@ -230,6 +232,14 @@ TEST(ModuleData, UpdateIfChanged) {
   module.UpdateIfChanged(module_info);
   EXPECT_FALSE(module.is_loaded());
 
+  // the result of frame-pointer validation is also reset
+  module.set_has_functions_without_frame_pointers(true);
+  EXPECT_TRUE(module.is_frame_pointer_validated());
+  module_info.set_build_id("different build id again");
+  module.UpdateIfChanged(module_info);
+  EXPECT_FALSE(module.has_functions_without_frame_pointers());
+  EXPECT_FALSE(module.is_frame_pointer_validated());
+
   // file_path is not allowed to be changed
   module_info.set_file_path("changed/path");
   EXPECT_DEATH(module.UpdateIfChanged(module_info), "Check failed");
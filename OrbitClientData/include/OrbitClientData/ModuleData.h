@@ -41,11 +41,20 @@ class ModuleData final {
   [[nodiscard]] const orbit_client_protos::FunctionInfo* FindFunctionFromHash(uint64_t hash) const;
   [[nodiscard]] const std::vector<const orbit_client_protos::FunctionInfo*> GetFunctions() const;
   [[nodiscard]] std::vector<orbit_client_protos::FunctionInfo> GetOrbitFunctions() const;
+  // Whether frame-pointer validation found functions compiled without frame pointers in this
+  // module. This is false until the module has been validated, and again when the module changes.
+  [[nodiscard]] bool has_functions_without_frame_pointers() const;
+  // Whether frame-pointer validation ran on the current version of this module.
+  [[nodiscard]] bool is_frame_pointer_validated() const;
+  // Records the result of frame-pointer validation.
+  void set_has_functions_without_frame_pointers(bool has_functions_without_frame_pointers);
 
  private:
   mutable absl::Mutex mutex_;
   orbit_grpc_protos::ModuleInfo module_info_;
   bool is_loaded_;
+  bool has_functions_without_frame_pointers_ = false;
+  bool is_frame_pointer_validated_ = false;
   std::map<uint64_t, std::unique_ptr<orbit_client_protos::FunctionInfo>> functions_;
   // TODO(168799822) This is a map of hash to function used for preset loading. Currently presets
   // are based on a hash of the functions pretty name. This should be changed to not use hashes
@@ -6,10 +6,38 @@
 
 #include <capstone/capstone.h>
 
+#include <algorithm>
 #include <iostream>
+#include <optional>
 
 #include "OrbitBase/Logging.h"
 
+namespace {
+
+void AddFramelessCodeRange(std::vector<FramelessCodeRange>* ranges, const cs_insn& instruction,
+                           uint64_t return_address_stack_offset) {
+  if (!ranges->empty() && ranges->back().end_offset == instruction.address &&
+      ranges->back().return_address_stack_offset == return_address_stack_offset) {
+    ranges->back().end_offset += instruction.size;
+    return;
+  }
+  ranges->push_back(FramelessCodeRange{instruction.address, instruction.address + instruction.size,
+                                       return_address_stack_offset});
+}
+
+bool IsReturnOrTailCall(const cs_insn& instruction) {
+  return instruction.id == X86_INS_RET || instruction.id == X86_INS_JMP;
+}
+
+bool IsReturnInstruction(const cs_insn& instruction) {
+  for (uint8_t i = 0; i < instruction.detail->groups_count; i++) {
+    if (instruction.detail->groups[i] == X86_GRP_RET) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
 FunctionFramePointerValidator::FunctionFramePointerValidator(csh handle, const uint8_t* code,
                                                              size_t code_size) {
   handle_ = handle;
@@ -168,4 +196,141 @@ bool FunctionFramePointerValidator::Validate() {
   bool validated = IsLeafFunction() || (instructions_count_ >= 4 && ValidateFramePointers());
 
   return validated;
-}
\ No newline at end of file
+}
+
+std::vector<FramelessCodeRange> FunctionFramePointerValidator::GetFramelessCodeRanges() {
+  if (instructions_count_ == 0) {
+    ERROR("Failed to disassemble given code!");
+    return {};
+  }
+  if (instructions_count_ >= 4 && ValidateFramePointers()) {
+    return GetFramelessCodeRangesWithFrame();
+  }
+  if (IsLeafFunction()) {
+    return GetFramelessCodeRangesOfLeafFunction();
+  }
+  return {};
+}
+
+std::vector<FramelessCodeRange> FunctionFramePointerValidator::GetFramelessCodeRangesWithFrame() {
+  std::vector<FramelessCodeRange> ranges;
+  // Before "push ebp" or "enter", the return address is at the top of the stack.
+  AddFramelessCodeRange(&ranges, instructions_[0], 0);
+  if (instructions_[0].id != X86_INS_ENTER) {
+    // Before "mov ebp, esp", it is right above the pushed base pointer.
+    AddFramelessCodeRange(&ranges, instructions_[1], instructions_[0].detail->x86.operands[0].size);
+  }
+
+  // After "leave" or "pop ebp", it is at the top of the stack again.
+  for (size_t i = 1; i < instructions_count_; i++) {
+    if (!IsReturnOrTailCall(instructions_[i])) {
+      continue;
+    }
+    const cs_insn& previous_instruction = instructions_[i - 1];
+    const cs_x86& previous_x86 = previous_instruction.detail->x86;
+    if (previous_instruction.id == X86_INS_LEAVE ||
+        (previous_instruction.id == X86_INS_POP && previous_x86.op_count == 1 &&
+         previous_x86.operands[0].type == X86_OP_REG &&
+         IsBasePointer(previous_x86.operands[0].reg))) {
+      AddFramelessCodeRange(&ranges, instructions_[i], 0);
+    }
+  }
+  return ranges;
+}
+
+std::optional<size_t> FunctionFramePointerValidator::FindInstruction(uint64_t address) const {
+  const cs_insn* begin = instructions_;
+  const cs_insn* end = instructions_ + instructions_count_;
+  const cs_insn* instruction =
+      std::lower_bound(begin, end, address, [](const cs_insn& insn, uint64_t value) {
+        return insn.address < value;
+      });
+  if (instruction == end || instruction->address != address) return std::nullopt;
+  return instruction - begin;
+}
+
+std::vector<FramelessCodeRange>
+FunctionFramePointerValidator::GetFramelessCodeRangesOfLeafFunction() {
+  // The stack offset at each instruction is propagated along the branches of the function, as with
+  // shrink-wrapping, code after an unconditional jump can be at any stack offset.
+  std::vector<std::optional<int64_t>> stack_offsets(instructions_count_);
+  std::vector<size_t> instructions_to_visit;
+  // Returns false if the instruction was already reached at a different stack offset.
+  auto reach = [&stack_offsets, &instructions_to_visit](size_t index, int64_t stack_offset) {
+    if (stack_offsets[index].has_value()) return stack_offsets[index].value() == stack_offset;
+    stack_offsets[index] = stack_offset;
+    instructions_to_visit.push_back(index);
+    return true;
+  };
+  reach(0, 0);
+
+  const uint64_t code_end = instructions_[instructions_count_ - 1].address +
+                            instructions_[instructions_count_ - 1].size;
+  while (!instructions_to_visit.empty()) {
+    const size_t i = instructions_to_visit.back();
+    instructions_to_visit.pop_back();
+    const cs_insn& instruction = instructions_[i];
+    const cs_x86& x86 = instruction.detail->x86;
+    int64_t stack_offset = stack_offsets[i].value();
+
+    // Returns and tail calls have to leave the stack as it was at the entry.
+    if (IsReturnInstruction(instruction)) {
+      if (stack_offset != 0) return {};
+      continue;
+    }
+    if (IsRetOrJumpInstruction(instruction)) {
+      if (x86.op_count == 1 && x86.operands[0].type == X86_OP_IMM) {
+        const auto target = static_cast<uint64_t>(x86.operands[0].imm);
+        if (target < code_end) {
+          std::optional<size_t> target_index = FindInstruction(target);
+          if (!target_index.has_value() || !reach(target_index.value(), stack_offset)) return {};
+        } else if (stack_offset != 0) {
+          return {};
+        }
+      }
+      // The code reached only through indirect jumps, e.g., from jump tables, is not followed.
+      if (instruction.id == X86_INS_JMP) continue;
+    } else {
+      const bool is_stack_pointer_adjustment =
+          (instruction.id == X86_INS_SUB || instruction.id == X86_INS_ADD) && x86.op_count == 2 &&
+          x86.operands[0].type == X86_OP_REG && IsStackPointer(x86.operands[0].reg) &&
+          x86.operands[1].type == X86_OP_IMM;
+      if (instruction.id == X86_INS_PUSH) {
+        stack_offset += x86.operands[0].size;
+      } else if (instruction.id == X86_INS_POP) {
+        stack_offset -= x86.operands[0].size;
+      } else if (is_stack_pointer_adjustment) {
+        stack_offset += instruction.id == X86_INS_SUB ? x86.operands[1].imm : -x86.operands[1].imm;
+      } else {
+        cs_regs regs_read, regs_write;
+        uint8_t read_count, write_count;
+        if (cs_regs_access(handle_, &instruction, regs_read, &read_count, regs_write,
+                           &write_count) != 0) {
+          return {};
+        }
+        for (uint8_t j = 0; j < write_count; j++) {
+          // The base pointer is only allowed to be saved and restored, as otherwise the rest of
+          // the callchain is wrong anyway.
+          if (IsStackPointer(regs_write[j]) || IsBasePointer(regs_write[j])) {
+            return {};
+          }
+        }
+      }
+      if (stack_offset < 0) {
+        return {};
+      }
+    }
+
+    if (i + 1 < instructions_count_ && !reach(i + 1, stack_offset)) {
+      return {};
+    }
+  }
+
+  std::vector<FramelessCodeRange> ranges;
+  for (size_t i = 0; i < instructions_count_; i++) {
+    if (stack_offsets[i].has_value()) {
+      AddFramelessCodeRange(&ranges, instructions_[i], stack_offsets[i].value());
+    }
+  }
+  return ranges;
+}
@@ -2,9 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 #include <capstone/capstone.h>
-#include <gmock/gmock-matchers.h>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
 #include "include/OrbitFramePointerValidator/FunctionFramePointerValidator.h"
 
 namespace {
@@ -46,6 +50,55 @@ constexpr uint8_t kTailFunctionWithFP[] = {
     0x5D,                          // pop ebp
     0xFF, 0xE0                     // jmp eax
 };
+constexpr uint8_t kLeafFunctionWithPushes[] = {
+    0x53,              // push ebx
+    0x83, 0xEC, 0x10,  // sub esp,0x10
+    0x83, 0xC0, 0x01,  // add eax,0x1
+    0x83, 0xC4, 0x10,  // add esp,0x10
+    0x5B,              // pop ebx
+    0xC3               // ret
+};
+constexpr uint8_t kShrinkWrappedLeafFunction[] = {
+    0x85, 0xC0,                    // test eax,eax
+    0x74, 0x0C,                    // je 0x10
+    0x53,                          // push ebx
+    0x40,                          // inc eax
+    0x3D, 0x00, 0x01, 0x00, 0x00,  // cmp eax,0x100
+    0x7D, 0x02,                    // jge 0xf
+    0xEB, 0xF6,                    // jmp 0x5
+    0x5B,                          // pop ebx
+    0xC3                           // ret
+};
+constexpr uint8_t kLeafFunctionWithInconsistentStackOffsets[] = {
+    0x74, 0x01,  // je 0x3
+    0x53,        // push ebx
+    0x5B,        // pop ebx
+    0xC3         // ret
+};
+constexpr uint8_t kLeafFunctionMovingStackPointer[] = {
+    0x89, 0xEC,  // mov esp,ebp
+    0xC3         // ret
+};
+
+// Returns begin offset, end offset, and return address stack offset of each range.
+std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> GetFramelessCodeRanges(const uint8_t* code,
+                                                                              size_t code_size) {
+  csh handle;
+  if (cs_open(CS_ARCH_X86, CS_MODE_32, &handle) != CS_ERR_OK) {
+    ADD_FAILURE() << "Unable to open capstone";
+    return {};
+  }
+  cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
+  std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> result;
+  {
+    FunctionFramePointerValidator validator(handle, code, code_size);
+    for (const FramelessCodeRange& range : validator.GetFramelessCodeRanges()) {
+      result.emplace_back(range.begin_offset, range.end_offset, range.return_address_stack_offset);
+    }
+  }
+  cs_close(&handle);
+  return result;
+}
 
 TEST(FunctionFramePointerValidator, validateWithFP) {
   csh handle;
@@ -97,4 +150,50 @@ TEST(FunctionFramePointerValidator, validateTailFunction) {
   cs_close(&handle);
 }
 
-}  // namespace
\ No newline at end of file
+TEST(FunctionFramePointerValidator, framelessCodeRangesWithFP) {
+  EXPECT_THAT(GetFramelessCodeRanges(kFunctionWithFP, sizeof(kFunctionWithFP)),
+              testing::ElementsAre(std::make_tuple(0, 1, 0), std::make_tuple(1, 3, 4),
+                                   std::make_tuple(14, 15, 0)));
+}
+
+TEST(FunctionFramePointerValidator, framelessCodeRangesEnterLeave) {
+  EXPECT_THAT(GetFramelessCodeRanges(kFunctionWithEnterLeaveWithFP,
+                                     sizeof(kFunctionWithEnterLeaveWithFP)),
+              testing::ElementsAre(std::make_tuple(0, 4, 0), std::make_tuple(13, 14, 0)));
+}
+
+TEST(FunctionFramePointerValidator, framelessCodeRangesTailFunction) {
+  EXPECT_THAT(GetFramelessCodeRanges(kTailFunctionWithFP, sizeof(kTailFunctionWithFP)),
+              testing::ElementsAre(std::make_tuple(0, 1, 0), std::make_tuple(1, 3, 4),
+                                   std::make_tuple(14, 16, 0)));
+}
+
+TEST(FunctionFramePointerValidator, framelessCodeRangesWithoutFP) {
+  EXPECT_THAT(GetFramelessCodeRanges(kFunctionWithoutFP, sizeof(kFunctionWithoutFP)),
+              testing::IsEmpty());
+}
+
+TEST(FunctionFramePointerValidator, framelessCodeRangesLeafFunction) {
+  EXPECT_THAT(GetFramelessCodeRanges(kLeafFunction, sizeof(kLeafFunction)),
+              testing::ElementsAre(std::make_tuple(0, 16, 0)));
+  EXPECT_THAT(GetFramelessCodeRanges(kLeafFunctionWithPushes, sizeof(kLeafFunctionWithPushes)),
+              testing::ElementsAre(std::make_tuple(0, 1, 0), std::make_tuple(1, 4, 4),
+                                   std::make_tuple(4, 10, 20), std::make_tuple(10, 11, 4),
+                                   std::make_tuple(11, 12, 0)));
+  EXPECT_THAT(GetFramelessCodeRanges(kLeafFunctionMovingStackPointer,
+                                     sizeof(kLeafFunctionMovingStackPointer)),
+              testing::IsEmpty());
+}
+
+TEST(FunctionFramePointerValidator, framelessCodeRangesShrinkWrappedLeafFunction) {
+  // The loop after "push ebx" jumps back with the pushed register still on the stack.
+  EXPECT_THAT(
+      GetFramelessCodeRanges(kShrinkWrappedLeafFunction, sizeof(kShrinkWrappedLeafFunction)),
+      testing::ElementsAre(std::make_tuple(0, 5, 0), std::make_tuple(5, 16, 4),
+                           std::make_tuple(16, 17, 0)));
+  EXPECT_THAT(GetFramelessCodeRanges(kLeafFunctionWithInconsistentStackOffsets,
+                                     sizeof(kLeafFunctionWithInconsistentStackOffsets)),
+              testing::IsEmpty());
+}
+
+}  // namespace
@@ -7,6 +7,19 @@
 
 #include <capstone/capstone.h>
 
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Range of instructions of a function, as offsets from the start of the function, at which the
+// frame pointer doesn't hold the frame of the function, together with where the return address is
+// relative to the stack pointer there.
+struct FramelessCodeRange {
+  uint64_t begin_offset;
+  uint64_t end_offset;
+  uint64_t return_address_stack_offset;
+};
+
 // Provide utilities to check whether a function was compiled with
 // "-fno-omit-frame-pointer (-momit-leaf-frame-pointer)". The latter one is
 // optional.
@@ -25,16 +38,29 @@ class FunctionFramePointerValidator {
 
   bool Validate();
 
+  // Returns the code at which frame-pointer unwinding skips the caller of the function, because
+  // the frame pointer still holds the frame of the caller: the prologue before "mov ebp, esp",
+  // the returns after the epilogue, and leaf functions that don't set up a frame. For the latter,
+  // the stack pointer is followed through pushes, pops and immediate adjustments along the direct
+  // branches of the function; code only reached through indirect jumps has no ranges. Functions
+  // that modify the stack pointer or the base pointer in other ways, or that reach an instruction
+  // at different stack offsets, and functions without frame pointers, have no ranges. The ranges
+  // are sorted and don't overlap.
+  std::vector<FramelessCodeRange> GetFramelessCodeRanges();
+
  private:
   static bool IsCallInstruction(const cs_insn& instruction);
   static bool IsRetOrJumpInstruction(const cs_insn& instruction);
   static bool IsMovInstruction(const cs_insn& instruction);
   static bool IsBasePointer(uint16_t reg);
   static bool IsStackPointer(uint16_t reg);
+  [[nodiscard]] std::optional<size_t> FindInstruction(uint64_t address) const;
   bool IsLeafFunction();
   bool ValidatePrologue();
   bool ValidateEpilogue();
   bool ValidateFramePointers();
+  std::vector<FramelessCodeRange> GetFramelessCodeRangesWithFrame();
+  std::vector<FramelessCodeRange> GetFramelessCodeRangesOfLeafFunction();
 
   cs_insn* instructions_;
   size_t instructions_count_;
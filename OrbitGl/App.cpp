@@ -889,6 +889,8 @@ void OrbitApp::ClearCapture() {
   if (GCurrentTimeGraph != nullptr) {
     GCurrentTimeGraph->Clear();
   }
+  // Timers deferred until their name is received must not show up in the next capture.
+  manual_instrumentation_manager_->Clear();
 
   CHECK(capture_cleared_callback_);
   capture_cleared_callback_();
@@ -11,10 +11,10 @@
 #include "OrbitBase/Tracing.h"
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
-                      std::unique_ptr<PickingUserData> user_data) {
+                      const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kLine, user_data_.size(), batcher_id_);
 
-  AddLine(from, to, z, color, picking_color, std::move(user_data));
+  AddLine(from, to, z, color, picking_color, user_data);
 }
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
@@ -23,12 +23,12 @@ void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color,
 
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
 
-  AddLine(from, to, z, color, picking_color, nullptr);
+  AddLine(from, to, z, color, picking_color);
 }
 
 void Batcher::AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
-                              std::unique_ptr<PickingUserData> user_data) {
-  AddLine(pos, pos + Vec2(0, size), z, color, std::move(user_data));
+                              const PickingUserData& user_data) {
+  AddLine(pos, pos + Vec2(0, size), z, color, user_data);
 }
 
 void Batcher::AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
@@ -37,11 +37,11 @@ void Batcher::AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
 
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
 
-  AddLine(pos, pos + Vec2(0, size), z, color, picking_color, nullptr);
+  AddLine(pos, pos + Vec2(0, size), z, color, picking_color);
 }
 
 void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Color& picking_color,
-                      std::unique_ptr<PickingUserData> user_data) {
+                      const PickingUserData& user_data) {
   Line line;
   line.start_point = Vec3(floorf(from[0]), floorf(from[1]), z);
   line.end_point = Vec3(floorf(to[0]), floorf(to[1]), z);
@@ -50,20 +50,20 @@ void Batcher::AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Col
   buffer.line_buffer.lines_.push_back(line);
   buffer.line_buffer.colors_.push_back_n(color, 2);
   buffer.line_buffer.picking_colors_.push_back_n(picking_color, 2);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 void Batcher::AddBox(const Box& box, const std::array<Color, 4>& colors,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kBox, user_data_.size(), batcher_id_);
-  AddBox(box, colors, picking_color, std::move(user_data));
+  AddBox(box, colors, picking_color, user_data);
 }
 
 void Batcher::AddBox(const Box& box, const Color& color,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   std::array<Color, 4> colors;
   Fill(colors, color);
-  AddBox(box, colors, std::move(user_data));
+  AddBox(box, colors, user_data);
 }
 
 void Batcher::AddBox(const Box& box, const Color& color, std::shared_ptr<Pickable> pickable) {
@@ -73,26 +73,26 @@ void Batcher::AddBox(const Box& box, const Color& color, std::shared_ptr<Pickabl
   std::array<Color, 4> colors;
   Fill(colors, color);
 
-  AddBox(box, colors, picking_color, nullptr);
+  AddBox(box, colors, picking_color);
 }
 
 void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color) {
-  AddShadedBox(pos, size, z, color, std::unique_ptr<PickingUserData>(),
+  AddShadedBox(pos, size, z, color, PickingUserData(),
                ShadingDirection::kLeftToRight);
 }
 
 void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
                            ShadingDirection shading_direction) {
-  AddShadedBox(pos, size, z, color, std::unique_ptr<PickingUserData>(), shading_direction);
+  AddShadedBox(pos, size, z, color, PickingUserData(), shading_direction);
 }
 
 void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
-                           std::unique_ptr<PickingUserData> user_data,
+                           const PickingUserData& user_data,
                            ShadingDirection shading_direction) {
   std::array<Color, 4> colors;
   GetBoxGradientColors(color, &colors, shading_direction);
   Box box(pos, size, z);
-  AddBox(box, colors, std::move(user_data));
+  AddBox(box, colors, user_data);
 }
 
 static std::vector<Triangle> GetUnitArcTriangles(float angle_0, float angle_1, uint32_t num_sides) {
@@ -180,11 +180,11 @@ void Batcher::AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
   GetBoxGradientColors(color, &colors, shading_direction);
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
   Box box(pos, size, z);
-  AddBox(box, colors, picking_color, nullptr);
+  AddBox(box, colors, picking_color);
 }
 
 void Batcher::AddBox(const Box& box, const std::array<Color, 4>& colors, const Color& picking_color,
-                     std::unique_ptr<PickingUserData> user_data) {
+                     const PickingUserData& user_data) {
   Box rounded_box = box;
   for (size_t v = 0; v < 4; ++v) {
     rounded_box.vertices[v][0] = floorf(rounded_box.vertices[v][0]);
@@ -195,14 +195,14 @@ void Batcher::AddBox(const Box& box, const std::array<Color, 4>& colors, const C
   buffer.box_buffer.boxes_.push_back(rounded_box);
   buffer.box_buffer.colors_.push_back(colors);
   buffer.box_buffer.picking_colors_.push_back_n(picking_color, 4);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
-                          std::unique_ptr<PickingUserData> user_data) {
+                          const PickingUserData& user_data) {
   Color picking_color = PickingId::ToColor(PickingType::kTriangle, user_data_.size(), batcher_id_);
 
-  AddTriangle(triangle, color, picking_color, std::move(user_data));
+  AddTriangle(triangle, color, picking_color, user_data);
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
@@ -211,11 +211,11 @@ void Batcher::AddTriangle(const Triangle& triangle, const Color& color,
 
   Color picking_color = picking_manager_->GetPickableColor(pickable, batcher_id_);
 
-  AddTriangle(triangle, color, picking_color, nullptr);
+  AddTriangle(triangle, color, picking_color);
 }
 
 void Batcher::AddTriangle(const Triangle& triangle, const Color& color, const Color& picking_color,
-                          std::unique_ptr<PickingUserData> user_data) {
+                          const PickingUserData& user_data) {
   Triangle rounded_tri = triangle;
   for (size_t v = 0; v < 3; ++v) {
     rounded_tri.vertices[v][0] = floorf(rounded_tri.vertices[v][0]);
@@ -226,7 +226,7 @@ void Batcher::AddTriangle(const Triangle& triangle, const Color& color, const Co
   buffer.triangle_buffer.triangles_.push_back(rounded_tri);
   buffer.triangle_buffer.colors_.push_back_n(color, 3);
   buffer.triangle_buffer.picking_colors_.push_back_n(picking_color, 3);
-  user_data_.push_back(std::move(user_data));
+  user_data_.push_back(user_data);
 }
 
 void Batcher::AddCircle(Vec2 position, float radius, float z, Color color) {
@@ -259,7 +259,7 @@ const PickingUserData* Batcher::GetUserData(PickingId id) const {
     case PickingType::kTriangle:
     case PickingType::kLine:
       CHECK(id.element_id < user_data_.size());
-      return user_data_[id.element_id].get();
+      return user_data_[id.element_id].IsEmpty() ? nullptr : &user_data_[id.element_id];
     case PickingType::kPickable:
       return nullptr;
   }
@@ -335,6 +335,18 @@ std::vector<float> Batcher::GetLayers() const {
   return layers;
 };
 
+RenderingStats::LayerStats Batcher::GetLayerStats(float layer) const {
+  RenderingStats::LayerStats layer_stats;
+  auto it = primitive_buffers_by_layer_.find(layer);
+  if (it == primitive_buffers_by_layer_.end()) return layer_stats;
+
+  const PrimitiveBuffers& buffers = it->second;
+  layer_stats.num_lines = buffers.line_buffer.lines_.size();
+  layer_stats.num_boxes = buffers.box_buffer.boxes_.size();
+  layer_stats.num_triangles = buffers.triangle_buffer.triangles_.size();
+  return layer_stats;
+}
+
 void Batcher::DrawLayer(float layer, bool picking) const {
   ORBIT_SCOPE_FUNCTION;
   if (!primitive_buffers_by_layer_.count(layer)) return;
@@ -11,17 +11,28 @@
 #include "BlockChain.h"
 #include "Geometry.h"
 #include "PickingManager.h"
+#include "RenderingStats.h"
 #include "TextBox.h"
 
 using TooltipCallback = std::function<std::string(PickingId)>;
 
+// Picking metadata attached to a single primitive. This is stored by value in the Batcher for
+// every primitive, so it is kept small and trivially copyable: the tooltip callback is owned by
+// the caller (typically a track, which creates it once) and is only invoked when the primitive is
+// actually picked.
 struct PickingUserData {
   TextBox* text_box_;
-  TooltipCallback generate_tooltip_;
-  const void* custom_data_ = nullptr;
+  const TooltipCallback* generate_tooltip_;
+  const void* custom_data_;
 
-  explicit PickingUserData(TextBox* text_box = nullptr, TooltipCallback generate_tooltip = nullptr)
-      : text_box_(text_box), generate_tooltip_(std::move(generate_tooltip)) {}
+  explicit PickingUserData(TextBox* text_box = nullptr,
+                           const TooltipCallback* generate_tooltip = nullptr,
+                           const void* custom_data = nullptr)
+      : text_box_(text_box), generate_tooltip_(generate_tooltip), custom_data_(custom_data) {}
+
+  [[nodiscard]] bool IsEmpty() const {
+    return text_box_ == nullptr && generate_tooltip_ == nullptr && custom_data_ == nullptr;
+  }
 };
 
 struct LineBuffer {
@@ -107,24 +118,24 @@ class Batcher {
   Batcher(Batcher&&) = delete;
 
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color,
-               std::unique_ptr<PickingUserData> user_data = nullptr);
+               const PickingUserData& user_data = PickingUserData());
   void AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
-                       std::unique_ptr<PickingUserData> user_data = nullptr);
+                       const PickingUserData& user_data = PickingUserData());
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color, std::shared_ptr<Pickable> pickable);
   void AddVerticalLine(Vec2 pos, float size, float z, const Color& color,
                        std::shared_ptr<Pickable> pickable);
 
   void AddBox(const Box& box, const std::array<Color, 4>& colors,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const Color& color,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const Color& color, std::shared_ptr<Pickable> pickable);
 
   void AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color);
   void AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
                     ShadingDirection shading_direction);
   void AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
-                    std::unique_ptr<PickingUserData> user_data,
+                    const PickingUserData& user_data,
                     ShadingDirection shading_direction = ShadingDirection::kLeftToRight);
   void AddShadedBox(Vec2 pos, Vec2 size, float z, const Color& color,
                     std::shared_ptr<Pickable> pickable,
@@ -138,12 +149,13 @@ class Batcher {
   void AddBottomRightRoundedCorner(Vec2 pos, float radius, float z, const Color& color);
 
   void AddTriangle(const Triangle& triangle, const Color& color,
-                   std::unique_ptr<PickingUserData> user_data = nullptr);
+                   const PickingUserData& user_data = PickingUserData());
   void AddTriangle(const Triangle& triangle, const Color& color,
                    std::shared_ptr<Pickable> pickable);
 
   void AddCircle(Vec2 position, float radius, float z, Color color);
   [[nodiscard]] std::vector<float> GetLayers() const;
+  [[nodiscard]] RenderingStats::LayerStats GetLayerStats(float layer) const;
   void DrawLayer(float layer, bool picking = false) const;
   virtual void Draw(bool picking = false) const;
 
@@ -169,17 +181,19 @@ class Batcher {
                             ShadingDirection shading_direction = ShadingDirection::kLeftToRight);
 
   void AddLine(Vec2 from, Vec2 to, float z, const Color& color, const Color& picking_color,
-               std::unique_ptr<PickingUserData> user_data = nullptr);
+               const PickingUserData& user_data = PickingUserData());
   void AddBox(const Box& box, const std::array<Color, 4>& colors, const Color& picking_color,
-              std::unique_ptr<PickingUserData> user_data = nullptr);
+              const PickingUserData& user_data = PickingUserData());
   void AddTriangle(const Triangle& triangle, const Color& color, const Color& picking_color,
-                   std::unique_ptr<PickingUserData> user_data = nullptr);
+                   const PickingUserData& user_data = PickingUserData());
 
   BatcherId batcher_id_;
   PickingManager* picking_manager_;
   std::unordered_map<float, PrimitiveBuffers> primitive_buffers_by_layer_;
 
-  std::vector<std::unique_ptr<PickingUserData>> user_data_;
+  // Indexed by the element id encoded in the picking color. Cleared (but not deallocated) on every
+  // new frame, so steady-state rendering does not allocate for picking metadata.
+  std::vector<PickingUserData> user_data_;
 
   std::vector<Vec2> circle_points;
 };
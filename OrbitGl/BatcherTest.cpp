@@ -136,21 +136,18 @@ TEST(Batcher, PickingSimpleElements) {
   MockBatcher batcher(BatcherId::kUi);
 
   std::string line_custom_data = "line custom data";
-  auto line_user_data = std::make_unique<PickingUserData>();
-  line_user_data->custom_data_ = &line_custom_data;
+  PickingUserData line_user_data(nullptr, nullptr, &line_custom_data);
 
   std::string triangle_custom_data = "triangle custom data";
-  auto triangle_user_data = std::make_unique<PickingUserData>();
-  triangle_user_data->custom_data_ = &triangle_custom_data;
+  PickingUserData triangle_user_data(nullptr, nullptr, &triangle_custom_data);
 
   std::string box_custom_data = "box custom data";
-  auto box_user_data = std::make_unique<PickingUserData>();
-  box_user_data->custom_data_ = &box_custom_data;
+  PickingUserData box_user_data(nullptr, nullptr, &box_custom_data);
 
-  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), std::move(line_user_data));
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), line_user_data);
   batcher.AddTriangle(Triangle(Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(1, 0, 0)), Color(0, 255, 0, 255),
-                      std::move(triangle_user_data));
-  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), std::move(box_user_data));
+                      triangle_user_data);
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), box_user_data);
 
   batcher.Draw(true);
   ExpectCustomDataEq(batcher, batcher.GetDrawnLineColors()[0], line_custom_data);
@@ -158,6 +155,19 @@ TEST(Batcher, PickingSimpleElements) {
   ExpectCustomDataEq(batcher, batcher.GetDrawnBoxColors()[0], box_custom_data);
 }
 
+TEST(Batcher, PickingElementsWithoutUserData) {
+  MockBatcher batcher(BatcherId::kUi);
+
+  std::string box_custom_data = "box custom data";
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255));
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255),
+                 PickingUserData(nullptr, nullptr, &box_custom_data));
+
+  batcher.Draw(true);
+  EXPECT_EQ(batcher.GetUserData(MockRenderPickingColor(batcher.GetDrawnLineColors()[0])), nullptr);
+  ExpectCustomDataEq(batcher, batcher.GetDrawnBoxColors()[0], box_custom_data);
+}
+
 void ExpectPickableEq(const MockBatcher& batcher, const Color& rendered_color, PickingManager& pm,
                       std::shared_ptr<const Pickable> pickable) {
   PickingId id = MockRenderPickingColor(rendered_color);
@@ -189,21 +199,18 @@ TEST(Batcher, MultipleDrawCalls) {
   MockBatcher batcher(BatcherId::kUi);
 
   std::string line_custom_data = "line custom data";
-  auto line_user_data = std::make_unique<PickingUserData>();
-  line_user_data->custom_data_ = &line_custom_data;
+  PickingUserData line_user_data(nullptr, nullptr, &line_custom_data);
 
   std::string triangle_custom_data = "triangle custom data";
-  auto triangle_user_data = std::make_unique<PickingUserData>();
-  triangle_user_data->custom_data_ = &triangle_custom_data;
+  PickingUserData triangle_user_data(nullptr, nullptr, &triangle_custom_data);
 
   std::string box_custom_data = "box custom data";
-  auto box_user_data = std::make_unique<PickingUserData>();
-  box_user_data->custom_data_ = &box_custom_data;
+  PickingUserData box_user_data(nullptr, nullptr, &box_custom_data);
 
-  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), std::move(line_user_data));
+  batcher.AddLine(Vec2(0, 0), Vec2(1, 0), 0, Color(255, 255, 255, 255), line_user_data);
   batcher.AddTriangle(Triangle(Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(1, 0, 0)), Color(0, 255, 0, 255),
-                      std::move(triangle_user_data));
-  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), std::move(box_user_data));
+                      triangle_user_data);
+  batcher.AddBox(Box(Vec2(0, 0), Vec2(1, 1), 0), Color(255, 0, 0, 255), box_user_data);
 
   batcher.Draw(true);
 
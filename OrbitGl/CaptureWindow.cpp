@@ -4,9 +4,16 @@
 
 #include "CaptureWindow.h"
 
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cinttypes>
+
 #include "App.h"
 #include "GlUtils.h"
+#include "OrbitBase/Profiling.h"
 #include "OrbitBase/ThreadConstants.h"
+#include "RenderingStats.h"
 #include "TimeGraph.h"
 #include "absl/base/casts.h"
 
@@ -228,7 +235,7 @@ void CaptureWindow::Hover(int x, int y) {
     PickingUserData* user_data = batcher.GetUserData(pick_id);
 
     if (user_data && user_data->generate_tooltip_) {
-      tooltip = user_data->generate_tooltip_(pick_id);
+      tooltip = (*user_data->generate_tooltip_)(pick_id);
     }
   }
 
@@ -479,6 +486,12 @@ std::unique_ptr<AccessibleWidgetBridge> CaptureWindow::CreateAccessibilityInterf
 
 void CaptureWindow::Draw() {
   ORBIT_SCOPE("CaptureWindow::Draw");
+  RenderingStats& rendering_stats = time_graph_.GetRenderingStats();
+  const uint64_t start_ns = MonotonicTimestampNs();
+  if (GetPickingMode() == PickingMode::kNone) {
+    rendering_stats.StartFrame(start_ns);
+  }
+
   if (ShouldAutoZoom()) {
     ZoomAll();
   }
@@ -529,15 +542,34 @@ void CaptureWindow::Draw() {
     if (layer < GlCanvas::kScreenSpaceCutPoint) {
       Prepare2DViewport(0, 0, GetWidth(), GetHeight());
     }
-    time_graph_.GetBatcher().DrawLayer(layer, GetPickingMode() != PickingMode::kNone);
-    ui_batcher_.DrawLayer(layer, GetPickingMode() != PickingMode::kNone);
+    {
+      RenderingStats::ScopedStageTimer stage_timer(&rendering_stats,
+                                                   RenderingStats::Stage::kDrawLayers);
+      time_graph_.GetBatcher().DrawLayer(layer, GetPickingMode() != PickingMode::kNone);
+      ui_batcher_.DrawLayer(layer, GetPickingMode() != PickingMode::kNone);
+    }
+    rendering_stats.AddLayerStats(layer, time_graph_.GetBatcher().GetLayerStats(layer));
+    rendering_stats.AddLayerStats(layer, ui_batcher_.GetLayerStats(layer));
 
     PrepareScreenSpaceViewport();
     if (GetPickingMode() == PickingMode::kNone) {
+      RenderingStats::ScopedStageTimer stage_timer(&rendering_stats,
+                                                   RenderingStats::Stage::kRenderText);
       text_renderer_.RenderLayer(&ui_batcher_, layer);
       RenderText(layer);
+
+      RenderingStats::LayerStats text_stats;
+      text_stats.num_text_vertices = text_renderer_.GetNumVertices(layer) +
+                                     time_graph_.GetTextRenderer()->GetNumVertices(layer);
+      rendering_stats.AddLayerStats(layer, text_stats);
     }
   }
+
+  if (GetPickingMode() == PickingMode::kNone) {
+    rendering_stats.EndFrame();
+  } else {
+    rendering_stats.AddPickingTime(MonotonicTimestampNs() - start_ns);
+  }
 }
 
 void CaptureWindow::DrawScreenSpace() {
@@ -680,6 +712,8 @@ void CaptureWindow::RenderImGui() {
   if (ImGui::BeginTabBar("CaptureWindowTabBar", ImGuiTabBarFlags_None)) {
     if (ImGui::BeginTabItem("Layout Properties")) {
       if (time_graph_.GetLayout().DrawProperties()) {
+        // Layout properties might change which threads are aggregated.
+        time_graph_.GetTrackManager()->InvalidateSorting();
         NeedsUpdate();
       }
 
@@ -721,6 +755,11 @@ void CaptureWindow::RenderImGui() {
       ImGui::EndTabItem();
     }
 
+    if (ImGui::BeginTabItem("Rendering Stats")) {
+      RenderRenderingStatsImGui();
+      ImGui::EndTabItem();
+    }
+
     if (ImGui::BeginTabItem("Misc")) {
       static bool show_imgui_demo = false;
       ImGui::Checkbox("Show ImGui Demo", &show_imgui_demo);
@@ -733,6 +772,62 @@ void CaptureWindow::RenderImGui() {
   }
 }
 
+void CaptureWindow::RenderRenderingStatsImGui() {
+  const RenderingStats& stats = time_graph_.GetRenderingStats();
+  ImGui::Text("Frames: %zu", stats.GetNumFrames());
+  ImGui::Text("Frame time: %.2f ms (avg %.2f ms)",
+              static_cast<double>(stats.GetLastFrameTimeNs()) / 1e6,
+              stats.GetAverageFrameTimeMs());
+  for (size_t i = 0; i < RenderingStats::kNumStages; ++i) {
+    auto stage = static_cast<RenderingStats::Stage>(i);
+    ImGui::Text("  %s: %.2f ms (avg %.2f ms)", RenderingStats::GetStageName(stage),
+                static_cast<double>(stats.GetLastStageTimeNs(stage)) / 1e6,
+                stats.GetAverageStageTimeMs(stage));
+  }
+  ImGui::Text("Picking: %.2f ms (avg %.2f ms over %" PRIu64 " passes)",
+              static_cast<double>(stats.GetLastPickingTimeNs()) / 1e6,
+              stats.GetAveragePickingTimeMs(), stats.GetNumPickingPasses());
+
+  std::vector<float> frame_times_ms = stats.GetFrameTimesMs();
+  ImGui::PlotLines("Frame times (ms)", frame_times_ms.data(),
+                   static_cast<int>(frame_times_ms.size()), 0, nullptr, 0.f, FLT_MAX,
+                   ImVec2(0, 80));
+
+  std::array<uint32_t, RenderingStats::kNumHistogramBuckets> histogram =
+      stats.GetFrameTimeHistogram();
+  std::array<float, RenderingStats::kNumHistogramBuckets> histogram_values;
+  std::transform(histogram.begin(), histogram.end(), histogram_values.begin(),
+                 [](uint32_t count) { return static_cast<float>(count); });
+  ImGui::PlotHistogram("Frame time histogram", histogram_values.data(),
+                       static_cast<int>(histogram_values.size()), 0, nullptr, 0.f, FLT_MAX,
+                       ImVec2(0, 80));
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    if (i < RenderingStats::kHistogramBucketLimitsMs.size()) {
+      ImGui::Text("  < %.1f ms: %u", RenderingStats::kHistogramBucketLimitsMs[i], histogram[i]);
+    } else {
+      ImGui::Text("  >= %.1f ms: %u", RenderingStats::kHistogramBucketLimitsMs.back(),
+                  histogram[i]);
+    }
+  }
+
+  ImGui::Separator();
+  ImGui::Text("Primitives per layer (lines / boxes / triangles / text vertices):");
+  for (const auto& [layer, layer_stats] : stats.GetLastFrameLayerStats()) {
+    ImGui::Text("  %.4f: %u / %u / %u / %u (%" PRIu64 " vertices)", static_cast<double>(layer),
+                layer_stats.num_lines, layer_stats.num_boxes, layer_stats.num_triangles,
+                layer_stats.num_text_vertices, layer_stats.GetNumVertices());
+  }
+
+  ImGui::Separator();
+  constexpr size_t kMaxNumTracksShown = 20;
+  ImGui::Text("Slowest tracks in UpdatePrimitives:");
+  const auto& track_times = stats.GetLastFrameTrackTimes();
+  for (size_t i = 0; i < std::min(track_times.size(), kMaxNumTracksShown); ++i) {
+    ImGui::Text("  %s: %.3f ms", track_times[i].first.c_str(),
+                static_cast<double>(track_times[i].second) / 1e6);
+  }
+}
+
 void CaptureWindow::RenderText(float layer) {
   ORBIT_SCOPE_FUNCTION;
   if (GetPickingMode() == PickingMode::kNone) {
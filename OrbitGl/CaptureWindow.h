@@ -49,6 +49,7 @@ class CaptureWindow : public GlCanvas {
   void RenderHelpUi();
   void RenderTimeBar();
   void RenderSelectionOverlay();
+  void RenderRenderingStatsImGui();
   void SelectTextBox(const TextBox* text_box);
 
   void UpdateHorizontalScroll(float ratio);
@@ -115,10 +115,8 @@ void EventTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingM
         Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset,
                  pos_[1] - track_height + 1);
         Vec2 size(kPickingBoxWidth, track_height);
-        auto user_data = std::make_unique<PickingUserData>(
-            nullptr, [&](PickingId id) -> std::string { return GetSampleTooltip(id); });
-        user_data->custom_data_ = &event;
-        batcher->AddShadedBox(pos, size, z, kGreenSelection, std::move(user_data));
+        batcher->AddShadedBox(pos, size, z, kGreenSelection,
+                              PickingUserData(nullptr, &sample_tooltip_callback_, &event));
       }
     };
     if (thread_id_ == orbit_base::kAllProcessThreadsTid) {
@@ -47,5 +47,9 @@ class EventTrack : public Track {
                                                       int bottom_n_lines = 5) const;
 
  private:
+  const TooltipCallback sample_tooltip_callback_ = [this](PickingId id) {
+    return GetSampleTooltip(id);
+  };
+
   OrbitApp* app_ = nullptr;
 };
@@ -63,6 +63,11 @@ void FramePointerValidatorClient::AnalyzeModules(const std::vector<const ModuleD
     }
     size_t fpo_functions = response.functions_without_frame_pointer_size();
     size_t no_fpo_functions = functions.size() - fpo_functions;
+    // Remembered for captures with hybrid unwinding.
+    ModuleData* mutable_module = app_->GetMutableModuleByPath(module->file_path());
+    if (mutable_module != nullptr) {
+      mutable_module->set_has_functions_without_frame_pointers(fpo_functions > 0);
+    }
     dialogue_messages.push_back(
         absl::StrFormat("Module %s: %d functions support frame pointers, %d functions don't.",
                         module->name(), no_fpo_functions, fpo_functions));
@@ -4,6 +4,8 @@
 
 #include "ManualInstrumentationManager.h"
 
+#include <absl/strings/str_format.h>
+
 using orbit_client_protos::TimerInfo;
 
 void ManualInstrumentationManager::AddAsyncTimerListener(AsyncTimerInfoListener* listener) {
@@ -48,7 +50,13 @@ void ManualInstrumentationManager::ProcessAsyncTimer(
       TimerInfo async_span = start_timer_info;
       async_span.set_end(timer_info.end());
       absl::MutexLock lock(&mutex_);
-      for (auto* listener : async_timer_info_listeners_) (*listener)(start_event.name, async_span);
+      if (!IsEventNameKnown(start_event)) {
+        async_spans_waiting_for_name_[orbit_api::GetNameId(start_event)].push_back(
+            std::move(async_span));
+        return;
+      }
+      const std::string name = GetEventName(start_event);
+      for (auto* listener : async_timer_info_listeners_) (*listener)(name, async_span);
     }
   }
 }
@@ -63,3 +71,64 @@ void ManualInstrumentationManager::ProcessStringEvent(const orbit_api::Event& ev
     string_manager_.AddOrReplace(event_id, event.name);
   }
 }
+
+std::vector<TimerInfo> ManualInstrumentationManager::ProcessNameRegistrationEvent(
+    const orbit_api::Event& event) {
+  const uint64_t name_id = event.data;
+  const auto encoded_offset = static_cast<uint32_t>(event.color);
+  const size_t offset = encoded_offset & ~orbit_api::kLastNameChunkFlag;
+  const bool is_last_chunk = (encoded_offset & orbit_api::kLastNameChunkFlag) != 0;
+
+  absl::MutexLock lock(&mutex_);
+  std::string& name = partial_interned_names_[name_id];
+  if (offset != name.size()) {
+    // Chunks of the same name are sent in order by a single thread, but the first chunks might
+    // have been sent before the capture started. Wait for the next registration of the name.
+    partial_interned_names_.erase(name_id);
+    return {};
+  }
+  name.append(event.name);
+  if (!is_last_chunk) return {};
+
+  interned_names_.AddOrReplace(name_id, name);
+  auto async_spans_it = async_spans_waiting_for_name_.find(name_id);
+  if (async_spans_it != async_spans_waiting_for_name_.end()) {
+    for (const TimerInfo& async_span : async_spans_it->second) {
+      for (auto* listener : async_timer_info_listeners_) (*listener)(name, async_span);
+    }
+    async_spans_waiting_for_name_.erase(async_spans_it);
+  }
+  partial_interned_names_.erase(name_id);
+
+  auto timers_it = timers_waiting_for_name_.find(name_id);
+  if (timers_it == timers_waiting_for_name_.end()) return {};
+  std::vector<TimerInfo> timers = std::move(timers_it->second);
+  timers_waiting_for_name_.erase(timers_it);
+  return timers;
+}
+
+bool ManualInstrumentationManager::DeferTimerIfNameIsUnknown(const TimerInfo& timer_info) {
+  orbit_api::Event event = ApiEventFromTimerInfo(timer_info);
+  absl::MutexLock lock(&mutex_);
+  if (IsEventNameKnown(event)) return false;
+  timers_waiting_for_name_[orbit_api::GetNameId(event)].push_back(timer_info);
+  return true;
+}
+
+void ManualInstrumentationManager::Clear() {
+  absl::MutexLock lock(&mutex_);
+  async_timer_info_start_by_id_.clear();
+  partial_interned_names_.clear();
+  timers_waiting_for_name_.clear();
+  async_spans_waiting_for_name_.clear();
+}
+
+std::string ManualInstrumentationManager::GetEventName(const orbit_api::Event& event) const {
+  if (!orbit_api::HasNameId(event)) return event.name;
+  const uint64_t name_id = orbit_api::GetNameId(event);
+  return interned_names_.Get(name_id).value_or(absl::StrFormat("Unknown name [%#x]", name_id));
+}
+
+bool ManualInstrumentationManager::IsEventNameKnown(const orbit_api::Event& event) const {
+  return !orbit_api::HasNameId(event) || interned_names_.Contains(orbit_api::GetNameId(event));
+}
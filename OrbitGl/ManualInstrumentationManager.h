@@ -5,6 +5,9 @@
 #ifndef ORBIT_GL_MANUAL_INSTRUMENTATION_MANAGER_H_
 #define ORBIT_GL_MANUAL_INSTRUMENTATION_MANAGER_H_
 
+#include <string>
+#include <vector>
+
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Tracing.h"
 #include "StringManager.h"
@@ -24,9 +27,24 @@ class ManualInstrumentationManager {
   void RemoveAsyncTimerListener(AsyncTimerInfoListener* listener);
   void ProcessAsyncTimer(const orbit_client_protos::TimerInfo& timer_info);
   void ProcessStringEvent(const orbit_api::Event& event);
+  // Returns the timers that were deferred until the registered name was received, see
+  // DeferTimerIfNameIsUnknown. Async spans waiting for the name are sent to the listeners.
+  [[nodiscard]] std::vector<orbit_client_protos::TimerInfo> ProcessNameRegistrationEvent(
+      const orbit_api::Event& event);
+  // Keeps the timer if the interned name of its event was not received yet, so that no track gets
+  // created with a placeholder name. Returns whether the timer was kept.
+  [[nodiscard]] bool DeferTimerIfNameIsUnknown(const orbit_client_protos::TimerInfo& timer_info);
+  // Drops the state of the current capture: deferred timers and async spans, async spans that were
+  // started, and partially received names. Names that were fully received are kept.
+  void Clear();
   [[nodiscard]] std::string GetString(uint32_t id) const {
     return string_manager_.Get(id).value_or("");
   }
+
+  // Returns the name of the event, resolving interned names (see ORBIT_SCOPE_INTERNED in Orbit.h).
+  // For interned names that were not received yet, a placeholder showing the id is returned.
+  [[nodiscard]] std::string GetEventName(const orbit_api::Event& event) const;
+  [[nodiscard]] bool IsEventNameKnown(const orbit_api::Event& event) const;
   [[nodiscard]] static orbit_api::Event ApiEventFromTimerInfo(
       const orbit_client_protos::TimerInfo& timer_info);
 
@@ -34,6 +52,14 @@ class ManualInstrumentationManager {
   absl::flat_hash_set<AsyncTimerInfoListener*> async_timer_info_listeners_;
   absl::flat_hash_map<uint32_t, orbit_client_protos::TimerInfo> async_timer_info_start_by_id_;
   StringManager string_manager_;
+  // Interned names by id, and names for which only some chunks were received.
+  StringManager interned_names_;
+  absl::flat_hash_map<uint64_t, std::string> partial_interned_names_;
+  // Timers and async spans waiting for their interned name, by name id.
+  absl::flat_hash_map<uint64_t, std::vector<orbit_client_protos::TimerInfo>>
+      timers_waiting_for_name_;
+  absl::flat_hash_map<uint64_t, std::vector<orbit_client_protos::TimerInfo>>
+      async_spans_waiting_for_name_;
   absl::Mutex mutex_;
 };
 
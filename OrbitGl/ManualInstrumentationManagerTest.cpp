@@ -0,0 +1,198 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "ManualInstrumentationManager.h"
+
+namespace {
+
+std::vector<orbit_api::Event> GetNameRegistrationEvents(const std::string& name,
+                                                        uint64_t name_id) {
+  std::vector<orbit_api::Event> events;
+  orbit_api::ForEachNameRegistrationEvent(
+      name.c_str(), name_id, [&events](const orbit_api::EncodedEvent& e) {
+        events.push_back(e.event);
+      });
+  return events;
+}
+
+orbit_api::Event GetEventWithNameId(uint64_t name_id) {
+  orbit_api::EncodedEvent e(orbit_api::kScopeStart);
+  orbit_api::SetNameId(&e.event, name_id);
+  return e.event;
+}
+
+orbit_client_protos::TimerInfo GetTimerInfo(const orbit_api::Event& event, uint64_t time) {
+  orbit_api::EncodedEvent e(orbit_api::kNone);
+  e.event = event;
+  orbit_client_protos::TimerInfo timer_info;
+  timer_info.set_start(time);
+  timer_info.set_end(time);
+  for (uint64_t arg : e.args) {
+    timer_info.add_registers(arg);
+  }
+  return timer_info;
+}
+
+}  // namespace
+
+TEST(ManualInstrumentationManager, EventNameWithoutNameId) {
+  ManualInstrumentationManager manager;
+  orbit_api::EncodedEvent e(orbit_api::kScopeStart, "name");
+  EXPECT_TRUE(manager.IsEventNameKnown(e.event));
+  EXPECT_EQ(manager.GetEventName(e.event), "name");
+}
+
+TEST(ManualInstrumentationManager, InternedEventName) {
+  const std::string kName = "A scope name that is longer than kMaxEventStringSize";
+  const uint64_t kNameId = orbit_api::HashName(kName.c_str());
+  ManualInstrumentationManager manager;
+
+  orbit_api::Event event = GetEventWithNameId(kNameId);
+  EXPECT_FALSE(manager.IsEventNameKnown(event));
+  EXPECT_NE(manager.GetEventName(event), kName);
+
+  std::vector<orbit_api::Event> registration_events = GetNameRegistrationEvents(kName, kNameId);
+  ASSERT_GT(registration_events.size(), 1);
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_FALSE(manager.IsEventNameKnown(event));
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_event).empty());
+  }
+  EXPECT_TRUE(manager.IsEventNameKnown(event));
+  EXPECT_EQ(manager.GetEventName(event), kName);
+
+  // Registering the name again doesn't change it.
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_event).empty());
+    EXPECT_EQ(manager.GetEventName(event), kName);
+  }
+}
+
+TEST(ManualInstrumentationManager, NameRegistrationWithMissingFirstChunk) {
+  const std::string kName = "A scope name that is longer than kMaxEventStringSize";
+  const uint64_t kNameId = orbit_api::HashName(kName.c_str());
+  ManualInstrumentationManager manager;
+  orbit_api::Event event = GetEventWithNameId(kNameId);
+
+  std::vector<orbit_api::Event> registration_events = GetNameRegistrationEvents(kName, kNameId);
+  ASSERT_GT(registration_events.size(), 1);
+  for (size_t i = 1; i < registration_events.size(); ++i) {
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_events[i]).empty());
+  }
+  EXPECT_FALSE(manager.IsEventNameKnown(event));
+
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_event).empty());
+  }
+  EXPECT_EQ(manager.GetEventName(event), kName);
+}
+
+TEST(ManualInstrumentationManager, TimersWithUnknownNameAreDeferred) {
+  const std::string kName = "A scope name that is longer than kMaxEventStringSize";
+  const uint64_t kNameId = orbit_api::HashName(kName.c_str());
+  ManualInstrumentationManager manager;
+
+  orbit_api::Event event = GetEventWithNameId(kNameId);
+  event.type = orbit_api::kTrackInt;
+  orbit_client_protos::TimerInfo timer_info = GetTimerInfo(event, 42);
+  EXPECT_TRUE(manager.DeferTimerIfNameIsUnknown(timer_info));
+
+  std::vector<orbit_api::Event> registration_events = GetNameRegistrationEvents(kName, kNameId);
+  std::vector<orbit_client_protos::TimerInfo> deferred_timer_infos;
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_TRUE(deferred_timer_infos.empty());
+    deferred_timer_infos = manager.ProcessNameRegistrationEvent(registration_event);
+  }
+  ASSERT_EQ(deferred_timer_infos.size(), 1);
+  EXPECT_EQ(deferred_timer_infos[0].start(), 42);
+
+  EXPECT_FALSE(manager.DeferTimerIfNameIsUnknown(timer_info));
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_event).empty());
+  }
+}
+
+TEST(ManualInstrumentationManager, AsyncSpansWithUnknownNameAreDeferred) {
+  const std::string kName = "A scope name that is longer than kMaxEventStringSize";
+  const uint64_t kNameId = orbit_api::HashName(kName.c_str());
+  constexpr uint64_t kAsyncId = 7;
+  ManualInstrumentationManager manager;
+
+  std::vector<std::string> names;
+  ManualInstrumentationManager::AsyncTimerInfoListener listener =
+      [&names](const std::string& name, const orbit_client_protos::TimerInfo& /*timer_info*/) {
+        names.push_back(name);
+      };
+  manager.AddAsyncTimerListener(&listener);
+
+  orbit_api::Event start_event = GetEventWithNameId(kNameId);
+  start_event.type = orbit_api::kScopeStartAsync;
+  start_event.data = kAsyncId;
+  orbit_api::EncodedEvent stop(orbit_api::kScopeStopAsync, nullptr, kAsyncId);
+  manager.ProcessAsyncTimer(GetTimerInfo(start_event, 1));
+  manager.ProcessAsyncTimer(GetTimerInfo(stop.event, 2));
+  EXPECT_TRUE(names.empty());
+
+  for (const orbit_api::Event& registration_event : GetNameRegistrationEvents(kName, kNameId)) {
+    EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_event).empty());
+  }
+  EXPECT_EQ(names, std::vector<std::string>{kName});
+
+  manager.RemoveAsyncTimerListener(&listener);
+}
+
+TEST(ManualInstrumentationManager, DeferredTimersAreNotKeptForTheNextCapture) {
+  const std::string kName = "A scope name that is longer than kMaxEventStringSize";
+  const uint64_t kNameId = orbit_api::HashName(kName.c_str());
+  constexpr uint64_t kAsyncId = 7;
+  ManualInstrumentationManager manager;
+
+  std::vector<uint64_t> async_span_starts;
+  ManualInstrumentationManager::AsyncTimerInfoListener listener =
+      [&async_span_starts](const std::string& /*name*/,
+                           const orbit_client_protos::TimerInfo& timer_info) {
+        async_span_starts.push_back(timer_info.start());
+      };
+  manager.AddAsyncTimerListener(&listener);
+
+  orbit_api::Event event = GetEventWithNameId(kNameId);
+  event.type = orbit_api::kTrackInt;
+  orbit_api::Event start_event = GetEventWithNameId(kNameId);
+  start_event.type = orbit_api::kScopeStartAsync;
+  start_event.data = kAsyncId;
+  orbit_api::EncodedEvent stop(orbit_api::kScopeStopAsync, nullptr, kAsyncId);
+  std::vector<orbit_api::Event> registration_events = GetNameRegistrationEvents(kName, kNameId);
+  ASSERT_GT(registration_events.size(), 1);
+
+  // First capture: the name is never fully received, and an async span is left open.
+  EXPECT_TRUE(manager.DeferTimerIfNameIsUnknown(GetTimerInfo(event, 1)));
+  manager.ProcessAsyncTimer(GetTimerInfo(start_event, 2));
+  manager.ProcessAsyncTimer(GetTimerInfo(stop.event, 3));
+  manager.ProcessAsyncTimer(GetTimerInfo(start_event, 4));
+  EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_events[0]).empty());
+  manager.Clear();
+
+  // Second capture: only its own timers are returned once the name is received.
+  EXPECT_TRUE(manager.DeferTimerIfNameIsUnknown(GetTimerInfo(event, 10)));
+  manager.ProcessAsyncTimer(GetTimerInfo(stop.event, 11));
+  manager.ProcessAsyncTimer(GetTimerInfo(start_event, 12));
+  manager.ProcessAsyncTimer(GetTimerInfo(stop.event, 13));
+  EXPECT_TRUE(manager.ProcessNameRegistrationEvent(registration_events[1]).empty());
+  EXPECT_FALSE(manager.IsEventNameKnown(event));
+
+  std::vector<orbit_client_protos::TimerInfo> deferred_timer_infos;
+  for (const orbit_api::Event& registration_event : registration_events) {
+    EXPECT_TRUE(deferred_timer_infos.empty());
+    deferred_timer_infos = manager.ProcessNameRegistrationEvent(registration_event);
+  }
+  ASSERT_EQ(deferred_timer_infos.size(), 1);
+  EXPECT_EQ(deferred_timer_infos[0].start(), 10);
+  EXPECT_EQ(async_span_starts, std::vector<uint64_t>{12});
+
+  manager.RemoveAsyncTimerListener(&listener);
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "RenderingStats.h"
+
+#include <algorithm>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/Tracing.h"
+
+namespace {
+
+[[nodiscard]] double NsToMs(uint64_t duration_ns) { return static_cast<double>(duration_ns) / 1e6; }
+
+}  // namespace
+
+void RenderingStats::StartFrame(uint64_t timestamp_ns) {
+  is_in_frame_ = true;
+  current_frame_start_ns_ = timestamp_ns;
+  current_frame_ = FrameStats{};
+  current_frame_layer_stats_.clear();
+  current_frame_track_times_.clear();
+}
+
+void RenderingStats::EndFrame(uint64_t timestamp_ns) {
+  CHECK(is_in_frame_);
+  CHECK(timestamp_ns >= current_frame_start_ns_);
+  is_in_frame_ = false;
+  current_frame_.frame_time_ns = timestamp_ns - current_frame_start_ns_;
+
+  frames_[next_frame_index_] = current_frame_;
+  next_frame_index_ = (next_frame_index_ + 1) % kNumFrames;
+  num_frames_ = std::min(num_frames_ + 1, kNumFrames);
+
+  std::swap(last_frame_layer_stats_, current_frame_layer_stats_);
+
+  // Only copy the names of the tracks that are displayed.
+  const size_t num_track_times = std::min(current_frame_track_times_.size(), kMaxNumTrackTimes);
+  std::partial_sort(current_frame_track_times_.begin(),
+                    current_frame_track_times_.begin() + num_track_times,
+                    current_frame_track_times_.end(),
+                    [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+  last_frame_track_times_.clear();
+  for (size_t i = 0; i < num_track_times; ++i) {
+    last_frame_track_times_.emplace_back(*current_frame_track_times_[i].first,
+                                         current_frame_track_times_[i].second);
+  }
+
+  uint64_t num_vertices = 0;
+  for (const auto& [unused_layer, layer_stats] : last_frame_layer_stats_) {
+    num_vertices += layer_stats.GetNumVertices();
+  }
+
+  ORBIT_DOUBLE("Frame time (ms)", NsToMs(current_frame_.frame_time_ns));
+  ORBIT_DOUBLE("UpdatePrimitives (ms)", NsToMs(GetLastStageTimeNs(Stage::kUpdatePrimitives)));
+  ORBIT_DOUBLE("Draw layers (ms)", NsToMs(GetLastStageTimeNs(Stage::kDrawLayers)));
+  ORBIT_DOUBLE("Render text (ms)", NsToMs(GetLastStageTimeNs(Stage::kRenderText)));
+  ORBIT_UINT64("Vertices per frame", num_vertices);
+}
+
+void RenderingStats::AddPickingTime(uint64_t duration_ns) {
+  ++num_picking_passes_;
+  last_picking_time_ns_ = duration_ns;
+  total_picking_time_ns_ += duration_ns;
+  ORBIT_DOUBLE("Picking (ms)", NsToMs(duration_ns));
+}
+
+void RenderingStats::AddStageTime(Stage stage, uint64_t duration_ns) {
+  if (!is_in_frame_) return;
+  current_frame_.stage_times_ns[static_cast<size_t>(stage)] += duration_ns;
+}
+
+void RenderingStats::AddTrackTime(const std::string& track_name, uint64_t duration_ns) {
+  if (!is_in_frame_) return;
+  current_frame_track_times_.emplace_back(&track_name, duration_ns);
+}
+
+void RenderingStats::AddLayerStats(float layer, const LayerStats& layer_stats) {
+  if (!is_in_frame_) return;
+  LayerStats& stats = current_frame_layer_stats_[layer];
+  stats.num_lines += layer_stats.num_lines;
+  stats.num_boxes += layer_stats.num_boxes;
+  stats.num_triangles += layer_stats.num_triangles;
+  stats.num_text_vertices += layer_stats.num_text_vertices;
+}
+
+const RenderingStats::FrameStats& RenderingStats::GetLastFrame() const {
+  return frames_[(next_frame_index_ + kNumFrames - 1) % kNumFrames];
+}
+
+uint64_t RenderingStats::GetLastFrameTimeNs() const {
+  if (num_frames_ == 0) return 0;
+  return GetLastFrame().frame_time_ns;
+}
+
+uint64_t RenderingStats::GetLastStageTimeNs(Stage stage) const {
+  if (num_frames_ == 0) return 0;
+  return GetLastFrame().stage_times_ns[static_cast<size_t>(stage)];
+}
+
+double RenderingStats::GetAverageFrameTimeMs() const {
+  if (num_frames_ == 0) return 0.0;
+  uint64_t sum_ns = 0;
+  for (size_t i = 0; i < num_frames_; ++i) {
+    sum_ns += frames_[i].frame_time_ns;
+  }
+  return NsToMs(sum_ns) / static_cast<double>(num_frames_);
+}
+
+double RenderingStats::GetAverageStageTimeMs(Stage stage) const {
+  if (num_frames_ == 0) return 0.0;
+  uint64_t sum_ns = 0;
+  for (size_t i = 0; i < num_frames_; ++i) {
+    sum_ns += frames_[i].stage_times_ns[static_cast<size_t>(stage)];
+  }
+  return NsToMs(sum_ns) / static_cast<double>(num_frames_);
+}
+
+double RenderingStats::GetAveragePickingTimeMs() const {
+  if (num_picking_passes_ == 0) return 0.0;
+  return NsToMs(total_picking_time_ns_) / static_cast<double>(num_picking_passes_);
+}
+
+std::vector<float> RenderingStats::GetFrameTimesMs() const {
+  std::vector<float> frame_times_ms;
+  frame_times_ms.reserve(num_frames_);
+  size_t oldest_index = (next_frame_index_ + kNumFrames - num_frames_) % kNumFrames;
+  for (size_t i = 0; i < num_frames_; ++i) {
+    const FrameStats& frame = frames_[(oldest_index + i) % kNumFrames];
+    frame_times_ms.push_back(static_cast<float>(NsToMs(frame.frame_time_ns)));
+  }
+  return frame_times_ms;
+}
+
+std::array<uint32_t, RenderingStats::kNumHistogramBuckets> RenderingStats::GetFrameTimeHistogram()
+    const {
+  std::array<uint32_t, kNumHistogramBuckets> histogram = {};
+  for (size_t i = 0; i < num_frames_; ++i) {
+    const double frame_time_ms = NsToMs(frames_[i].frame_time_ns);
+    auto bucket_it = std::upper_bound(kHistogramBucketLimitsMs.begin(),
+                                      kHistogramBucketLimitsMs.end(), frame_time_ms);
+    ++histogram[bucket_it - kHistogramBucketLimitsMs.begin()];
+  }
+  return histogram;
+}
+
+const char* RenderingStats::GetStageName(Stage stage) {
+  switch (stage) {
+    case Stage::kUpdatePrimitives:
+      return "UpdatePrimitives";
+    case Stage::kDrawLayers:
+      return "Draw layers";
+    case Stage::kRenderText:
+      return "Render text";
+  }
+  UNREACHABLE();
+}
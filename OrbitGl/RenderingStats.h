@@ -0,0 +1,129 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_RENDERING_STATS_H_
+#define ORBIT_GL_RENDERING_STATS_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/Profiling.h"
+
+// Collects the time spent in the individual stages of a frame of the capture window (primitive
+// generation, drawing of the batched primitives and text rendering) together with the number of
+// primitives drawn per layer. The last kNumFrames frames are kept to compute averages and a
+// histogram of frame times, which are displayed in the ImGui debug window. Every finished frame is
+// also reported through the introspection API.
+// Picking passes are not frames: they are timed separately, and what is measured during them is
+// not added to any frame.
+class RenderingStats {
+ public:
+  enum class Stage : size_t { kUpdatePrimitives = 0, kDrawLayers, kRenderText };
+  static constexpr size_t kNumStages = 3;
+  static constexpr size_t kNumFrames = 256;
+  // Number of tracks of the last frame for which GetLastFrameTrackTimes reports a time.
+  static constexpr size_t kMaxNumTrackTimes = 20;
+
+  // Upper limits (exclusive) of the buckets of the frame time histogram. The last bucket of the
+  // histogram contains all frames that took longer than the last limit.
+  static constexpr std::array<double, 5> kHistogramBucketLimitsMs = {8.0, 16.7, 33.3, 66.7, 100.0};
+  static constexpr size_t kNumHistogramBuckets = kHistogramBucketLimitsMs.size() + 1;
+
+  struct LayerStats {
+    uint32_t num_lines = 0;
+    uint32_t num_boxes = 0;
+    uint32_t num_triangles = 0;
+    uint32_t num_text_vertices = 0;
+
+    [[nodiscard]] uint64_t GetNumVertices() const {
+      return uint64_t{2} * num_lines + uint64_t{4} * num_boxes + uint64_t{3} * num_triangles +
+             num_text_vertices;
+    }
+  };
+
+  // Adds the time spent in its scope to the given stage of the current frame. "stats" can be
+  // nullptr, in which case nothing is measured.
+  class ScopedStageTimer {
+   public:
+    ScopedStageTimer(RenderingStats* stats, Stage stage)
+        : stats_(stats), stage_(stage), start_ns_(stats != nullptr ? MonotonicTimestampNs() : 0) {}
+    ~ScopedStageTimer() {
+      if (stats_ != nullptr) stats_->AddStageTime(stage_, MonotonicTimestampNs() - start_ns_);
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+   private:
+    RenderingStats* stats_;
+    Stage stage_;
+    uint64_t start_ns_;
+  };
+
+  void StartFrame(uint64_t timestamp_ns = MonotonicTimestampNs());
+  void EndFrame(uint64_t timestamp_ns = MonotonicTimestampNs());
+
+  void AddPickingTime(uint64_t duration_ns);
+
+  // These are ignored outside of StartFrame and EndFrame. track_name must stay valid until
+  // EndFrame.
+  void AddStageTime(Stage stage, uint64_t duration_ns);
+  void AddTrackTime(const std::string& track_name, uint64_t duration_ns);
+  void AddLayerStats(float layer, const LayerStats& layer_stats);
+
+  [[nodiscard]] size_t GetNumFrames() const { return num_frames_; }
+  [[nodiscard]] uint64_t GetLastFrameTimeNs() const;
+  [[nodiscard]] uint64_t GetLastStageTimeNs(Stage stage) const;
+  [[nodiscard]] double GetAverageFrameTimeMs() const;
+  [[nodiscard]] double GetAverageStageTimeMs(Stage stage) const;
+  [[nodiscard]] uint64_t GetNumPickingPasses() const { return num_picking_passes_; }
+  [[nodiscard]] uint64_t GetLastPickingTimeNs() const { return last_picking_time_ns_; }
+  [[nodiscard]] double GetAveragePickingTimeMs() const;
+
+  // Frame times of the frames in the rolling window, oldest first.
+  [[nodiscard]] std::vector<float> GetFrameTimesMs() const;
+  [[nodiscard]] std::array<uint32_t, kNumHistogramBuckets> GetFrameTimeHistogram() const;
+
+  [[nodiscard]] const std::map<float, LayerStats>& GetLastFrameLayerStats() const {
+    return last_frame_layer_stats_;
+  }
+  // Time spent generating the primitives of the kMaxNumTrackTimes slowest tracks in the last frame,
+  // slowest first.
+  [[nodiscard]] const std::vector<std::pair<std::string, uint64_t>>& GetLastFrameTrackTimes()
+      const {
+    return last_frame_track_times_;
+  }
+
+  [[nodiscard]] static const char* GetStageName(Stage stage);
+
+ private:
+  struct FrameStats {
+    uint64_t frame_time_ns = 0;
+    std::array<uint64_t, kNumStages> stage_times_ns = {};
+  };
+
+  [[nodiscard]] const FrameStats& GetLastFrame() const;
+
+  std::array<FrameStats, kNumFrames> frames_ = {};
+  size_t next_frame_index_ = 0;
+  size_t num_frames_ = 0;
+
+  bool is_in_frame_ = false;
+  uint64_t current_frame_start_ns_ = 0;
+  FrameStats current_frame_;
+  std::map<float, LayerStats> current_frame_layer_stats_;
+  std::map<float, LayerStats> last_frame_layer_stats_;
+  std::vector<std::pair<const std::string*, uint64_t>> current_frame_track_times_;
+  std::vector<std::pair<std::string, uint64_t>> last_frame_track_times_;
+
+  uint64_t num_picking_passes_ = 0;
+  uint64_t last_picking_time_ns_ = 0;
+  uint64_t total_picking_time_ns_ = 0;
+};
+
+#endif  // ORBIT_GL_RENDERING_STATS_H_
@@ -0,0 +1,170 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "RenderingStats.h"
+
+namespace {
+
+constexpr uint64_t kNsPerMs = 1'000'000;
+
+void AddFrame(RenderingStats* stats, uint64_t frame_time_ns) {
+  static uint64_t timestamp_ns = 0;
+  stats->StartFrame(timestamp_ns);
+  timestamp_ns += frame_time_ns;
+  stats->EndFrame(timestamp_ns);
+}
+
+}  // namespace
+
+TEST(RenderingStats, Empty) {
+  RenderingStats stats;
+  EXPECT_EQ(stats.GetNumFrames(), 0);
+  EXPECT_EQ(stats.GetLastFrameTimeNs(), 0);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kUpdatePrimitives), 0);
+  EXPECT_EQ(stats.GetAverageFrameTimeMs(), 0.0);
+  EXPECT_TRUE(stats.GetFrameTimesMs().empty());
+  for (uint32_t count : stats.GetFrameTimeHistogram()) {
+    EXPECT_EQ(count, 0);
+  }
+}
+
+TEST(RenderingStats, StageTimesAreAccumulatedPerFrame) {
+  RenderingStats stats;
+  stats.StartFrame(0);
+  stats.AddStageTime(RenderingStats::Stage::kDrawLayers, 100);
+  stats.AddStageTime(RenderingStats::Stage::kDrawLayers, 50);
+  stats.AddStageTime(RenderingStats::Stage::kRenderText, 20);
+  stats.EndFrame(1000);
+
+  EXPECT_EQ(stats.GetNumFrames(), 1);
+  EXPECT_EQ(stats.GetLastFrameTimeNs(), 1000);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kDrawLayers), 150);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kRenderText), 20);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kUpdatePrimitives), 0);
+
+  stats.StartFrame(2000);
+  stats.AddStageTime(RenderingStats::Stage::kRenderText, 40);
+  stats.EndFrame(2500);
+
+  EXPECT_EQ(stats.GetNumFrames(), 2);
+  EXPECT_EQ(stats.GetLastFrameTimeNs(), 500);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kDrawLayers), 0);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kRenderText), 40);
+  EXPECT_DOUBLE_EQ(stats.GetAverageStageTimeMs(RenderingStats::Stage::kRenderText), 30.0 / 1e6);
+}
+
+TEST(RenderingStats, RollingWindow) {
+  RenderingStats stats;
+  for (size_t i = 0; i < RenderingStats::kNumFrames; ++i) {
+    AddFrame(&stats, 1 * kNsPerMs);
+  }
+  AddFrame(&stats, 3 * kNsPerMs);
+
+  EXPECT_EQ(stats.GetNumFrames(), RenderingStats::kNumFrames);
+  std::vector<float> frame_times_ms = stats.GetFrameTimesMs();
+  ASSERT_EQ(frame_times_ms.size(), RenderingStats::kNumFrames);
+  EXPECT_FLOAT_EQ(frame_times_ms.front(), 1.f);
+  EXPECT_FLOAT_EQ(frame_times_ms.back(), 3.f);
+  EXPECT_DOUBLE_EQ(stats.GetAverageFrameTimeMs(),
+                   (RenderingStats::kNumFrames + 2.0) / RenderingStats::kNumFrames);
+}
+
+TEST(RenderingStats, FrameTimeHistogram) {
+  RenderingStats stats;
+  AddFrame(&stats, 1 * kNsPerMs);
+  AddFrame(&stats, 8 * kNsPerMs);
+  AddFrame(&stats, 10 * kNsPerMs);
+  AddFrame(&stats, 20 * kNsPerMs);
+  AddFrame(&stats, 500 * kNsPerMs);
+
+  std::array<uint32_t, RenderingStats::kNumHistogramBuckets> histogram =
+      stats.GetFrameTimeHistogram();
+  EXPECT_EQ(histogram[0], 1);
+  EXPECT_EQ(histogram[1], 2);
+  EXPECT_EQ(histogram[2], 1);
+  EXPECT_EQ(histogram[3], 0);
+  EXPECT_EQ(histogram[4], 0);
+  EXPECT_EQ(histogram[5], 1);
+}
+
+TEST(RenderingStats, LayerStatsAndTrackTimes) {
+  RenderingStats stats;
+  stats.StartFrame(0);
+  RenderingStats::LayerStats batcher_stats;
+  batcher_stats.num_lines = 1;
+  batcher_stats.num_boxes = 2;
+  batcher_stats.num_triangles = 3;
+  RenderingStats::LayerStats text_stats;
+  text_stats.num_text_vertices = 8;
+  stats.AddLayerStats(0.1f, batcher_stats);
+  stats.AddLayerStats(0.1f, text_stats);
+  const std::string fast_track_name = "fast";
+  const std::string slow_track_name = "slow";
+  stats.AddTrackTime(fast_track_name, 10);
+  stats.AddTrackTime(slow_track_name, 20);
+  stats.EndFrame(100);
+
+  const auto& layer_stats = stats.GetLastFrameLayerStats();
+  ASSERT_EQ(layer_stats.size(), 1);
+  const RenderingStats::LayerStats& layer = layer_stats.at(0.1f);
+  EXPECT_EQ(layer.num_lines, 1);
+  EXPECT_EQ(layer.num_boxes, 2);
+  EXPECT_EQ(layer.num_triangles, 3);
+  EXPECT_EQ(layer.num_text_vertices, 8);
+  EXPECT_EQ(layer.GetNumVertices(), 2 + 8 + 9 + 8);
+
+  const auto& track_times = stats.GetLastFrameTrackTimes();
+  ASSERT_EQ(track_times.size(), 2);
+  EXPECT_EQ(track_times[0].first, "slow");
+  EXPECT_EQ(track_times[1].first, "fast");
+
+  stats.StartFrame(200);
+  stats.EndFrame(300);
+  EXPECT_TRUE(stats.GetLastFrameLayerStats().empty());
+  EXPECT_TRUE(stats.GetLastFrameTrackTimes().empty());
+}
+
+TEST(RenderingStats, OnlySlowestTrackTimesAreKept) {
+  RenderingStats stats;
+  std::vector<std::string> track_names;
+  for (size_t i = 0; i < 2 * RenderingStats::kMaxNumTrackTimes; ++i) {
+    track_names.push_back(std::to_string(i));
+  }
+  stats.StartFrame(0);
+  for (size_t i = 0; i < track_names.size(); ++i) {
+    stats.AddTrackTime(track_names[i], i);
+  }
+  stats.EndFrame(100);
+
+  const auto& track_times = stats.GetLastFrameTrackTimes();
+  ASSERT_EQ(track_times.size(), RenderingStats::kMaxNumTrackTimes);
+  EXPECT_EQ(track_times.front().first, track_names.back());
+  EXPECT_EQ(track_times.back().second, RenderingStats::kMaxNumTrackTimes);
+}
+
+TEST(RenderingStats, PickingPassesAreNotFrames) {
+  RenderingStats stats;
+  AddFrame(&stats, 1 * kNsPerMs);
+
+  // What is measured between frames, i.e., during picking passes, is ignored.
+  stats.AddStageTime(RenderingStats::Stage::kDrawLayers, 100);
+  stats.AddLayerStats(0.1f, RenderingStats::LayerStats{1, 0, 0, 0});
+  stats.AddPickingTime(300);
+  stats.AddPickingTime(100);
+
+  EXPECT_EQ(stats.GetNumFrames(), 1);
+  EXPECT_EQ(stats.GetNumPickingPasses(), 2);
+  EXPECT_EQ(stats.GetLastPickingTimeNs(), 100);
+  EXPECT_DOUBLE_EQ(stats.GetAveragePickingTimeMs(), 200.0 / 1e6);
+
+  stats.StartFrame(0);
+  stats.EndFrame(100);
+  EXPECT_EQ(stats.GetLastStageTimeNs(RenderingStats::Stage::kDrawLayers), 0);
+  EXPECT_TRUE(stats.GetLastFrameLayerStats().empty());
+}
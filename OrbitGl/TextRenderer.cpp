@@ -12,12 +12,6 @@
 #include "GlUtils.h"
 #include "OrbitBase/ExecutablePath.h"
 
-typedef struct {
-  float x, y, z;     // position
-  float s, t;        // texture
-  float r, g, b, a;  // color
-} vertex_t;
-
 bool TextRenderer::draw_outline_ = false;
 
 TextRenderer::TextRenderer() : texture_atlas_(nullptr), canvas_(nullptr), initialized_(false) {}
@@ -41,6 +35,25 @@ TextRenderer::~TextRenderer() {
 void TextRenderer::Init() {
   if (initialized_) return;
 
+  InitFonts();
+
+  glGenTextures(1, &texture_atlas_->id);
+
+  const auto exe_dir = orbit_base::GetExecutableDir();
+  const auto vert_shader_file_name = (exe_dir / "shaders" / "v3f-t2f-c4f.vert").string();
+  const auto frag_shader_file_name = (exe_dir / "shaders" / "v3f-t2f-c4f.frag").string();
+  shader_ = shader_load(vert_shader_file_name.c_str(), frag_shader_file_name.c_str());
+
+  mat4_set_identity(&projection_);
+  mat4_set_identity(&model_);
+  mat4_set_identity(&view_);
+
+  initialized_ = true;
+}
+
+void TextRenderer::InitFonts() {
+  if (fonts_initialized_) return;
+
   int atlasSize = 2 * 1024;
   texture_atlas_ = texture_atlas_new(atlasSize, atlasSize, 1);
 
@@ -54,17 +67,7 @@ void TextRenderer::Init() {
   pen_.x = 0;
   pen_.y = 0;
 
-  glGenTextures(1, &texture_atlas_->id);
-
-  const auto vert_shader_file_name = (exe_dir / "shaders" / "v3f-t2f-c4f.vert").string();
-  const auto frag_shader_file_name = (exe_dir / "shaders" / "v3f-t2f-c4f.frag").string();
-  shader_ = shader_load(vert_shader_file_name.c_str(), frag_shader_file_name.c_str());
-
-  mat4_set_identity(&projection_);
-  mat4_set_identity(&model_);
-  mat4_set_identity(&view_);
-
-  initialized_ = true;
+  fonts_initialized_ = true;
 }
 
 texture_font_t* TextRenderer::GetFont(uint32_t size) {
@@ -154,8 +157,88 @@ void TextRenderer::DrawOutline(Batcher* batcher, vertex_buffer_t* vertex_buffer)
   }
 }
 
-void TextRenderer::AddTextInternal(texture_font_t* font, const char* text, const vec4& color,
-                                   vec2* pen, float max_size, float z, vec2* out_text_pos,
+void TextRenderer::AppendShapedText(texture_font_t* font, const char* text, size_t begin,
+                                    size_t end, GlyphRun* run) {
+  float pen_x = run->end_pen_x;
+  float pen_y = run->end_pen_y;
+  for (size_t i = begin; i < end; ++i) {
+    if (text[i] == '\n') {
+      if (!run->is_multi_line) {
+        run->first_line_end_pen_x = pen_x;
+        run->is_multi_line = true;
+      }
+      pen_x = 0.f;
+      pen_y -= font->height;
+      continue;
+    }
+
+    const char* codepoint = text + i;
+    if (!texture_font_find_glyph(font, codepoint)) {
+      texture_font_load_glyph(font, codepoint);
+    }
+
+    texture_glyph_t* glyph = texture_font_get_glyph(font, codepoint);
+    if (glyph == nullptr) continue;
+
+    float kerning = (i == 0) ? 0.0f : texture_glyph_get_kerning(glyph, codepoint - 1);
+    pen_x += kerning;
+
+    CachedGlyph cached_glyph;
+    cached_glyph.char_index = i;
+    cached_glyph.pen_x = pen_x;
+    cached_glyph.pen_y = pen_y;
+    cached_glyph.advance_x = glyph->advance_x;
+    cached_glyph.offset_x = static_cast<float>(glyph->offset_x);
+    cached_glyph.offset_y = static_cast<float>(glyph->offset_y);
+    cached_glyph.width = static_cast<float>(glyph->width);
+    cached_glyph.height = static_cast<float>(glyph->height);
+    cached_glyph.s0 = glyph->s0;
+    cached_glyph.t0 = glyph->t0;
+    cached_glyph.s1 = glyph->s1;
+    cached_glyph.t1 = glyph->t1;
+    run->glyphs.push_back(cached_glyph);
+
+    pen_x += glyph->advance_x;
+  }
+  run->end_pen_x = pen_x;
+  run->end_pen_y = pen_y;
+  if (!run->is_multi_line) run->first_line_end_pen_x = pen_x;
+}
+
+const TextRenderer::GlyphRun& TextRenderer::GetCachedGlyphRun(texture_font_t* font,
+                                                              std::string_view text) {
+  auto& glyph_runs = glyph_runs_by_font_[font];
+  auto it = glyph_runs.find(text);
+  if (it != glyph_runs.end()) return it->second;
+
+  // Labels can contain arbitrary user data (e.g. manual instrumentation values), so the cache has
+  // to be bounded. Dropping everything is fine as the working set is rebuilt within a frame.
+  constexpr size_t kMaxNumCachedGlyphRuns = 64 * 1024;
+  if (num_cached_glyph_runs_ >= kMaxNumCachedGlyphRuns) {
+    for (auto& [unused_font, runs] : glyph_runs_by_font_) {
+      runs.clear();
+    }
+    num_cached_glyph_runs_ = 0;
+  }
+
+  GlyphRun run;
+  AppendShapedText(font, text.data(), 0, text.size(), &run);
+  ++num_cached_glyph_runs_;
+  return glyph_runs_by_font_[font].emplace(std::string(text), std::move(run)).first->second;
+}
+
+const TextRenderer::GlyphRun& TextRenderer::GetLabelGlyphRun(texture_font_t* font,
+                                                             const char* text,
+                                                             size_t text_length,
+                                                             size_t trailing_chars_length) {
+  const size_t trailing_chars_begin = text_length - trailing_chars_length;
+  label_glyph_run_ = GetCachedGlyphRun(font, std::string_view(text, trailing_chars_begin));
+  AppendShapedText(font, text, trailing_chars_begin, text_length, &label_glyph_run_);
+  return label_glyph_run_;
+}
+
+void TextRenderer::AddTextInternal(const GlyphRun& run, const vec4& color, vec2* pen,
+                                   float max_size, float z, vec2* out_text_pos,
                                    vec2* out_text_size) {
   float r = color.red, g = color.green, b = color.blue, a = color.alpha;
 
@@ -166,55 +249,53 @@ void TextRenderer::AddTextInternal(texture_font_t* font, const char* text, const
   float min_y = FLT_MAX;
   float max_y = -FLT_MAX;
   constexpr std::array<GLuint, 6> indices = {0, 1, 2, 0, 2, 3};
-  vec2 initial_pen = *pen;
-
-  for (size_t i = 0; i < strlen(text); ++i) {
-    if (text[i] == '\n') {
-      pen->x = initial_pen.x;
-      pen->y -= font->height;
-      continue;
+  const vec2 initial_pen = *pen;
+
+  // All glyphs of the string are submitted to the vertex buffer at once.
+  vertex_scratch_buffer_.clear();
+  index_scratch_buffer_.clear();
+  pen->x = initial_pen.x + run.end_pen_x;
+  pen->y = initial_pen.y + run.end_pen_y;
+
+  for (const CachedGlyph& glyph : run.glyphs) {
+    const float pen_x = initial_pen.x + glyph.pen_x;
+    const float pen_y = initial_pen.y + glyph.pen_y;
+
+    float x0 = floorf(pen_x + glyph.offset_x);
+    float y0 = floorf(pen_y + glyph.offset_y);
+    float x1 = floorf(x0 + glyph.width);
+    float y1 = floorf(y0 - glyph.height);
+
+    min_x = std::min(min_x, x0);
+    max_x = std::max(max_x, x1);
+    min_y = std::min(min_y, y1);
+    max_y = std::max(max_y, y0);
+
+    str_width = max_x - min_x;
+
+    if (str_width > max_width) {
+      pen->x = pen_x;
+      pen->y = pen_y;
+      break;
     }
 
-    if (!texture_font_find_glyph(font, text + i)) {
-      texture_font_load_glyph(font, text + i);
+    const auto first_vertex = static_cast<GLuint>(vertex_scratch_buffer_.size());
+    vertex_scratch_buffer_.push_back({x0, y0, z, glyph.s0, glyph.t0, r, g, b, a});
+    vertex_scratch_buffer_.push_back({x0, y1, z, glyph.s0, glyph.t1, r, g, b, a});
+    vertex_scratch_buffer_.push_back({x1, y1, z, glyph.s1, glyph.t1, r, g, b, a});
+    vertex_scratch_buffer_.push_back({x1, y0, z, glyph.s1, glyph.t0, r, g, b, a});
+    for (GLuint index : indices) {
+      index_scratch_buffer_.push_back(first_vertex + index);
     }
+  }
 
-    texture_glyph_t* glyph = texture_font_get_glyph(font, text + i);
-    if (glyph != nullptr) {
-      float kerning = (i == 0) ? 0.0f : texture_glyph_get_kerning(glyph, text + i - 1);
-      pen->x += kerning;
-
-      float x0 = floorf(pen->x + glyph->offset_x);
-      float y0 = floorf(pen->y + glyph->offset_y);
-      float x1 = floorf(x0 + glyph->width);
-      float y1 = floorf(y0 - glyph->height);
-
-      float s0 = glyph->s0;
-      float t0 = glyph->t0;
-      float s1 = glyph->s1;
-      float t1 = glyph->t1;
-
-      vertex_t vertices[4] = {{x0, y0, z, s0, t0, r, g, b, a},
-                              {x0, y1, z, s0, t1, r, g, b, a},
-                              {x1, y1, z, s1, t1, r, g, b, a},
-                              {x1, y0, z, s1, t0, r, g, b, a}};
-
-      min_x = std::min(min_x, x0);
-      max_x = std::max(max_x, x1);
-      min_y = std::min(min_y, y1);
-      max_y = std::max(max_y, y0);
-
-      str_width = max_x - min_x;
-
-      if (str_width > max_width) {
-        break;
-      }
-      if (!vertex_buffers_by_layer_.count(z)) {
-        vertex_buffers_by_layer_[z] = vertex_buffer_new("vertex:3f,tex_coord:2f,color:4f");
-      }
-      vertex_buffer_push_back(vertex_buffers_by_layer_.at(z), vertices, 4, indices.data(), 6);
-      pen->x += glyph->advance_x;
+  if (!vertex_scratch_buffer_.empty()) {
+    if (!vertex_buffers_by_layer_.count(z)) {
+      vertex_buffers_by_layer_[z] = vertex_buffer_new("vertex:3f,tex_coord:2f,color:4f");
     }
+    vertex_buffer_push_back(vertex_buffers_by_layer_.at(z), vertex_scratch_buffer_.data(),
+                            vertex_scratch_buffer_.size(), index_scratch_buffer_.data(),
+                            index_scratch_buffer_.size());
   }
 
   if (out_text_pos) {
@@ -232,18 +313,25 @@ void TextRenderer::AddText(const char* text, float x, float y, float z, const Co
                            uint32_t font_size, float max_size, bool right_justified,
                            Vec2* out_text_pos, Vec2* out_text_size) {
   if (!font_size) return;
+  glyph_run_scratch_.Clear();
+  AppendShapedText(GetFont(font_size), text, 0, strlen(text), &glyph_run_scratch_);
+  AddGlyphRun(glyph_run_scratch_, x, y, z, color, max_size, right_justified, out_text_pos,
+              out_text_size);
+}
+
+void TextRenderer::AddGlyphRun(const GlyphRun& run, float x, float y, float z, const Color& color,
+                               float max_size, bool right_justified, Vec2* out_text_pos,
+                               Vec2* out_text_size) {
   ToScreenSpace(x, y, pen_.x, pen_.y);
 
   if (right_justified) {
     max_size = FLT_MAX;
-    int string_width = GetStringWidthScreenSpace(text, font_size);
-    pen_.x -= string_width;
+    pen_.x -= ceilf(run.first_line_end_pen_x);
   }
 
   vec2 out_screen_pos;
   vec2 out_screen_size;
-  AddTextInternal(GetFont(font_size), text, ColorToVec4(color), &pen_, max_size, z, &out_screen_pos,
-                  &out_screen_size);
+  AddTextInternal(run, ColorToVec4(color), &pen_, max_size, z, &out_screen_pos, &out_screen_size);
   if (out_text_pos) {
     float inv_y = canvas_->GetHeight() - out_screen_pos.y;
     (*out_text_pos) = canvas_->ScreenToWorld(Vec2(out_screen_pos.x, inv_y));
@@ -259,43 +347,33 @@ float TextRenderer::AddTextTrailingCharsPrioritized(const char* text, float x, f
                                                     const Color& color,
                                                     size_t trailing_chars_length,
                                                     uint32_t font_size, float max_size) {
-  if (!initialized_) {
-    Init();
-  }
+  InitFonts();
 
-  float temp_pen_x = ToScreenSpace(x);
   float max_width = max_size == -1.f ? FLT_MAX : ToScreenSpace(max_size);
+  // Labels of boxes that are too small for even a single character are culled before any shaping.
+  if (max_width < 1.f) return 0.f;
+
+  float start_pen_x = ToScreenSpace(x);
   float string_width = 0.f;
   int min_x = INT_MAX;
   int max_x = -INT_MAX;
 
-  const size_t text_length = strlen(text);
   texture_font_t* font = GetFont(font_size);
-  size_t i;
-  for (i = 0; i < text_length; ++i) {
-    if (!texture_font_find_glyph(font, text + i)) {
-      texture_font_load_glyph(font, text + i);
-    }
-
-    texture_glyph_t* glyph = texture_font_get_glyph(font, text + i);
-    if (glyph != NULL) {
-      float kerning = 0.0f;
-      if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, text + i - 1);
-      }
-      temp_pen_x += kerning;
-      int x0 = static_cast<int>(temp_pen_x + glyph->offset_x);
-      int x1 = static_cast<int>(x0 + glyph->width);
-
-      min_x = std::min(min_x, x0);
-      max_x = std::max(max_x, x1);
-      string_width = float(max_x - min_x);
-
-      if (string_width > max_width) {
-        break;
-      }
-
-      temp_pen_x += glyph->advance_x;
+  const size_t text_length = strlen(text);
+  trailing_chars_length = std::min(trailing_chars_length, text_length);
+  const GlyphRun& label_run = GetLabelGlyphRun(font, text, text_length, trailing_chars_length);
+  size_t i = text_length;
+  for (const CachedGlyph& glyph : label_run.glyphs) {
+    int x0 = static_cast<int>(start_pen_x + glyph.pen_x + glyph.offset_x);
+    int x1 = static_cast<int>(x0 + glyph.width);
+
+    min_x = std::min(min_x, x0);
+    max_x = std::max(max_x, x1);
+    string_width = float(max_x - min_x);
+
+    if (string_width > max_width) {
+      i = glyph.char_index;
+      break;
     }
   }
 
@@ -303,6 +381,7 @@ float TextRenderer::AddTextTrailingCharsPrioritized(const char* text, float x, f
   // characters
 
   auto fitting_chars_count = i;
+  if (fitting_chars_count == 0) return 0.f;
 
   static const char* ELLIPSIS_TEXT = "... ";
   static const size_t ELLIPSIS_TEXT_LEN = strlen(ELLIPSIS_TEXT);
@@ -313,20 +392,27 @@ float TextRenderer::AddTextTrailingCharsPrioritized(const char* text, float x, f
                            (fitting_chars_count > (trailing_chars_length + ELLIPSIS_BUFFER_SIZE));
 
   if (!use_ellipsis_text) {
-    AddText(text, x, y, z, color, font_size, max_size);
-    return GetStringWidth(text, font_size);
-  } else {
-    auto leading_char_count = fitting_chars_count - (trailing_chars_length + ELLIPSIS_TEXT_LEN);
-
-    std::string modified_text(text, leading_char_count);
-    modified_text.append(ELLIPSIS_TEXT);
-
-    auto timePosition = text_length - trailing_chars_length;
-    modified_text.append(&text[timePosition], trailing_chars_length);
+    AddGlyphRun(label_run, x, y, z, color, max_size, false, nullptr, nullptr);
+    return canvas_->ScreenToWorldWidth(static_cast<int>(ceilf(label_run.first_line_end_pen_x)));
+  }
 
-    AddText(modified_text.c_str(), x, y, z, color, font_size, max_size);
-    return GetStringWidth(modified_text.c_str(), font_size);
+  // The leading characters are the beginning of the cached glyphs of the label, only the ellipsis
+  // and the trailing characters are shaped again.
+  auto leading_char_count = fitting_chars_count - (trailing_chars_length + ELLIPSIS_TEXT_LEN);
+  glyph_run_scratch_.Clear();
+  for (const CachedGlyph& glyph : label_run.glyphs) {
+    if (glyph.char_index >= leading_char_count) break;
+    glyph_run_scratch_.glyphs.push_back(glyph);
+    glyph_run_scratch_.end_pen_x = glyph.pen_x + glyph.advance_x;
+    glyph_run_scratch_.end_pen_y = glyph.pen_y;
   }
+  AppendShapedText(font, ELLIPSIS_TEXT, 0, ELLIPSIS_TEXT_LEN, &glyph_run_scratch_);
+  AppendShapedText(font, text, text_length - trailing_chars_length, text_length,
+                   &glyph_run_scratch_);
+
+  AddGlyphRun(glyph_run_scratch_, x, y, z, color, max_size, false, nullptr, nullptr);
+  return canvas_->ScreenToWorldWidth(
+      static_cast<int>(ceilf(glyph_run_scratch_.first_line_end_pen_x)));
 }
 
 float TextRenderer::GetStringWidth(const char* text, uint32_t font_size) {
@@ -338,26 +424,11 @@ float TextRenderer::GetStringHeight(const char* text, uint32_t font_size) {
 }
 
 int TextRenderer::GetStringWidthScreenSpace(const char* text, uint32_t font_size) {
-  float string_width = 0;
-
-  std::size_t len = strlen(text);
-  for (std::size_t i = 0; i < len; ++i) {
-    texture_glyph_t* glyph = texture_font_get_glyph(GetFont(font_size), text + i);
-    if (glyph != NULL) {
-      float kerning = 0.0f;
-      if (i > 0) {
-        kerning = texture_glyph_get_kerning(glyph, text + i - 1);
-      }
-
-      string_width += kerning;
-      string_width += glyph->advance_x;
-    }
+  glyph_run_scratch_.Clear();
+  AppendShapedText(GetFont(font_size), text, 0, strlen(text), &glyph_run_scratch_);
 
-    // Only return width of first line.
-    if (text[i] == '\n') break;
-  }
-
-  return static_cast<int>(ceil(string_width));
+  // Only return width of first line.
+  return static_cast<int>(ceil(glyph_run_scratch_.first_line_end_pen_x));
 }
 
 int TextRenderer::GetStringHeightScreenSpace(const char* text, uint32_t font_size) {
@@ -387,6 +458,12 @@ std::vector<float> TextRenderer::GetLayers() const {
   return layers;
 };
 
+uint32_t TextRenderer::GetNumVertices(float layer) const {
+  auto it = vertex_buffers_by_layer_.find(layer);
+  if (it == vertex_buffers_by_layer_.end()) return 0;
+  return static_cast<uint32_t>(it->second->vertices->size);
+}
+
 void TextRenderer::ToScreenSpace(float x, float y, float& o_x, float& o_y) {
   float world_width = canvas_->GetWorldWidth();
   float world_height = canvas_->GetWorldHeight();
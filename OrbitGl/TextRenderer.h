@@ -7,9 +7,13 @@
 #include <freetype-gl/mat4.h>
 
 #include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "Batcher.h"
 #include "OpenGl.h"
+#include "absl/container/flat_hash_map.h"
 
 namespace ftgl {
 struct vertex_buffer_t;
@@ -18,37 +22,94 @@ struct texture_font_t;
 
 class GlCanvas;
 
+typedef struct {
+  float x, y, z;     // position
+  float s, t;        // texture
+  float r, g, b, a;  // color
+} vertex_t;
+
 class TextRenderer {
  public:
   explicit TextRenderer();
   ~TextRenderer();
 
   void Init();
+  // Loads the fonts without touching any OpenGL state. This is enough to generate the vertices of
+  // text (e.g. in benchmarks that run without a window), while Init() is required for rendering.
+  void InitFonts();
   void Clear();
   void SetCanvas(GlCanvas* canvas) { canvas_ = canvas; }
 
   void RenderLayer(Batcher* batcher, float layer);
   void RenderDebug(Batcher* batcher);
   [[nodiscard]] std::vector<float> GetLayers() const;
+  [[nodiscard]] uint32_t GetNumVertices(float layer) const;
 
   void AddText(const char* text, float x, float y, float z, const Color& color, uint32_t font_size,
                float max_size = -1.f, bool right_justified = false, Vec2* out_text_pos = nullptr,
                Vec2* out_text_size = nullptr);
 
+  // Adds a label made of a stable part, e.g. a function name, followed by
+  // `trailing_chars_length` characters that change often, e.g. an elapsed time. When the label is
+  // wider than max_size, the end of the stable part is replaced by an ellipsis. Returns the width
+  // of the added label, or 0 if the label was culled.
   float AddTextTrailingCharsPrioritized(const char* text, float x, float y, float z,
                                         const Color& color, size_t trailing_chars_length,
                                         uint32_t font_size, float max_size);
 
   [[nodiscard]] float GetStringWidth(const char* text, uint32_t font_size);
   [[nodiscard]] float GetStringHeight(const char* text, uint32_t font_size);
+  [[nodiscard]] size_t GetNumCachedGlyphRuns() const { return num_cached_glyph_runs_; }
 
   static void SetDrawOutline(bool value) { draw_outline_ = value; }
 
  protected:
-  void AddTextInternal(texture_font_t* font, const char* text, const vec4& color, vec2* pen,
-                       float max_size = -1.f, float z = -0.01f, vec2* out_text_pos = nullptr,
+  // A glyph of a shaped string, positioned relative to the pen at the start of the string.
+  struct CachedGlyph {
+    size_t char_index;
+    float pen_x;
+    float pen_y;
+    float advance_x;
+    float offset_x;
+    float offset_y;
+    float width;
+    float height;
+    float s0, t0, s1, t1;
+  };
+
+  // Glyph lookups and kerning of a string at a given font size.
+  struct GlyphRun {
+    void Clear() {
+      glyphs.clear();
+      end_pen_x = 0.f;
+      end_pen_y = 0.f;
+      first_line_end_pen_x = 0.f;
+      is_multi_line = false;
+    }
+
+    std::vector<CachedGlyph> glyphs;
+    float end_pen_x = 0.f;
+    float end_pen_y = 0.f;
+    float first_line_end_pen_x = 0.f;
+    bool is_multi_line = false;
+  };
+
+  void AddGlyphRun(const GlyphRun& run, float x, float y, float z, const Color& color,
+                   float max_size, bool right_justified, Vec2* out_text_pos, Vec2* out_text_size);
+  void AddTextInternal(const GlyphRun& run, const vec4& color, vec2* pen, float max_size = -1.f,
+                       float z = -0.01f, vec2* out_text_pos = nullptr,
                        vec2* out_text_size = nullptr);
 
+  // Shapes text[begin, end) and appends its glyphs to `run`, continuing at the end of the run.
+  static void AppendShapedText(texture_font_t* font, const char* text, size_t begin, size_t end,
+                               GlyphRun* run);
+  // Most labels drawn per frame are the same function names over and over, so the stable part of
+  // a label is only shaped once per font. Only that part is used as the key of the cache, as
+  // trailing characters like elapsed times would make almost every label unique.
+  [[nodiscard]] const GlyphRun& GetCachedGlyphRun(texture_font_t* font, std::string_view text);
+  [[nodiscard]] const GlyphRun& GetLabelGlyphRun(texture_font_t* font, const char* text,
+                                                 size_t text_length, size_t trailing_chars_length);
+
   void ToScreenSpace(float x, float y, float& o_x, float& o_y);
   [[nodiscard]] float ToScreenSpace(float width);
   [[nodiscard]] int GetStringWidthScreenSpace(const char* text, uint32_t font_size);
@@ -61,6 +122,13 @@ class TextRenderer {
   texture_atlas_t* texture_atlas_;
   std::unordered_map<float, vertex_buffer_t*> vertex_buffers_by_layer_;
   std::map<uint32_t, texture_font_t*> fonts_by_size_;
+  absl::flat_hash_map<texture_font_t*, absl::flat_hash_map<std::string, GlyphRun>>
+      glyph_runs_by_font_;
+  size_t num_cached_glyph_runs_ = 0;
+  GlyphRun label_glyph_run_;
+  GlyphRun glyph_run_scratch_;
+  std::vector<vertex_t> vertex_scratch_buffer_;
+  std::vector<GLuint> index_scratch_buffer_;
   GlCanvas* canvas_;
   GLuint shader_;
   mat4 model_;
@@ -68,6 +136,7 @@ class TextRenderer {
   mat4 projection_;
   vec2 pen_;
   bool initialized_;
+  bool fonts_initialized_ = false;
   static bool draw_outline_;
 };
 
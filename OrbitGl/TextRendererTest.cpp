@@ -0,0 +1,98 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "GlCanvas.h"
+#include "TextRenderer.h"
+
+namespace {
+
+constexpr uint32_t kFontSize = 14;
+constexpr int kScreenWidth = 1000;
+constexpr int kScreenHeight = 100;
+constexpr float kZ = 0.f;
+const Color kWhite(255, 255, 255, 255);
+
+// Canvas without a window whose world coordinates are its screen coordinates. Loading the fonts of
+// its text renderer is enough to generate the vertices of text without an OpenGL context.
+class HeadlessCanvas : public GlCanvas {
+ public:
+  HeadlessCanvas() : GlCanvas(kFontSize) {
+    Resize(kScreenWidth, kScreenHeight);
+    world_width_ = static_cast<float>(kScreenWidth);
+    world_height_ = static_cast<float>(kScreenHeight);
+    world_top_left_x_ = 0.f;
+    world_top_left_y_ = static_cast<float>(kScreenHeight);
+    GetTextRenderer().InitFonts();
+  }
+};
+
+}  // namespace
+
+TEST(TextRenderer, LabelsOnlyCacheTheirLeadingCharacters) {
+  HeadlessCanvas canvas;
+  TextRenderer& text_renderer = canvas.GetTextRenderer();
+
+  const std::string time = "1.23 ms";
+  text_renderer.AddTextTrailingCharsPrioritized(("function " + time).c_str(), 0.f, 0.f, kZ, kWhite,
+                                                time.size(), kFontSize, -1.f);
+  text_renderer.AddTextTrailingCharsPrioritized("function 4.56 ms", 0.f, 0.f, kZ, kWhite,
+                                                time.size(), kFontSize, -1.f);
+  EXPECT_EQ(text_renderer.GetNumCachedGlyphRuns(), 1);
+
+  text_renderer.AddTextTrailingCharsPrioritized(("other_function " + time).c_str(), 0.f, 0.f, kZ,
+                                                kWhite, time.size(), kFontSize, -1.f);
+  EXPECT_EQ(text_renderer.GetNumCachedGlyphRuns(), 2);
+
+  text_renderer.AddText("not a label", 0.f, 0.f, kZ, kWhite, kFontSize);
+  EXPECT_EQ(text_renderer.GetNumCachedGlyphRuns(), 2);
+}
+
+TEST(TextRenderer, LabelsAreShapedLikeText) {
+  HeadlessCanvas canvas;
+  TextRenderer& text_renderer = canvas.GetTextRenderer();
+
+  const std::string text = "function 1.23 ms";
+  const float width = text_renderer.AddTextTrailingCharsPrioritized(text.c_str(), 0.f, 0.f, kZ,
+                                                                    kWhite, 7, kFontSize, -1.f);
+  EXPECT_EQ(width, text_renderer.GetStringWidth(text.c_str(), kFontSize));
+  const uint32_t num_label_vertices = text_renderer.GetNumVertices(kZ);
+  EXPECT_GT(num_label_vertices, 0);
+
+  text_renderer.Clear();
+  text_renderer.AddText(text.c_str(), 0.f, 0.f, kZ, kWhite, kFontSize);
+  EXPECT_EQ(text_renderer.GetNumVertices(kZ), num_label_vertices);
+}
+
+TEST(TextRenderer, TooLongLabelsKeepTrailingCharacters) {
+  HeadlessCanvas canvas;
+  TextRenderer& text_renderer = canvas.GetTextRenderer();
+
+  const std::string time = "1.23 ms";
+  const std::string text = "a_function_with_a_very_long_name " + time;
+  const float full_width = text_renderer.GetStringWidth(text.c_str(), kFontSize);
+  const float max_size = full_width / 2;
+  const float width = text_renderer.AddTextTrailingCharsPrioritized(
+      text.c_str(), 0.f, 0.f, kZ, kWhite, time.size(), kFontSize, max_size);
+  EXPECT_LT(width, full_width);
+  EXPECT_GT(width, text_renderer.GetStringWidth(("... " + time).c_str(), kFontSize));
+  EXPECT_EQ(text_renderer.GetNumCachedGlyphRuns(), 1);
+}
+
+TEST(TextRenderer, ZeroWidthLabelsAreCulledBeforeShaping) {
+  HeadlessCanvas canvas;
+  TextRenderer& text_renderer = canvas.GetTextRenderer();
+
+  EXPECT_EQ(text_renderer.AddTextTrailingCharsPrioritized("function 1.23 ms", 0.f, 0.f, kZ, kWhite,
+                                                          7, kFontSize, 0.f),
+            0.f);
+  EXPECT_EQ(text_renderer.AddTextTrailingCharsPrioritized("function 1.23 ms", 0.f, 0.f, kZ, kWhite,
+                                                          7, kFontSize, 0.5f),
+            0.f);
+  EXPECT_EQ(text_renderer.GetNumCachedGlyphRuns(), 0);
+  EXPECT_EQ(text_renderer.GetNumVertices(kZ), 0);
+}
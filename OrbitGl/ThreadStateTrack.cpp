@@ -143,20 +143,18 @@ void ThreadStateTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
 
         const Color color = GetThreadStateColor(slice.thread_state());
 
-        auto user_data = std::make_unique<PickingUserData>(
-            nullptr, [&](PickingId id) { return GetThreadStateSliceTooltip(id); });
-        user_data->custom_data_ = &slice;
+        const PickingUserData user_data(nullptr, &slice_tooltip_callback_, &slice);
 
         if (slice.end_timestamp_ns() - slice.begin_timestamp_ns() > pixel_delta_ns) {
           Box box(pos, size, GlCanvas::kZValueEvent + z_offset);
-          batcher->AddBox(box, color, std::move(user_data));
+          batcher->AddBox(box, color, user_data);
         } else {
           // Make this slice cover an entire pixel and don't draw subsequent slices that would
           // coincide with the same pixel.
           // Use AddBox instead of AddVerticalLine as otherwise the tops of Boxes and lines wouldn't
           // be properly aligned.
           Box box(pos, {pixel_width_in_world_coords, size[1]}, GlCanvas::kZValueEvent + z_offset);
-          batcher->AddBox(box, color, std::move(user_data));
+          batcher->AddBox(box, color, user_data);
 
           if (pixel_delta_ns != 0) {
             ignore_until_ns =
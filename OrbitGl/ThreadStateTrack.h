@@ -33,6 +33,10 @@ class ThreadStateTrack final : public Track {
  private:
   std::string GetThreadStateSliceTooltip(PickingId id) const;
 
+  const TooltipCallback slice_tooltip_callback_ = [this](PickingId id) {
+    return GetThreadStateSliceTooltip(id);
+  };
+
   OrbitApp* app_ = nullptr;
 };
 
@@ -0,0 +1,251 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ThreadSummaryTrack.h"
+
+#include <absl/strings/str_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "GlCanvas.h"
+#include "TimeGraph.h"
+#include "TimeGraphLayout.h"
+#include "TrackManager.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+ThreadSummaryTrack::ThreadSummaryTrack(TimeGraph* time_graph) : Track(time_graph) {
+  collapse_toggle_->SetState(TriangleToggle::State::kCollapsed,
+                             TriangleToggle::InitialStateUpdate::kReplaceInitialState);
+  absl::MutexLock lock(&mutex_);
+  UpdateLabel();
+}
+
+std::string ThreadSummaryTrack::GetTooltip() const {
+  return "Aggregates threads with little activity. The heat map shows how busy these threads are "
+         "together over time. Expand the track to show the individual threads.";
+}
+
+float ThreadSummaryTrack::GetHeight() const {
+  const TimeGraphLayout& layout = time_graph_->GetLayout();
+  return layout.GetTextBoxHeight() + layout.GetTrackBottomMargin();
+}
+
+bool ThreadSummaryTrack::IsEmpty() const {
+  absl::MutexLock lock(&mutex_);
+  return aggregated_threads_.empty();
+}
+
+void ThreadSummaryTrack::OnCollapseToggle(TriangleToggle::State state) {
+  // Expanding or collapsing this track adds or removes tracks from the list of sorted tracks.
+  time_graph_->GetTrackManager()->InvalidateSorting();
+  Track::OnCollapseToggle(state);
+}
+
+void ThreadSummaryTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
+                                          PickingMode picking_mode, float z_offset) {
+  Batcher* batcher = &time_graph_->GetBatcher();
+  GlCanvas* canvas = time_graph_->GetCanvas();
+
+  SetSize(canvas->GetWorldWidth(), GetHeight());
+  pos_[0] = canvas->GetWorldTopLeftX();
+
+  const float track_z = GlCanvas::kZValueTrack + z_offset;
+  const float heat_map_z = GlCanvas::kZValueBox + z_offset;
+
+  Box box(pos_, Vec2(size_[0], -size_[1]), track_z);
+  batcher->AddBox(box, GetBackgroundColor(), shared_from_this());
+
+  if (picking_mode != PickingMode::kNone || max_tick <= min_tick) return;
+
+  absl::MutexLock lock(&mutex_);
+  if (buckets_.empty()) return;
+
+  // When zoomed out, several buckets fall into the same pixel. These are drawn as a single box
+  // showing the highest activity among them.
+  const double time_window_ns = 1000.0 * time_graph_->GetTimeWindowUs();
+  const double bucket_width = static_cast<double>(canvas->GetWorldWidth()) *
+                              static_cast<double>(kBucketDurationNs) / time_window_ns;
+  const double pixel_width =
+      static_cast<double>(canvas->GetWorldWidth()) / std::max(canvas->GetWidth(), 1);
+  const uint64_t buckets_per_box =
+      std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(pixel_width / bucket_width)));
+  const uint64_t box_duration_ns = buckets_per_box * kBucketDurationNs;
+
+  const Color kIdleColor = GetBackgroundColor();
+  const Color kBusyColor(255, 140, 0, 255);
+  const float box_height = GetHeight() - time_graph_->GetLayout().GetTrackBottomMargin();
+  const float box_y = pos_[1] - box_height;
+  auto add_box = [&](uint64_t box_index, float activity) {
+    const uint64_t start_ns = std::max(box_index * box_duration_ns, min_tick);
+    const uint64_t end_ns = std::min((box_index + 1) * box_duration_ns, max_tick);
+    const float x0 = time_graph_->GetWorldFromTick(start_ns);
+    const float x1 = time_graph_->GetWorldFromTick(end_ns);
+    Color color;
+    for (size_t i = 0; i < 4; ++i) {
+      color[i] = static_cast<unsigned char>(kIdleColor[i] +
+                                            activity * (kBusyColor[i] - kIdleColor[i]));
+    }
+    batcher->AddBox(Box(Vec2(x0, box_y), Vec2(x1 - x0, box_height), heat_map_z), color);
+  };
+
+  std::optional<uint64_t> current_box_index;
+  float current_box_activity = 0.f;
+  for (auto it = buckets_.lower_bound(min_tick / kBucketDurationNs);
+       it != buckets_.end() && it->first <= max_tick / kBucketDurationNs; ++it) {
+    const auto& [bucket_index, bucket] = *it;
+    const float busy_activity =
+        max_bucket_busy_ns_ == 0
+            ? 0.f
+            : static_cast<float>(static_cast<double>(bucket.busy_ns) / max_bucket_busy_ns_);
+    const float sample_activity =
+        max_bucket_callstack_events_ == 0
+            ? 0.f
+            : static_cast<float>(bucket.num_callstack_events) /
+                  static_cast<float>(max_bucket_callstack_events_);
+    const float activity = std::max(busy_activity, sample_activity);
+
+    const uint64_t box_index = bucket_index / buckets_per_box;
+    if (current_box_index.has_value() && current_box_index.value() != box_index) {
+      add_box(current_box_index.value(), current_box_activity);
+      current_box_activity = 0.f;
+    }
+    current_box_index = box_index;
+    current_box_activity = std::max(current_box_activity, activity);
+  }
+  if (current_box_index.has_value()) {
+    add_box(current_box_index.value(), current_box_activity);
+  }
+}
+
+void ThreadSummaryTrack::SetThreadTracks(std::vector<ThreadTrack*> thread_tracks) {
+  absl::MutexLock lock(&mutex_);
+
+  bool threads_removed = false;
+  absl::flat_hash_map<int32_t, AggregatedThread> aggregated_threads;
+  for (ThreadTrack* track : thread_tracks) {
+    const int32_t thread_id = track->GetThreadId();
+    auto it = aggregated_threads_.find(thread_id);
+    if (it != aggregated_threads_.end()) {
+      aggregated_threads.emplace(thread_id, it->second);
+    } else {
+      AggregatedThread& thread = aggregated_threads[thread_id];
+      thread.track = track;
+      AddExistingTimers(&thread);
+    }
+  }
+  for (const auto& [thread_id, unused_thread] : aggregated_threads_) {
+    if (!aggregated_threads.contains(thread_id)) {
+      threads_removed = true;
+      break;
+    }
+  }
+
+  aggregated_threads_ = std::move(aggregated_threads);
+  thread_tracks_ = std::move(thread_tracks);
+
+  // Threads only stop being aggregated when their activity grows, which happens at most once per
+  // thread, so rebuilding the heat map from scratch in that case is fine.
+  if (threads_removed) {
+    buckets_.clear();
+    max_bucket_busy_ns_ = 0;
+    max_bucket_callstack_events_ = 0;
+    for (auto& [unused_thread_id, thread] : aggregated_threads_) {
+      thread.timers_added_until_ns = 0;
+      thread.callstack_events_added_until_ns = 0;
+      thread.has_callstack_events = false;
+      AddExistingTimers(&thread);
+    }
+  }
+
+  UpdateLabel();
+}
+
+std::vector<ThreadTrack*> ThreadSummaryTrack::GetThreadTracks() const {
+  absl::MutexLock lock(&mutex_);
+  return thread_tracks_;
+}
+
+void ThreadSummaryTrack::OnThreadTimer(const TimerInfo& timer_info) {
+  if (timer_info.depth() != 0) return;
+
+  absl::MutexLock lock(&mutex_);
+  auto it = aggregated_threads_.find(timer_info.thread_id());
+  if (it == aggregated_threads_.end()) return;
+  // The timer might already have been added together with the existing timers of the thread.
+  if (timer_info.start() <= it->second.timers_added_until_ns) return;
+
+  AddTimer(timer_info.start(), timer_info.end());
+}
+
+void ThreadSummaryTrack::UpdateCallstackEvents(const CallstackData& callstack_data) {
+  absl::MutexLock lock(&mutex_);
+  for (auto& [thread_id, thread] : aggregated_threads_) {
+    const uint64_t min_time_ns =
+        thread.has_callstack_events ? thread.callstack_events_added_until_ns + 1 : 0;
+    for (const CallstackEvent& event : callstack_data.GetCallstackEventsOfTidInTimeRange(
+             thread_id, min_time_ns, std::numeric_limits<uint64_t>::max())) {
+      AddCallstackEvent(event.time());
+      thread.callstack_events_added_until_ns = event.time();
+      thread.has_callstack_events = true;
+    }
+  }
+}
+
+uint64_t ThreadSummaryTrack::GetBusyNsOfBucketAt(uint64_t time_ns) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = buckets_.find(time_ns / kBucketDurationNs);
+  return it != buckets_.end() ? it->second.busy_ns : 0;
+}
+
+uint32_t ThreadSummaryTrack::GetNumCallstackEventsOfBucketAt(uint64_t time_ns) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = buckets_.find(time_ns / kBucketDurationNs);
+  return it != buckets_.end() ? it->second.num_callstack_events : 0;
+}
+
+void ThreadSummaryTrack::AddTimer(uint64_t start_ns, uint64_t end_ns) {
+  for (uint64_t bucket_index = start_ns / kBucketDurationNs;
+       bucket_index <= end_ns / kBucketDurationNs; ++bucket_index) {
+    const uint64_t bucket_start_ns = bucket_index * kBucketDurationNs;
+    const uint64_t bucket_end_ns = bucket_start_ns + kBucketDurationNs;
+    Bucket& bucket = buckets_[bucket_index];
+    bucket.busy_ns += std::min(end_ns, bucket_end_ns) - std::max(start_ns, bucket_start_ns);
+    max_bucket_busy_ns_ = std::max(max_bucket_busy_ns_, bucket.busy_ns);
+  }
+}
+
+void ThreadSummaryTrack::AddCallstackEvent(uint64_t time_ns) {
+  Bucket& bucket = buckets_[time_ns / kBucketDurationNs];
+  ++bucket.num_callstack_events;
+  max_bucket_callstack_events_ =
+      std::max(max_bucket_callstack_events_, bucket.num_callstack_events);
+}
+
+void ThreadSummaryTrack::AddExistingTimers(AggregatedThread* thread) {
+  // Chains are sorted by depth and only top-level timers are aggregated.
+  std::vector<std::shared_ptr<TimerChain>> chains = thread->track->GetTimers();
+  if (chains.empty()) return;
+  for (TimerChainIterator it = chains.front()->begin(); it != chains.front()->end(); ++it) {
+    TimerBlock& block = *it;
+    for (size_t k = 0; k < block.size(); ++k) {
+      const TimerInfo& timer_info = block[k].GetTimerInfo();
+      if (timer_info.depth() != 0) return;
+      AddTimer(timer_info.start(), timer_info.end());
+      thread->timers_added_until_ns = std::max(thread->timers_added_until_ns, timer_info.start());
+    }
+  }
+}
+
+void ThreadSummaryTrack::UpdateLabel() {
+  std::string label = absl::StrFormat("Low activity threads (%u)", aggregated_threads_.size());
+  SetName(label);
+  SetLabel(label);
+}
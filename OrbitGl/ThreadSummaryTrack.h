@@ -0,0 +1,89 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_GL_THREAD_SUMMARY_TRACK_H_
+#define ORBIT_GL_THREAD_SUMMARY_TRACK_H_
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "OrbitClientData/CallstackData.h"
+#include "ThreadTrack.h"
+#include "Track.h"
+#include "capture_data.pb.h"
+
+// Track that stands in for many thread tracks with little activity, so that captures of processes
+// with thousands of (short-lived) threads don't need thousands of tracks to be laid out and drawn.
+// The activity of the aggregated threads is shown as a heat map of time buckets, which is updated
+// incrementally as timers and callstack samples arrive. Expanding the track makes TrackManager
+// show the individual thread tracks right below it.
+class ThreadSummaryTrack final : public Track {
+ public:
+  static constexpr uint64_t kBucketDurationNs = 10'000'000;
+
+  explicit ThreadSummaryTrack(TimeGraph* time_graph);
+
+  [[nodiscard]] Type GetType() const override { return kThreadSummaryTrack; }
+  [[nodiscard]] std::string GetTooltip() const override;
+  [[nodiscard]] float GetHeight() const override;
+  [[nodiscard]] bool IsCollapsable() const override { return true; }
+  [[nodiscard]] bool IsEmpty() const override;
+  [[nodiscard]] bool Movable() override { return false; }
+
+  void UpdatePrimitives(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode,
+                        float z_offset = 0) override;
+  void OnCollapseToggle(TriangleToggle::State state) override;
+
+  // Sets the thread tracks aggregated by this track, sorted as they should appear when expanded.
+  // The activity of newly aggregated threads is added to the heat map; if threads stopped being
+  // aggregated, the heat map is rebuilt from the remaining ones.
+  void SetThreadTracks(std::vector<ThreadTrack*> thread_tracks);
+  [[nodiscard]] std::vector<ThreadTrack*> GetThreadTracks() const;
+
+  // Adds a top-level timer to the heat map if its thread is aggregated by this track.
+  void OnThreadTimer(const orbit_client_protos::TimerInfo& timer_info);
+  // Adds the callstack samples of aggregated threads that were not seen before.
+  void UpdateCallstackEvents(const CallstackData& callstack_data);
+
+  // Activity of the aggregated threads in the heat map bucket that contains time_ns.
+  [[nodiscard]] uint64_t GetBusyNsOfBucketAt(uint64_t time_ns) const;
+  [[nodiscard]] uint32_t GetNumCallstackEventsOfBucketAt(uint64_t time_ns) const;
+
+ private:
+  struct Bucket {
+    uint64_t busy_ns = 0;
+    uint32_t num_callstack_events = 0;
+  };
+
+  struct AggregatedThread {
+    ThreadTrack* track = nullptr;
+    // Top-level timers starting at or before this timestamp were added when the thread started to
+    // be aggregated.
+    uint64_t timers_added_until_ns = 0;
+    // Callstack samples up to (and including) this timestamp were added to the heat map.
+    uint64_t callstack_events_added_until_ns = 0;
+    bool has_callstack_events = false;
+  };
+
+  void AddTimer(uint64_t start_ns, uint64_t end_ns);
+  void AddCallstackEvent(uint64_t time_ns);
+  void AddExistingTimers(AggregatedThread* thread);
+  void UpdateLabel();
+
+  mutable absl::Mutex mutex_;
+  std::vector<ThreadTrack*> thread_tracks_;
+  absl::flat_hash_map<int32_t, AggregatedThread> aggregated_threads_;
+  // Buckets with any activity, indexed by timestamp / kBucketDurationNs.
+  std::map<uint64_t, Bucket> buckets_;
+  uint64_t max_bucket_busy_ns_ = 0;
+  uint32_t max_bucket_callstack_events_ = 0;
+};
+
+#endif  // ORBIT_GL_THREAD_SUMMARY_TRACK_H_
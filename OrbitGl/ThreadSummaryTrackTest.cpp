@@ -0,0 +1,216 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "App.h"
+#include "OrbitClientData/Callstack.h"
+#include "OrbitClientData/CallstackTypes.h"
+#include "OrbitClientData/ModuleManager.h"
+#include "OrbitClientData/ProcessData.h"
+#include "OrbitClientModel/CaptureData.h"
+#include "ThreadSummaryTrack.h"
+#include "ThreadTrack.h"
+#include "TimeGraph.h"
+#include "TrackManager.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+constexpr uint32_t kFontSize = 14;
+// Enough thread tracks for TrackManager to aggregate the ones with little activity.
+constexpr size_t kNumThreads = 40;
+// TrackManager doesn't aggregate fewer thread tracks than this.
+constexpr size_t kMinNumThreadTracksToAggregate = 32;
+constexpr int32_t kFirstThreadId = 100;
+constexpr uint64_t kCallstackEventTimeNs = 1'000'000'000;
+constexpr uint64_t kTimerStartNs =
+    kCallstackEventTimeNs + 10 * ThreadSummaryTrack::kBucketDurationNs;
+constexpr uint64_t kTimerDurationNs = 1'000'000;
+
+class ThreadSummaryTrackTest : public testing::Test {
+ protected:
+  ThreadSummaryTrackTest() : app_{OrbitApp::Create(nullptr)} {
+    app_->SetCaptureData(
+        CaptureData(ProcessData(), &module_manager_, {}, {}, UserDefinedCaptureData()));
+    capture_data_ = &app_->GetMutableCaptureData();
+    time_graph_ = std::make_unique<TimeGraph>(kFontSize, app_.get());
+    time_graph_->SetCaptureData(capture_data_);
+
+    CallStack callstack({0x1000, 0x2000});
+    callstack_id_ = callstack.GetHash();
+    capture_data_->AddUniqueCallStack(std::move(callstack));
+  }
+
+  // Adds threads kFirstThreadId, kFirstThreadId + 1, ... with one callstack sample each, as
+  // TrackManager only creates the tracks of threads with callstack samples.
+  void AddThreads(size_t num_threads) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      AddCallstackEvents(kFirstThreadId + static_cast<int32_t>(i), 1);
+    }
+  }
+
+  void AddCallstackEvents(int32_t thread_id, size_t num_events) {
+    for (size_t i = 0; i < num_events; ++i) {
+      CallstackEvent callstack_event;
+      callstack_event.set_time(kCallstackEventTimeNs + i);
+      callstack_event.set_thread_id(thread_id);
+      callstack_event.set_callstack_hash(callstack_id_);
+      capture_data_->AddCallstackEvent(std::move(callstack_event));
+    }
+  }
+
+  [[nodiscard]] TimerInfo MakeTopLevelTimer(int32_t thread_id, uint64_t start_ns) const {
+    TimerInfo timer_info;
+    timer_info.set_process_id(capture_data_->process_id());
+    timer_info.set_thread_id(thread_id);
+    timer_info.set_start(start_ns);
+    timer_info.set_end(start_ns + kTimerDurationNs);
+    timer_info.set_depth(0);
+    timer_info.set_type(TimerInfo::kNone);
+    return timer_info;
+  }
+
+  void SortTracks() {
+    TrackManager* track_manager = time_graph_->GetTrackManager();
+    track_manager->InvalidateSorting();
+    track_manager->SortTracks();
+  }
+
+  [[nodiscard]] ThreadTrack* GetThreadTrack(int32_t thread_id) {
+    return time_graph_->GetTrackManager()->GetOrCreateThreadTrack(thread_id);
+  }
+
+  [[nodiscard]] ThreadSummaryTrack* GetThreadSummaryTrack() {
+    return time_graph_->GetTrackManager()->GetThreadSummaryTrack();
+  }
+
+  [[nodiscard]] bool IsAggregated(int32_t thread_id) {
+    std::vector<ThreadTrack*> tracks = GetThreadSummaryTrack()->GetThreadTracks();
+    return std::find(tracks.begin(), tracks.end(), GetThreadTrack(thread_id)) != tracks.end();
+  }
+
+  [[nodiscard]] bool IsVisible(const Track* track) const {
+    std::vector<Track*> tracks = time_graph_->GetTrackManager()->GetVisibleTracks();
+    return std::find(tracks.begin(), tracks.end(), track) != tracks.end();
+  }
+
+  orbit_client_data::ModuleManager module_manager_;
+  std::unique_ptr<OrbitApp> app_;
+  CaptureData* capture_data_ = nullptr;
+  std::unique_ptr<TimeGraph> time_graph_;
+  CallstackID callstack_id_ = 0;
+};
+
+}  // namespace
+
+TEST_F(ThreadSummaryTrackTest, AggregatesThreadsUpToMaxEvents) {
+  AddThreads(kNumThreads);
+  const auto max_events =
+      static_cast<size_t>(time_graph_->GetLayout().GetLowActivityThreadMaxEvents());
+  constexpr int32_t kThreadAtMaxEvents = kFirstThreadId;
+  constexpr int32_t kThreadAboveMaxEvents = kFirstThreadId + 1;
+  AddCallstackEvents(kThreadAtMaxEvents, max_events - 1);
+  AddCallstackEvents(kThreadAboveMaxEvents, max_events);
+
+  SortTracks();
+
+  EXPECT_EQ(GetThreadSummaryTrack()->GetThreadTracks().size(), kNumThreads - 1);
+  EXPECT_TRUE(IsAggregated(kThreadAtMaxEvents));
+  EXPECT_FALSE(IsAggregated(kThreadAboveMaxEvents));
+  EXPECT_TRUE(IsVisible(GetThreadSummaryTrack()));
+  EXPECT_TRUE(IsVisible(GetThreadTrack(kThreadAboveMaxEvents)));
+  // The summary track starts collapsed, hiding the aggregated threads.
+  EXPECT_FALSE(IsVisible(GetThreadTrack(kThreadAtMaxEvents)));
+}
+
+TEST_F(ThreadSummaryTrackTest, TimersCountTowardsMaxEvents) {
+  AddThreads(kNumThreads);
+  const auto max_events =
+      static_cast<size_t>(time_graph_->GetLayout().GetLowActivityThreadMaxEvents());
+  for (size_t i = 0; i < max_events; ++i) {
+    time_graph_->ProcessTimer(
+        MakeTopLevelTimer(kFirstThreadId, kTimerStartNs + i * kTimerDurationNs), nullptr);
+  }
+
+  SortTracks();
+
+  EXPECT_FALSE(IsAggregated(kFirstThreadId));
+  EXPECT_TRUE(IsAggregated(kFirstThreadId + 1));
+}
+
+TEST_F(ThreadSummaryTrackTest, NoAggregationWithFewThreadTracks) {
+  AddThreads(kMinNumThreadTracksToAggregate - 1);
+
+  SortTracks();
+
+  EXPECT_TRUE(GetThreadSummaryTrack()->IsEmpty());
+  EXPECT_FALSE(IsVisible(GetThreadSummaryTrack()));
+  EXPECT_TRUE(IsVisible(GetThreadTrack(kFirstThreadId)));
+
+  AddThreads(kMinNumThreadTracksToAggregate);
+  SortTracks();
+
+  EXPECT_EQ(GetThreadSummaryTrack()->GetThreadTracks().size(), kMinNumThreadTracksToAggregate);
+  EXPECT_TRUE(IsVisible(GetThreadSummaryTrack()));
+}
+
+TEST_F(ThreadSummaryTrackTest, TimersAreAddedToHeatMapOnce) {
+  AddThreads(kNumThreads);
+  // This timer reaches the thread track before the thread is aggregated, and the summary track
+  // only afterwards.
+  const TimerInfo early_timer = MakeTopLevelTimer(kFirstThreadId, kTimerStartNs);
+  GetThreadTrack(kFirstThreadId)->OnTimer(early_timer);
+
+  SortTracks();
+  ASSERT_TRUE(IsAggregated(kFirstThreadId));
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), kTimerDurationNs);
+
+  GetThreadSummaryTrack()->OnThreadTimer(early_timer);
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), kTimerDurationNs);
+
+  time_graph_->ProcessTimer(MakeTopLevelTimer(kFirstThreadId, kTimerStartNs + kTimerDurationNs),
+                            nullptr);
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), 2 * kTimerDurationNs);
+
+  SortTracks();
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), 2 * kTimerDurationNs);
+  EXPECT_EQ(GetThreadSummaryTrack()->GetNumCallstackEventsOfBucketAt(kCallstackEventTimeNs),
+            kNumThreads);
+}
+
+TEST_F(ThreadSummaryTrackTest, HeatMapIsRebuiltWhenThreadsStopBeingAggregated) {
+  AddThreads(kNumThreads);
+  constexpr int32_t kBusyThreadId = kFirstThreadId;
+  constexpr int32_t kIdleThreadId = kFirstThreadId + 1;
+  time_graph_->ProcessTimer(MakeTopLevelTimer(kBusyThreadId, kTimerStartNs), nullptr);
+  time_graph_->ProcessTimer(MakeTopLevelTimer(kIdleThreadId, kTimerStartNs), nullptr);
+
+  SortTracks();
+  ASSERT_TRUE(IsAggregated(kBusyThreadId));
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), 2 * kTimerDurationNs);
+  EXPECT_EQ(GetThreadSummaryTrack()->GetNumCallstackEventsOfBucketAt(kCallstackEventTimeNs),
+            kNumThreads);
+
+  const auto max_events =
+      static_cast<size_t>(time_graph_->GetLayout().GetLowActivityThreadMaxEvents());
+  AddCallstackEvents(kBusyThreadId, max_events);
+  SortTracks();
+
+  EXPECT_FALSE(IsAggregated(kBusyThreadId));
+  EXPECT_TRUE(IsAggregated(kIdleThreadId));
+  EXPECT_EQ(GetThreadSummaryTrack()->GetBusyNsOfBucketAt(kTimerStartNs), kTimerDurationNs);
+  EXPECT_EQ(GetThreadSummaryTrack()->GetNumCallstackEventsOfBucketAt(kCallstackEventTimeNs),
+            kNumThreads - 1);
+}
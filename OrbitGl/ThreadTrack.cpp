@@ -67,7 +67,7 @@ std::string ThreadTrack::GetBoxTooltip(PickingId id) const {
   if (is_manual) {
     const TimerInfo& timer_info = text_box->GetTimerInfo();
     auto api_event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
-    function_name = api_event.name;
+    function_name = app_->GetManualInstrumentationManager()->GetEventName(api_event);
   } else {
     function_name = function_utils::GetDisplayName(*func);
   }
@@ -132,8 +132,9 @@ Color ThreadTrack::GetTimerColor(const TimerInfo& timer_info, bool is_selected)
     color = user_color.value();
   } else if (timer_info.type() == TimerInfo::kIntrospection) {
     orbit_api::Event event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
-    color = event.color == orbit::Color::kAuto ? time_graph_->GetColor(event.name)
-                                               : ToColor(static_cast<uint64_t>(event.color));
+    color = event.color == orbit::Color::kAuto
+                ? time_graph_->GetColor(app_->GetManualInstrumentationManager()->GetEventName(event))
+                : ToColor(static_cast<uint64_t>(event.color));
   } else {
     color = time_graph_->GetThreadColor(timer_info.thread_id());
   }
@@ -244,6 +245,8 @@ void ThreadTrack::SetTrackColor(Color color) {
 void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_us, float min_x,
                                    float z_offset, TextBox* text_box) {
   TimeGraphLayout layout = time_graph_->GetLayout();
+  ManualInstrumentationManager* manual_instrumentation_manager =
+      app_->GetManualInstrumentationManager();
   if (text_box->GetText().empty()) {
     std::string time = GetPrettyTime(absl::Microseconds(elapsed_us));
     text_box->SetElapsedTimeTextLength(time.length());
@@ -254,7 +257,9 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_u
       std::string name;
       if (func->orbit_type() == FunctionInfo::kOrbitTimerStart) {
         auto api_event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
-        name = api_event.name;
+        // Don't cache the text until the interned name of the scope is received.
+        if (!manual_instrumentation_manager->IsEventNameKnown(api_event)) return;
+        name = manual_instrumentation_manager->GetEventName(api_event);
       } else {
         name = function_utils::GetDisplayName(*func);
       }
@@ -264,7 +269,9 @@ void ThreadTrack::SetTimesliceText(const TimerInfo& timer_info, double elapsed_u
       text_box->SetText(text);
     } else if (timer_info.type() == TimerInfo::kIntrospection) {
       auto api_event = ManualInstrumentationManager::ApiEventFromTimerInfo(timer_info);
-      std::string text = absl::StrFormat("%s %s", api_event.name, time.c_str());
+      if (!manual_instrumentation_manager->IsEventNameKnown(api_event)) return;
+      std::string text = absl::StrFormat(
+          "%s %s", manual_instrumentation_manager->GetEventName(api_event), time.c_str());
       text_box->SetText(text);
     } else {
       ERROR(
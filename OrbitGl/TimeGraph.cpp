@@ -265,6 +265,7 @@ void TimeGraph::ProcessTimer(const TimerInfo& timer_info, const FunctionInfo* fu
     ThreadTrack* track = track_manager_->GetOrCreateThreadTrack(timer_info.thread_id());
     if (timer_info.type() != TimerInfo::kCoreActivity) {
       track->OnTimer(timer_info);
+      track_manager_->GetThreadSummaryTrack()->OnThreadTimer(timer_info);
       ++thread_count_map_[timer_info.thread_id()];
     } else {
       auto scheduler_track = track_manager_->GetOrCreateSchedulerTrack();
@@ -316,6 +317,7 @@ void TimeGraph::ProcessIntrospectionTimer(const TimerInfo& timer_info) {
     case orbit_api::kTrackFloat:
     case orbit_api::kTrackDouble:
     case orbit_api::kString:
+    case orbit_api::kNameRegistration:
       ProcessValueTrackingTimer(timer_info);
       break;
     default:
@@ -330,8 +332,17 @@ void TimeGraph::ProcessValueTrackingTimer(const TimerInfo& timer_info) {
     manual_instrumentation_manager_->ProcessStringEvent(event);
     return;
   }
+  if (event.type == orbit_api::kNameRegistration) {
+    for (const TimerInfo& deferred_timer_info :
+         manual_instrumentation_manager_->ProcessNameRegistrationEvent(event)) {
+      ProcessValueTrackingTimer(deferred_timer_info);
+    }
+    return;
+  }
+  if (manual_instrumentation_manager_->DeferTimerIfNameIsUnknown(timer_info)) return;
 
-  GraphTrack* track = track_manager_->GetOrCreateGraphTrack(event.name);
+  GraphTrack* track =
+      track_manager_->GetOrCreateGraphTrack(manual_instrumentation_manager_->GetEventName(event));
   uint64_t time = timer_info.start();
 
   switch (event.type) {
@@ -517,6 +528,8 @@ void TimeGraph::NeedsUpdate() {
 
 void TimeGraph::UpdatePrimitives(PickingMode picking_mode) {
   ORBIT_SCOPE_FUNCTION;
+  RenderingStats::ScopedStageTimer stage_timer(&rendering_stats_,
+                                               RenderingStats::Stage::kUpdatePrimitives);
   CHECK(track_manager_->GetStringManager() != nullptr);
 
   batcher_.StartNewFrame();
@@ -740,6 +753,7 @@ std::string TimeGraph::GetThreadNameFromTid(uint32_t tid) {
 
 void TimeGraph::DrawTracks(GlCanvas* canvas, PickingMode picking_mode) {
   for (auto& track : track_manager_->GetVisibleTracks()) {
+    if (!track_manager_->IsTrackInViewport(*track)) continue;
     float z_offset = 0;
     if (track->IsPinned()) {
       z_offset = GlCanvas::kZOffsetPinnedTrack;
@@ -23,6 +23,7 @@
 #include "ManualInstrumentationManager.h"
 #include "OrbitClientModel/CaptureData.h"
 #include "PickingManager.h"
+#include "RenderingStats.h"
 #include "StringManager.h"
 #include "TextBox.h"
 #include "TextRenderer.h"
@@ -122,6 +123,7 @@ class TimeGraph {
     return lround((font_size_)*layout_.GetScale());
   }
   [[nodiscard]] Batcher& GetBatcher() { return batcher_; }
+  [[nodiscard]] RenderingStats& GetRenderingStats() { return rendering_stats_; }
   [[nodiscard]] uint32_t GetNumTimers() const;
   [[nodiscard]] uint32_t GetNumCores() const { return num_cores_; }
   [[nodiscard]] std::vector<std::shared_ptr<TimerChain>> GetAllTimerChains() const;
@@ -234,6 +236,7 @@ class TimeGraph {
   bool draw_text_ = true;
 
   Batcher batcher_;
+  RenderingStats rendering_stats_;
 
   // TODO(b/174655559): Use absl's mutex here.
   mutable std::recursive_mutex mutex_;
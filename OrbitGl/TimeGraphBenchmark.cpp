@@ -0,0 +1,200 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "App.h"
+#include "Batcher.h"
+#include "CaptureWindow.h"
+#include "OrbitClientData/Callstack.h"
+#include "OrbitClientData/CallstackTypes.h"
+#include "OrbitClientData/ModuleManager.h"
+#include "OrbitClientModel/CaptureData.h"
+#include "StringManager.h"
+#include "TextRenderer.h"
+#include "TimeGraph.h"
+#include "capture_data.pb.h"
+
+using orbit_client_protos::CallstackEvent;
+using orbit_client_protos::TimerInfo;
+
+namespace {
+
+constexpr uint32_t kFontSize = 14;
+constexpr int kScreenWidth = 1920;
+constexpr int kScreenHeight = 1080;
+constexpr int32_t kProcessId = 42;
+constexpr uint64_t kCaptureStartNs = 1'000'000'000;
+constexpr uint64_t kTopLevelTimerPeriodNs = 1'000'000;
+constexpr uint64_t kCallstackPeriodNs = 100'000;
+constexpr size_t kNumUniqueCallstacks = 16;
+constexpr size_t kCallstackDepth = 32;
+
+// CaptureWindow that is never shown on screen. The world dimensions, which are usually updated
+// while preparing the OpenGL viewport, are derived from the screen size directly, and only the
+// fonts of the text renderers are loaded. This is enough to generate all primitives of a frame
+// without an OpenGL context.
+class HeadlessCaptureWindow : public CaptureWindow {
+ public:
+  explicit HeadlessCaptureWindow(OrbitApp* app) : CaptureWindow(kFontSize, app) {
+    Resize(kScreenWidth, kScreenHeight);
+    world_width_ = static_cast<float>(kScreenWidth);
+    world_height_ = static_cast<float>(kScreenHeight);
+    GetTextRenderer().InitFonts();
+    GetTimeGraph()->GetTextRenderer()->InitFonts();
+  }
+};
+
+// Capture made of `num_threads` threads, each with `num_timers_per_thread` timers. The timers of a
+// thread are organized as back-to-back stacks of nested calls of depth `depth`. Every thread also
+// gets a callstack sample every kCallstackPeriodNs.
+class SyntheticCapture {
+ public:
+  SyntheticCapture(size_t num_threads, size_t num_timers_per_thread, size_t depth)
+      : app_(OrbitApp::Create(nullptr)),
+        capture_data_(ProcessData(), &module_manager_, {}, {}, UserDefinedCaptureData()),
+        capture_window_(app_.get()) {
+    TimeGraph* time_graph = capture_window_.GetTimeGraph();
+    time_graph->SetStringManager(std::make_shared<StringManager>());
+    time_graph->SetCaptureData(&capture_data_);
+
+    for (size_t i = 0; i < kNumUniqueCallstacks; ++i) {
+      std::vector<uint64_t> frames(kCallstackDepth);
+      for (size_t frame = 0; frame < kCallstackDepth; ++frame) {
+        frames[frame] = 0x10000 * (i + 1) + frame;
+      }
+      CallStack callstack(std::move(frames));
+      callstack_ids_.push_back(callstack.GetHash());
+      capture_data_.AddUniqueCallStack(std::move(callstack));
+    }
+
+    const size_t num_stacks_per_thread = std::max<size_t>(num_timers_per_thread / depth, 1);
+    capture_end_ns_ = kCaptureStartNs + num_stacks_per_thread * kTopLevelTimerPeriodNs;
+    for (size_t thread = 0; thread < num_threads; ++thread) {
+      const int32_t thread_id = kProcessId + 1 + static_cast<int32_t>(thread);
+      capture_data_.AddOrAssignThreadName(thread_id, "Thread " + std::to_string(thread));
+      AddTimers(time_graph, thread_id, num_stacks_per_thread, depth);
+      AddCallstackEvents(thread_id);
+    }
+    time_graph->UpdateCaptureMinMaxTimestamps();
+  }
+
+  [[nodiscard]] TimeGraph* GetTimeGraph() { return capture_window_.GetTimeGraph(); }
+  [[nodiscard]] TextRenderer& GetTextRenderer() { return capture_window_.GetTextRenderer(); }
+  [[nodiscard]] uint64_t GetCaptureStartNs() const { return kCaptureStartNs; }
+  [[nodiscard]] uint64_t GetCaptureEndNs() const { return capture_end_ns_; }
+
+ private:
+  static void AddTimers(TimeGraph* time_graph, int32_t thread_id, size_t num_stacks,
+                        size_t depth) {
+    for (size_t stack = 0; stack < num_stacks; ++stack) {
+      uint64_t start_ns = kCaptureStartNs + stack * kTopLevelTimerPeriodNs;
+      uint64_t end_ns = start_ns + kTopLevelTimerPeriodNs * 9 / 10;
+      for (size_t current_depth = 0; current_depth < depth; ++current_depth) {
+        TimerInfo timer_info;
+        timer_info.set_process_id(kProcessId);
+        timer_info.set_thread_id(thread_id);
+        timer_info.set_start(start_ns);
+        timer_info.set_end(end_ns);
+        timer_info.set_depth(static_cast<uint32_t>(current_depth));
+        timer_info.set_function_address(0x1000 + current_depth);
+        timer_info.set_type(TimerInfo::kNone);
+        time_graph->ProcessTimer(timer_info, nullptr);
+
+        // Each child covers the middle part of its parent.
+        const uint64_t margin_ns = (end_ns - start_ns) / 8;
+        start_ns += margin_ns;
+        end_ns -= margin_ns;
+      }
+    }
+  }
+
+  void AddCallstackEvents(int32_t thread_id) {
+    size_t index = 0;
+    for (uint64_t time = kCaptureStartNs; time < capture_end_ns_; time += kCallstackPeriodNs) {
+      CallstackEvent callstack_event;
+      callstack_event.set_time(time);
+      callstack_event.set_thread_id(thread_id);
+      callstack_event.set_callstack_hash(callstack_ids_[index++ % callstack_ids_.size()]);
+      capture_data_.AddCallstackEvent(std::move(callstack_event));
+    }
+  }
+
+  std::unique_ptr<OrbitApp> app_;
+  orbit_client_data::ModuleManager module_manager_;
+  CaptureData capture_data_;
+  HeadlessCaptureWindow capture_window_;
+  std::vector<CallstackID> callstack_ids_;
+  uint64_t capture_end_ns_ = 0;
+};
+
+// Size in bytes of the primitives and text vertices generated for the last frame, including the
+// colors used for drawing and for picking, and the per-primitive picking user data.
+uint64_t GetPrimitivesSizeInBytes(SyntheticCapture* capture) {
+  uint64_t size = 0;
+  const Batcher& batcher = capture->GetTimeGraph()->GetBatcher();
+  for (float layer : batcher.GetLayers()) {
+    RenderingStats::LayerStats stats = batcher.GetLayerStats(layer);
+    size += stats.num_lines * (sizeof(Line) + 2 * 2 * sizeof(Color));
+    size += stats.num_boxes * (sizeof(Box) + 2 * 4 * sizeof(Color));
+    size += stats.num_triangles * (sizeof(Triangle) + 2 * 3 * sizeof(Color));
+    size += (stats.num_lines + stats.num_boxes + stats.num_triangles) * sizeof(PickingUserData);
+  }
+
+  for (TextRenderer* text_renderer :
+       {&capture->GetTextRenderer(), capture->GetTimeGraph()->GetTextRenderer()}) {
+    for (float layer : text_renderer->GetLayers()) {
+      size += text_renderer->GetNumVertices(layer) * sizeof(vertex_t);
+    }
+  }
+  return size;
+}
+
+// Arguments: number of threads, timers per thread, depth of the timer stacks, and the fraction of
+// the capture that is visible, in 1/1000 (1000 shows the whole capture).
+void BM_UpdatePrimitives(benchmark::State& state) {
+  SyntheticCapture capture(state.range(0), state.range(1), state.range(2));
+  TimeGraph* time_graph = capture.GetTimeGraph();
+
+  const uint64_t capture_duration_ns = capture.GetCaptureEndNs() - capture.GetCaptureStartNs();
+  const uint64_t visible_duration_ns = capture_duration_ns * state.range(3) / 1000;
+  const uint64_t visible_start_ns =
+      capture.GetCaptureStartNs() + (capture_duration_ns - visible_duration_ns) / 2;
+  time_graph->Zoom(visible_start_ns, visible_start_ns + visible_duration_ns);
+
+  for (auto _ : state) {
+    capture.GetTextRenderer().Clear();
+    time_graph->UpdatePrimitives(PickingMode::kNone);
+  }
+
+  state.counters["primitive_bytes"] =
+      benchmark::Counter(static_cast<double>(GetPrimitivesSizeInBytes(&capture)),
+                         benchmark::Counter::kDefaults, benchmark::Counter::kIs1024);
+  state.counters["frames_per_second"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_UpdatePrimitives)
+    ->ArgNames({"threads", "timers", "depth", "zoom"})
+    // Few threads with a lot of timers, at different zoom levels.
+    ->Args({8, 100'000, 8, 1000})
+    ->Args({8, 100'000, 8, 100})
+    ->Args({8, 100'000, 8, 1})
+    // Many threads with few timers each.
+    ->Args({1000, 1'000, 4, 1000})
+    ->Args({1000, 1'000, 4, 10})
+    // Deep stacks.
+    ->Args({16, 50'000, 50, 1000})
+    ->Args({16, 50'000, 50, 10});
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -71,6 +71,13 @@ bool TimeGraphLayout::DrawProperties() {
   FLOAT_SLIDER(toolbar_icon_height_);
   FLOAT_SLIDER_MIN_MAX(scale_, 0.05f, 20.f);
   ImGui::Checkbox("Draw Track Background", &draw_track_background_);
+  if (ImGui::Checkbox("Aggregate Low Activity Threads", &aggregate_low_activity_threads_)) {
+    needs_redraw = true;
+  }
+  if (ImGui::SliderInt("low_activity_thread_max_events_", &low_activity_thread_max_events_, 0,
+                       1000)) {
+    needs_redraw = true;
+  }
 
   return needs_redraw;
 }
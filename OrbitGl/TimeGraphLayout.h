@@ -41,6 +41,8 @@ class TimeGraphLayout {
   void SetNumCores(int a_NumCores) { num_cores_ = a_NumCores; }
   bool DrawProperties();
   bool GetDrawTrackBackground() const { return draw_track_background_; }
+  bool GetAggregateLowActivityThreads() const { return aggregate_low_activity_threads_; }
+  int GetLowActivityThreadMaxEvents() const { return low_activity_thread_max_events_; }
 
  protected:
   int num_cores_;
@@ -76,6 +78,10 @@ class TimeGraphLayout {
 
   bool draw_properties_ = false;
   bool draw_track_background_ = true;
+  // Threads with at most this many timers and callstack samples are shown in a single summary
+  // track when the capture has many threads.
+  bool aggregate_low_activity_threads_ = true;
+  int low_activity_thread_max_events_ = 10;
 };
 
 #endif  // ORBIT_GL_TIME_GRAPH_LAYOUT_H_
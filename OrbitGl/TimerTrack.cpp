@@ -120,16 +120,15 @@ void TimerTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
         text_box.SetPos(pos);
         text_box.SetSize(size);
 
-        auto user_data = std::make_unique<PickingUserData>(
-            &text_box, [&](PickingId id) { return this->GetBoxTooltip(id); });
+        const PickingUserData user_data(&text_box, &box_tooltip_callback_);
 
         if (is_visible_width) {
           if (!is_collapsed) {
             SetTimesliceText(timer_info, elapsed_us, world_start_x, z_offset, &text_box);
           }
-          batcher->AddShadedBox(pos, size, z, color, std::move(user_data));
+          batcher->AddShadedBox(pos, size, z, color, user_data);
         } else {
-          batcher->AddVerticalLine(pos, size[1], z, color, std::move(user_data));
+          batcher->AddVerticalLine(pos, size[1], z, color, user_data);
           // For lines, we can ignore the entire pixel into which this event
           // falls. We align this precisely on the pixel x-coordinate of the
           // current line being drawn (in ticks). If pixel_delta_in_ticks is
@@ -91,6 +91,10 @@ class TimerTrack : public Track {
   std::map<int, std::shared_ptr<TimerChain>> timers_;
 
   [[nodiscard]] virtual std::string GetBoxTooltip(PickingId id) const;
+  // Shared by all boxes of this track, so that no per-box callback has to be created.
+  const TooltipCallback box_tooltip_callback_ = [this](PickingId id) {
+    return GetBoxTooltip(id);
+  };
   float GetHeight() const override;
   float box_height_;
 
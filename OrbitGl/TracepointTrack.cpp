@@ -104,10 +104,9 @@ void TracepointTrack::UpdatePrimitives(uint64_t min_tick, uint64_t max_tick,
           Vec2 pos(time_graph_->GetWorldFromTick(time) - kPickingBoxOffset,
                    pos_[1] - track_height + 1);
           Vec2 size(kPickingBoxWidth, track_height);
-          auto user_data = std::make_unique<PickingUserData>(
-              nullptr, [&](PickingId id) -> std::string { return GetSampleTooltip(id); });
-          user_data->custom_data_ = &tracepoint;
-          batcher->AddShadedBox(pos, size, z, kGreenSelection, std::move(user_data));
+          batcher->AddShadedBox(
+              pos, size, z, kGreenSelection,
+              PickingUserData(nullptr, &tracepoint_tooltip_callback_, &tracepoint));
         });
   }
 }
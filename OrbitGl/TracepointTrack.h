@@ -23,6 +23,11 @@ class TracepointTrack : public EventTrack {
 
   std::string GetSampleTooltip(PickingId id) const;
   bool IsEmpty() const override;
+
+ private:
+  const TooltipCallback tracepoint_tooltip_callback_ = [this](PickingId id) {
+    return GetSampleTooltip(id);
+  };
 };
 
 #endif  // ORBIT_GL_TRACEPOINT_TRACK_H_
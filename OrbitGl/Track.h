@@ -36,6 +36,7 @@ class Track : public Pickable, public std::enable_shared_from_this<Track> {
     kSchedulerTrack,
     kAsyncTrack,
     kThreadStateTrack,
+    kThreadSummaryTrack,
     kUnknown,
   };
 
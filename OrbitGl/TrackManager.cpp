@@ -29,9 +29,17 @@
 
 using orbit_client_protos::FunctionInfo;
 
+namespace {
+
+// Below this number of thread tracks, aggregating low activity threads doesn't save much.
+constexpr size_t kMinNumThreadTracksToAggregate = 32;
+
+}  // namespace
+
 TrackManager::TrackManager(TimeGraph* time_graph, OrbitApp* app)
     : time_graph_(time_graph), app_{app} {
   GetOrCreateSchedulerTrack();
+  thread_summary_track_ = std::make_shared<ThreadSummaryTrack>(time_graph_);
 
   tracepoints_system_wide_track_ = GetOrCreateThreadTrack(orbit_base::kAllThreadsOfAllProcessesTid);
 }
@@ -49,6 +57,7 @@ void TrackManager::Clear() {
   visible_tracks_.clear();
 
   GetOrCreateSchedulerTrack();
+  thread_summary_track_ = std::make_shared<ThreadSummaryTrack>(time_graph_);
   tracepoints_system_wide_track_ = GetOrCreateThreadTrack(orbit_base::kAllThreadsOfAllProcessesTid);
 }
 
@@ -139,16 +148,20 @@ void TrackManager::SortTracks() {
       all_processes_sorted_tracks.push_back(process_track);
     }
 
+    // Separate "capture_pid" tracks from tracks that originate from other processes.
+    int32_t capture_pid = capture_data ? capture_data->process_id() : 0;
+
     // Thread tracks.
+    std::vector<ThreadTrack*> thread_tracks;
     for (auto thread_id : sorted_thread_ids) {
       auto track = GetOrCreateThreadTrack(thread_id);
       if (!track->IsEmpty()) {
-        all_processes_sorted_tracks.push_back(track);
+        thread_tracks.push_back(track);
       }
     }
+    Append(all_processes_sorted_tracks,
+           AggregateLowActivityThreadTracks(thread_tracks, capture_pid));
 
-    // Separate "capture_pid" tracks from tracks that originate from other processes.
-    int32_t capture_pid = capture_data ? capture_data->process_id() : 0;
     std::vector<Track*> capture_pid_tracks;
     std::vector<Track*> external_pid_tracks;
     for (auto& track : all_processes_sorted_tracks) {
@@ -180,6 +193,49 @@ void TrackManager::SortTracks() {
   sorting_invalidated_ = false;
 }
 
+std::vector<Track*> TrackManager::AggregateLowActivityThreadTracks(
+    const std::vector<ThreadTrack*>& thread_tracks, int32_t capture_pid) {
+  const TimeGraphLayout& layout = time_graph_->GetLayout();
+  if (!layout.GetAggregateLowActivityThreads() ||
+      thread_tracks.size() < kMinNumThreadTracksToAggregate) {
+    thread_summary_track_->SetThreadTracks({});
+    return {thread_tracks.begin(), thread_tracks.end()};
+  }
+
+  const uint64_t max_num_events = static_cast<uint64_t>(layout.GetLowActivityThreadMaxEvents());
+  std::vector<Track*> tracks;
+  std::vector<ThreadTrack*> low_activity_tracks;
+  for (ThreadTrack* track : thread_tracks) {
+    const int32_t thread_id = track->GetThreadId();
+    const int32_t pid = track->GetProcessId();
+    auto event_count_it = event_count_.find(thread_id);
+    const uint64_t num_events = static_cast<uint64_t>(track->GetNumTimers()) +
+                                (event_count_it != event_count_.end() ? event_count_it->second : 0);
+    // Pinned and selected threads, as well as threads of other processes (introspection), are
+    // always shown on their own.
+    if (track->IsPinned() || thread_id == app_->selected_thread_id() ||
+        (pid != -1 && pid != capture_pid) || num_events > max_num_events) {
+      tracks.push_back(track);
+    } else {
+      low_activity_tracks.push_back(track);
+    }
+  }
+
+  thread_summary_track_->SetThreadTracks(low_activity_tracks);
+  const CaptureData* capture_data = time_graph_->GetCaptureData();
+  if (capture_data != nullptr) {
+    thread_summary_track_->UpdateCallstackEvents(*capture_data->GetCallstackData());
+  }
+
+  if (!thread_summary_track_->IsEmpty()) {
+    tracks.push_back(thread_summary_track_.get());
+    if (!thread_summary_track_->IsCollapsed()) {
+      tracks.insert(tracks.end(), low_activity_tracks.begin(), low_activity_tracks.end());
+    }
+  }
+  return tracks;
+}
+
 void TrackManager::SetFilter(const std::string& filter) {
   filter_ = absl::AsciiStrToLower(filter);
   UpdateFilteredTrackList();
@@ -193,12 +249,24 @@ void TrackManager::UpdateFilteredTrackList() {
 
   visible_tracks_.clear();
   std::vector<std::string> filters = absl::StrSplit(filter_, ' ', absl::SkipWhitespace());
-  for (const auto& track : sorted_tracks_) {
+  auto matches_filter = [&filters](const Track* track) {
     std::string lower_case_label = absl::AsciiStrToLower(track->GetLabel());
     for (auto& filter : filters) {
-      if (absl::StrContains(lower_case_label, filter)) {
-        visible_tracks_.push_back(track);
-        break;
+      if (absl::StrContains(lower_case_label, filter)) return true;
+    }
+    return false;
+  };
+  for (const auto& track : sorted_tracks_) {
+    if (matches_filter(track)) {
+      visible_tracks_.push_back(track);
+    }
+    // Aggregated threads that are not shown because the summary track is collapsed can still be
+    // found by filtering.
+    if (track == thread_summary_track_.get() && thread_summary_track_->IsCollapsed()) {
+      for (ThreadTrack* thread_track : thread_summary_track_->GetThreadTracks()) {
+        if (matches_filter(thread_track)) {
+          visible_tracks_.push_back(thread_track);
+        }
       }
     }
   }
@@ -312,7 +380,7 @@ void TrackManager::UpdateTracks(uint64_t min_tick, uint64_t max_tick, PickingMod
     const float z_offset = GlCanvas::kZOffsetPinnedTrack;
     track->SetY(current_y + time_graph_->GetCanvas()->GetWorldTopLeftY() - layout.GetTopMargin() -
                 layout.GetSchedulerTrackOffset());
-    track->UpdatePrimitives(min_tick, max_tick, picking_mode, z_offset);
+    UpdateTrackPrimitives(track, min_tick, max_tick, picking_mode, z_offset);
     const float height = (track->GetHeight() + layout.GetSpaceBetweenTracks());
     current_y -= height;
     pinned_tracks_height += height;
@@ -326,7 +394,9 @@ void TrackManager::UpdateTracks(uint64_t min_tick, uint64_t max_tick, PickingMod
 
     const float z_offset = track->IsMoving() ? GlCanvas::kZOffsetMovingTack : 0.f;
     track->SetY(current_y);
-    track->UpdatePrimitives(min_tick, max_tick, picking_mode, z_offset);
+    if (IsTrackInViewport(*track)) {
+      UpdateTrackPrimitives(track, min_tick, max_tick, picking_mode, z_offset);
+    }
     current_y -= (track->GetHeight() + layout.GetSpaceBetweenTracks());
   }
 
@@ -334,6 +404,30 @@ void TrackManager::UpdateTracks(uint64_t min_tick, uint64_t max_tick, PickingMod
   tracks_total_height_ = std::abs(current_y);
 }
 
+bool TrackManager::IsTrackInViewport(const Track& track) const {
+  if (track.IsPinned() || track.IsMoving()) return true;
+
+  const GlCanvas* canvas = time_graph_->GetCanvas();
+  const TimeGraphLayout& layout = time_graph_->GetLayout();
+  // The tab is drawn above the top of the track.
+  const float track_top = track.GetPos()[1] + layout.GetTrackTabHeight();
+  const float track_bottom = track.GetPos()[1] - track.GetHeight();
+  // Keep a margin of one viewport height on both sides, so that tracks don't pop in while
+  // resizing or scrolling.
+  const float world_height = canvas->GetWorldHeight();
+  const float viewport_top = canvas->GetWorldTopLeftY() + world_height;
+  const float viewport_bottom = canvas->GetWorldTopLeftY() - 2.f * world_height;
+  return track_bottom <= viewport_top && track_top >= viewport_bottom;
+}
+
+void TrackManager::UpdateTrackPrimitives(Track* track, uint64_t min_tick, uint64_t max_tick,
+                                         PickingMode picking_mode, float z_offset) {
+  uint64_t start_ns = MonotonicTimestampNs();
+  track->UpdatePrimitives(min_tick, max_tick, picking_mode, z_offset);
+  time_graph_->GetRenderingStats().AddTrackTime(track->GetName(),
+                                                MonotonicTimestampNs() - start_ns);
+}
+
 void TrackManager::AddTrack(std::shared_ptr<Track> track) {
   all_tracks_.push_back(track);
   sorting_invalidated_ = true;
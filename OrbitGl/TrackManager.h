@@ -21,6 +21,7 @@
 #include "PickingManager.h"
 #include "SchedulerTrack.h"
 #include "StringManager.h"
+#include "ThreadSummaryTrack.h"
 #include "ThreadTrack.h"
 #include "Timer.h"
 #include "Track.h"
@@ -45,15 +46,22 @@ class TrackManager {
   [[nodiscard]] ThreadTrack* GetTracepointsSystemWideTrack() const {
     return tracepoints_system_wide_track_;
   }
+  [[nodiscard]] ThreadSummaryTrack* GetThreadSummaryTrack() const {
+    return thread_summary_track_.get();
+  }
 
   void SetStringManager(StringManager* str_manager);
   [[nodiscard]] const StringManager* GetStringManager() const { return string_manager_; }
 
   void SortTracks();
+  void InvalidateSorting() { sorting_invalidated_ = true; }
   void SetFilter(const std::string& filter);
 
   void UpdateTracks(uint64_t min_tick, uint64_t max_tick, PickingMode picking_mode);
   [[nodiscard]] float GetTracksTotalHeight() const { return tracks_total_height_; }
+  // Tracks that are not within (or close to) the viewport are skipped when updating primitives and
+  // drawing. Pinned and moving tracks are always considered to be in the viewport.
+  [[nodiscard]] bool IsTrackInViewport(const Track& track) const;
 
   SchedulerTrack* GetOrCreateSchedulerTrack();
   ThreadTrack* GetOrCreateThreadTrack(int32_t tid);
@@ -69,8 +77,14 @@ class TrackManager {
 
  private:
   void UpdateFilteredTrackList();
+  void UpdateTrackPrimitives(Track* track, uint64_t min_tick, uint64_t max_tick,
+                             PickingMode picking_mode, float z_offset);
   [[nodiscard]] int FindMovingTrackIndex();
   [[nodiscard]] std::vector<int32_t> GetSortedThreadIds();
+  // Moves the thread tracks with little activity into the thread summary track and returns the
+  // tracks to show in place of `thread_tracks`.
+  [[nodiscard]] std::vector<Track*> AggregateLowActivityThreadTracks(
+      const std::vector<ThreadTrack*>& thread_tracks, int32_t capture_pid);
 
   mutable std::recursive_mutex mutex_;
 
@@ -84,6 +98,7 @@ class TrackManager {
   // TODO (b/175865913): Use Function info instead of their address as key to FrameTracks
   std::unordered_map<uint64_t, std::shared_ptr<FrameTrack>> frame_tracks_;
   std::shared_ptr<SchedulerTrack> scheduler_track_;
+  std::shared_ptr<ThreadSummaryTrack> thread_summary_track_;
   ThreadTrack* tracepoints_system_wide_track_;
 
   TimeGraph* time_graph_;
@@ -4,8 +4,6 @@
 
 #include "ContextSwitchAndThreadStateVisitor.h"
 
-#include <absl/container/flat_hash_map.h>
-
 #include <algorithm>
 #include <utility>
 
@@ -18,7 +16,7 @@ using orbit_grpc_protos::SchedulingSlice;
 using orbit_grpc_protos::ThreadStateSlice;
 
 void ContextSwitchAndThreadStateVisitor::ProcessInitialTidToPidAssociation(pid_t tid, pid_t pid) {
-  bool new_insertion = tid_to_pid_association_.insert_or_assign(tid, pid).second;
+  bool new_insertion = tid_to_pid_association_.InsertOrAssign(tid, pid);
   if (!new_insertion) {
     ERROR("Overwriting previous pid for tid %d with initial pid %d", tid, pid);
   }
@@ -27,7 +25,7 @@ void ContextSwitchAndThreadStateVisitor::ProcessInitialTidToPidAssociation(pid_t
 void ContextSwitchAndThreadStateVisitor::visit(ForkPerfEvent* event) {
   pid_t pid = event->GetPid();
   pid_t tid = event->GetTid();
-  bool new_insertion = tid_to_pid_association_.insert_or_assign(tid, pid).second;
+  bool new_insertion = tid_to_pid_association_.InsertOrAssign(tid, pid);
   if (!new_insertion) {
     ERROR("Overwriting previous pid for tid %d with pid %d from PERF_RECORD_FORK", tid, pid);
   }
@@ -44,7 +42,7 @@ void ContextSwitchAndThreadStateVisitor::visit(ForkPerfEvent* event) {
 void ContextSwitchAndThreadStateVisitor::visit(ExitPerfEvent* event) {
   pid_t pid = event->GetPid();
   pid_t tid = event->GetTid();
-  tid_to_pid_association_.insert_or_assign(tid, pid);
+  tid_to_pid_association_.InsertOrAssign(tid, pid);
   // Don't log an error on overwrite, as it's expected that the pid was already known.
 }
 
@@ -53,20 +51,20 @@ bool ContextSwitchAndThreadStateVisitor::TidMatchesPidFilter(pid_t tid) {
     return false;
   }
 
-  auto tid_to_pid_it = tid_to_pid_association_.find(tid);
-  if (tid_to_pid_it == tid_to_pid_association_.end()) {
+  const pid_t* pid = tid_to_pid_association_.Find(tid);
+  if (pid == nullptr) {
     return false;
   }
 
-  return tid_to_pid_it->second == thread_state_pid_filter_;
+  return *pid == thread_state_pid_filter_;
 }
 
 std::optional<pid_t> ContextSwitchAndThreadStateVisitor::GetPidOfTid(pid_t tid) {
-  auto tid_to_pid_it = tid_to_pid_association_.find(tid);
-  if (tid_to_pid_it == tid_to_pid_association_.end()) {
+  const pid_t* pid = tid_to_pid_association_.Find(tid);
+  if (pid == nullptr) {
     return std::nullopt;
   }
-  return tid_to_pid_it->second;
+  return *pid;
 }
 
 void ContextSwitchAndThreadStateVisitor::ProcessInitialState(uint64_t timestamp_ns, pid_t tid,
@@ -5,8 +5,6 @@
 #ifndef ORBIT_LINUX_TRACING_THREAD_STATE_VISITOR_H_
 #define ORBIT_LINUX_TRACING_THREAD_STATE_VISITOR_H_
 
-#include <absl/container/flat_hash_map.h>
-#include <absl/hash/hash.h>
 #include <sys/types.h>
 
 #include <cstdint>
@@ -18,6 +16,7 @@
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
 #include "ThreadStateManager.h"
+#include "TidHashMap.h"
 #include "capture.pb.h"
 
 namespace orbit_linux_tracing {
@@ -66,7 +65,9 @@ class ContextSwitchAndThreadStateVisitor : public PerfEventVisitor {
   std::optional<pid_t> GetPidOfTid(pid_t tid);
   static constexpr pid_t kPidFilterNoThreadState = -1;
   pid_t thread_state_pid_filter_ = kPidFilterNoThreadState;
-  absl::flat_hash_map<pid_t, pid_t> tid_to_pid_association_;
+  // Contains all the threads of the system, so preallocate for a large number of them.
+  static constexpr size_t kInitialTidToPidAssociationCapacity = 64 * 1024;
+  TidHashMap<pid_t> tid_to_pid_association_{kInitialTidToPidAssociationCapacity};
 
   ContextSwitchManager switch_manager_;
   ThreadStateManager state_manager_;
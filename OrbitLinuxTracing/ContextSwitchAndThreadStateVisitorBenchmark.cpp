@@ -0,0 +1,159 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "ContextSwitchAndThreadStateVisitor.h"
+#include "KernelTracepoints.h"
+#include "OrbitLinuxTracing/TracerListener.h"
+#include "PerfEvent.h"
+#include "capture.pb.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+class NoOpTracerListener : public TracerListener {
+ public:
+  void OnSchedulingSlice(orbit_grpc_protos::SchedulingSlice /*scheduling_slice*/) override {}
+  void OnCallstackSample(orbit_grpc_protos::CallstackSample /*callstack_sample*/) override {}
+  void OnFunctionCall(orbit_grpc_protos::FunctionCall /*function_call*/) override {}
+  void OnIntrospectionScope(
+      orbit_grpc_protos::IntrospectionScope /*introspection_scope*/) override {}
+  void OnGpuJob(orbit_grpc_protos::GpuJob /*gpu_job*/) override {}
+  void OnThreadName(orbit_grpc_protos::ThreadName /*thread_name*/) override {}
+  void OnThreadStateSlice(orbit_grpc_protos::ThreadStateSlice /*thread_state_slice*/) override {}
+  void OnAddressInfo(orbit_grpc_protos::AddressInfo /*address_info*/) override {}
+  void OnTracepointEvent(orbit_grpc_protos::TracepointEvent /*tracepoint_event*/) override {}
+  void OnModulesUpdate(
+      orbit_grpc_protos::ModulesUpdateEvent /*modules_update_event*/) override {}
+};
+
+constexpr uint32_t kNumCores = 32;
+constexpr pid_t kThreadsPerProcess = 50;
+constexpr size_t kNumEvents = 100'000;
+// Threads of the first process are the ones whose thread states are collected.
+constexpr pid_t kFirstPid = 1000;
+
+// Each process has kThreadsPerProcess threads and its pid is the tid of its first thread.
+pid_t PidOfTid(pid_t tid) {
+  return kFirstPid + (tid - kFirstPid) / kThreadsPerProcess * kThreadsPerProcess;
+}
+
+std::unique_ptr<SchedSwitchPerfEvent> MakeSchedSwitch(uint32_t cpu, pid_t prev_tid,
+                                                      int64_t prev_state, pid_t next_tid) {
+  auto event = std::make_unique<SchedSwitchPerfEvent>(sizeof(sched_switch_tracepoint));
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  event->ring_buffer_record.sample_id.pid = prev_tid == 0 ? 0 : PidOfTid(prev_tid);
+  event->ring_buffer_record.sample_id.tid = prev_tid;
+  sched_switch_tracepoint tracepoint{};
+  tracepoint.prev_pid = prev_tid;
+  tracepoint.prev_state = prev_state;
+  tracepoint.next_pid = next_tid;
+  memcpy(event->tracepoint_data.get(), &tracepoint, sizeof(tracepoint));
+  return event;
+}
+
+std::unique_ptr<SchedWakeupPerfEvent> MakeSchedWakeup(uint32_t cpu, pid_t woken_tid) {
+  auto event = std::make_unique<SchedWakeupPerfEvent>(sizeof(sched_wakeup_tracepoint));
+  event->ring_buffer_record.sample_id.cpu = cpu;
+  sched_wakeup_tracepoint tracepoint{};
+  tracepoint.pid = woken_tid;
+  memcpy(event->tracepoint_data.get(), &tracepoint, sizeof(tracepoint));
+  return event;
+}
+
+// Generates a synthetic but consistent scheduler trace over num_threads threads, all initially
+// runnable, on kNumCores cores: on each sched:sched_switch the running thread is either preempted
+// or goes to sleep, and the next runnable thread is switched in; every third event is a
+// sched:sched_wakeup of a random sleeping thread.
+std::vector<std::unique_ptr<TracepointPerfEvent>> GenerateSchedulerTrace(pid_t num_threads) {
+  std::mt19937 random_engine{42};
+  std::deque<pid_t> runnable_tids;
+  for (pid_t tid = kFirstPid; tid < kFirstPid + num_threads; ++tid) {
+    runnable_tids.push_back(tid);
+  }
+  std::vector<pid_t> sleeping_tids;
+  // 0 is the idle thread.
+  std::vector<pid_t> running_tid_by_core(kNumCores, 0);
+
+  std::vector<std::unique_ptr<TracepointPerfEvent>> events;
+  events.reserve(kNumEvents);
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    const uint32_t cpu = i % kNumCores;
+    if (i % 3 == 2 && !sleeping_tids.empty()) {
+      size_t index =
+          std::uniform_int_distribution<size_t>{0, sleeping_tids.size() - 1}(random_engine);
+      pid_t woken_tid = sleeping_tids[index];
+      sleeping_tids[index] = sleeping_tids.back();
+      sleeping_tids.pop_back();
+      runnable_tids.push_back(woken_tid);
+      events.emplace_back(MakeSchedWakeup(cpu, woken_tid));
+      continue;
+    }
+
+    const pid_t prev_tid = running_tid_by_core[cpu];
+    // 0 is TASK_RUNNING (preempted), 1 is TASK_INTERRUPTIBLE.
+    const int64_t prev_state = std::bernoulli_distribution{0.5}(random_engine) ? 0 : 1;
+    if (prev_tid != 0) {
+      if (prev_state == 0) {
+        runnable_tids.push_back(prev_tid);
+      } else {
+        sleeping_tids.push_back(prev_tid);
+      }
+    }
+    pid_t next_tid = 0;
+    if (!runnable_tids.empty()) {
+      next_tid = runnable_tids.front();
+      runnable_tids.pop_front();
+    }
+    events.emplace_back(MakeSchedSwitch(cpu, prev_tid, prev_state, next_tid));
+    running_tid_by_core[cpu] = next_tid;
+  }
+  return events;
+}
+
+// Measures the throughput of ContextSwitchAndThreadStateVisitor with num_threads threads in the
+// system, of which the ones of the first process have their thread states collected.
+void BM_ContextSwitchAndThreadStateVisitor(benchmark::State& state) {
+  const auto num_threads = static_cast<pid_t>(state.range(0));
+  const std::vector<std::unique_ptr<TracepointPerfEvent>> events =
+      GenerateSchedulerTrace(num_threads);
+  NoOpTracerListener listener;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto visitor = std::make_unique<ContextSwitchAndThreadStateVisitor>();
+    visitor->SetListener(&listener);
+    visitor->SetThreadStatePidFilter(kFirstPid);
+    for (pid_t tid = kFirstPid; tid < kFirstPid + num_threads; ++tid) {
+      visitor->ProcessInitialTidToPidAssociation(tid, PidOfTid(tid));
+    }
+    for (pid_t tid = kFirstPid; tid < kFirstPid + kThreadsPerProcess; ++tid) {
+      visitor->ProcessInitialState(0, tid, 'R');
+    }
+    state.ResumeTiming();
+
+    uint64_t timestamp_ns = 0;
+    for (const std::unique_ptr<TracepointPerfEvent>& event : events) {
+      event->ring_buffer_record.sample_id.time = ++timestamp_ns;
+      event->Accept(visitor.get());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(events.size()));
+}
+
+BENCHMARK(BM_ContextSwitchAndThreadStateVisitor)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+}  // namespace
+
+}  // namespace orbit_linux_tracing
@@ -5,11 +5,11 @@
 #ifndef ORBIT_LINUX_TRACING_CONTEXT_SWITCH_MANAGER_H_
 #define ORBIT_LINUX_TRACING_CONTEXT_SWITCH_MANAGER_H_
 
-#include <absl/container/flat_hash_map.h>
 #include <stdint.h>
 #include <sys/types.h>
 
 #include <optional>
+#include <vector>
 
 #include "capture.pb.h"
 
@@ -18,9 +18,11 @@ namespace orbit_linux_tracing {
 // For each core, keeps the last context switch into a process and matches it
 // with the next context switch away from a process to produce SchedulingSlice
 // events. It assumes that context switches for the same core come in order.
+// The open switches are kept in an array indexed by core, sized for the number of cores.
 class ContextSwitchManager {
  public:
-  ContextSwitchManager() = default;
+  ContextSwitchManager();
+  explicit ContextSwitchManager(size_t num_cores) : open_switches_by_core_(num_cores) {}
 
   ContextSwitchManager(const ContextSwitchManager&) = delete;
   ContextSwitchManager& operator=(const ContextSwitchManager&) = delete;
@@ -44,7 +46,7 @@ class ContextSwitchManager {
     uint64_t timestamp_ns;
   };
 
-  absl::flat_hash_map<uint16_t, OpenSwitchIn> open_switches_by_core_;
+  std::vector<std::optional<OpenSwitchIn>> open_switches_by_core_;
 };
 
 }  // namespace orbit_linux_tracing
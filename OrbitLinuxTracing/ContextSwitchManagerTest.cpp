@@ -253,4 +253,47 @@ TEST(ContextSwitchManager, OneCoreOutOfOrder) {
                "timestamp_ns >= open_timestamp_ns");
 }
 
+TEST(ContextSwitchManager, OneCoreLostOutOverwritesIn) {
+  constexpr pid_t kPid1 = 42;
+  constexpr pid_t kTid1 = 43;
+  constexpr pid_t kPid2 = 52;
+  constexpr pid_t kTid2 = 53;
+  constexpr uint16_t kCore = 1;
+  std::optional<SchedulingSlice> processed_scheduling_slice;
+  ContextSwitchManager context_switch_manager;
+
+  context_switch_manager.ProcessContextSwitchIn(kPid1, kTid1, kCore, 100);
+  // The switch out of kTid1 was lost.
+  context_switch_manager.ProcessContextSwitchIn(kPid2, kTid2, kCore, 102);
+
+  processed_scheduling_slice =
+      context_switch_manager.ProcessContextSwitchOut(kPid2, kTid2, kCore, 103);
+  ASSERT_TRUE(processed_scheduling_slice.has_value());
+  EXPECT_EQ(processed_scheduling_slice.value().pid(), kPid2);
+  EXPECT_EQ(processed_scheduling_slice.value().tid(), kTid2);
+  EXPECT_EQ(processed_scheduling_slice.value().in_timestamp_ns(), 102);
+  EXPECT_EQ(processed_scheduling_slice.value().out_timestamp_ns(), 103);
+}
+
+TEST(ContextSwitchManager, CoreBeyondNumCores) {
+  constexpr pid_t kPid = 42;
+  constexpr pid_t kTid = 43;
+  constexpr uint16_t kCore = 5;
+  std::optional<SchedulingSlice> processed_scheduling_slice;
+  ContextSwitchManager context_switch_manager{2};
+
+  processed_scheduling_slice =
+      context_switch_manager.ProcessContextSwitchOut(kPid, kTid, kCore + 1, 99);
+  EXPECT_FALSE(processed_scheduling_slice.has_value());
+
+  context_switch_manager.ProcessContextSwitchIn(kPid, kTid, kCore, 100);
+
+  processed_scheduling_slice =
+      context_switch_manager.ProcessContextSwitchOut(kPid, kTid, kCore, 101);
+  ASSERT_TRUE(processed_scheduling_slice.has_value());
+  EXPECT_EQ(processed_scheduling_slice.value().core(), kCore);
+  EXPECT_EQ(processed_scheduling_slice.value().in_timestamp_ns(), 100);
+  EXPECT_EQ(processed_scheduling_slice.value().out_timestamp_ns(), 101);
+}
+
 }  // namespace orbit_linux_tracing
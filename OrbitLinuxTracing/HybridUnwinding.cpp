@@ -0,0 +1,99 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "HybridUnwinding.h"
+
+#include <optional>
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Returns the number of frames of callchain_pcs, starting from begin, that can be trusted: the
+// caller of a function in a module without frame pointers is not reliable if it is in a module with
+// frame pointers.
+size_t GetReliableCallchainEnd(const std::vector<uint64_t>& callchain_pcs, size_t begin,
+                               const GetFramePointerSupportFunction& get_frame_pointer_support) {
+  for (size_t i = begin; i + 1 < callchain_pcs.size(); ++i) {
+    if (get_frame_pointer_support(callchain_pcs[i]) == FramePointerSupport::kWithoutFramePointers &&
+        get_frame_pointer_support(callchain_pcs[i + 1]) ==
+            FramePointerSupport::kWithFramePointers) {
+      return i + 1;
+    }
+  }
+  return callchain_pcs.size();
+}
+
+}  // namespace
+
+bool CallchainNeedsDwarfUnwinding(const std::vector<uint64_t>& callchain_pcs,
+                                  const GetFramePointerSupportFunction& get_frame_pointer_support) {
+  return GetReliableCallchainEnd(callchain_pcs, 0, get_frame_pointer_support) <
+         callchain_pcs.size();
+}
+
+HybridCallstack JoinCallchainWithDwarfFrames(
+    const std::vector<uint64_t>& callchain_pcs, const std::vector<uint64_t>& dwarf_pcs,
+    bool dwarf_unwinding_is_complete,
+    const GetFramePointerSupportFunction& get_frame_pointer_support) {
+  size_t first_callchain_frame_without_frame_pointers = 0;
+  while (first_callchain_frame_without_frame_pointers < callchain_pcs.size() &&
+         get_frame_pointer_support(callchain_pcs[first_callchain_frame_without_frame_pointers]) !=
+             FramePointerSupport::kWithoutFramePointers) {
+    ++first_callchain_frame_without_frame_pointers;
+  }
+  if (first_callchain_frame_without_frame_pointers == callchain_pcs.size()) {
+    return HybridCallstack{callchain_pcs, false};
+  }
+
+  std::optional<size_t> last_dwarf_frame_without_frame_pointers;
+  for (size_t i = 0; i < dwarf_pcs.size(); ++i) {
+    if (get_frame_pointer_support(dwarf_pcs[i]) == FramePointerSupport::kWithoutFramePointers) {
+      last_dwarf_frame_without_frame_pointers = i;
+    }
+  }
+
+  // Look for the first DWARF frame after all the frames without frame pointers that also appears
+  // in the unreliable part of the callchain. Also require the next frames to match, when both
+  // exist, so that the join doesn't happen on garbage that the callchain went through.
+  if (last_dwarf_frame_without_frame_pointers.has_value()) {
+    for (size_t dwarf_index = last_dwarf_frame_without_frame_pointers.value() + 1;
+         dwarf_index < dwarf_pcs.size(); ++dwarf_index) {
+      for (size_t callchain_index = first_callchain_frame_without_frame_pointers + 1;
+           callchain_index < callchain_pcs.size(); ++callchain_index) {
+        if (callchain_pcs[callchain_index] != dwarf_pcs[dwarf_index]) continue;
+        if (dwarf_index + 1 < dwarf_pcs.size() && callchain_index + 1 < callchain_pcs.size() &&
+            callchain_pcs[callchain_index + 1] != dwarf_pcs[dwarf_index + 1]) {
+          continue;
+        }
+
+        const size_t callchain_end =
+            GetReliableCallchainEnd(callchain_pcs, callchain_index, get_frame_pointer_support);
+        HybridCallstack result;
+        result.pcs.reserve(dwarf_index + callchain_end - callchain_index);
+        result.pcs.insert(result.pcs.end(), dwarf_pcs.begin(), dwarf_pcs.begin() + dwarf_index);
+        result.pcs.insert(result.pcs.end(), callchain_pcs.begin() + callchain_index,
+                          callchain_pcs.begin() + callchain_end);
+        result.is_truncated = callchain_end < callchain_pcs.size();
+        return result;
+      }
+    }
+  }
+
+  if (dwarf_unwinding_is_complete && !dwarf_pcs.empty()) {
+    return HybridCallstack{dwarf_pcs, false};
+  }
+
+  // The frame of the callchain in a module without frame pointers is still correct, only its
+  // callers are not.
+  const size_t reliable_callchain_size = first_callchain_frame_without_frame_pointers + 1;
+  if (dwarf_pcs.size() > reliable_callchain_size) {
+    return HybridCallstack{dwarf_pcs, true};
+  }
+  return HybridCallstack{std::vector<uint64_t>(callchain_pcs.begin(),
+                                               callchain_pcs.begin() + reliable_callchain_size),
+                         true};
+}
+
+}  // namespace orbit_linux_tracing
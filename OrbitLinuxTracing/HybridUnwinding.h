@@ -0,0 +1,54 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_HYBRID_UNWINDING_H_
+#define ORBIT_LINUX_TRACING_HYBRID_UNWINDING_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace orbit_linux_tracing {
+
+// In hybrid unwinding mode, samples are unwound by the kernel using frame pointers, and the user
+// registers and the top of the user stack are collected alongside the callchain. Callchains are
+// only trusted up to the first frame in a module without frame pointers: as the functions of that
+// module don't maintain the frame pointer, the caller of such a function can be skipped or the
+// rest of the callchain can be garbage. The following functions decide which callchains need to be
+// repaired with the frames unwound using DWARF information, and join the two.
+// All program counters are those of the frames, i.e., return addresses are decremented by one to
+// fall into the call instructions, as libunwindstack does.
+
+enum class FramePointerSupport { kUnknownModule, kWithFramePointers, kWithoutFramePointers };
+
+using GetFramePointerSupportFunction = std::function<FramePointerSupport(uint64_t pc)>;
+
+// A callchain needs to be repaired when a frame in a module without frame pointers is followed by a
+// frame in a module with frame pointers. Frames in modules without frame pointers that are only
+// followed by more such frames, or by unknown addresses, are the outermost frames of the thread
+// (e.g., the entry points in the C library) and leave nothing to repair.
+[[nodiscard]] bool CallchainNeedsDwarfUnwinding(
+    const std::vector<uint64_t>& callchain_pcs,
+    const GetFramePointerSupportFunction& get_frame_pointer_support);
+
+struct HybridCallstack {
+  std::vector<uint64_t> pcs;
+  // Whether outermost frames are known to be missing.
+  bool is_truncated = false;
+};
+
+// Replaces the frames of callchain_pcs starting from the first one in a module without frame
+// pointers with the frames in dwarf_pcs, up to the first frame below all frames in modules without
+// frame pointers of dwarf_pcs that can also be found after that point in callchain_pcs. The
+// callchain is then followed from there. When such a frame doesn't exist, e.g., because the stack
+// copy was too small, the longer of the two reliable parts is kept and the result is truncated,
+// unless DWARF unwinding reached the outermost frame.
+[[nodiscard]] HybridCallstack JoinCallchainWithDwarfFrames(
+    const std::vector<uint64_t>& callchain_pcs, const std::vector<uint64_t>& dwarf_pcs,
+    bool dwarf_unwinding_is_complete,
+    const GetFramePointerSupportFunction& get_frame_pointer_support);
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_HYBRID_UNWINDING_H_
@@ -0,0 +1,111 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "HybridUnwinding.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Addresses in [0x1000, 0x2000) belong to a module with frame pointers, addresses in
+// [0x2000, 0x3000) to a module without frame pointers, all others to no known module.
+FramePointerSupport GetFramePointerSupport(uint64_t pc) {
+  if (pc >= 0x1000 && pc < 0x2000) return FramePointerSupport::kWithFramePointers;
+  if (pc >= 0x2000 && pc < 0x3000) return FramePointerSupport::kWithoutFramePointers;
+  return FramePointerSupport::kUnknownModule;
+}
+
+}  // namespace
+
+TEST(CallchainNeedsDwarfUnwinding, OnlyWhenFramesWithoutFramePointersHaveCallersWithThem) {
+  EXPECT_FALSE(CallchainNeedsDwarfUnwinding({}, GetFramePointerSupport));
+  EXPECT_FALSE(CallchainNeedsDwarfUnwinding({0x1100, 0x1200, 0x1300}, GetFramePointerSupport));
+  // Thread entry points in a module without frame pointers.
+  EXPECT_FALSE(
+      CallchainNeedsDwarfUnwinding({0x1100, 0x1200, 0x2100, 0x2200}, GetFramePointerSupport));
+  // Garbage after a frame without frame pointers.
+  EXPECT_FALSE(CallchainNeedsDwarfUnwinding({0x1100, 0x2100, 0x7777}, GetFramePointerSupport));
+  EXPECT_TRUE(CallchainNeedsDwarfUnwinding({0x2100, 0x1200}, GetFramePointerSupport));
+  EXPECT_TRUE(CallchainNeedsDwarfUnwinding({0x1100, 0x2100, 0x2200, 0x1300, 0x1400},
+                                           GetFramePointerSupport));
+}
+
+TEST(JoinCallchainWithDwarfFrames, CallchainWithoutFramesWithoutFramePointersIsKept) {
+  HybridCallstack callstack = JoinCallchainWithDwarfFrames({0x1100, 0x1200}, {0x1100},
+                                                           false, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x1100, 0x1200));
+  EXPECT_FALSE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, SkippedCallerIsRecovered) {
+  // 0x1200 calls 0x2100 (e.g., qsort), which calls back into 0x1100. The callchain skips 0x2100's
+  // caller 0x1200.
+  const std::vector<uint64_t> callchain{0x1100, 0x2100, 0x1300, 0x1400, 0x2400};
+  const std::vector<uint64_t> dwarf{0x1100, 0x2100, 0x1200, 0x1300};
+  HybridCallstack callstack =
+      JoinCallchainWithDwarfFrames(callchain, dwarf, false, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x1100, 0x2100, 0x1200, 0x1300, 0x1400, 0x2400));
+  EXPECT_FALSE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, LeafWithoutFramePointers) {
+  // The sample hit 0x2100 (e.g., memcpy), so the callchain skips its caller 0x1200.
+  const std::vector<uint64_t> callchain{0x2100, 0x1300, 0x1400};
+  const std::vector<uint64_t> dwarf{0x2100, 0x1200, 0x1300};
+  HybridCallstack callstack =
+      JoinCallchainWithDwarfFrames(callchain, dwarf, false, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x2100, 0x1200, 0x1300, 0x1400));
+  EXPECT_FALSE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, JoinPointRequiresNextFramesToMatch) {
+  // The callchain goes through garbage after 0x2100, which happens to contain 0x1300.
+  const std::vector<uint64_t> callchain{0x2100, 0x1300, 0x1400, 0x1300, 0x1500};
+  const std::vector<uint64_t> dwarf{0x2100, 0x1200, 0x1300, 0x1500};
+  HybridCallstack callstack =
+      JoinCallchainWithDwarfFrames(callchain, dwarf, false, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x2100, 0x1200, 0x1300, 0x1500));
+  EXPECT_FALSE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, UnreliableTailOfCallchainIsTruncated) {
+  const std::vector<uint64_t> callchain{0x2100, 0x1300, 0x2300, 0x1500, 0x1600};
+  const std::vector<uint64_t> dwarf{0x2100, 0x1200, 0x1300};
+  HybridCallstack callstack =
+      JoinCallchainWithDwarfFrames(callchain, dwarf, false, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x2100, 0x1200, 0x1300, 0x2300));
+  EXPECT_TRUE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, CompleteDwarfFramesAreUsedWithoutJoinPoint) {
+  const std::vector<uint64_t> callchain{0x2100, 0x7777};
+  const std::vector<uint64_t> dwarf{0x2100, 0x1200, 0x1300};
+  HybridCallstack callstack =
+      JoinCallchainWithDwarfFrames(callchain, dwarf, true, GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x2100, 0x1200, 0x1300));
+  EXPECT_FALSE(callstack.is_truncated);
+}
+
+TEST(JoinCallchainWithDwarfFrames, LongerReliablePartIsKeptWithoutJoinPoint) {
+  // DWARF unwinding stopped in the module without frame pointers, e.g., at the end of the stack
+  // copy.
+  const std::vector<uint64_t> callchain{0x1100, 0x1200, 0x2100, 0x1300};
+  HybridCallstack callstack = JoinCallchainWithDwarfFrames(callchain, {0x1100, 0x1200}, false,
+                                                           GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x1100, 0x1200, 0x2100));
+  EXPECT_TRUE(callstack.is_truncated);
+
+  callstack = JoinCallchainWithDwarfFrames(callchain, {0x1100, 0x1200, 0x2100, 0x2200}, false,
+                                           GetFramePointerSupport);
+  EXPECT_THAT(callstack.pcs, testing::ElementsAre(0x1100, 0x1200, 0x2100, 0x2200));
+  EXPECT_TRUE(callstack.is_truncated);
+}
+
+}  // namespace orbit_linux_tracing
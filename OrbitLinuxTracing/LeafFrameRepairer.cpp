@@ -0,0 +1,342 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "LeafFrameRepairer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "ElfUtils/ElfFile.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+#include "OrbitBase/UniqueResource.h"
+#include "absl/strings/str_format.h"
+#include "symbol.pb.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+std::optional<uint64_t> FileOffsetToAddress(
+    const std::vector<orbit_elf_utils::ElfFile::LoadSegment>& load_segments, uint64_t file_offset) {
+  for (const orbit_elf_utils::ElfFile::LoadSegment& segment : load_segments) {
+    if (file_offset >= segment.offset && file_offset - segment.offset < segment.file_size) {
+      return file_offset - segment.offset + segment.vaddr;
+    }
+  }
+  return std::nullopt;
+}
+
+bool ReadFully(int fd, uint64_t file_offset, std::vector<uint8_t>* data) {
+  uint64_t num_bytes_read = 0;
+  while (num_bytes_read < data->size()) {
+    ssize_t result = pread(fd, data->data() + num_bytes_read, data->size() - num_bytes_read,
+                           static_cast<off_t>(file_offset + num_bytes_read));
+    if (result == -1 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    num_bytes_read += result;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::optional<uint64_t> ReadReturnAddressOfFramelessCode(
+    const std::vector<FramelessCodeRange>& frameless_code_ranges, uint64_t offset_in_function,
+    const char* stack_data, uint64_t stack_size) {
+  auto range_it = std::upper_bound(
+      frameless_code_ranges.begin(), frameless_code_ranges.end(), offset_in_function,
+      [](uint64_t offset, const FramelessCodeRange& range) { return offset < range.begin_offset; });
+  if (range_it == frameless_code_ranges.begin()) {
+    return std::nullopt;
+  }
+  --range_it;
+  if (offset_in_function >= range_it->end_offset) {
+    return std::nullopt;
+  }
+
+  uint64_t return_address;
+  if (range_it->return_address_stack_offset + sizeof(return_address) > stack_size) {
+    return std::nullopt;
+  }
+  memcpy(&return_address, stack_data + range_it->return_address_stack_offset,
+         sizeof(return_address));
+  return return_address;
+}
+
+LeafFrameRepairer::Module::~Module() {
+  if (capstone_handle.has_value()) {
+    cs_close(&capstone_handle.value());
+  }
+}
+
+LeafFrameRepairer::LeafFrameRepairer(pid_t pid)
+    : pid_{pid}, loader_thread_{&LeafFrameRepairer::LoadScheduledModules, this} {}
+
+LeafFrameRepairer::~LeafFrameRepairer() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_loading_ = true;
+  }
+  loader_thread_.join();
+}
+
+void LeafFrameRepairer::PreloadModules(unwindstack::Maps* maps) {
+  absl::MutexLock lock(&mutex_);
+  for (const auto& map_info : *maps) {
+    if ((map_info->flags & PROT_EXEC) == 0 || map_info->name.empty() ||
+        map_info->name[0] == '[') {
+      continue;
+    }
+    ScheduleModule(map_info->name);
+  }
+}
+
+void LeafFrameRepairer::WaitForScheduledModules() {
+  absl::MutexLock lock(&mutex_);
+  auto no_module_loading = +[](LeafFrameRepairer* repairer) {
+    repairer->mutex_.AssertHeld();
+    return repairer->num_modules_loading_ == 0;
+  };
+  mutex_.Await(absl::Condition(no_module_loading, this));
+}
+
+void LeafFrameRepairer::OnMapsChanged() {
+  for (auto& [unused_file_path, module] : modules_by_path_) {
+    if (module != nullptr) {
+      module->is_mapping_of_module_by_range.clear();
+    }
+  }
+}
+
+std::optional<uint64_t> LeafFrameRepairer::GetSkippedReturnAddress(unwindstack::Maps* maps,
+                                                                   uint64_t ip,
+                                                                   const char* stack_data,
+                                                                   uint64_t stack_size) {
+  unwindstack::MapInfo* map_info = maps->Find(ip);
+  // Skip anonymous executable memory and special maps like [vdso] or [uprobes].
+  if (map_info == nullptr || map_info->name.empty() || map_info->name[0] == '[') {
+    return std::nullopt;
+  }
+
+  Module* module = GetLoadedModule(map_info->name);
+  if (module == nullptr || !IsMappingOfModule(*map_info, module)) {
+    return std::nullopt;
+  }
+
+  // The map gives the file offset of ip, but symbols are at the virtual addresses of the PT_LOAD
+  // segments, which can differ from file offsets (e.g., lld places the text segment one page
+  // after its file offset).
+  std::optional<uint64_t> address =
+      FileOffsetToAddress(module->load_segments, ip - map_info->start + map_info->offset);
+  if (!address.has_value()) {
+    return std::nullopt;
+  }
+  auto function_it = std::upper_bound(
+      module->functions.begin(), module->functions.end(), address.value(),
+      [](uint64_t sample_address, const Function& function) {
+        return sample_address < function.address;
+      });
+  if (function_it == module->functions.begin()) {
+    return std::nullopt;
+  }
+  --function_it;
+  if (address.value() >= function_it->address + function_it->size) {
+    return std::nullopt;
+  }
+
+  auto [frameless_code_it, inserted] =
+      module->frameless_code_by_function.try_emplace(function_it->address);
+  if (inserted) {
+    frameless_code_it->second = AnalyzeFunction(*module, *function_it);
+  }
+
+  std::optional<uint64_t> return_address =
+      ReadReturnAddressOfFramelessCode(frameless_code_it->second,
+                                       address.value() - function_it->address, stack_data,
+                                       stack_size);
+  if (!return_address.has_value()) {
+    return std::nullopt;
+  }
+  // Guard against wrong analysis results: a return address must point to executable code.
+  unwindstack::MapInfo* return_address_map_info = maps->Find(return_address.value());
+  if (return_address_map_info == nullptr || (return_address_map_info->flags & PROT_EXEC) == 0) {
+    return std::nullopt;
+  }
+  return return_address;
+}
+
+LeafFrameRepairer::Module* LeafFrameRepairer::GetLoadedModule(const std::string& file_path) {
+  auto module_it = modules_by_path_.find(file_path);
+  if (module_it != modules_by_path_.end()) {
+    return module_it->second.get();
+  }
+
+  absl::MutexLock lock(&mutex_);
+  auto loaded_module_it = loaded_modules_by_path_.find(file_path);
+  if (loaded_module_it == loaded_modules_by_path_.end()) {
+    ScheduleModule(file_path);
+    return nullptr;
+  }
+  std::unique_ptr<Module> module = std::move(loaded_module_it->second);
+  loaded_modules_by_path_.erase(loaded_module_it);
+  return modules_by_path_.emplace(file_path, std::move(module)).first->second.get();
+}
+
+bool LeafFrameRepairer::IsMappingOfModule(const unwindstack::MapInfo& map_info, Module* module) {
+  auto [is_mapping_of_module_it, inserted] = module->is_mapping_of_module_by_range.try_emplace(
+      std::make_pair(map_info.start, map_info.end), false);
+  if (inserted) {
+    // This link leads to the file that was mapped, even if the path now names another file.
+    const std::string map_file_path =
+        absl::StrFormat("/proc/%d/map_files/%x-%x", pid_, map_info.start, map_info.end);
+    struct stat stat_buf {};
+    is_mapping_of_module_it->second = stat(map_file_path.c_str(), &stat_buf) == 0 &&
+                                      stat_buf.st_dev == module->device &&
+                                      stat_buf.st_ino == module->inode;
+  }
+  return is_mapping_of_module_it->second;
+}
+
+void LeafFrameRepairer::ScheduleModule(const std::string& file_path) {
+  if (!scheduled_paths_.insert(file_path).second) {
+    return;
+  }
+  paths_to_load_.push_back(file_path);
+  ++num_modules_loading_;
+}
+
+void LeafFrameRepairer::LoadScheduledModules() {
+  pthread_setname_np(pthread_self(), "LeafFrameLoader");
+  while (true) {
+    std::string file_path;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto module_to_load_or_stop = +[](LeafFrameRepairer* repairer) {
+        repairer->mutex_.AssertHeld();
+        return repairer->stop_loading_ || !repairer->paths_to_load_.empty();
+      };
+      mutex_.Await(absl::Condition(module_to_load_or_stop, this));
+      if (stop_loading_) {
+        return;
+      }
+      file_path = std::move(paths_to_load_.front());
+      paths_to_load_.pop_front();
+    }
+
+    std::unique_ptr<Module> module = LoadModule(file_path);
+
+    absl::MutexLock lock(&mutex_);
+    loaded_modules_by_path_.emplace(std::move(file_path), std::move(module));
+    --num_modules_loading_;
+  }
+}
+
+std::unique_ptr<LeafFrameRepairer::Module> LeafFrameRepairer::LoadModule(
+    const std::string& file_path) {
+  // Keep the file open while it is loaded, so that its symbols and code come from the same file
+  // even if the path is replaced in the meantime.
+  int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    ERROR("Opening \"%s\" to repair leaf frames: %s", file_path, SafeStrerror(errno));
+    return nullptr;
+  }
+  orbit_base::unique_resource fd_closer{fd, [](int fd) { close(fd); }};
+  struct stat stat_buf {};
+  if (fstat(fd, &stat_buf) != 0) {
+    ERROR("Loading \"%s\" to repair leaf frames: %s", file_path, SafeStrerror(errno));
+    return nullptr;
+  }
+  auto elf_file = orbit_elf_utils::ElfFile::Create(absl::StrFormat("/proc/self/fd/%d", fd));
+  if (!elf_file) {
+    ERROR("Loading \"%s\" to repair leaf frames: %s", file_path, elf_file.error().message());
+    return nullptr;
+  }
+  auto symbols = elf_file.value()->LoadSymbols();
+  if (!symbols) {
+    LOG("Not repairing leaf frames in \"%s\": %s", file_path, symbols.error().message());
+    return nullptr;
+  }
+  auto load_segments = elf_file.value()->GetLoadSegments();
+  if (!load_segments) {
+    ERROR("Loading \"%s\" to repair leaf frames: %s", file_path, load_segments.error().message());
+    return nullptr;
+  }
+
+  csh capstone_handle;
+  cs_mode mode = elf_file.value()->Is64Bit() ? CS_MODE_64 : CS_MODE_32;
+  if (cs_open(CS_ARCH_X86, mode, &capstone_handle) != CS_ERR_OK) {
+    ERROR("Unable to open capstone.");
+    return nullptr;
+  }
+  cs_option(capstone_handle, CS_OPT_DETAIL, CS_OPT_ON);
+
+  auto module = std::make_unique<Module>();
+  module->file_path = file_path;
+  module->device = stat_buf.st_dev;
+  module->inode = stat_buf.st_ino;
+  module->capstone_handle = capstone_handle;
+  module->load_segments = std::move(load_segments.value());
+  module->functions.reserve(symbols.value().symbol_infos_size());
+  for (const orbit_grpc_protos::SymbolInfo& symbol_info : symbols.value().symbol_infos()) {
+    if (symbol_info.size() == 0) {
+      continue;
+    }
+    module->functions.push_back(Function{symbol_info.address(), symbol_info.size()});
+  }
+  std::sort(
+      module->functions.begin(), module->functions.end(),
+      [](const Function& lhs, const Function& rhs) { return lhs.address < rhs.address; });
+
+  // Read the code now, on this thread, so that analyzing a function doesn't need to read the file.
+  for (const orbit_elf_utils::ElfFile::LoadSegment& segment : module->load_segments) {
+    auto function_it = std::lower_bound(
+        module->functions.begin(), module->functions.end(), segment.vaddr,
+        [](const Function& function, uint64_t address) { return function.address < address; });
+    if (function_it == module->functions.end() ||
+        function_it->address - segment.vaddr >= segment.file_size) {
+      continue;
+    }
+    CodeSegment code_segment{segment.vaddr, std::vector<uint8_t>(segment.file_size)};
+    if (!ReadFully(fd, segment.offset, &code_segment.code)) {
+      ERROR("Reading code at %#lx of \"%s\"", segment.vaddr, file_path);
+      return nullptr;
+    }
+    module->code_segments.push_back(std::move(code_segment));
+  }
+  return module;
+}
+
+std::vector<FramelessCodeRange> LeafFrameRepairer::AnalyzeFunction(const Module& module,
+                                                                   const Function& function) {
+  for (const CodeSegment& code_segment : module.code_segments) {
+    if (function.address < code_segment.vaddr ||
+        function.address - code_segment.vaddr >= code_segment.code.size()) {
+      continue;
+    }
+    // Only analyze functions entirely stored in the file.
+    const uint64_t offset_in_segment = function.address - code_segment.vaddr;
+    if (function.size > code_segment.code.size() - offset_in_segment) {
+      return {};
+    }
+    FunctionFramePointerValidator validator{module.capstone_handle.value(),
+                                            code_segment.code.data() + offset_in_segment,
+                                            function.size};
+    return validator.GetFramelessCodeRanges();
+  }
+  return {};
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,137 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_LEAF_FRAME_REPAIRER_H_
+#define ORBIT_LINUX_TRACING_LEAF_FRAME_REPAIRER_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
+#include <absl/synchronization/mutex.h>
+#include <capstone/capstone.h>
+#include <sys/types.h>
+#include <unwindstack/MapInfo.h>
+#include <unwindstack/Maps.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ElfUtils/ElfFile.h"
+#include "OrbitFramePointerValidator/FunctionFramePointerValidator.h"
+
+namespace orbit_linux_tracing {
+
+// Returns the return address that frame-pointer unwinding skipped for a sample at
+// offset_in_function, given the frameless code of the function (see
+// FunctionFramePointerValidator::GetFramelessCodeRanges) and the copy of the top of the stack of
+// the sample. Returns nullopt if the frame pointer holds the frame of the function at that offset,
+// or if the return address is not in the stack copy.
+[[nodiscard]] std::optional<uint64_t> ReadReturnAddressOfFramelessCode(
+    const std::vector<FramelessCodeRange>& frameless_code_ranges, uint64_t offset_in_function,
+    const char* stack_data, uint64_t stack_size);
+
+// Frame-pointer callchains miss the caller of the innermost function when the sample falls into
+// its prologue or epilogue, or into a leaf function that doesn't set up a frame, as the frame
+// pointer then still holds the frame of the caller. LeafFrameRepairer finds the function of the
+// sampled instruction in the symbols of its module, analyzes it with
+// FunctionFramePointerValidator, and reads the missing return address from the copy of the top of
+// the stack of the sample.
+// Modules are loaded on a separate thread, so that reading symbols and code doesn't stall the
+// processing of events: samples in a module are not repaired until the module has been loaded.
+// Functions are analyzed on first use, from the code read with the module. The results are cached.
+// Modules without a .symtab section are not repaired.
+// Modules are identified by path, so a sample is only repaired if its mapping in process pid is the
+// file that was loaded, and not another file that has replaced it on disk since it was mapped.
+class LeafFrameRepairer {
+ public:
+  explicit LeafFrameRepairer(pid_t pid);
+  ~LeafFrameRepairer();
+
+  LeafFrameRepairer(const LeafFrameRepairer&) = delete;
+  LeafFrameRepairer& operator=(const LeafFrameRepairer&) = delete;
+  LeafFrameRepairer(LeafFrameRepairer&&) = delete;
+  LeafFrameRepairer& operator=(LeafFrameRepairer&&) = delete;
+
+  [[nodiscard]] std::optional<uint64_t> GetSkippedReturnAddress(unwindstack::Maps* maps,
+                                                                uint64_t ip,
+                                                                const char* stack_data,
+                                                                uint64_t stack_size);
+
+  // Schedules the loading of the modules of all executable file mappings in maps, e.g., of the
+  // target process at the start of the capture, so that their samples can be repaired sooner.
+  void PreloadModules(unwindstack::Maps* maps);
+
+  // Blocks until all scheduled modules have been loaded.
+  void WaitForScheduledModules();
+
+  // Forgets which mappings were checked to be of loaded modules, as the same addresses could now
+  // map other files.
+  void OnMapsChanged();
+
+ private:
+  // The address of a function is its address in the ELF file, as for symbols, not its file offset.
+  struct Function {
+    uint64_t address;
+    uint64_t size;
+  };
+
+  // The contents of a PT_LOAD segment that contains functions.
+  struct CodeSegment {
+    uint64_t vaddr;
+    std::vector<uint8_t> code;
+  };
+
+  struct Module {
+    ~Module();
+
+    // Sorted by address.
+    std::vector<Function> functions;
+    std::vector<orbit_elf_utils::ElfFile::LoadSegment> load_segments;
+    std::vector<CodeSegment> code_segments;
+    std::string file_path;
+    // The file that was loaded.
+    dev_t device = 0;
+    ino_t inode = 0;
+    std::optional<csh> capstone_handle;
+    absl::flat_hash_map<uint64_t, std::vector<FramelessCodeRange>> frameless_code_by_function;
+    // Whether the mapping with these start and end addresses is of the file that was loaded.
+    absl::flat_hash_map<std::pair<uint64_t, uint64_t>, bool> is_mapping_of_module_by_range;
+  };
+
+  // Returns the module if it has been loaded successfully, otherwise schedules its loading if
+  // needed and returns nullptr.
+  [[nodiscard]] Module* GetLoadedModule(const std::string& file_path);
+  [[nodiscard]] bool IsMappingOfModule(const unwindstack::MapInfo& map_info, Module* module);
+  void ScheduleModule(const std::string& file_path) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void LoadScheduledModules();
+
+  [[nodiscard]] static std::unique_ptr<Module> LoadModule(const std::string& file_path);
+  [[nodiscard]] static std::vector<FramelessCodeRange> AnalyzeFunction(const Module& module,
+                                                                       const Function& function);
+
+  pid_t pid_;
+
+  // Only accessed by the thread that calls GetSkippedReturnAddress, so that repairing a sample in a
+  // loaded module doesn't require locking. A nullptr module failed to load.
+  absl::flat_hash_map<std::string, std::unique_ptr<Module>> modules_by_path_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_set<std::string> scheduled_paths_ ABSL_GUARDED_BY(mutex_);
+  std::deque<std::string> paths_to_load_ ABSL_GUARDED_BY(mutex_);
+  uint64_t num_modules_loading_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<std::string, std::unique_ptr<Module>> loaded_modules_by_path_
+      ABSL_GUARDED_BY(mutex_);
+  bool stop_loading_ ABSL_GUARDED_BY(mutex_) = false;
+  std::thread loader_thread_;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_LEAF_FRAME_REPAIRER_H_
@@ -0,0 +1,196 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/strings/str_format.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LeafFrameRepairer.h"
+#include "LibunwindstackUnwinder.h"
+#include "OrbitBase/ExecutablePath.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// push rbp at [0, 1), mov rbp,rsp at [1, 4), ret after pop rbp at [20, 21).
+const std::vector<FramelessCodeRange> kFramelessCodeRanges{{0, 1, 0}, {1, 4, 8}, {20, 21, 0}};
+
+constexpr uint64_t kReturnAddressAtTop = 0x1234;
+constexpr uint64_t kReturnAddressAboveBasePointer = 0x5678;
+
+std::array<char, 16> MakeStack() {
+  std::array<char, 16> stack{};
+  memcpy(stack.data(), &kReturnAddressAtTop, sizeof(uint64_t));
+  memcpy(stack.data() + sizeof(uint64_t), &kReturnAddressAboveBasePointer, sizeof(uint64_t));
+  return stack;
+}
+
+// The text segment of this file is at vaddr 0x402000 but at file offset 0x1000. framed_function
+// is at 0x40200e: push rbp at [0, 1), mov rbp,rsp at [1, 4), nop, pop rbp, ret at [6, 7).
+constexpr uint64_t kTextFileOffset = 0x1000;
+constexpr uint64_t kTextSize = 0x1000;
+constexpr uint64_t kFramedFunctionOffsetInText = 0xe;
+constexpr uint64_t kReturnAddressOffsetInText = 0x5;
+
+std::string GetTestElfPath() {
+  return (orbit_base::GetExecutableDir() / "testdata" / "text_vaddr_not_file_offset_elf").string();
+}
+
+// Maps the text segment of file_path into this process, as the repairer checks the mapped file
+// through /proc/<pid>/map_files. Returns MAP_FAILED on error.
+void* MapText(const std::string& file_path) {
+  int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return MAP_FAILED;
+  }
+  void* text = mmap(nullptr, kTextSize, PROT_READ, MAP_PRIVATE, fd, kTextFileOffset);
+  close(fd);
+  return text;
+}
+
+std::unique_ptr<unwindstack::BufferMaps> ParseTextMaps(uint64_t text_address,
+                                                       const std::string& file_path) {
+  return LibunwindstackUnwinder::ParseMaps(absl::StrFormat("%x-%x r-xp %08x 00:00 0 %s\n",
+                                                           text_address, text_address + kTextSize,
+                                                           kTextFileOffset, file_path));
+}
+
+}  // namespace
+
+TEST(ReadReturnAddressOfFramelessCode, ReadsReturnAddressInFramelessCode) {
+  std::array<char, 16> stack = MakeStack();
+  EXPECT_EQ(ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 0, stack.data(), stack.size()),
+            kReturnAddressAtTop);
+  EXPECT_EQ(ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 3, stack.data(), stack.size()),
+            kReturnAddressAboveBasePointer);
+  EXPECT_EQ(ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 20, stack.data(), stack.size()),
+            kReturnAddressAtTop);
+}
+
+TEST(ReadReturnAddressOfFramelessCode, NothingWhereFramePointerHoldsTheFrame) {
+  std::array<char, 16> stack = MakeStack();
+  EXPECT_FALSE(
+      ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 4, stack.data(), stack.size())
+          .has_value());
+  EXPECT_FALSE(
+      ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 19, stack.data(), stack.size())
+          .has_value());
+  EXPECT_FALSE(
+      ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 21, stack.data(), stack.size())
+          .has_value());
+  EXPECT_FALSE(ReadReturnAddressOfFramelessCode({}, 0, stack.data(), stack.size()).has_value());
+}
+
+TEST(ReadReturnAddressOfFramelessCode, NothingBeyondStackCopy) {
+  std::array<char, 16> stack = MakeStack();
+  EXPECT_FALSE(
+      ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 2, stack.data(), 12).has_value());
+  EXPECT_EQ(ReadReturnAddressOfFramelessCode(kFramelessCodeRanges, 0, stack.data(), 8),
+            kReturnAddressAtTop);
+}
+
+TEST(LeafFrameRepairer, GetSkippedReturnAddressWhenTextVaddrIsNotFileOffset) {
+  const std::string file_path = GetTestElfPath();
+  void* text = MapText(file_path);
+  ASSERT_NE(text, MAP_FAILED);
+  const auto text_address = reinterpret_cast<uint64_t>(text);
+  std::unique_ptr<unwindstack::BufferMaps> maps = ParseTextMaps(text_address, file_path);
+  const uint64_t framed_function_address = text_address + kFramedFunctionOffsetInText;
+  const uint64_t return_address = text_address + kReturnAddressOffsetInText;
+  constexpr uint64_t kNotCodeAddress = 0x1234;
+
+  LeafFrameRepairer repairer{getpid()};
+  repairer.PreloadModules(maps.get());
+  repairer.WaitForScheduledModules();
+  std::array<char, 16> stack{};
+  memcpy(stack.data(), &return_address, sizeof(uint64_t));
+  EXPECT_EQ(repairer.GetSkippedReturnAddress(maps.get(), framed_function_address, stack.data(),
+                                             stack.size()),
+            return_address);
+  EXPECT_EQ(repairer.GetSkippedReturnAddress(maps.get(), framed_function_address + 6, stack.data(),
+                                             stack.size()),
+            return_address);
+  EXPECT_FALSE(repairer
+                   .GetSkippedReturnAddress(maps.get(), framed_function_address + 4, stack.data(),
+                                            stack.size())
+                   .has_value());
+
+  memcpy(stack.data(), &kNotCodeAddress, sizeof(uint64_t));
+  EXPECT_FALSE(
+      repairer
+          .GetSkippedReturnAddress(maps.get(), framed_function_address, stack.data(), stack.size())
+          .has_value());
+
+  munmap(text, kTextSize);
+}
+
+TEST(LeafFrameRepairer, GetSkippedReturnAddressOnceModuleIsLoaded) {
+  const std::string file_path = GetTestElfPath();
+  void* text = MapText(file_path);
+  ASSERT_NE(text, MAP_FAILED);
+  const auto text_address = reinterpret_cast<uint64_t>(text);
+  std::unique_ptr<unwindstack::BufferMaps> maps = ParseTextMaps(text_address, file_path);
+  const uint64_t framed_function_address = text_address + kFramedFunctionOffsetInText;
+  const uint64_t return_address = text_address + kReturnAddressOffsetInText;
+
+  LeafFrameRepairer repairer{getpid()};
+  std::array<char, 16> stack{};
+  memcpy(stack.data(), &return_address, sizeof(uint64_t));
+  // The first sample in the module only schedules its loading.
+  EXPECT_FALSE(
+      repairer
+          .GetSkippedReturnAddress(maps.get(), framed_function_address, stack.data(), stack.size())
+          .has_value());
+  repairer.WaitForScheduledModules();
+  EXPECT_EQ(repairer.GetSkippedReturnAddress(maps.get(), framed_function_address, stack.data(),
+                                             stack.size()),
+            return_address);
+
+  munmap(text, kTextSize);
+}
+
+TEST(LeafFrameRepairer, NothingWhenMappedFileIsNotTheLoadedFile) {
+  const std::filesystem::path file_path =
+      std::filesystem::temp_directory_path() /
+      absl::StrFormat("leaf_frame_repairer_test_%d", getpid());
+  const std::filesystem::path replacement_path = file_path.string() + ".new";
+  std::filesystem::copy_file(GetTestElfPath(), file_path,
+                             std::filesystem::copy_options::overwrite_existing);
+  std::filesystem::copy_file(GetTestElfPath(), replacement_path,
+                             std::filesystem::copy_options::overwrite_existing);
+  void* text = MapText(file_path.string());
+  ASSERT_NE(text, MAP_FAILED);
+  // The path now names a file with the same contents that is not the one mapped.
+  std::filesystem::rename(replacement_path, file_path);
+  const auto text_address = reinterpret_cast<uint64_t>(text);
+  std::unique_ptr<unwindstack::BufferMaps> maps = ParseTextMaps(text_address, file_path.string());
+  const uint64_t framed_function_address = text_address + kFramedFunctionOffsetInText;
+  const uint64_t return_address = text_address + kReturnAddressOffsetInText;
+
+  LeafFrameRepairer repairer{getpid()};
+  repairer.PreloadModules(maps.get());
+  repairer.WaitForScheduledModules();
+  std::array<char, 16> stack{};
+  memcpy(stack.data(), &return_address, sizeof(uint64_t));
+  EXPECT_FALSE(
+      repairer
+          .GetSkippedReturnAddress(maps.get(), framed_function_address, stack.data(), stack.size())
+          .has_value());
+
+  munmap(text, kTextSize);
+  std::filesystem::remove(file_path);
+}
+
+}  // namespace orbit_linux_tracing
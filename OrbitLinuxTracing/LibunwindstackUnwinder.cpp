@@ -4,17 +4,60 @@
 
 #include "LibunwindstackUnwinder.h"
 
+#include <unwindstack/MapInfo.h>
 #include <unwindstack/Memory.h>
 #include <unwindstack/Regs.h>
 #include <unwindstack/RegsX86_64.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
 
 #include "OrbitBase/Logging.h"
 
 namespace orbit_linux_tracing {
 
+namespace {
+
+// Forwards reads to the memory of a stack dump, recording how far from the stack pointer they go.
+// Reads are only considered stack reads up to stack_map_end, the end of the mapping containing the
+// stack pointer, as unwinding can also try to read other memory, e.g., the [vdso].
+class StackDumpUsageTrackingMemory : public unwindstack::Memory {
+ public:
+  StackDumpUsageTrackingMemory(std::shared_ptr<unwindstack::Memory> stack_dump_memory,
+                               uint64_t stack_start, uint64_t stack_end, uint64_t stack_map_end,
+                               StackDumpUsage* usage)
+      : stack_dump_memory_{std::move(stack_dump_memory)},
+        stack_start_{stack_start},
+        stack_end_{stack_end},
+        stack_map_end_{stack_map_end},
+        usage_{usage} {}
+
+  size_t Read(uint64_t addr, void* dst, size_t size) override {
+    if (addr >= stack_start_ && addr < stack_map_end_) {
+      const uint64_t read_end = addr + size;
+      if (read_end > stack_end_) {
+        usage_->read_beyond_stack_dump = true;
+      }
+      usage_->used_size =
+          std::max(usage_->used_size, std::min(read_end, stack_end_) - stack_start_);
+    }
+    return stack_dump_memory_->Read(addr, dst, size);
+  }
+
+ private:
+  std::shared_ptr<unwindstack::Memory> stack_dump_memory_;
+  uint64_t stack_start_;
+  uint64_t stack_end_;
+  uint64_t stack_map_end_;
+  StackDumpUsage* usage_;
+};
+
+}  // namespace
+
 std::unique_ptr<unwindstack::BufferMaps> LibunwindstackUnwinder::ParseMaps(
     const std::string& maps_buffer) {
   auto maps = std::make_unique<unwindstack::BufferMaps>(maps_buffer.c_str());
@@ -34,7 +77,7 @@ const std::array<size_t, unwindstack::X86_64_REG_LAST>
 
 std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
     unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
-    const void* stack_dump, uint64_t stack_dump_size) {
+    const void* stack_dump, uint64_t stack_dump_size, StackDumpUsage* stack_dump_usage) {
   unwindstack::RegsX86_64 regs{};
   for (size_t perf_reg = 0; perf_reg < unwindstack::X86_64_REG_LAST; ++perf_reg) {
     regs[perf_reg] = perf_regs.at(UNWINDSTACK_REGS_TO_PERF_REGS[perf_reg]);
@@ -43,6 +86,17 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
   std::shared_ptr<unwindstack::Memory> memory = unwindstack::Memory::CreateOfflineMemory(
       static_cast<const uint8_t*>(stack_dump), regs[unwindstack::X86_64_REG_RSP],
       regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
+  if (stack_dump_usage != nullptr) {
+    *stack_dump_usage = StackDumpUsage{};
+    const uint64_t stack_pointer = regs[unwindstack::X86_64_REG_RSP];
+    unwindstack::MapInfo* stack_map_info = maps->Find(stack_pointer);
+    const uint64_t stack_map_end = stack_map_info != nullptr
+                                       ? stack_map_info->end
+                                       : std::numeric_limits<uint64_t>::max();
+    memory = std::make_shared<StackDumpUsageTrackingMemory>(
+        std::move(memory), stack_pointer, stack_pointer + stack_dump_size, stack_map_end,
+        stack_dump_usage);
+  }
 
   unwindstack::Unwinder unwinder{MAX_FRAMES, maps, &regs, memory};
   // Careful: regs are modified. Use regs.Clone() if you need to reuse regs
@@ -64,4 +118,25 @@ std::vector<unwindstack::FrameData> LibunwindstackUnwinder::Unwind(
   return unwinder.frames();
 }
 
+std::vector<unwindstack::FrameData> LibunwindstackUnwinder::UnwindAsFarAsPossible(
+    unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+    const void* stack_dump, uint64_t stack_dump_size, bool* is_complete) {
+  unwindstack::RegsX86_64 regs{};
+  for (size_t perf_reg = 0; perf_reg < unwindstack::X86_64_REG_LAST; ++perf_reg) {
+    regs[perf_reg] = perf_regs.at(UNWINDSTACK_REGS_TO_PERF_REGS[perf_reg]);
+  }
+
+  std::shared_ptr<unwindstack::Memory> memory = unwindstack::Memory::CreateOfflineMemory(
+      static_cast<const uint8_t*>(stack_dump), regs[unwindstack::X86_64_REG_RSP],
+      regs[unwindstack::X86_64_REG_RSP] + stack_dump_size);
+
+  unwindstack::Unwinder unwinder{MAX_FRAMES, maps, &regs, memory};
+  // Only the addresses are needed, and resolving function names is expensive.
+  unwinder.SetResolveNames(false);
+  unwinder.Unwind();
+
+  *is_complete = unwinder.LastErrorCode() == unwindstack::ERROR_NONE;
+  return unwinder.frames();
+}
+
 }  // namespace orbit_linux_tracing
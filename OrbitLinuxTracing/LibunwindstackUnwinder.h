@@ -20,13 +20,31 @@
 
 namespace orbit_linux_tracing {
 
+// How much of a stack dump unwinding actually read.
+struct StackDumpUsage {
+  // Bytes from the start of the stack dump (the stack pointer) to the end of the furthest read.
+  uint64_t used_size = 0;
+  // Whether unwinding tried to read the stack beyond the end of the stack dump. The unwinding of
+  // such samples normally fails, or misses the outermost frames.
+  bool read_beyond_stack_dump = false;
+};
+
 class LibunwindstackUnwinder {
  public:
   static std::unique_ptr<unwindstack::BufferMaps> ParseMaps(const std::string& maps_buffer);
 
+  // If stack_dump_usage is not nullptr, it receives how much of the stack dump was read.
   std::vector<unwindstack::FrameData> Unwind(
       unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
-      const void* stack_dump, uint64_t stack_dump_size);
+      const void* stack_dump, uint64_t stack_dump_size,
+      StackDumpUsage* stack_dump_usage = nullptr);
+
+  // Unlike Unwind, also returns the frames unwound before an error, for example before reaching
+  // the end of a stack dump that doesn't contain the outermost frames, and doesn't resolve function
+  // names. is_complete is set to whether unwinding reached the outermost frame without errors.
+  std::vector<unwindstack::FrameData> UnwindAsFarAsPossible(
+      unwindstack::Maps* maps, const std::array<uint64_t, PERF_REG_X86_64_MAX>& perf_regs,
+      const void* stack_dump, uint64_t stack_dump_size, bool* is_complete);
 
  private:
   static constexpr size_t MAX_FRAMES = 1024;  // This is arbitrary.
@@ -10,10 +10,13 @@
 #include <stdio.h>
 #include <sys/resource.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <sstream>
@@ -23,6 +26,7 @@
 #include <thread>
 #include <vector>
 
+#include "LinuxTracingUtils.h"
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/SafeStrerror.h"
 
@@ -109,6 +113,19 @@ std::vector<pid_t> GetAllTids() {
   return all_tids;
 }
 
+std::optional<pid_t> GetLastAllocatedPid() {
+  std::optional<std::string> ns_last_pid = ReadFile("/proc/sys/kernel/ns_last_pid");
+  if (!ns_last_pid.has_value()) {
+    return std::nullopt;
+  }
+  pid_t last_pid;
+  if (!absl::SimpleAtoi(ns_last_pid.value(), &last_pid)) {
+    ERROR("Parsing /proc/sys/kernel/ns_last_pid: \"%s\"", ns_last_pid.value());
+    return std::nullopt;
+  }
+  return last_pid;
+}
+
 std::optional<char> GetThreadState(pid_t tid) {
   fs::path stat{fs::path{"/proc"} / std::to_string(tid) / "stat"};
   if (!fs::exists(stat)) {
@@ -263,6 +280,38 @@ int GetTracepointId(const char* tracepoint_category, const char* tracepoint_name
   return tp_id;
 }
 
+std::string BuildTidTracepointFilter(const std::vector<std::string_view>& tid_fields,
+                                     std::vector<pid_t> tids, pid_t last_allocated_tid) {
+  CHECK(!tid_fields.empty());
+  // The kernel copies the filter with strndup_user(filter, PAGE_SIZE).
+  const size_t max_filter_length = GetPageSize() - 1;
+
+  std::sort(tids.begin(), tids.end());
+  std::string filter;
+  for (pid_t tid : tids) {
+    for (std::string_view tid_field : tid_fields) {
+      absl::StrAppendFormat(&filter, "%s == %d || ", tid_field, tid);
+    }
+  }
+  for (std::string_view tid_field : tid_fields) {
+    absl::StrAppendFormat(&filter, "%s > %d || ", tid_field, last_allocated_tid);
+  }
+  filter.resize(filter.size() - std::string_view{" || "}.size());
+  if (filter.size() <= max_filter_length) {
+    return filter;
+  }
+
+  // Too many threads to list them all: fall back to also letting through the events of the
+  // threads in between.
+  filter.clear();
+  for (std::string_view tid_field : tid_fields) {
+    absl::StrAppendFormat(&filter, "%s >= %d || ", tid_field,
+                          std::min(tids.front(), last_allocated_tid + 1));
+  }
+  filter.resize(filter.size() - std::string_view{" || "}.size());
+  return filter;
+}
+
 uint64_t GetMaxOpenFilesHardLimit() {
   rlimit limit;
   int ret = getrlimit(RLIMIT_NOFILE, &limit);
@@ -273,6 +322,16 @@ uint64_t GetMaxOpenFilesHardLimit() {
   return limit.rlim_max;
 }
 
+uint64_t GetMaxOpenFilesSoftLimit() {
+  rlimit limit;
+  int ret = getrlimit(RLIMIT_NOFILE, &limit);
+  if (ret != 0) {
+    ERROR("getrlimit: %s", SafeStrerror(errno));
+    return 0;
+  }
+  return limit.rlim_cur;
+}
+
 bool SetMaxOpenFilesSoftLimit(uint64_t soft_limit) {
   uint64_t hard_limit = GetMaxOpenFilesHardLimit();
   if (hard_limit == 0) {
@@ -287,4 +346,27 @@ bool SetMaxOpenFilesSoftLimit(uint64_t soft_limit) {
   return true;
 }
 
+void ParallelFor(size_t count, size_t max_num_threads,
+                 const std::function<void(size_t)>& function) {
+  std::atomic<size_t> next_index = 0;
+  auto worker = [&next_index, count, &function] {
+    for (size_t index = next_index++; index < count; index = next_index++) {
+      function(index);
+    }
+  };
+
+  const size_t num_threads =
+      std::max<size_t>(1, std::min<size_t>({max_num_threads, count,
+                                             std::max(1u, std::thread::hardware_concurrency())}));
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace orbit_linux_tracing
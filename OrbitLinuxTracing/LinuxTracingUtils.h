@@ -8,7 +8,11 @@
 #include <unistd.h>
 
 #include <ctime>
+#include <functional>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Profiling.h"
@@ -25,6 +29,11 @@ std::vector<pid_t> GetTidsOfProcess(pid_t pid);
 
 std::vector<pid_t> GetAllTids();
 
+// Returns the last pid (or tid) allocated by the kernel in the pid namespace of this process, as
+// read from /proc/sys/kernel/ns_last_pid. Until pids wrap around, threads created later have
+// higher tids.
+std::optional<pid_t> GetLastAllocatedPid();
+
 // The association between a character and a thread state is documented at
 // https://man7.org/linux/man-pages/man5/proc.5.html in the "/proc/[pid]/stat" section,
 // and at https://www.man7.org/linux/man-pages/man1/ps.1.html#PROCESS_STATE_CODES.
@@ -45,10 +54,23 @@ std::vector<int> GetCpusetCpus(pid_t pid);
 // -1 in case of any errors.
 int GetTracepointId(const char* tracepoint_category, const char* tracepoint_name);
 
+// Builds a filter for PERF_EVENT_IOC_SET_FILTER that only lets through the tracepoint events for
+// which at least one of tid_fields (example: "prev_pid", "next_pid") is one of tids or is greater
+// than last_allocated_tid, i.e., refers to a thread created after tids were listed. If the filter
+// would exceed the length accepted by the kernel, a single lower bound on the tids is used instead.
+std::string BuildTidTracepointFilter(const std::vector<std::string_view>& tid_fields,
+                                     std::vector<pid_t> tids, pid_t last_allocated_tid);
+
 uint64_t GetMaxOpenFilesHardLimit();
 
+uint64_t GetMaxOpenFilesSoftLimit();
+
 bool SetMaxOpenFilesSoftLimit(uint64_t soft_limit);
 
+// Calls function(index) for every index in [0, count), distributing the indices over up to
+// max_num_threads threads, the calling one included. Returns when all calls have returned.
+void ParallelFor(size_t count, size_t max_num_threads, const std::function<void(size_t)>& function);
+
 #if defined(__x86_64__)
 
 #define READ_ONCE(x) (*static_cast<volatile typeof(x)*>(&x))
@@ -103,6 +103,17 @@ TEST(GetAllTids, OrbitLinuxTracingTestsMainAndAnotherAndSystemd) {
   EXPECT_THAT(returned_tids, ::testing::IsSupersetOf(expected_tids));
 }
 
+TEST(GetLastAllocatedPid, NotLowerThanNewThread) {
+  pid_t thread_tid = -1;
+  std::thread thread{[&thread_tid] { thread_tid = syscall(SYS_gettid); }};
+  thread.join();
+
+  std::optional<pid_t> last_allocated_pid = GetLastAllocatedPid();
+  ASSERT_TRUE(last_allocated_pid.has_value());
+  // Unless pids have wrapped around in the meantime.
+  EXPECT_GE(last_allocated_pid.value(), thread_tid);
+}
+
 TEST(GetThreadName, OrbitLinuxTracingTests) {
   // Thread names have a length limit of 15 characters.
   std::string expected_name = std::string{"OrbitLinuxTracingTests"}.substr(0, 15);
@@ -217,4 +228,32 @@ TEST(ParseCpusetCpus, SingleValuesAndRanges) {
   EXPECT_THAT(returned_cpus, ::testing::ElementsAre(0, 1, 2, 4, 7, 12, 13, 14));
 }
 
+TEST(BuildTidTracepointFilter, ListsTidsAndLetsThroughNewThreads) {
+  EXPECT_EQ(BuildTidTracepointFilter({"pid"}, {42, 7}, 100), "pid == 7 || pid == 42 || pid > 100");
+  EXPECT_EQ(BuildTidTracepointFilter({"prev_pid", "next_pid"}, {42}, 100),
+            "prev_pid == 42 || next_pid == 42 || prev_pid > 100 || next_pid > 100");
+  EXPECT_EQ(BuildTidTracepointFilter({"pid"}, {}, 100), "pid > 100");
+}
+
+TEST(BuildTidTracepointFilter, FallsBackToLowerBoundWithManyTids) {
+  std::vector<pid_t> tids;
+  for (pid_t tid = 1000; tid < 1000 + static_cast<pid_t>(GetPageSize()); tid += 2) {
+    tids.push_back(tid);
+  }
+  EXPECT_EQ(BuildTidTracepointFilter({"prev_pid", "next_pid"}, tids, 100'000),
+            "prev_pid >= 1000 || next_pid >= 1000");
+}
+
+TEST(MaxOpenFiles, CanRaiseSoftLimitUpToHardLimit) {
+  const uint64_t soft_limit = GetMaxOpenFilesSoftLimit();
+  const uint64_t hard_limit = GetMaxOpenFilesHardLimit();
+  ASSERT_GT(soft_limit, 0);
+  ASSERT_LE(soft_limit, hard_limit);
+
+  EXPECT_TRUE(SetMaxOpenFilesSoftLimit(hard_limit));
+  EXPECT_EQ(GetMaxOpenFilesSoftLimit(), hard_limit);
+  EXPECT_TRUE(SetMaxOpenFilesSoftLimit(soft_limit));
+  EXPECT_EQ(GetMaxOpenFilesSoftLimit(), soft_limit);
+}
+
 }  // namespace orbit_linux_tracing
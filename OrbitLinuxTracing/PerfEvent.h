@@ -13,6 +13,7 @@
 #include <array>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -151,6 +152,37 @@ class LostPerfEvent : public PerfEvent {
   uint32_t GetCpu() const { return ring_buffer_record.sample_id.cpu; }
 };
 
+inline std::array<uint64_t, PERF_REG_X86_64_MAX> perf_event_sample_regs_user_all_to_register_array(
+    const perf_event_sample_regs_user_all& regs) {
+  std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
+  registers[PERF_REG_X86_AX] = regs.ax;
+  registers[PERF_REG_X86_BX] = regs.bx;
+  registers[PERF_REG_X86_CX] = regs.cx;
+  registers[PERF_REG_X86_DX] = regs.dx;
+  registers[PERF_REG_X86_SI] = regs.si;
+  registers[PERF_REG_X86_DI] = regs.di;
+  registers[PERF_REG_X86_BP] = regs.bp;
+  registers[PERF_REG_X86_SP] = regs.sp;
+  registers[PERF_REG_X86_IP] = regs.ip;
+  registers[PERF_REG_X86_FLAGS] = regs.flags;
+  registers[PERF_REG_X86_CS] = regs.cs;
+  registers[PERF_REG_X86_SS] = regs.ss;
+  // Registers ds, es, fs, gs do not actually exist.
+  registers[PERF_REG_X86_DS] = 0ul;
+  registers[PERF_REG_X86_ES] = 0ul;
+  registers[PERF_REG_X86_FS] = 0ul;
+  registers[PERF_REG_X86_GS] = 0ul;
+  registers[PERF_REG_X86_R8] = regs.r8;
+  registers[PERF_REG_X86_R9] = regs.r9;
+  registers[PERF_REG_X86_R10] = regs.r10;
+  registers[PERF_REG_X86_R11] = regs.r11;
+  registers[PERF_REG_X86_R12] = regs.r12;
+  registers[PERF_REG_X86_R13] = regs.r13;
+  registers[PERF_REG_X86_R14] = regs.r14;
+  registers[PERF_REG_X86_R15] = regs.r15;
+  return registers;
+}
+
 struct dynamically_sized_perf_event_stack_sample {
   struct dynamically_sized_perf_event_sample_stack_user {
     uint64_t dyn_size;
@@ -173,7 +205,8 @@ class StackSamplePerfEvent : public PerfEvent {
   std::unique_ptr<dynamically_sized_perf_event_stack_sample> ring_buffer_record;
 
   explicit StackSamplePerfEvent(uint64_t dyn_size)
-      : ring_buffer_record{std::make_unique<dynamically_sized_perf_event_stack_sample>(dyn_size)} {}
+      : ring_buffer_record{std::make_unique<dynamically_sized_perf_event_stack_sample>(dyn_size)},
+        dumped_stack_size_{dyn_size} {}
 
   uint64_t GetTimestamp() const override { return ring_buffer_record->sample_id.time; }
 
@@ -194,37 +227,13 @@ class StackSamplePerfEvent : public PerfEvent {
   char* GetStackData() { return ring_buffer_record->stack.data.get(); }
   uint64_t GetStackSize() const { return ring_buffer_record->stack.dyn_size; }
 
+  // The size of the stack dumped by the kernel, of which only the first GetStackSize() bytes were
+  // copied from the ring buffer.
+  uint64_t GetDumpedStackSize() const { return dumped_stack_size_; }
+  void SetDumpedStackSize(uint64_t dumped_stack_size) { dumped_stack_size_ = dumped_stack_size; }
+
  private:
-  static std::array<uint64_t, PERF_REG_X86_64_MAX>
-  perf_event_sample_regs_user_all_to_register_array(const perf_event_sample_regs_user_all& regs) {
-    std::array<uint64_t, PERF_REG_X86_64_MAX> registers{};
-    registers[PERF_REG_X86_AX] = regs.ax;
-    registers[PERF_REG_X86_BX] = regs.bx;
-    registers[PERF_REG_X86_CX] = regs.cx;
-    registers[PERF_REG_X86_DX] = regs.dx;
-    registers[PERF_REG_X86_SI] = regs.si;
-    registers[PERF_REG_X86_DI] = regs.di;
-    registers[PERF_REG_X86_BP] = regs.bp;
-    registers[PERF_REG_X86_SP] = regs.sp;
-    registers[PERF_REG_X86_IP] = regs.ip;
-    registers[PERF_REG_X86_FLAGS] = regs.flags;
-    registers[PERF_REG_X86_CS] = regs.cs;
-    registers[PERF_REG_X86_SS] = regs.ss;
-    // Registers ds, es, fs, gs do not actually exist.
-    registers[PERF_REG_X86_DS] = 0ul;
-    registers[PERF_REG_X86_ES] = 0ul;
-    registers[PERF_REG_X86_FS] = 0ul;
-    registers[PERF_REG_X86_GS] = 0ul;
-    registers[PERF_REG_X86_R8] = regs.r8;
-    registers[PERF_REG_X86_R9] = regs.r9;
-    registers[PERF_REG_X86_R10] = regs.r10;
-    registers[PERF_REG_X86_R11] = regs.r11;
-    registers[PERF_REG_X86_R12] = regs.r12;
-    registers[PERF_REG_X86_R13] = regs.r13;
-    registers[PERF_REG_X86_R14] = regs.r14;
-    registers[PERF_REG_X86_R15] = regs.r15;
-    return registers;
-  }
+  uint64_t dumped_stack_size_;
 };
 
 class CallchainSamplePerfEvent : public PerfEvent {
@@ -250,6 +259,28 @@ class CallchainSamplePerfEvent : public PerfEvent {
   const uint64_t* GetCallchain() const { return ips.data(); }
 
   uint64_t GetCallchainSize() const { return ring_buffer_record.nr; }
+
+  // Only samples from callchain_and_stack_sample_event_open also have the registers and the top of
+  // the stack, and only if they have user-space registers.
+  void SetRegistersAndStack(const perf_event_sample_regs_user_all& regs, uint64_t stack_size) {
+    regs_ = regs;
+    stack_data_ = make_unique_for_overwrite<char[]>(stack_size);
+    stack_size_ = stack_size;
+  }
+  bool HasRegistersAndStack() const { return regs_.has_value(); }
+
+  std::array<uint64_t, PERF_REG_X86_64_MAX> GetRegisters() const {
+    return perf_event_sample_regs_user_all_to_register_array(regs_.value());
+  }
+
+  const char* GetStackData() const { return stack_data_.get(); }
+  char* GetStackData() { return stack_data_.get(); }
+  uint64_t GetStackSize() const { return stack_size_; }
+
+ private:
+  std::optional<perf_event_sample_regs_user_all> regs_;
+  std::unique_ptr<char[]> stack_data_;
+  uint64_t stack_size_ = 0;
 };
 
 class AbstractUprobesPerfEvent {
@@ -379,6 +410,13 @@ class TaskNewtaskPerfEvent : public TracepointPerfEvent {
   pid_t GetTid() const { return GetTypedTracepointData<task_newtask_tracepoint>().pid; }
 
   const char* GetComm() const { return GetTypedTracepointData<task_newtask_tracepoint>().comm; }
+
+  // The process of the thread that created the new thread (or process).
+  pid_t GetCreatorPid() const { return ring_buffer_record.sample_id.pid; }
+
+  uint64_t GetCloneFlags() const {
+    return GetTypedTracepointData<task_newtask_tracepoint>().clone_flags;
+  }
 };
 
 class TaskRenamePerfEvent : public TracepointPerfEvent {
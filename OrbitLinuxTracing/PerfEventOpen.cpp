@@ -69,14 +69,14 @@ int mmap_task_event_open(pid_t pid, int32_t cpu) {
   return generic_event_open(&pe, pid, cpu);
 }
 
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
+int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu, uint16_t stack_dump_size) {
   perf_event_attr pe = generic_event_attr();
   pe.type = PERF_TYPE_SOFTWARE;
   pe.config = PERF_COUNT_SW_CPU_CLOCK;
   pe.sample_period = period_ns;
   pe.sample_type |= PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
   pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
-  pe.sample_stack_user = SAMPLE_STACK_USER_SIZE;
+  pe.sample_stack_user = stack_dump_size;
 
   return generic_event_open(&pe, pid, cpu);
 }
@@ -87,13 +87,27 @@ int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu) {
   pe.config = PERF_COUNT_SW_CPU_CLOCK;
   pe.sample_period = period_ns;
   pe.sample_type |= PERF_SAMPLE_CALLCHAIN;
-  // TODO(kuebler): Read this from /proc/sys/kernel/perf_event_max_stack
-  pe.sample_max_stack = 127;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
   pe.exclude_callchain_kernel = true;
 
   return generic_event_open(&pe, pid, cpu);
 }
 
+int callchain_and_stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                                          uint16_t stack_dump_size) {
+  perf_event_attr pe = generic_event_attr();
+  pe.type = PERF_TYPE_SOFTWARE;
+  pe.config = PERF_COUNT_SW_CPU_CLOCK;
+  pe.sample_period = period_ns;
+  pe.sample_type |= PERF_SAMPLE_CALLCHAIN | PERF_SAMPLE_REGS_USER | PERF_SAMPLE_STACK_USER;
+  pe.sample_max_stack = SAMPLE_MAX_STACK;
+  pe.exclude_callchain_kernel = true;
+  pe.sample_regs_user = SAMPLE_REGS_USER_ALL;
+  pe.sample_stack_user = stack_dump_size;
+
+  return generic_event_open(&pe, pid, cpu);
+}
+
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset, pid_t pid,
                                int32_t cpu) {
   perf_event_attr pe = uprobe_event_attr(module, function_offset);
@@ -52,6 +52,17 @@ inline void perf_event_redirect(int from_fd, int to_fd) {
   }
 }
 
+// A tracepoint filter can only be set once for each file descriptor: further attempts fail with
+// EEXIST.
+inline bool perf_event_set_filter(int file_descriptor, const char* filter) {
+  int ret = ioctl(file_descriptor, PERF_EVENT_IOC_SET_FILTER, filter);
+  if (ret != 0) {
+    ERROR("PERF_EVENT_IOC_SET_FILTER: %s", SafeStrerror(errno));
+    return false;
+  }
+  return true;
+}
+
 inline uint64_t perf_event_get_id(int file_descriptor) {
   uint64_t id;
   int ret = ioctl(file_descriptor, PERF_EVENT_IOC_ID, &id);
@@ -98,26 +109,42 @@ static constexpr uint64_t SAMPLE_REGS_USER_SP_IP_ARGUMENTS =
 // If we want the size we pass to coincide with the size we get, we need to pass
 // a lower value. For the current layout of perf_event_stack_sample, the maximum
 // size is 65312, but let's leave some extra room.
-// TODO: As this amount of memory has to be copied from the ring buffer for each
-//  sample, this constant should be a parameters and should be made available in
-//  some setting.
+// This is the default and the maximum stack dump size for stack_sample_event_open.
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE = 65000;
 
 static_assert(sizeof(void*) == 8);
 static constexpr uint16_t SAMPLE_STACK_USER_SIZE_8BYTES = 8;
 
+// Default stack dump size for callchain_and_stack_sample_event_open in hybrid mode: enough to
+// unwind a few frames with DWARF information.
+static constexpr uint16_t SAMPLE_STACK_USER_SIZE_HYBRID = 8192;
+// Default stack dump size for callchain_and_stack_sample_event_open when only repairing leaf
+// frames: enough to contain the return address of most functions that don't set up a frame.
+static constexpr uint16_t SAMPLE_STACK_USER_SIZE_LEAF_FRAMES = 512;
+
+// Maximum number of frames in the callchains collected for frame pointer unwinding.
+// TODO(kuebler): Read this from /proc/sys/kernel/perf_event_max_stack
+static constexpr uint16_t SAMPLE_MAX_STACK = 127;
+
 // perf_event_open for context switches.
 int context_switch_event_open(pid_t pid, int32_t cpu);
 
 // perf_event_open for task (fork and exit) and mmap records in the same buffer.
 int mmap_task_event_open(pid_t pid, int32_t cpu);
 
-// perf_event_open for stack sampling.
-int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
+// perf_event_open for stack sampling. stack_dump_size must be a multiple of 8 and at most
+// SAMPLE_STACK_USER_SIZE.
+int stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                            uint16_t stack_dump_size = SAMPLE_STACK_USER_SIZE);
 
 // perf_event_open for stack sampling using frame pointers.
 int callchain_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu);
 
+// perf_event_open for stack sampling using frame pointers, also dumping the registers and the top
+// stack_dump_size bytes of the stack, to unwind the frames that frame pointers can't handle.
+int callchain_and_stack_sample_event_open(uint64_t period_ns, pid_t pid, int32_t cpu,
+                                          uint16_t stack_dump_size);
+
 // perf_event_open for uprobes and uretprobes.
 int uprobes_retaddr_event_open(const char* module, uint64_t function_offset, pid_t pid,
                                int32_t cpu);
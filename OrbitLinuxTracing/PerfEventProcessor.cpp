@@ -5,6 +5,7 @@
 #include "PerfEventProcessor.h"
 
 #include <memory>
+#include <optional>
 #include <utility>
 
 #include "LinuxTracingUtils.h"
@@ -60,4 +61,12 @@ void PerfEventProcessor::ProcessOldEvents() {
   }
 }
 
+std::optional<uint64_t> PerfEventProcessor::GetNextProcessingTimestampNs() {
+  if (!event_queue_.HasEvent()) {
+    return std::nullopt;
+  }
+  // See the condition in ProcessOldEvents.
+  return event_queue_.TopEvent()->GetTimestamp() + kProcessingDelayMs * 1'000'000 + 1;
+}
+
 }  // namespace orbit_linux_tracing
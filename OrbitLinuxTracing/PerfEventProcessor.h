@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <atomic>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "PerfEvent.h"
@@ -32,6 +33,10 @@ class PerfEventProcessor {
 
   void ProcessOldEvents();
 
+  // Returns the earliest timestamp at which ProcessOldEvents will process at least one event, or
+  // std::nullopt if there is no event to process at all. Allows callers to sleep until then.
+  [[nodiscard]] std::optional<uint64_t> GetNextProcessingTimestampNs();
+
   void AddVisitor(PerfEventVisitor* visitor) { visitors_.push_back(visitor); }
 
   void ClearVisitors() { visitors_.clear(); }
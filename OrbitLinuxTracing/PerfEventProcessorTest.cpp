@@ -9,6 +9,7 @@
 #include <atomic>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <thread>
 
 #include "LinuxTracingUtils.h"
@@ -114,6 +115,30 @@ TEST_F(PerfEventProcessorTest, DiscardedOutOfOrderCounter) {
   processor_.ProcessOldEvents();
 }
 
+TEST_F(PerfEventProcessorTest, GetNextProcessingTimestampNs) {
+  EXPECT_FALSE(processor_.GetNextProcessingTimestampNs().has_value());
+
+  uint64_t oldest_timestamp_ns = MonotonicTimestampNs();
+  processor_.AddEvent(MakeFakePerfEvent(11, oldest_timestamp_ns + 1));
+  processor_.AddEvent(MakeFakePerfEvent(22, oldest_timestamp_ns));
+  std::optional<uint64_t> next_processing_timestamp_ns =
+      processor_.GetNextProcessingTimestampNs();
+  ASSERT_TRUE(next_processing_timestamp_ns.has_value());
+  EXPECT_GT(next_processing_timestamp_ns.value(),
+            oldest_timestamp_ns + kDelayBeforeProcessOldEventsMs * 1'000'000);
+
+  EXPECT_CALL(mock_visitor_, visit).Times(0);
+  processor_.ProcessOldEvents();
+  ::testing::Mock::VerifyAndClearExpectations(&mock_visitor_);
+
+  while (MonotonicTimestampNs() <= next_processing_timestamp_ns.value()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_CALL(mock_visitor_, visit).Times(2);
+  processor_.ProcessOldEvents();
+  EXPECT_FALSE(processor_.GetNextProcessingTimestampNs().has_value());
+}
+
 TEST_F(PerfEventProcessorTest, ProcessOldEventsNeedsVisitor) {
   processor_.ClearVisitors();
   processor_.AddEvent(MakeFakePerfEvent(11, MonotonicTimestampNs()));
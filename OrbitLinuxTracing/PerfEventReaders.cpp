@@ -4,6 +4,7 @@
 
 #include "PerfEventReaders.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "PerfEventRecords.h"
@@ -61,20 +62,34 @@ pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer) {
   return pid;
 }
 
-std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(PerfEventRingBuffer* ring_buffer,
-                                                                  const perf_event_header& header) {
-  // Data in the ring buffer has the layout of perf_event_stack_sample, but we
-  // copy it into dynamically_sized_perf_event_stack_sample.
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer) {
+  pid_t tid;
+  // All PERF_RECORD_SAMPLEs start with
+  //   perf_event_header header;
+  //   perf_event_sample_id_tid_time_streamid_cpu sample_id;
+  ring_buffer->ReadValueAtOffset(
+      &tid, sizeof(perf_event_header) + offsetof(perf_event_sample_id_tid_time_streamid_cpu, tid));
+  return tid;
+}
+
+std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint64_t max_stack_size_to_copy) {
+  // Data in the ring buffer has the layout of perf_event_stack_sample, but with a stack dump of the
+  // size the event was opened with instead of SAMPLE_STACK_USER_SIZE, so dyn_size is read from the
+  // end of the record. We copy it into dynamically_sized_perf_event_stack_sample.
   uint64_t dyn_size;
-  ring_buffer->ReadValueAtOffset(&dyn_size, offsetof(perf_event_stack_sample, stack.dyn_size));
-  auto event = std::make_unique<StackSamplePerfEvent>(dyn_size);
+  ring_buffer->ReadValueAtOffset(&dyn_size, header.size - sizeof(dyn_size));
+  auto event = std::make_unique<StackSamplePerfEvent>(std::min(dyn_size, max_stack_size_to_copy));
+  event->SetDumpedStackSize(dyn_size);
   event->ring_buffer_record->header = header;
   ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->sample_id,
                                  offsetof(perf_event_stack_sample, sample_id));
   ring_buffer->ReadValueAtOffset(&event->ring_buffer_record->regs,
                                  offsetof(perf_event_stack_sample, regs));
   ring_buffer->ReadRawAtOffset(event->ring_buffer_record->stack.data.get(),
-                               offsetof(perf_event_stack_sample, stack.data), dyn_size);
+                               offsetof(perf_event_stack_sample, stack.data),
+                               event->GetStackSize());
   ring_buffer->SkipRecord(header);
   return event;
 }
@@ -94,6 +109,31 @@ std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
                                offsetof(perf_event_callchain_sample_fixed, nr) +
                                    sizeof(perf_event_callchain_sample_fixed::nr),
                                size_in_bytes);
+
+  // Samples from callchain_and_stack_sample_event_open continue with the registers and the stack
+  // dump, with the layout of perf_event_sample_regs_user_all and perf_event_sample_stack_user. When
+  // there are no user-space registers, only abi (PERF_SAMPLE_REGS_ABI_NONE) and a size of 0 follow.
+  const uint64_t regs_offset = offsetof(perf_event_callchain_sample_fixed, nr) +
+                               sizeof(perf_event_callchain_sample_fixed::nr) + size_in_bytes;
+  if (header.size >= regs_offset + sizeof(perf_event_sample_regs_user_all) + sizeof(uint64_t)) {
+    perf_event_sample_regs_user_all regs;
+    ring_buffer->ReadValueAtOffset(&regs, regs_offset);
+    if (regs.abi != PERF_SAMPLE_REGS_ABI_NONE) {
+      const uint64_t stack_offset = regs_offset + sizeof(perf_event_sample_regs_user_all);
+      uint64_t stack_size;
+      ring_buffer->ReadValueAtOffset(&stack_size, stack_offset);
+      uint64_t dyn_size = 0;
+      if (stack_size > 0) {
+        ring_buffer->ReadValueAtOffset(&dyn_size, header.size - sizeof(dyn_size));
+      }
+      event->SetRegistersAndStack(regs, dyn_size);
+      if (dyn_size > 0) {
+        ring_buffer->ReadRawAtOffset(event->GetStackData(), stack_offset + sizeof(stack_size),
+                                     dyn_size);
+      }
+    }
+  }
+
   ring_buffer->SkipRecord(header);
   return event;
 }
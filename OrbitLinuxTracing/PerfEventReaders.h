@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <limits>
 #include <memory>
 #include <type_traits>
 
@@ -29,8 +30,13 @@ uint64_t ReadSampleRecordStreamId(PerfEventRingBuffer* ring_buffer);
 
 pid_t ReadSampleRecordPid(PerfEventRingBuffer* ring_buffer);
 
-std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(PerfEventRingBuffer* ring_buffer,
-                                                                  const perf_event_header& header);
+pid_t ReadSampleRecordTid(PerfEventRingBuffer* ring_buffer);
+
+// Only copies the first max_stack_size_to_copy bytes of the stack dump, which can be smaller than
+// the stack dump size the sampling event was opened with.
+std::unique_ptr<StackSamplePerfEvent> ConsumeStackSamplePerfEvent(
+    PerfEventRingBuffer* ring_buffer, const perf_event_header& header,
+    uint64_t max_stack_size_to_copy = std::numeric_limits<uint64_t>::max());
 
 std::unique_ptr<CallchainSamplePerfEvent> ConsumeCallchainSamplePerfEvent(
     PerfEventRingBuffer* ring_buffer, const perf_event_header& header);
@@ -105,6 +105,12 @@ struct __attribute__((__packed__)) perf_event_stack_sample {
   perf_event_sample_stack_user stack;
 };
 
+// perf_event_stack_sample describes records with a stack dump of SAMPLE_STACK_USER_SIZE bytes.
+// This is the size of the records with a stack dump of stack_dump_size bytes instead.
+constexpr uint64_t GetStackSampleRecordSize(uint64_t stack_dump_size) {
+  return sizeof(perf_event_stack_sample) - SAMPLE_STACK_USER_SIZE + stack_dump_size;
+}
+
 struct __attribute__((__packed__)) perf_event_callchain_sample_fixed {
   perf_event_header header;
   perf_event_sample_id_tid_time_streamid_cpu sample_id;
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <utility>
 
@@ -77,6 +78,7 @@ PerfEventRingBuffer::PerfEventRingBuffer(PerfEventRingBuffer&& o) noexcept {
   std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
   std::swap(file_descriptor_, o.file_descriptor_);
   std::swap(name_, o.name_);
+  std::swap(peak_fill_bytes_, o.peak_fill_bytes_);
 }
 
 PerfEventRingBuffer& PerfEventRingBuffer::operator=(PerfEventRingBuffer&& o) noexcept {
@@ -88,6 +90,7 @@ PerfEventRingBuffer& PerfEventRingBuffer::operator=(PerfEventRingBuffer&& o) noe
     std::swap(ring_buffer_size_log2_, o.ring_buffer_size_log2_);
     std::swap(file_descriptor_, o.file_descriptor_);
     std::swap(name_, o.name_);
+    std::swap(peak_fill_bytes_, o.peak_fill_bytes_);
   }
   return *this;
 }
@@ -106,6 +109,7 @@ bool PerfEventRingBuffer::HasNewData() {
   uint64_t head = ReadRingBufferHead(metadata_page_);
   DCHECK((metadata_page_->data_tail == head) ||
          (head >= metadata_page_->data_tail + sizeof(perf_event_header)));
+  peak_fill_bytes_ = std::max<uint64_t>(peak_fill_bytes_, head - metadata_page_->data_tail);
   return head > metadata_page_->data_tail;
 }
 
@@ -27,6 +27,10 @@ class PerfEventRingBuffer {
   bool IsOpen() const { return ring_buffer_ != nullptr; }
   int GetFileDescriptor() const { return file_descriptor_; }
   const std::string& GetName() const { return name_; }
+  uint64_t GetSize() const { return ring_buffer_size_; }
+  // The largest amount of unread data that HasNewData has found in the ring buffer. When this gets
+  // close to GetSize(), the ring buffer is about to overflow and events are lost.
+  uint64_t GetPeakFillBytes() const { return peak_fill_bytes_; }
 
   bool HasNewData();
   void ReadHeader(perf_event_header* header);
@@ -57,6 +61,7 @@ class PerfEventRingBuffer {
   uint32_t ring_buffer_size_log2_ = 0;
   int file_descriptor_ = -1;
   std::string name_;
+  uint64_t peak_fill_bytes_ = 0;
 
   // ConsumeRawRecord reads header.size bytes into record buffer and then skips the record.
   void ConsumeRawRecord(const perf_event_header& header, void* record);
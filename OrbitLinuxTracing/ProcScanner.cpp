@@ -0,0 +1,188 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ProcScanner.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "LinuxTracingUtils.h"
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+#include "OrbitBase/Tracing.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Large enough to list the threads of most processes with a single getdents64.
+constexpr size_t kDirentsBufferSize = 32 * 1024;
+// /proc/<pid>/task/<tid>/stat is a single line of a few hundred bytes at most, comm even shorter.
+constexpr size_t kFileBufferSize = 1024;
+// Processes are split in more chunks than threads as their number of threads varies widely.
+constexpr size_t kChunksPerThread = 8;
+
+// The buffers used to scan a chunk of processes, allocated once per chunk.
+struct ScanBuffers {
+  std::unique_ptr<char[]> dirents = std::make_unique<char[]>(kDirentsBufferSize);
+  std::array<char, kFileBufferSize> file{};
+};
+
+std::optional<pid_t> ParsePid(const char* name) {
+  if (*name == '\0') return std::nullopt;
+  int64_t pid = 0;
+  for (const char* c = name; *c != '\0'; ++c) {
+    if (*c < '0' || *c > '9') return std::nullopt;
+    pid = pid * 10 + (*c - '0');
+    if (pid > std::numeric_limits<pid_t>::max()) return std::nullopt;
+  }
+  if (pid == 0) return std::nullopt;
+  return static_cast<pid_t>(pid);
+}
+
+// Calls callback(pid) for every entry of the directory dir_fd whose name is a pid or tid, as in
+// /proc and /proc/<pid>/task.
+template <typename Callback>
+void ForEachPidEntry(int dir_fd, ScanBuffers* buffers, Callback&& callback) {
+  while (true) {
+    long num_bytes = syscall(SYS_getdents64, dir_fd, buffers->dirents.get(), kDirentsBufferSize);
+    if (num_bytes <= 0) {
+      // 0 means the end of the directory. Errors are possible when the process has exited in
+      // the meantime, and can't be distinguished from the directory being incomplete anyway.
+      return;
+    }
+    for (long offset = 0; offset < num_bytes;) {
+      const auto* entry = reinterpret_cast<const dirent64*>(buffers->dirents.get() + offset);
+      offset += entry->d_reclen;
+      if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+      if (std::optional<pid_t> pid = ParsePid(entry->d_name); pid.has_value()) {
+        callback(pid.value());
+      }
+    }
+  }
+}
+
+// Reads the beginning of the file at path relative to dir_fd into buffers->file. Returns
+// std::nullopt if the file doesn't exist (anymore).
+std::optional<std::string_view> ReadSmallFile(int dir_fd, const char* path, ScanBuffers* buffers) {
+  int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return std::nullopt;
+  }
+  ssize_t num_bytes = pread(fd, buffers->file.data(), buffers->file.size(), 0);
+  close(fd);
+  if (num_bytes < 0) {
+    return std::nullopt;
+  }
+  return std::string_view{buffers->file.data(), static_cast<size_t>(num_bytes)};
+}
+
+// As in GetThreadState, skip pid and comm, which is enclosed in parentheses but could contain
+// spaces and parentheses itself, to find the state.
+std::optional<char> ParseThreadStateFromStat(std::string_view stat) {
+  size_t last_closed_paren_index = stat.find_last_of(')');
+  if (last_closed_paren_index == std::string_view::npos) {
+    return std::nullopt;
+  }
+  size_t state_index = stat.find_first_not_of(' ', last_closed_paren_index + 1);
+  if (state_index == std::string_view::npos || stat[state_index] == '\n') {
+    return std::nullopt;
+  }
+  return stat[state_index];
+}
+
+void ScanProcess(int proc_fd, pid_t pid, bool read_thread_states, ScanBuffers* buffers,
+                 std::vector<ProcThread>* threads) {
+  // Large enough for "<pid>/task", "<tid>/comm" and "<tid>/stat".
+  std::array<char, 32> path{};
+  snprintf(path.data(), path.size(), "%d/task", pid);
+  int task_fd = openat(proc_fd, path.data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (task_fd == -1) {
+    // The process has exited in the meantime.
+    return;
+  }
+
+  ForEachPidEntry(task_fd, buffers, [&](pid_t tid) {
+    ProcThread& thread = threads->emplace_back();
+    thread.pid = pid;
+    thread.tid = tid;
+
+    snprintf(path.data(), path.size(), "%d/comm", tid);
+    if (std::optional<std::string_view> comm = ReadSmallFile(task_fd, path.data(), buffers);
+        comm.has_value()) {
+      std::string_view name = comm.value();
+      if (!name.empty() && name.back() == '\n') {
+        name.remove_suffix(1);
+      }
+      thread.name = name;
+    }
+
+    if (read_thread_states) {
+      snprintf(path.data(), path.size(), "%d/stat", tid);
+      thread.state_timestamp_ns = MonotonicTimestampNs();
+      if (std::optional<std::string_view> stat = ReadSmallFile(task_fd, path.data(), buffers);
+          stat.has_value()) {
+        thread.state = ParseThreadStateFromStat(stat.value());
+      }
+    }
+  });
+
+  close(task_fd);
+}
+
+}  // namespace
+
+std::vector<ProcThread> ScanProcThreads(std::optional<pid_t> pid_to_read_thread_states_of,
+                                        size_t max_num_threads) {
+  ORBIT_SCOPE_FUNCTION;
+  int proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (proc_fd == -1) {
+    ERROR("Opening /proc: %s", SafeStrerror(errno));
+    return {};
+  }
+
+  std::vector<pid_t> pids;
+  {
+    ScanBuffers buffers;
+    ForEachPidEntry(proc_fd, &buffers, [&pids](pid_t pid) { pids.push_back(pid); });
+  }
+
+  const size_t num_chunks =
+      std::min(pids.size(), std::max<size_t>(1, max_num_threads) * kChunksPerThread);
+  std::vector<std::vector<ProcThread>> threads_per_chunk(num_chunks);
+  ParallelFor(num_chunks, max_num_threads, [&](size_t chunk_index) {
+    ScanBuffers buffers;
+    const size_t begin = chunk_index * pids.size() / num_chunks;
+    const size_t end = (chunk_index + 1) * pids.size() / num_chunks;
+    for (size_t i = begin; i < end; ++i) {
+      ScanProcess(proc_fd, pids[i], pids[i] == pid_to_read_thread_states_of, &buffers,
+                  &threads_per_chunk[chunk_index]);
+    }
+  });
+  close(proc_fd);
+
+  size_t num_threads = 0;
+  for (const std::vector<ProcThread>& chunk_threads : threads_per_chunk) {
+    num_threads += chunk_threads.size();
+  }
+  std::vector<ProcThread> threads;
+  threads.reserve(num_threads);
+  for (std::vector<ProcThread>& chunk_threads : threads_per_chunk) {
+    std::move(chunk_threads.begin(), chunk_threads.end(), std::back_inserter(threads));
+  }
+  return threads;
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,41 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_PROC_SCANNER_H_
+#define ORBIT_LINUX_TRACING_PROC_SCANNER_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace orbit_linux_tracing {
+
+// A thread as found in /proc by ScanProcThreads.
+struct ProcThread {
+  pid_t pid = -1;
+  pid_t tid = -1;
+  // Empty if the name could not be read, e.g., because the thread has exited in the meantime.
+  std::string name;
+  // Only read for the threads of the process passed to ScanProcThreads as
+  // pid_to_read_thread_states_of, together with the time at which it was read.
+  std::optional<char> state;
+  uint64_t state_timestamp_ns = 0;
+};
+
+// Walks /proc once and returns all the threads of all the processes, with their names and, for the
+// threads of pid_to_read_thread_states_of, their states. This replaces calling GetAllTids,
+// GetTidsOfProcess, orbit_base::GetThreadName and GetThreadState for every thread, which is slow
+// on systems with tens of thousands of threads. Directories are listed with getdents64 and files
+// are read with openat and pread into buffers reused for all the processes handled by the same
+// thread, and processes are distributed over up to max_num_threads threads.
+// Threads of the same process are returned consecutively.
+[[nodiscard]] std::vector<ProcThread> ScanProcThreads(
+    std::optional<pid_t> pid_to_read_thread_states_of, size_t max_num_threads);
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_PROC_SCANNER_H_
@@ -0,0 +1,91 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <absl/synchronization/mutex.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ProcScanner.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+const ProcThread* FindThread(const std::vector<ProcThread>& threads, pid_t tid) {
+  for (const ProcThread& thread : threads) {
+    if (thread.tid == tid) return &thread;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(ScanProcThreads, OrbitLinuxTracingTestsMainAndAnotherAndSystemd) {
+  pid_t main_tid = syscall(SYS_gettid);
+  pid_t thread_tid = -1;
+  std::vector<ProcThread> threads;
+
+  absl::Mutex mutex;
+  std::thread thread{[&] {
+    // Make sure /proc/<pid>/task/<tid>/stat is parsed correctly
+    // even when the thread name contains spaces and parentheses.
+    pthread_setname_np(pthread_self(), ") )  )()( )(  )");
+    absl::MutexLock lock{&mutex};
+    thread_tid = syscall(SYS_gettid);
+    mutex.Await(absl::Condition(
+        +[](std::vector<ProcThread>* threads) { return !threads->empty(); }, &threads));
+  }};
+
+  {
+    absl::MutexLock lock{&mutex};
+    mutex.Await(absl::Condition(
+        +[](pid_t* tid) { return *tid != -1; }, &thread_tid));
+    // Make sure `thread` has had the time to go to sleep waiting for the scan to be done.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    threads = ScanProcThreads(getpid(), 4);
+  }
+  thread.join();
+
+  const ProcThread* init = FindThread(threads, 1);
+  ASSERT_NE(init, nullptr);
+  EXPECT_EQ(init->pid, 1);
+  EXPECT_FALSE(init->state.has_value());
+
+  const ProcThread* main_thread = FindThread(threads, main_tid);
+  ASSERT_NE(main_thread, nullptr);
+  EXPECT_EQ(main_thread->pid, getpid());
+  // Thread names have a length limit of 15 characters.
+  EXPECT_EQ(main_thread->name, std::string{"OrbitLinuxTracingTests"}.substr(0, 15));
+  ASSERT_TRUE(main_thread->state.has_value());
+  EXPECT_EQ(main_thread->state.value(), 'R');
+
+  const ProcThread* other_thread = FindThread(threads, thread_tid);
+  ASSERT_NE(other_thread, nullptr);
+  EXPECT_EQ(other_thread->pid, getpid());
+  EXPECT_EQ(other_thread->name, ") )  )()( )(  )");
+  ASSERT_TRUE(other_thread->state.has_value());
+  EXPECT_EQ(other_thread->state.value(), 'S');  // Interruptible sleep
+}
+
+TEST(ScanProcThreads, WithoutThreadStates) {
+  std::vector<ProcThread> threads = ScanProcThreads(std::nullopt, 1);
+  ASSERT_FALSE(threads.empty());
+  for (const ProcThread& thread : threads) {
+    EXPECT_FALSE(thread.state.has_value());
+  }
+  const ProcThread* main_thread = FindThread(threads, getpid());
+  ASSERT_NE(main_thread, nullptr);
+  EXPECT_EQ(main_thread->pid, getpid());
+}
+
+}  // namespace orbit_linux_tracing
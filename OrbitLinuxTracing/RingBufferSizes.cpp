@@ -0,0 +1,217 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "RingBufferSizes.h"
+
+#include <absl/strings/numbers.h>
+#include <linux/capability.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "KernelTracepoints.h"
+#include "LinuxTracingUtils.h"
+#include "OrbitBase/Logging.h"
+#include "PerfEventRecords.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+// Ring buffers are sized to hold the events produced in this time, which is supposed to be long
+// enough to accommodate TracerThread::Run's thread not being scheduled for a few tens of
+// milliseconds.
+constexpr double kBufferedTimeS = 0.2;
+
+// The sampling ring buffers receive at most sampling_rate samples per second on each cpu.
+constexpr uint64_t kMinSamplingSizeKb = 256;
+constexpr uint64_t kMaxSamplingSizeKb = 64 * 1024;
+
+// Each call to an instrumented function produces a uprobe and a uretprobe record. The rate of calls
+// is unknown, so assume that each function is called this many times per second on each cpu.
+// As a single hot function can be called much more often than that, the ring buffers are never
+// smaller than kDefaultUprobesSizeKb, the size used for all captures before the sizes depended on
+// the capture options, unless the budget requires it.
+constexpr double kEstimatedCallsPerSecondPerFunction = 2'000;
+constexpr uint64_t kUprobesAndUretprobesRecordsSize =
+    sizeof(perf_event_sp_ip_arguments_8bytes_sample) + sizeof(perf_event_ax_sample);
+constexpr uint64_t kDefaultUprobesSizeKb = 8 * 1024;
+constexpr uint64_t kMinUprobesSizeKb = 512;
+constexpr uint64_t kMaxUprobesSizeKb = 32 * 1024;
+
+// Busy cpus can have tens of thousands of context switches and wakeups per second. Most of these
+// are discarded in the kernel when the scheduler events are limited to the target.
+constexpr double kEstimatedSchedulerEventsPerSecond = 50'000;
+constexpr double kEstimatedTargetSchedulerEventsPerSecond = 10'000;
+constexpr uint64_t kSchedulerEventRecordSize =
+    sizeof(perf_event_raw_sample_fixed) + sizeof(sched_switch_tracepoint);
+constexpr uint64_t kMinContextSwitchesAndThreadStateSizeKb = 64;
+constexpr uint64_t kMaxContextSwitchesAndThreadStateSizeKb = 16 * 1024;
+
+constexpr uint64_t kSizePerInstrumentedTracepointKb = 512;
+constexpr uint64_t kMinInstrumentedTracepointsSizeKb = 256;
+constexpr uint64_t kMaxInstrumentedTracepointsSizeKb = 8 * 1024;
+
+// These ring buffers receive few events, independently of the capture options.
+constexpr uint64_t kMmapTaskSizeKb = 64;
+constexpr uint64_t kThreadNamesSizeKb = 64;
+constexpr uint64_t kGpuTracingSizeKb = 256;
+
+uint64_t RoundUpToPowerOfTwo(uint64_t value) {
+  uint64_t power_of_two = 1;
+  while (power_of_two < value) {
+    power_of_two *= 2;
+  }
+  return power_of_two;
+}
+
+uint64_t ComputeSizeKb(double bytes_per_second, uint64_t min_size_kb, uint64_t max_size_kb) {
+  auto size_kb = static_cast<uint64_t>(bytes_per_second * kBufferedTimeS / 1024);
+  return std::clamp(RoundUpToPowerOfTwo(size_kb), min_size_kb, max_size_kb);
+}
+
+std::optional<int64_t> ReadIntegerFromFile(std::string_view filename) {
+  std::optional<std::string> content = ReadFile(filename);
+  if (!content.has_value()) {
+    return std::nullopt;
+  }
+  int64_t value;
+  if (!absl::SimpleAtoi(content.value(), &value)) {
+    ERROR("Parsing \"%s\"", std::string{filename});
+    return std::nullopt;
+  }
+  return value;
+}
+
+bool HasCapIpcLock() {
+  std::optional<std::string> status = ReadFile("/proc/self/status");
+  if (!status.has_value()) {
+    return false;
+  }
+  constexpr std::string_view kCapEffPrefix = "CapEff:";
+  std::istringstream status_stream{status.value()};
+  std::string line;
+  while (std::getline(status_stream, line)) {
+    if (line.compare(0, kCapEffPrefix.size(), kCapEffPrefix) != 0) continue;
+    const char* effective_capabilities_hex = line.c_str() + kCapEffPrefix.size();
+    char* end = nullptr;
+    uint64_t effective_capabilities = strtoull(effective_capabilities_hex, &end, 16);
+    if (end == effective_capabilities_hex) {
+      ERROR("Parsing \"%s\"", line);
+      return false;
+    }
+    return (effective_capabilities & (1ULL << CAP_IPC_LOCK)) != 0;
+  }
+  return false;
+}
+
+}  // namespace
+
+uint64_t RingBufferSizesKb::GetLockedPerCpuKb() const {
+  const std::array<uint64_t, 7> sizes_kb{mmap_task,
+                                         uprobes,
+                                         sampling,
+                                         thread_names,
+                                         context_switches_and_thread_state,
+                                         gpu_tracing,
+                                         instrumented_tracepoints};
+  const uint64_t num_ring_buffers =
+      std::count_if(sizes_kb.begin(), sizes_kb.end(), [](uint64_t size_kb) { return size_kb > 0; });
+  return GetTotalPerCpuKb() + num_ring_buffers * (GetPageSize() / 1024);
+}
+
+RingBufferSizesKb ComputeRingBufferSizesKb(const RingBufferSizingParameters& parameters) {
+  RingBufferSizesKb sizes;
+  sizes.mmap_task = kMmapTaskSizeKb;
+  sizes.thread_names = kThreadNamesSizeKb;
+
+  if (parameters.sampling_rate > 0) {
+    sizes.sampling = ComputeSizeKb(parameters.sampling_rate * parameters.sample_record_size,
+                                   kMinSamplingSizeKb, kMaxSamplingSizeKb);
+  }
+
+  if (parameters.num_instrumented_functions > 0) {
+    sizes.uprobes = ComputeSizeKb(parameters.num_instrumented_functions *
+                                      kEstimatedCallsPerSecondPerFunction *
+                                      kUprobesAndUretprobesRecordsSize,
+                                  kDefaultUprobesSizeKb, kMaxUprobesSizeKb);
+  }
+
+  if (parameters.trace_scheduler_events) {
+    double events_per_second = parameters.scheduler_events_limited_to_target
+                                   ? kEstimatedTargetSchedulerEventsPerSecond
+                                   : kEstimatedSchedulerEventsPerSecond;
+    sizes.context_switches_and_thread_state =
+        ComputeSizeKb(events_per_second * kSchedulerEventRecordSize,
+                      kMinContextSwitchesAndThreadStateSizeKb,
+                      kMaxContextSwitchesAndThreadStateSizeKb);
+  }
+
+  if (parameters.trace_gpu_driver) {
+    sizes.gpu_tracing = kGpuTracingSizeKb;
+  }
+
+  if (parameters.num_instrumented_tracepoints > 0) {
+    sizes.instrumented_tracepoints =
+        std::clamp(RoundUpToPowerOfTwo(parameters.num_instrumented_tracepoints *
+                                       kSizePerInstrumentedTracepointKb),
+                   kMinInstrumentedTracepointsSizeKb, kMaxInstrumentedTracepointsSizeKb);
+  }
+
+  if (!parameters.budget_kb.has_value() || parameters.num_cpus == 0) {
+    return sizes;
+  }
+
+  // Halve the largest ring buffers until the total fits into the budget. The ring buffers with
+  // fixed sizes are already small and are not shrunk.
+  const std::array<std::pair<uint64_t*, uint64_t>, 4> shrinkable_sizes_and_min_sizes_kb{{
+      {&sizes.sampling, kMinSamplingSizeKb},
+      {&sizes.uprobes, kMinUprobesSizeKb},
+      {&sizes.context_switches_and_thread_state, kMinContextSwitchesAndThreadStateSizeKb},
+      {&sizes.instrumented_tracepoints, kMinInstrumentedTracepointsSizeKb},
+  }};
+  while (sizes.GetLockedPerCpuKb() * parameters.num_cpus > parameters.budget_kb.value()) {
+    uint64_t* largest_size_kb = nullptr;
+    for (const auto& [size_kb, min_size_kb] : shrinkable_sizes_and_min_sizes_kb) {
+      if (*size_kb > min_size_kb &&
+          (largest_size_kb == nullptr || *size_kb > *largest_size_kb)) {
+        largest_size_kb = size_kb;
+      }
+    }
+    if (largest_size_kb == nullptr) {
+      break;
+    }
+    *largest_size_kb /= 2;
+  }
+  return sizes;
+}
+
+std::optional<uint64_t> GetPerfEventLockableMemoryKb(size_t num_cpus) {
+  // The kernel only enforces the limit for processes without CAP_IPC_LOCK, and only when
+  // perf_event_paranoid is not -1.
+  if (ReadIntegerFromFile("/proc/sys/kernel/perf_event_paranoid") == -1 || HasCapIpcLock()) {
+    return std::nullopt;
+  }
+
+  rlimit memlock_limit{};
+  if (getrlimit(RLIMIT_MEMLOCK, &memlock_limit) != 0 ||
+      memlock_limit.rlim_cur == RLIM_INFINITY) {
+    return std::nullopt;
+  }
+
+  std::optional<int64_t> perf_event_mlock_kb =
+      ReadIntegerFromFile("/proc/sys/kernel/perf_event_mlock_kb");
+  if (!perf_event_mlock_kb.has_value() || perf_event_mlock_kb.value() < 0) {
+    return std::nullopt;
+  }
+  return perf_event_mlock_kb.value() * num_cpus + memlock_limit.rlim_cur / 1024;
+}
+
+}  // namespace orbit_linux_tracing
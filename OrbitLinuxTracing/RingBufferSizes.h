@@ -0,0 +1,67 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_RING_BUFFER_SIZES_H_
+#define ORBIT_LINUX_TRACING_RING_BUFFER_SIZES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace orbit_linux_tracing {
+
+// Sizes of the perf_event_open ring buffers opened by TracerThread, of which there is one of each
+// kind per cpu. A size of 0 means that the corresponding ring buffers are not needed.
+struct RingBufferSizesKb {
+  uint64_t mmap_task = 0;
+  uint64_t uprobes = 0;
+  uint64_t sampling = 0;
+  uint64_t thread_names = 0;
+  uint64_t context_switches_and_thread_state = 0;
+  uint64_t gpu_tracing = 0;
+  uint64_t instrumented_tracepoints = 0;
+
+  [[nodiscard]] uint64_t GetTotalPerCpuKb() const {
+    return mmap_task + uprobes + sampling + thread_names + context_switches_and_thread_state +
+           gpu_tracing + instrumented_tracepoints;
+  }
+  // The memory that the kernel locks for the ring buffers of a cpu, which also includes the
+  // metadata page mapped in front of each ring buffer.
+  [[nodiscard]] uint64_t GetLockedPerCpuKb() const;
+};
+
+// What the ring buffer sizes are derived from, mostly coming from the CaptureOptions.
+struct RingBufferSizingParameters {
+  size_t num_cpus = 0;
+  // Zero if there is no sampling.
+  double sampling_rate = 0.0;
+  // The size of a single sample record, which depends on the unwinding method.
+  uint64_t sample_record_size = 0;
+  size_t num_instrumented_functions = 0;
+  bool trace_scheduler_events = false;
+  bool scheduler_events_limited_to_target = false;
+  bool trace_gpu_driver = false;
+  size_t num_instrumented_tracepoints = 0;
+  // Upper bound of the total size of all ring buffers on all cpus, if any.
+  std::optional<uint64_t> budget_kb;
+};
+
+// Each ring buffer is sized to hold the events estimated to be produced on a cpu in a fixed amount
+// of time, so that no events are lost when TracerThread::Run's thread is not scheduled for a
+// while. Sizes are rounded up to powers of two, as required by perf_event_open. If the locked
+// memory (see RingBufferSizesKb::GetLockedPerCpuKb) exceeds the budget, the largest ring buffers
+// are halved until it fits, or until they reach their minimum size.
+[[nodiscard]] RingBufferSizesKb ComputeRingBufferSizesKb(
+    const RingBufferSizingParameters& parameters);
+
+// Returns how much memory this process can lock for perf_event_open ring buffers: as many KB as
+// /proc/sys/kernel/perf_event_mlock_kb for each cpu, plus RLIMIT_MEMLOCK. Returns std::nullopt if
+// there is no limit, in particular for processes with CAP_IPC_LOCK.
+// This is an upper bound, as the perf_event_mlock_kb part is shared by all processes of the same
+// user that use perf_event_open ring buffers.
+[[nodiscard]] std::optional<uint64_t> GetPerfEventLockableMemoryKb(size_t num_cpus);
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_RING_BUFFER_SIZES_H_
@@ -0,0 +1,118 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "LinuxTracingUtils.h"
+#include "PerfEventOpen.h"
+#include "PerfEventRecords.h"
+#include "RingBufferSizes.h"
+
+namespace orbit_linux_tracing {
+
+TEST(ComputeRingBufferSizesKb, NothingToRecord) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 4;
+  RingBufferSizesKb sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.mmap_task, 64);
+  EXPECT_EQ(sizes.thread_names, 64);
+  EXPECT_EQ(sizes.uprobes, 0);
+  EXPECT_EQ(sizes.sampling, 0);
+  EXPECT_EQ(sizes.context_switches_and_thread_state, 0);
+  EXPECT_EQ(sizes.gpu_tracing, 0);
+  EXPECT_EQ(sizes.instrumented_tracepoints, 0);
+  EXPECT_EQ(sizes.GetTotalPerCpuKb(), 128);
+}
+
+TEST(ComputeRingBufferSizesKb, SamplingDependsOnRateAndUnwindingMethod) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 4;
+  parameters.sampling_rate = 1000.0;
+  parameters.sample_record_size = sizeof(perf_event_stack_sample);
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).sampling, 16 * 1024);
+
+  parameters.sampling_rate = 100.0;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).sampling, 2 * 1024);
+
+  parameters.sampling_rate = 1000.0;
+  parameters.sample_record_size =
+      sizeof(perf_event_callchain_sample_fixed) + SAMPLE_MAX_STACK * sizeof(uint64_t);
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).sampling, 256);
+
+  parameters.sampling_rate = 100'000.0;
+  parameters.sample_record_size = sizeof(perf_event_stack_sample);
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).sampling, 64 * 1024);
+}
+
+TEST(ComputeRingBufferSizesKb, UprobesDependOnNumberOfFunctions) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 4;
+  parameters.num_instrumented_functions = 1;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).uprobes, 8 * 1024);
+
+  parameters.num_instrumented_functions = 1'000;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).uprobes, 32 * 1024);
+
+  parameters.num_instrumented_functions = 100'000;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).uprobes, 32 * 1024);
+
+  // Only the budget makes the ring buffers smaller than 8 MB.
+  parameters.num_instrumented_functions = 1;
+  parameters.budget_kb = 4 * 1024;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).uprobes, 512);
+}
+
+TEST(ComputeRingBufferSizesKb, SchedulerEventsLimitedToTarget) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 4;
+  parameters.trace_scheduler_events = true;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).context_switches_and_thread_state, 2 * 1024);
+
+  parameters.scheduler_events_limited_to_target = true;
+  EXPECT_EQ(ComputeRingBufferSizesKb(parameters).context_switches_and_thread_state, 256);
+}
+
+TEST(ComputeRingBufferSizesKb, ShrinksLargestRingBuffersToFitBudget) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 64;
+  parameters.sampling_rate = 1000.0;
+  parameters.sample_record_size = sizeof(perf_event_stack_sample);
+  parameters.trace_scheduler_events = true;
+  RingBufferSizesKb sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.sampling, 16 * 1024);
+  EXPECT_EQ(sizes.context_switches_and_thread_state, 2 * 1024);
+
+  parameters.budget_kb = 512 * 1024;
+  sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.sampling, 4 * 1024);
+  EXPECT_EQ(sizes.context_switches_and_thread_state, 2 * 1024);
+  EXPECT_LE(sizes.GetLockedPerCpuKb() * parameters.num_cpus, parameters.budget_kb.value());
+
+  parameters.budget_kb = 1024;
+  sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.sampling, 256);
+  EXPECT_EQ(sizes.context_switches_and_thread_state, 64);
+  EXPECT_EQ(sizes.mmap_task, 64);
+}
+
+TEST(ComputeRingBufferSizesKb, BudgetIncludesMetadataPages) {
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = 64;
+  parameters.sampling_rate = 1000.0;
+  parameters.sample_record_size = sizeof(perf_event_stack_sample);
+  RingBufferSizesKb sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.sampling, 16 * 1024);
+  // Each of the mmap_task, thread_names and sampling ring buffers has a metadata page.
+  constexpr uint64_t kNumRingBuffers = 3;
+  EXPECT_EQ(sizes.GetLockedPerCpuKb(),
+            sizes.GetTotalPerCpuKb() + kNumRingBuffers * (GetPageSize() / 1024));
+
+  // The ring buffers themselves would fit exactly, but not with their metadata pages.
+  parameters.budget_kb = sizes.GetTotalPerCpuKb() * parameters.num_cpus;
+  sizes = ComputeRingBufferSizesKb(parameters);
+  EXPECT_EQ(sizes.sampling, 8 * 1024);
+  EXPECT_LE(sizes.GetLockedPerCpuKb() * parameters.num_cpus, parameters.budget_kb.value());
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,126 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "StackDumpUsageTracker.h"
+
+#include <absl/strings/str_format.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_linux_tracing {
+
+void StackDumpUsageHistogram::Add(uint64_t used_size) {
+  size_t bucket = 0;
+  while (bucket < kNumBuckets - 1 && used_size > (kMinBucketSize << bucket)) {
+    ++bucket;
+  }
+  ++counts[bucket];
+}
+
+std::string StackDumpUsageHistogram::ToString() const {
+  std::string result;
+  for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+    const uint64_t bucket_end = kMinBucketSize << bucket;
+    absl::StrAppendFormat(&result, "%s<=%lu%s: %lu", bucket == 0 ? "" : ", ",
+                          bucket_end < 1024 ? bucket_end : bucket_end / 1024,
+                          bucket_end < 1024 ? "B" : "KB", counts[bucket]);
+  }
+  return result;
+}
+
+uint64_t StackDumpUsageTracker::GetMaxStackSizeToCopy(pid_t tid) {
+  if (!adaptive_copy_) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  absl::MutexLock lock{&mutex_};
+  const uint64_t* max_used_size = max_used_size_by_tid_.Find(tid);
+  if (max_used_size == nullptr) {
+    return std::numeric_limits<uint64_t>::max();
+  }
+  const uint64_t size_to_copy = std::max(2 * *max_used_size, kCopyGranularity);
+  return (size_to_copy + kCopyGranularity - 1) / kCopyGranularity * kCopyGranularity;
+}
+
+void StackDumpUsageTracker::OnStackSampleUnwound(pid_t tid, uint64_t dumped_size,
+                                                 uint64_t copied_size,
+                                                 const StackDumpUsage& usage) {
+  absl::MutexLock lock{&mutex_};
+  ++sample_count_;
+  total_dumped_size_ += dumped_size;
+  total_copied_size_ += copied_size;
+  used_size_per_sample_.Add(usage.used_size);
+
+  uint64_t used_size = usage.used_size;
+  if (usage.read_beyond_stack_dump) {
+    if (copied_size < dumped_size) {
+      ++samples_beyond_copy_count_;
+      // The sample needed more than was copied, but it is unknown how much more.
+      used_size = std::max(used_size, copied_size);
+    } else {
+      ++samples_beyond_stack_dump_count_;
+    }
+  }
+
+  uint64_t* max_used_size = max_used_size_by_tid_.Find(tid);
+  if (max_used_size == nullptr) {
+    max_used_size_by_tid_.InsertOrAssign(tid, used_size);
+  } else {
+    *max_used_size = std::max(*max_used_size, used_size);
+  }
+}
+
+uint64_t StackDumpUsageTracker::GetSampleCount() const {
+  absl::MutexLock lock{&mutex_};
+  return sample_count_;
+}
+
+uint64_t StackDumpUsageTracker::GetSamplesBeyondStackDumpCount() const {
+  absl::MutexLock lock{&mutex_};
+  return samples_beyond_stack_dump_count_;
+}
+
+uint64_t StackDumpUsageTracker::GetSamplesBeyondCopyCount() const {
+  absl::MutexLock lock{&mutex_};
+  return samples_beyond_copy_count_;
+}
+
+StackDumpUsageHistogram StackDumpUsageTracker::GetUsedSizePerSampleHistogram() const {
+  absl::MutexLock lock{&mutex_};
+  return used_size_per_sample_;
+}
+
+StackDumpUsageHistogram StackDumpUsageTracker::GetMaxUsedSizePerThreadHistogram() const {
+  absl::MutexLock lock{&mutex_};
+  StackDumpUsageHistogram histogram;
+  max_used_size_by_tid_.ForEach(
+      [&histogram](pid_t /*tid*/, uint64_t max_used_size) { histogram.Add(max_used_size); });
+  return histogram;
+}
+
+void StackDumpUsageTracker::PrintSummary() const {
+  const StackDumpUsageHistogram used_size_per_sample = GetUsedSizePerSampleHistogram();
+  const StackDumpUsageHistogram max_used_size_per_thread = GetMaxUsedSizePerThreadHistogram();
+  absl::MutexLock lock{&mutex_};
+  if (sample_count_ == 0) {
+    return;
+  }
+  LOG("Stack dumps of %lu samples: %lu MB dumped, %lu MB copied%s", sample_count_,
+      total_dumped_size_ / 1024 / 1024, total_copied_size_ / 1024 / 1024,
+      adaptive_copy_ ? " (adaptive)" : "");
+  LOG("  Stack used by unwinding per sample: %s", used_size_per_sample.ToString());
+  LOG("  Stack used by unwinding per thread (max): %s", max_used_size_per_thread.ToString());
+  if (samples_beyond_stack_dump_count_ > 0) {
+    LOG("  %lu samples (%.1f%%) needed more stack than the stack dump size",
+        samples_beyond_stack_dump_count_, 100.0 * samples_beyond_stack_dump_count_ / sample_count_);
+  }
+  if (samples_beyond_copy_count_ > 0) {
+    LOG("  %lu samples (%.1f%%) needed more stack than was copied adaptively",
+        samples_beyond_copy_count_, 100.0 * samples_beyond_copy_count_ / sample_count_);
+  }
+}
+
+}  // namespace orbit_linux_tracing
@@ -0,0 +1,80 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_STACK_DUMP_USAGE_TRACKER_H_
+#define ORBIT_LINUX_TRACING_STACK_DUMP_USAGE_TRACKER_H_
+
+#include <absl/base/thread_annotations.h>
+#include <absl/synchronization/mutex.h>
+#include <sys/types.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "LibunwindstackUnwinder.h"
+#include "TidHashMap.h"
+
+namespace orbit_linux_tracing {
+
+// Number of used stack sizes falling into each bucket. Bucket i counts the sizes in
+// (kMinBucketSize << (i - 1), kMinBucketSize << i], the first one also including 0.
+struct StackDumpUsageHistogram {
+  static constexpr uint64_t kMinBucketSize = 512;
+  // The last bucket ends at 64 KB, which includes the maximum stack dump size.
+  static constexpr size_t kNumBuckets = 8;
+
+  std::array<uint64_t, kNumBuckets> counts{};
+
+  void Add(uint64_t used_size);
+  [[nodiscard]] std::string ToString() const;
+};
+
+// Keeps track of how much of the stack dumps of the samples unwound with DWARF information
+// LibunwindstackUnwinder::Unwind actually reads, for each thread, so that the distribution can be
+// reported at the end of the capture and the stack dump size can be tuned.
+// In adaptive mode, it also decides how much of each stack dump to copy out of the ring buffers,
+// which is what moves through PerfEventQueue: twice the most any sample of the same thread used
+// so far, rounded up to a page, and the whole dump for the first sample of a thread. When unwinding
+// then reads beyond the part that was copied, the sample is counted (UprobesUnwindingVisitor also
+// reports it as an unwinding error) and the next samples of that thread copy at least twice as
+// much.
+// GetMaxStackSizeToCopy and OnStackSampleUnwound can be called from different threads.
+class StackDumpUsageTracker {
+ public:
+  explicit StackDumpUsageTracker(bool adaptive_copy) : adaptive_copy_{adaptive_copy} {}
+
+  [[nodiscard]] uint64_t GetMaxStackSizeToCopy(pid_t tid);
+
+  void OnStackSampleUnwound(pid_t tid, uint64_t dumped_size, uint64_t copied_size,
+                            const StackDumpUsage& usage);
+
+  [[nodiscard]] uint64_t GetSampleCount() const;
+  // Samples whose unwinding read beyond the whole stack dump: the stack dump size is too small.
+  [[nodiscard]] uint64_t GetSamplesBeyondStackDumpCount() const;
+  // Samples whose unwinding read beyond the part of the stack dump copied in adaptive mode.
+  [[nodiscard]] uint64_t GetSamplesBeyondCopyCount() const;
+  [[nodiscard]] StackDumpUsageHistogram GetUsedSizePerSampleHistogram() const;
+  [[nodiscard]] StackDumpUsageHistogram GetMaxUsedSizePerThreadHistogram() const;
+
+  void PrintSummary() const;
+
+ private:
+  static constexpr uint64_t kCopyGranularity = 4096;
+
+  const bool adaptive_copy_;
+
+  mutable absl::Mutex mutex_;
+  TidHashMap<uint64_t> max_used_size_by_tid_ ABSL_GUARDED_BY(mutex_);
+  StackDumpUsageHistogram used_size_per_sample_ ABSL_GUARDED_BY(mutex_);
+  uint64_t sample_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t samples_beyond_stack_dump_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t samples_beyond_copy_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t total_dumped_size_ ABSL_GUARDED_BY(mutex_) = 0;
+  uint64_t total_copied_size_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_STACK_DUMP_USAGE_TRACKER_H_
@@ -0,0 +1,100 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+
+#include "LibunwindstackUnwinder.h"
+#include "StackDumpUsageTracker.h"
+
+namespace orbit_linux_tracing {
+
+namespace {
+
+constexpr uint64_t kDumpedSize = 65000;
+constexpr uint64_t kCopyEverything = std::numeric_limits<uint64_t>::max();
+
+StackDumpUsage MakeUsage(uint64_t used_size, bool read_beyond_stack_dump = false) {
+  StackDumpUsage usage;
+  usage.used_size = used_size;
+  usage.read_beyond_stack_dump = read_beyond_stack_dump;
+  return usage;
+}
+
+}  // namespace
+
+TEST(StackDumpUsageHistogram, Add) {
+  StackDumpUsageHistogram histogram;
+  histogram.Add(0);
+  histogram.Add(512);
+  histogram.Add(513);
+  histogram.Add(3000);
+  histogram.Add(65000);
+  histogram.Add(1'000'000);
+  EXPECT_EQ(histogram.counts[0], 2);
+  EXPECT_EQ(histogram.counts[1], 1);
+  EXPECT_EQ(histogram.counts[3], 1);
+  EXPECT_EQ(histogram.counts[7], 2);
+  EXPECT_EQ(histogram.ToString(),
+            "<=512B: 2, <=1KB: 1, <=2KB: 0, <=4KB: 1, <=8KB: 0, <=16KB: 0, <=32KB: 0, <=64KB: 2");
+}
+
+TEST(StackDumpUsageTracker, CopiesEverythingWhenNotAdaptive) {
+  StackDumpUsageTracker tracker{false};
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), kCopyEverything);
+  tracker.OnStackSampleUnwound(42, kDumpedSize, kDumpedSize, MakeUsage(1000));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), kCopyEverything);
+
+  tracker.OnStackSampleUnwound(43, kDumpedSize, kDumpedSize, MakeUsage(kDumpedSize, true));
+  EXPECT_EQ(tracker.GetSampleCount(), 2);
+  EXPECT_EQ(tracker.GetSamplesBeyondStackDumpCount(), 1);
+  EXPECT_EQ(tracker.GetSamplesBeyondCopyCount(), 0);
+
+  StackDumpUsageHistogram per_sample = tracker.GetUsedSizePerSampleHistogram();
+  EXPECT_EQ(per_sample.counts[1], 1);
+  EXPECT_EQ(per_sample.counts[7], 1);
+}
+
+TEST(StackDumpUsageTracker, AdaptiveCopyFollowsMaxUsedSizePerThread) {
+  StackDumpUsageTracker tracker{true};
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), kCopyEverything);
+
+  tracker.OnStackSampleUnwound(42, kDumpedSize, kDumpedSize, MakeUsage(1000));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), 4096);
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(43), kCopyEverything);
+
+  tracker.OnStackSampleUnwound(42, kDumpedSize, 4096, MakeUsage(3000));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), 8192);
+
+  // A shallower stack doesn't reduce the size to copy.
+  tracker.OnStackSampleUnwound(42, kDumpedSize, 8192, MakeUsage(100));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), 8192);
+
+  tracker.OnStackSampleUnwound(43, kDumpedSize, kDumpedSize, MakeUsage(20'000));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(43), 40'960);
+
+  StackDumpUsageHistogram per_thread = tracker.GetMaxUsedSizePerThreadHistogram();
+  EXPECT_EQ(per_thread.counts[3], 1);
+  EXPECT_EQ(per_thread.counts[6], 1);
+  EXPECT_EQ(tracker.GetSamplesBeyondCopyCount(), 0);
+}
+
+TEST(StackDumpUsageTracker, AdaptiveCopyGrowsWhenUnwindingReadsBeyondIt) {
+  StackDumpUsageTracker tracker{true};
+  tracker.OnStackSampleUnwound(42, kDumpedSize, kDumpedSize, MakeUsage(1000));
+  ASSERT_EQ(tracker.GetMaxStackSizeToCopy(42), 4096);
+
+  tracker.OnStackSampleUnwound(42, kDumpedSize, 4096, MakeUsage(4096, true));
+  EXPECT_EQ(tracker.GetSamplesBeyondCopyCount(), 1);
+  EXPECT_EQ(tracker.GetSamplesBeyondStackDumpCount(), 0);
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), 8192);
+
+  tracker.OnStackSampleUnwound(42, kDumpedSize, 8192, MakeUsage(8192, true));
+  EXPECT_EQ(tracker.GetMaxStackSizeToCopy(42), 16'384);
+  EXPECT_EQ(tracker.GetSamplesBeyondCopyCount(), 2);
+}
+
+}  // namespace orbit_linux_tracing
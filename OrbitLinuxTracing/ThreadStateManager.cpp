@@ -19,58 +19,56 @@ using orbit_grpc_protos::ThreadStateSlice;
 
 void ThreadStateManager::OnInitialState(uint64_t timestamp_ns, pid_t tid,
                                         ThreadStateSlice::ThreadState state) {
-  CHECK(!tid_open_states_.contains(tid));
-  tid_open_states_.emplace(tid, OpenState{state, timestamp_ns});
+  CHECK(!tid_open_states_.Contains(tid));
+  tid_open_states_.InsertOrAssign(tid, OpenState{state, timestamp_ns});
 }
 
 void ThreadStateManager::OnNewTask(uint64_t timestamp_ns, pid_t tid) {
   static constexpr ThreadStateSlice::ThreadState kNewState = ThreadStateSlice::kRunnable;
 
-  if (auto open_state_it = tid_open_states_.find(tid);
-      open_state_it != tid_open_states_.end() &&
-      timestamp_ns >= open_state_it->second.begin_timestamp_ns) {
+  OpenState* open_state = tid_open_states_.Find(tid);
+  if (open_state != nullptr && timestamp_ns >= open_state->begin_timestamp_ns) {
     ERROR("Processed task:task_newtask but thread %d was already known", tid);
     return;
   }
-  tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+  tid_open_states_.InsertOrAssign(tid, OpenState{kNewState, timestamp_ns});
 }
 
 std::optional<ThreadStateSlice> ThreadStateManager::OnSchedWakeup(uint64_t timestamp_ns,
                                                                   pid_t tid) {
   static constexpr ThreadStateSlice::ThreadState kNewState = ThreadStateSlice::kRunnable;
 
-  auto open_state_it = tid_open_states_.find(tid);
-  if (open_state_it == tid_open_states_.end()) {
+  OpenState* open_state = tid_open_states_.Find(tid);
+  if (open_state == nullptr) {
     ERROR("Processed sched:sched_wakeup but previous state of thread %d is unknown", tid);
-    tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+    tid_open_states_.InsertOrAssign(tid, OpenState{kNewState, timestamp_ns});
     return std::nullopt;
   }
 
-  const OpenState& open_state = open_state_it->second;
-  if (timestamp_ns < open_state.begin_timestamp_ns) {
+  if (timestamp_ns < open_state->begin_timestamp_ns) {
     // As noted above, overwrite the thread state retrieved at the beginning.
-    tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+    *open_state = OpenState{kNewState, timestamp_ns};
     return std::nullopt;
   }
 
-  if (open_state.state == kNewState || open_state.state == ThreadStateSlice::kRunning) {
+  if (open_state->state == kNewState || open_state->state == ThreadStateSlice::kRunning) {
     // It seems to be somewhat common for a thread to receive a wakeup
     // while already in runnable or running state: disregard the state change.
     return std::nullopt;
   }
 
-  if (open_state.state == ThreadStateSlice::kZombie ||
-      open_state.state == ThreadStateSlice::kDead) {
+  if (open_state->state == ThreadStateSlice::kZombie ||
+      open_state->state == ThreadStateSlice::kDead) {
     ERROR("Processed sched:sched_wakeup for thread %d but unexpected previous state %s", tid,
-          ThreadStateSlice::ThreadState_Name(open_state.state));
+          ThreadStateSlice::ThreadState_Name(open_state->state));
   }
 
   ThreadStateSlice slice;
   slice.set_tid(tid);
-  slice.set_thread_state(open_state.state);
-  slice.set_begin_timestamp_ns(open_state.begin_timestamp_ns);
+  slice.set_thread_state(open_state->state);
+  slice.set_begin_timestamp_ns(open_state->begin_timestamp_ns);
   slice.set_end_timestamp_ns(timestamp_ns);
-  tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+  *open_state = OpenState{kNewState, timestamp_ns};
   return slice;
 }
 
@@ -78,56 +76,54 @@ std::optional<ThreadStateSlice> ThreadStateManager::OnSchedSwitchIn(uint64_t tim
                                                                     pid_t tid) {
   static constexpr ThreadStateSlice::ThreadState kNewState = ThreadStateSlice::kRunning;
 
-  auto open_state_it = tid_open_states_.find(tid);
-  if (open_state_it == tid_open_states_.end()) {
+  OpenState* open_state = tid_open_states_.Find(tid);
+  if (open_state == nullptr) {
     ERROR("Processed sched:sched_switch(in) but previous state of thread %d is unknown", tid);
-    tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+    tid_open_states_.InsertOrAssign(tid, OpenState{kNewState, timestamp_ns});
     return std::nullopt;
   }
 
-  const OpenState& open_state = open_state_it->second;
-  if (timestamp_ns < open_state.begin_timestamp_ns) {
-    tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+  if (timestamp_ns < open_state->begin_timestamp_ns) {
+    *open_state = OpenState{kNewState, timestamp_ns};
     return std::nullopt;
   }
 
-  if (open_state.state == kNewState) {
+  if (open_state->state == kNewState) {
     // No state change: do nothing and don't overwrite the previous begin timestamp.
     return std::nullopt;
   }
 
-  // Don't print an error even if open_state.state != ThreadStateSlice::kRunnable: it seems to be
+  // Don't print an error even if open_state->state != ThreadStateSlice::kRunnable: it seems to be
   // sometimes possible for a thread to go from a non-runnable state directly to running, skipping
   // the sched:sched_wakeup event.
 
   ThreadStateSlice slice;
   slice.set_tid(tid);
-  slice.set_thread_state(open_state.state);
-  slice.set_begin_timestamp_ns(open_state.begin_timestamp_ns);
+  slice.set_thread_state(open_state->state);
+  slice.set_begin_timestamp_ns(open_state->begin_timestamp_ns);
   slice.set_end_timestamp_ns(timestamp_ns);
-  tid_open_states_.insert_or_assign(tid, OpenState{kNewState, timestamp_ns});
+  *open_state = OpenState{kNewState, timestamp_ns};
   return slice;
 }
 
 std::optional<ThreadStateSlice> ThreadStateManager::OnSchedSwitchOut(
     uint64_t timestamp_ns, pid_t tid, ThreadStateSlice::ThreadState new_state) {
-  auto open_state_it = tid_open_states_.find(tid);
-  if (open_state_it == tid_open_states_.end()) {
+  OpenState* open_state = tid_open_states_.Find(tid);
+  if (open_state == nullptr) {
     ERROR("Processed sched:sched_switch(out) but previous state of thread %d is unknown", tid);
-    tid_open_states_.insert_or_assign(tid, OpenState{new_state, timestamp_ns});
+    tid_open_states_.InsertOrAssign(tid, OpenState{new_state, timestamp_ns});
     return std::nullopt;
   }
 
-  const OpenState& open_state = open_state_it->second;
-  if (timestamp_ns < open_state.begin_timestamp_ns) {
-    tid_open_states_.insert_or_assign(tid, OpenState{new_state, timestamp_ns});
+  if (timestamp_ns < open_state->begin_timestamp_ns) {
+    *open_state = OpenState{new_state, timestamp_ns};
     return std::nullopt;
   }
 
   // As we are switching out of a CPU, if the previous state was kRunnable, assume it was kRunning.
   // This is because when we retrieve the initial thread states we have no way to distinguish
   // between kRunnable and kRunning. After all, for the OS they are the same state.
-  ThreadStateSlice::ThreadState adjusted_open_state_state = open_state.state;
+  ThreadStateSlice::ThreadState adjusted_open_state_state = open_state->state;
   if (adjusted_open_state_state == ThreadStateSlice::kRunnable) {
     adjusted_open_state_state = ThreadStateSlice::kRunning;
   }
@@ -144,25 +140,26 @@ std::optional<ThreadStateSlice> ThreadStateManager::OnSchedSwitchOut(
   ThreadStateSlice slice;
   slice.set_tid(tid);
   slice.set_thread_state(adjusted_open_state_state);
-  slice.set_begin_timestamp_ns(open_state.begin_timestamp_ns);
+  slice.set_begin_timestamp_ns(open_state->begin_timestamp_ns);
   slice.set_end_timestamp_ns(timestamp_ns);
 
   // Note: If the thread exits but the new_state is kZombie instead of kDead,
   // the switch to kDead will never be reported.
-  tid_open_states_.insert_or_assign(tid, OpenState{new_state, timestamp_ns});
+  *open_state = OpenState{new_state, timestamp_ns};
   return slice;
 }
 
 std::vector<ThreadStateSlice> ThreadStateManager::OnCaptureFinished(uint64_t timestamp_ns) {
   std::vector<ThreadStateSlice> slices;
-  for (const auto& [tid, open_state] : tid_open_states_) {
+  slices.reserve(tid_open_states_.size());
+  tid_open_states_.ForEach([&slices, timestamp_ns](pid_t tid, const OpenState& open_state) {
     ThreadStateSlice slice;
     slice.set_tid(tid);
     slice.set_thread_state(open_state.state);
     slice.set_begin_timestamp_ns(open_state.begin_timestamp_ns);
     slice.set_end_timestamp_ns(timestamp_ns);
     slices.emplace_back(std::move(slice));
-  }
+  });
   return slices;
 }
 
@@ -5,8 +5,14 @@
 #ifndef ORBIT_LINUX_TRACING_THREAD_STATE_MANAGER_H_
 #define ORBIT_LINUX_TRACING_THREAD_STATE_MANAGER_H_
 
+#include <sys/types.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
 #include "OrbitBase/Logging.h"
-#include "absl/container/flat_hash_map.h"
+#include "TidHashMap.h"
 #include "capture.pb.h"
 
 namespace orbit_linux_tracing {
@@ -54,13 +60,14 @@ class ThreadStateManager {
 
  private:
   struct OpenState {
+    OpenState() = default;
     OpenState(orbit_grpc_protos::ThreadStateSlice::ThreadState state, uint64_t begin_timestamp_ns)
         : state{state}, begin_timestamp_ns{begin_timestamp_ns} {}
-    orbit_grpc_protos::ThreadStateSlice::ThreadState state;
-    uint64_t begin_timestamp_ns;
+    orbit_grpc_protos::ThreadStateSlice::ThreadState state{};
+    uint64_t begin_timestamp_ns = 0;
   };
 
-  absl::flat_hash_map<pid_t, OpenState> tid_open_states_;
+  TidHashMap<OpenState> tid_open_states_;
 };
 
 }  // namespace orbit_linux_tracing
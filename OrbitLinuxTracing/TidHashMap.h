@@ -0,0 +1,123 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_LINUX_TRACING_TID_HASH_MAP_H_
+#define ORBIT_LINUX_TRACING_TID_HASH_MAP_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_linux_tracing {
+
+// A map from thread ids to values, used for the per-thread state that is looked up for every
+// sched:sched_switch and sched:sched_wakeup event. Entries are stored inline in a single array and
+// found with linear probing, using Fibonacci hashing of the tid. As entries are never removed
+// during a capture, there is no need for tombstones. The capacity is preallocated and doubled
+// whenever the map becomes half full, which keeps probe sequences short.
+// Value needs to be default-constructible.
+template <typename Value>
+class TidHashMap {
+ public:
+  explicit TidHashMap(size_t min_capacity = kDefaultMinCapacity) {
+    size_t capacity = kMinCapacity;
+    while (capacity < min_capacity) {
+      capacity *= 2;
+    }
+    Rehash(capacity);
+  }
+
+  [[nodiscard]] Value* Find(pid_t tid) {
+    for (size_t index = IndexOf(tid);; index = (index + 1) & (slots_.size() - 1)) {
+      Slot& slot = slots_[index];
+      if (slot.tid == kEmptyTid) return nullptr;
+      if (slot.tid == tid) return &slot.value;
+    }
+  }
+
+  [[nodiscard]] const Value* Find(pid_t tid) const {
+    return const_cast<TidHashMap*>(this)->Find(tid);
+  }
+
+  [[nodiscard]] bool Contains(pid_t tid) const { return Find(tid) != nullptr; }
+
+  // Returns true if tid was not in the map yet, false if its value was overwritten.
+  bool InsertOrAssign(pid_t tid, Value value) {
+    CHECK(tid != kEmptyTid);
+    if (2 * (size_ + 1) > slots_.size()) {
+      Rehash(2 * slots_.size());
+    }
+    for (size_t index = IndexOf(tid);; index = (index + 1) & (slots_.size() - 1)) {
+      Slot& slot = slots_[index];
+      if (slot.tid == kEmptyTid) {
+        slot.tid = tid;
+        slot.value = std::move(value);
+        ++size_;
+        return true;
+      }
+      if (slot.tid == tid) {
+        slot.value = std::move(value);
+        return false;
+      }
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] size_t capacity() const { return slots_.size(); }
+
+  // Calls function(tid, value) for every entry, in no particular order.
+  template <typename Function>
+  void ForEach(Function&& function) const {
+    for (const Slot& slot : slots_) {
+      if (slot.tid != kEmptyTid) {
+        function(slot.tid, slot.value);
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kMinCapacity = 16;
+  static constexpr size_t kDefaultMinCapacity = 1024;
+  // Thread ids are never negative, but -1 is commonly used for "unknown": don't use it here.
+  static constexpr pid_t kEmptyTid = std::numeric_limits<pid_t>::min();
+
+  struct Slot {
+    pid_t tid = kEmptyTid;
+    Value value{};
+  };
+
+  [[nodiscard]] size_t IndexOf(pid_t tid) const {
+    // 2^64 divided by the golden ratio.
+    constexpr uint64_t kFibonacciMultiplier = 0x9E3779B97F4A7C15;
+    return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(tid)) *
+                                kFibonacciMultiplier) >>
+                               shift_);
+  }
+
+  void Rehash(size_t capacity) {
+    std::vector<Slot> old_slots = std::exchange(slots_, std::vector<Slot>(capacity));
+    shift_ = 64 - __builtin_ctzl(capacity);
+    for (Slot& old_slot : old_slots) {
+      if (old_slot.tid == kEmptyTid) continue;
+      size_t index = IndexOf(old_slot.tid);
+      while (slots_[index].tid != kEmptyTid) {
+        index = (index + 1) & (capacity - 1);
+      }
+      slots_[index] = std::move(old_slot);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+  uint32_t shift_ = 64;
+};
+
+}  // namespace orbit_linux_tracing
+
+#endif  // ORBIT_LINUX_TRACING_TID_HASH_MAP_H_
@@ -0,0 +1,75 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sys/types.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "TidHashMap.h"
+
+namespace orbit_linux_tracing {
+
+TEST(TidHashMap, InsertOrAssignAndFind) {
+  TidHashMap<uint64_t> map;
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_EQ(map.Find(42), nullptr);
+
+  EXPECT_TRUE(map.InsertOrAssign(42, 1));
+  EXPECT_TRUE(map.InsertOrAssign(0, 2));
+  EXPECT_TRUE(map.InsertOrAssign(-1, 3));
+  EXPECT_EQ(map.size(), 3);
+
+  ASSERT_NE(map.Find(42), nullptr);
+  EXPECT_EQ(*map.Find(42), 1);
+  ASSERT_NE(map.Find(0), nullptr);
+  EXPECT_EQ(*map.Find(0), 2);
+  ASSERT_NE(map.Find(-1), nullptr);
+  EXPECT_EQ(*map.Find(-1), 3);
+  EXPECT_FALSE(map.Contains(43));
+
+  EXPECT_FALSE(map.InsertOrAssign(42, 4));
+  EXPECT_EQ(map.size(), 3);
+  EXPECT_EQ(*map.Find(42), 4);
+
+  *map.Find(0) = 5;
+  EXPECT_EQ(*map.Find(0), 5);
+}
+
+TEST(TidHashMap, GrowsAndKeepsAllEntries) {
+  TidHashMap<pid_t> map{16};
+  EXPECT_EQ(map.capacity(), 16);
+
+  constexpr pid_t kNumTids = 10'000;
+  for (pid_t tid = 0; tid < kNumTids; ++tid) {
+    // Also insert tids that are far apart.
+    EXPECT_TRUE(map.InsertOrAssign(tid * 4096, tid));
+  }
+  EXPECT_EQ(map.size(), kNumTids);
+  EXPECT_GE(map.capacity(), 2 * kNumTids);
+
+  for (pid_t tid = 0; tid < kNumTids; ++tid) {
+    const pid_t* value = map.Find(tid * 4096);
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*value, tid);
+  }
+  EXPECT_EQ(map.Find(1), nullptr);
+}
+
+TEST(TidHashMap, ForEach) {
+  TidHashMap<int> map;
+  map.InsertOrAssign(1, 10);
+  map.InsertOrAssign(2, 20);
+  map.InsertOrAssign(3, 30);
+
+  std::vector<std::pair<pid_t, int>> entries;
+  map.ForEach([&entries](pid_t tid, int value) { entries.emplace_back(tid, value); });
+  EXPECT_THAT(entries, ::testing::UnorderedElementsAre(std::make_pair(1, 10), std::make_pair(2, 20),
+                                                       std::make_pair(3, 30)));
+}
+
+}  // namespace orbit_linux_tracing
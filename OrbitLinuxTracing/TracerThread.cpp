@@ -9,10 +9,15 @@
 #include <absl/hash/hash.h>
 #include <absl/strings/str_format.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stddef.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -28,6 +33,7 @@
 #include "PerfEventOpen.h"
 #include "PerfEventReaders.h"
 #include "PerfEventRecords.h"
+#include "ProcScanner.h"
 #include "tracepoint.pb.h"
 
 namespace orbit_linux_tracing {
@@ -41,8 +47,15 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
     : trace_context_switches_{capture_options.trace_context_switches()},
       target_pid_{capture_options.pid()},
       unwinding_method_{capture_options.unwinding_method()},
+      adaptive_stack_dump_copy_{capture_options.adaptive_stack_dump_copy()},
+      // Unwinding with DWARF information doesn't skip callers.
+      repair_leaf_frames_{capture_options.repair_leaf_frames() &&
+                          (unwinding_method_ == CaptureOptions::kFramePointers ||
+                           unwinding_method_ == CaptureOptions::kHybrid)},
       trace_thread_state_{capture_options.trace_thread_state()},
-      trace_gpu_driver_{capture_options.trace_gpu_driver()} {
+      limit_scheduler_events_to_target_{capture_options.limit_scheduler_events_to_target()},
+      trace_gpu_driver_{capture_options.trace_gpu_driver()},
+      max_ring_buffers_memory_mb_{capture_options.max_ring_buffers_memory_mb()} {
   if (unwinding_method_ != CaptureOptions::kUndefined) {
     std::optional<uint64_t> sampling_period_ns =
         ComputeSamplingPeriodNs(capture_options.sampling_rate());
@@ -53,6 +66,31 @@ TracerThread::TracerThread(const CaptureOptions& capture_options)
     sampling_period_ns_ = 0;
   }
 
+  // The kernel requires the stack dump size to be a multiple of 8.
+  if (capture_options.stack_dump_size() == 0) {
+    // In hybrid mode, only the frames that the callchain gets wrong need to be unwound with DWARF
+    // information, and these are normally close to the top of the stack.
+    if (unwinding_method_ == CaptureOptions::kHybrid) {
+      stack_dump_size_ = SAMPLE_STACK_USER_SIZE_HYBRID;
+    } else if (unwinding_method_ == CaptureOptions::kFramePointers) {
+      stack_dump_size_ = SAMPLE_STACK_USER_SIZE_LEAF_FRAMES;
+    } else {
+      stack_dump_size_ = SAMPLE_STACK_USER_SIZE;
+    }
+  } else {
+    stack_dump_size_ = std::clamp<uint32_t>(capture_options.stack_dump_size() / 8 * 8, 8,
+                                            SAMPLE_STACK_USER_SIZE);
+    if (stack_dump_size_ != capture_options.stack_dump_size()) {
+      ERROR("Invalid stack dump size %u, using %u instead", capture_options.stack_dump_size(),
+            stack_dump_size_);
+    }
+  }
+
+  if (unwinding_method_ == CaptureOptions::kHybrid) {
+    modules_without_frame_pointers_.insert(capture_options.modules_without_frame_pointers().begin(),
+                                           capture_options.modules_without_frame_pointers().end());
+  }
+
   instrumented_functions_.reserve(capture_options.instrumented_functions_size());
 
   for (const CaptureOptions::InstrumentedFunction& instrumented_function :
@@ -91,6 +129,8 @@ void CloseFileDescriptors(const absl::flat_hash_map<int32_t, int>& fds_per_cpu)
     close(pair.second);
   }
 }
+
+double NsToMs(uint64_t ns) { return static_cast<double>(ns) / 1'000'000.0; }
 }  // namespace
 
 void TracerThread::InitUprobesEventVisitor() {
@@ -99,6 +139,18 @@ void TracerThread::InitUprobesEventVisitor() {
   uprobes_unwinding_visitor_->SetListener(listener_);
   uprobes_unwinding_visitor_->SetUnwindErrorsAndDiscardedSamplesCounters(
       &stats_.unwind_error_count, &stats_.discarded_samples_in_uretprobes_count);
+  if (unwinding_method_ == CaptureOptions::kDwarf) {
+    stack_dump_usage_tracker_ = std::make_unique<StackDumpUsageTracker>(adaptive_stack_dump_copy_);
+    uprobes_unwinding_visitor_->SetStackDumpUsageTracker(stack_dump_usage_tracker_.get());
+  } else if (unwinding_method_ == CaptureOptions::kHybrid) {
+    uprobes_unwinding_visitor_->SetModulesWithoutFramePointers(modules_without_frame_pointers_);
+    uprobes_unwinding_visitor_->SetHybridUnwindingCounters(
+        &stats_.samples_unwound_with_dwarf_count, &stats_.truncated_hybrid_callstack_count);
+  }
+  if (repair_leaf_frames_) {
+    uprobes_unwinding_visitor_->EnableLeafFrameRepair(target_pid_,
+                                                      &stats_.repaired_leaf_frame_count);
+  }
   event_processor_.AddVisitor(uprobes_unwinding_visitor_.get());
 }
 
@@ -160,52 +212,58 @@ void TracerThread::AddUretprobesFileDescriptors(
   }
 }
 
-bool TracerThread::OpenUserSpaceProbes(const std::vector<int32_t>& cpus) {
+bool TracerThread::OpenUserSpaceProbes(const std::vector<int32_t>& cpus,
+                                       size_t num_functions_to_open) {
   ORBIT_SCOPE_FUNCTION;
-  bool uprobes_event_open_errors = false;
 
-  absl::flat_hash_map<int32_t, std::vector<int>> uprobes_uretpobres_fds_per_cpu;
-  for (const auto& function : instrumented_functions_) {
+  // Opening uprobes and uretprobes takes one perf_event_open call per function per cpu, which adds
+  // up to seconds with thousands of functions on many cores: open them from several threads.
+  // The file descriptors are opened disabled and are only enabled all together in Run.
+  struct UserSpaceProbesFds {
+    bool success = false;
     absl::flat_hash_map<int32_t, int> uprobes_fds_per_cpu;
     absl::flat_hash_map<int32_t, int> uretprobes_fds_per_cpu;
-    uint64_t address = function.VirtualAddress();
-
-    if (manual_instrumentation_config_.IsTimerStartAddress(address)) {
-      // Only open uprobes for a "timer start" manual instrumentation function.
-      if (!OpenUprobes(function, cpus, &uprobes_fds_per_cpu)) {
-        CloseFileDescriptors(uprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
-      }
-    } else if (manual_instrumentation_config_.IsTimerStopAddress(address)) {
-      // Only open uretprobes for a "timer stop" manual instrumentation
-      // function.
-      if (!OpenUretprobes(function, cpus, &uretprobes_fds_per_cpu)) {
-        CloseFileDescriptors(uretprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
-      }
-    } else {
-      // Open both uprobes and uretprobes for regular functions.
-      bool success = OpenUprobes(function, cpus, &uprobes_fds_per_cpu) &&
-                     OpenUretprobes(function, cpus, &uretprobes_fds_per_cpu);
-      if (!success) {
-        CloseFileDescriptors(uprobes_fds_per_cpu);
-        CloseFileDescriptors(uretprobes_fds_per_cpu);
-        uprobes_event_open_errors = true;
-        continue;
-      }
+  };
+  std::vector<UserSpaceProbesFds> fds_per_function(num_functions_to_open);
+  ParallelFor(num_functions_to_open, USER_SPACE_PROBES_OPENING_MAX_THREADS,
+              [this, &cpus, &fds_per_function](size_t function_index) {
+                const Function& function = instrumented_functions_[function_index];
+                UserSpaceProbesFds& fds = fds_per_function[function_index];
+                uint64_t address = function.VirtualAddress();
+                if (manual_instrumentation_config_.IsTimerStartAddress(address)) {
+                  // Only open uprobes for a "timer start" manual instrumentation function.
+                  fds.success = OpenUprobes(function, cpus, &fds.uprobes_fds_per_cpu);
+                } else if (manual_instrumentation_config_.IsTimerStopAddress(address)) {
+                  // Only open uretprobes for a "timer stop" manual instrumentation function.
+                  fds.success = OpenUretprobes(function, cpus, &fds.uretprobes_fds_per_cpu);
+                } else {
+                  // Open both uprobes and uretprobes for regular functions.
+                  fds.success = OpenUprobes(function, cpus, &fds.uprobes_fds_per_cpu) &&
+                                OpenUretprobes(function, cpus, &fds.uretprobes_fds_per_cpu);
+                }
+              });
+
+  bool uprobes_event_open_errors = num_functions_to_open < instrumented_functions_.size();
+  absl::flat_hash_map<int32_t, std::vector<int>> uprobes_uretpobres_fds_per_cpu;
+  for (size_t function_index = 0; function_index < num_functions_to_open; ++function_index) {
+    const Function& function = instrumented_functions_[function_index];
+    const UserSpaceProbesFds& fds = fds_per_function[function_index];
+    if (!fds.success) {
+      CloseFileDescriptors(fds.uprobes_fds_per_cpu);
+      CloseFileDescriptors(fds.uretprobes_fds_per_cpu);
+      uprobes_event_open_errors = true;
+      continue;
     }
 
     // Uretprobe need to be enabled before uprobes as we support temporarily
     // not having a uprobe associated with a uretprobe but not the opposite.
-    AddUretprobesFileDescriptors(uretprobes_fds_per_cpu, function);
-    AddUprobesFileDescriptors(uprobes_fds_per_cpu, function);
+    AddUretprobesFileDescriptors(fds.uretprobes_fds_per_cpu, function);
+    AddUprobesFileDescriptors(fds.uprobes_fds_per_cpu, function);
 
-    for (const auto& [cpu, fd] : uretprobes_fds_per_cpu) {
+    for (const auto& [cpu, fd] : fds.uretprobes_fds_per_cpu) {
       uprobes_uretpobres_fds_per_cpu[cpu].push_back(fd);
     }
-    for (const auto& [cpu, fd] : uprobes_fds_per_cpu) {
+    for (const auto& [cpu, fd] : fds.uprobes_fds_per_cpu) {
       uprobes_uretpobres_fds_per_cpu[cpu].push_back(fd);
     }
   }
@@ -215,22 +273,78 @@ bool TracerThread::OpenUserSpaceProbes(const std::vector<int32_t>& cpus) {
   return !uprobes_event_open_errors;
 }
 
+size_t TracerThread::RaiseMaxOpenFilesForPerfEvents(size_t num_user_space_probes_cpus) {
+  // A "timer start" or "timer stop" function only needs a uprobe or a uretprobe per cpu, all other
+  // functions need both.
+  const uint64_t num_cpus = num_user_space_probes_cpus;
+  auto get_num_fds_of_function = [this, num_cpus](const Function& function) -> uint64_t {
+    uint64_t address = function.VirtualAddress();
+    if (manual_instrumentation_config_.IsTimerStartAddress(address) ||
+        manual_instrumentation_config_.IsTimerStopAddress(address)) {
+      return num_cpus;
+    }
+    return 2 * num_cpus;
+  };
+
+  // Keep the limit the service started with for the rest of the service, and leave room for the
+  // file descriptors of all the other perf_event_open events, which are opened on all cores. The
+  // initial limit is used as the base, as the limit raised for a previous capture would otherwise
+  // keep growing with every capture.
+  static const uint64_t initial_soft_limit = GetMaxOpenFilesSoftLimit();
+  const uint64_t hard_limit = GetMaxOpenFilesHardLimit();
+  if (initial_soft_limit == 0 || hard_limit == 0) {
+    // The limits couldn't be read: just try to open everything.
+    return instrumented_functions_.size();
+  }
+  const uint64_t num_other_fds =
+      initial_soft_limit + (OTHER_PERF_EVENT_FDS_PER_CPU + instrumented_tracepoints_.size()) *
+                               static_cast<uint64_t>(GetNumCores());
+
+  uint64_t num_fds = num_other_fds;
+  size_t num_functions = 0;
+  for (const Function& function : instrumented_functions_) {
+    const uint64_t num_fds_of_function = get_num_fds_of_function(function);
+    if (num_fds + num_fds_of_function > hard_limit) {
+      ERROR(
+          "Only instrumenting %u of %u functions, as the limit of %u open files doesn't allow to "
+          "open uprobes for more on %u cpus",
+          num_functions, instrumented_functions_.size(), hard_limit, num_cpus);
+      break;
+    }
+    num_fds += num_fds_of_function;
+    ++num_functions;
+  }
+
+  // Only raise the limit as much as needed, rather than up to the hard limit.
+  if (num_fds > GetMaxOpenFilesSoftLimit()) {
+    SetMaxOpenFilesSoftLimit(std::min(num_fds, hard_limit));
+  }
+  return num_functions;
+}
+
 void TracerThread::OpenUserSpaceProbesRingBuffers(
     const absl::flat_hash_map<int32_t, std::vector<int>>& uprobes_uretpobres_fds_per_cpu) {
   ORBIT_SCOPE_FUNCTION;
+  std::vector<const std::vector<int>*> fds_to_redirect;
   for (const auto& [/*int32_t*/ cpu, /*std::vector<int>*/ fds] : uprobes_uretpobres_fds_per_cpu) {
     if (fds.empty()) continue;
 
     // Create a single ring buffer per cpu.
     int ring_buffer_fd = fds[0];
     std::string buffer_name = absl::StrFormat("uprobes_uretprobes_%u", cpu);
-    ring_buffers_.emplace_back(ring_buffer_fd, UPROBES_RING_BUFFER_SIZE_KB, buffer_name);
-
-    // Redirect subsequent fds to the cpu specific ring buffer created above.
-    for (size_t i = 1; i < fds.size(); ++i) {
-      perf_event_redirect(fds[i], ring_buffer_fd);
-    }
+    ring_buffers_.emplace_back(ring_buffer_fd, ring_buffer_sizes_kb_.uprobes, buffer_name);
+    fds_to_redirect.push_back(&fds);
   }
+
+  // Redirect subsequent fds to the cpu specific ring buffer created above. As this is again one
+  // ioctl per function per cpu, the cpus are distributed over several threads.
+  ParallelFor(fds_to_redirect.size(), USER_SPACE_PROBES_OPENING_MAX_THREADS,
+              [&fds_to_redirect](size_t index) {
+                const std::vector<int>& fds = *fds_to_redirect[index];
+                for (size_t i = 1; i < fds.size(); ++i) {
+                  perf_event_redirect(fds[i], fds[0]);
+                }
+              });
 }
 
 bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
@@ -240,7 +354,7 @@ bool TracerThread::OpenMmapTask(const std::vector<int32_t>& cpus) {
   for (int32_t cpu : cpus) {
     int mmap_task_fd = mmap_task_event_open(-1, cpu);
     std::string buffer_name = absl::StrFormat("mmap_task_%d", cpu);
-    PerfEventRingBuffer mmap_task_ring_buffer{mmap_task_fd, MMAP_TASK_RING_BUFFER_SIZE_KB,
+    PerfEventRingBuffer mmap_task_ring_buffer{mmap_task_fd, ring_buffer_sizes_kb_.mmap_task,
                                               buffer_name};
     if (mmap_task_ring_buffer.IsOpen()) {
       mmap_task_tracing_fds.push_back(mmap_task_fd);
@@ -269,10 +383,19 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
     int sampling_fd;
     switch (unwinding_method_) {
       case CaptureOptions::kFramePointers:
-        sampling_fd = callchain_sample_event_open(sampling_period_ns_, -1, cpu);
+        if (repair_leaf_frames_) {
+          sampling_fd =
+              callchain_and_stack_sample_event_open(sampling_period_ns_, -1, cpu, stack_dump_size_);
+        } else {
+          sampling_fd = callchain_sample_event_open(sampling_period_ns_, -1, cpu);
+        }
         break;
       case CaptureOptions::kDwarf:
-        sampling_fd = stack_sample_event_open(sampling_period_ns_, -1, cpu);
+        sampling_fd = stack_sample_event_open(sampling_period_ns_, -1, cpu, stack_dump_size_);
+        break;
+      case CaptureOptions::kHybrid:
+        sampling_fd =
+            callchain_and_stack_sample_event_open(sampling_period_ns_, -1, cpu, stack_dump_size_);
         break;
       case CaptureOptions::kUndefined:
       default:
@@ -282,7 +405,7 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
     }
 
     std::string buffer_name = absl::StrFormat("sampling_%d", cpu);
-    PerfEventRingBuffer sampling_ring_buffer{sampling_fd, SAMPLING_RING_BUFFER_SIZE_KB,
+    PerfEventRingBuffer sampling_ring_buffer{sampling_fd, ring_buffer_sizes_kb_.sampling,
                                              buffer_name};
     if (sampling_ring_buffer.IsOpen()) {
       sampling_tracing_fds.push_back(sampling_fd);
@@ -299,7 +422,8 @@ bool TracerThread::OpenSampling(const std::vector<int32_t>& cpus) {
     uint64_t stream_id = perf_event_get_id(fd);
     if (unwinding_method_ == CaptureOptions::kDwarf) {
       stack_sampling_ids_.insert(stream_id);
-    } else if (unwinding_method_ == CaptureOptions::kFramePointers) {
+    } else if (unwinding_method_ == CaptureOptions::kFramePointers ||
+               unwinding_method_ == CaptureOptions::kHybrid) {
       callchain_sampling_ids_.insert(stream_id);
     }
   }
@@ -337,14 +461,18 @@ namespace {
 
 struct TracepointToOpen {
   TracepointToOpen(const char* tracepoint_category, const char* tracepoint_name,
-                   absl::flat_hash_set<uint64_t>* tracepoint_stream_ids)
+                   absl::flat_hash_set<uint64_t>* tracepoint_stream_ids,
+                   const char* tracepoint_filter = nullptr)
       : tracepoint_category{tracepoint_category},
         tracepoint_name{tracepoint_name},
-        tracepoint_stream_ids{tracepoint_stream_ids} {}
+        tracepoint_stream_ids{tracepoint_stream_ids},
+        tracepoint_filter{tracepoint_filter} {}
 
   const char* const tracepoint_category;
   const char* const tracepoint_name;
   absl::flat_hash_set<uint64_t>* const tracepoint_stream_ids;
+  // If not null, the filter installed on the tracepoint with PERF_EVENT_IOC_SET_FILTER.
+  const char* const tracepoint_filter;
 };
 
 }  // namespace
@@ -362,6 +490,7 @@ static bool OpenFileDescriptorsAndRingBuffersForAllTracepoints(
        ++tracepoint_index) {
     const char* tracepoint_category = tracepoints_to_open[tracepoint_index].tracepoint_category;
     const char* tracepoint_name = tracepoints_to_open[tracepoint_index].tracepoint_name;
+    const char* tracepoint_filter = tracepoints_to_open[tracepoint_index].tracepoint_filter;
     for (int32_t cpu : cpus) {
       int tracepoint_fd = tracepoint_event_open(tracepoint_category, tracepoint_name, -1, cpu);
       if (tracepoint_fd == -1) {
@@ -369,6 +498,11 @@ static bool OpenFileDescriptorsAndRingBuffersForAllTracepoints(
         tracepoint_event_open_errors = true;
         break;
       }
+      // The filter only saves bandwidth, as events are also filtered in user space: don't fail if
+      // it can't be installed. perf_event_set_filter already logs the error.
+      if (tracepoint_filter != nullptr) {
+        perf_event_set_filter(tracepoint_fd, tracepoint_filter);
+      }
       index_to_tracepoint_fds_per_cpu[tracepoint_index].emplace(cpu, tracepoint_fd);
     }
   }
@@ -415,7 +549,7 @@ bool TracerThread::OpenThreadNameTracepoints(const std::vector<int32_t>& cpus) {
   absl::flat_hash_map<int32_t, int> thread_name_tracepoint_ring_buffer_fds_per_cpu;
   return OpenFileDescriptorsAndRingBuffersForAllTracepoints(
       {{"task", "task_newtask", &task_newtask_ids_}, {"task", "task_rename", &task_rename_ids_}},
-      cpus, &tracing_fds_, THREAD_NAMES_RING_BUFFER_SIZE_KB,
+      cpus, &tracing_fds_, ring_buffer_sizes_kb_.thread_names,
       &thread_name_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
 }
 
@@ -430,15 +564,43 @@ void TracerThread::InitContextSwitchAndThreadStateVisitor() {
   event_processor_.AddVisitor(context_switch_and_thread_state_visitor_.get());
 }
 
+// When limit_scheduler_events_to_target_ is set, the sched:sched_switch and sched:sched_wakeup
+// tracepoints are filtered in the kernel to the threads of the target process. As a filter can't
+// be changed once installed, it explicitly lists the threads that exist now, and lets through all
+// the threads with a higher tid than the last one allocated, as these are the threads created
+// later, in particular with task:task_newtask by the target. Only when tids wrap around are new
+// threads of the target missed: ProcessSampleEvent counts them.
 bool TracerThread::OpenContextSwitchAndThreadStateTracepoints(const std::vector<int32_t>& cpus) {
   ORBIT_SCOPE_FUNCTION;
+  std::string sched_switch_filter;
+  std::string sched_wakeup_filter;
+  if (limit_scheduler_events_to_target_) {
+    // Read the last allocated tid before listing the threads, so that no thread is missed.
+    std::optional<pid_t> last_allocated_tid = GetLastAllocatedPid();
+    if (last_allocated_tid.has_value()) {
+      std::vector<pid_t> target_tids = GetTidsOfProcess(target_pid_);
+      sched_switch_filter =
+          BuildTidTracepointFilter({"prev_pid", "next_pid"}, target_tids, *last_allocated_tid);
+      sched_wakeup_filter = BuildTidTracepointFilter({"pid"}, target_tids, *last_allocated_tid);
+      scheduler_events_filter_last_allocated_tid_ = last_allocated_tid;
+    } else {
+      ERROR("Cannot filter scheduler events in the kernel: recording them for all processes");
+    }
+  }
+  const char* sched_switch_filter_or_null =
+      sched_switch_filter.empty() ? nullptr : sched_switch_filter.c_str();
+  const char* sched_wakeup_filter_or_null =
+      sched_wakeup_filter.empty() ? nullptr : sched_wakeup_filter.c_str();
+
   std::vector<TracepointToOpen> tracepoints_to_open;
   if (trace_thread_state_ || trace_context_switches_) {
-    tracepoints_to_open.emplace_back("sched", "sched_switch", &sched_switch_ids_);
+    tracepoints_to_open.emplace_back("sched", "sched_switch", &sched_switch_ids_,
+                                     sched_switch_filter_or_null);
   }
   if (trace_thread_state_) {
     // We also need task:task_newtask, but this is already opened by OpenThreadNameTracepoints.
-    tracepoints_to_open.emplace_back("sched", "sched_wakeup", &sched_wakeup_ids_);
+    tracepoints_to_open.emplace_back("sched", "sched_wakeup", &sched_wakeup_ids_,
+                                     sched_wakeup_filter_or_null);
   }
   if (tracepoints_to_open.empty()) {
     return true;
@@ -447,7 +609,7 @@ bool TracerThread::OpenContextSwitchAndThreadStateTracepoints(const std::vector<
   absl::flat_hash_map<int32_t, int> thread_state_tracepoint_ring_buffer_fds_per_cpu;
   return OpenFileDescriptorsAndRingBuffersForAllTracepoints(
       tracepoints_to_open, cpus, &tracing_fds_,
-      CONTEXT_SWITCHES_AND_THREAD_STATE_RING_BUFFER_SIZE_KB,
+      ring_buffer_sizes_kb_.context_switches_and_thread_state,
       &thread_state_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
 }
 
@@ -477,8 +639,8 @@ bool TracerThread::OpenGpuTracepoints(const std::vector<int32_t>& cpus) {
       {{"amdgpu", "amdgpu_cs_ioctl", &amdgpu_cs_ioctl_ids_},
        {"amdgpu", "amdgpu_sched_run_job", &amdgpu_sched_run_job_ids_},
        {"dma_fence", "dma_fence_signaled", &dma_fence_signaled_ids_}},
-      cpus, &tracing_fds_, GPU_TRACING_RING_BUFFER_SIZE_KB, &gpu_tracepoint_ring_buffer_fds_per_cpu,
-      &ring_buffers_);
+      cpus, &tracing_fds_, ring_buffer_sizes_kb_.gpu_tracing,
+      &gpu_tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
 }
 
 bool TracerThread::OpenInstrumentedTracepoints(const std::vector<int32_t>& cpus) {
@@ -490,7 +652,7 @@ bool TracerThread::OpenInstrumentedTracepoints(const std::vector<int32_t>& cpus)
     absl::flat_hash_set<uint64_t> stream_ids;
     tracepoint_event_open_errors |= !OpenFileDescriptorsAndRingBuffersForAllTracepoints(
         {{selected_tracepoint.category().c_str(), selected_tracepoint.name().c_str(), &stream_ids}},
-        cpus, &tracing_fds_, INSTRUMENTED_TRACEPOINTS_RING_BUFFER_SIZE_KB,
+        cpus, &tracing_fds_, ring_buffer_sizes_kb_.instrumented_tracepoints,
         &tracepoint_ring_buffer_fds_per_cpu, &ring_buffers_);
 
     for (const auto& stream_id : stream_ids) {
@@ -523,19 +685,33 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
     cpuset_cpus = all_cpus;
   }
 
-  // As we open two perf_event_open file descriptors (uprobe and uretprobe) per
-  // cpu per instrumented function, increase the maximum number of open files.
-  SetMaxOpenFilesSoftLimit(GetMaxOpenFilesHardLimit());
-
   event_processor_.SetDiscardedOutOfOrderCounter(&stats_.discarded_out_of_order_count);
 
+  ComputeRingBufferSizes(all_cpus.size());
+
+  // The time taken by each phase of the capture start is logged, as with many instrumented
+  // functions or many cores, opening all the file descriptors can take a long time.
+  const uint64_t capture_start_begin_ns = MonotonicTimestampNs();
+  uint64_t phase_begin_ns = capture_start_begin_ns;
+  auto end_phase = [&phase_begin_ns]() {
+    const uint64_t phase_end_ns = MonotonicTimestampNs();
+    const uint64_t phase_duration_ns = phase_end_ns - phase_begin_ns;
+    phase_begin_ns = phase_end_ns;
+    return phase_duration_ns;
+  };
+
+  // Raise the limit on open files before opening any file descriptor: with many cores, even the
+  // per-cpu events without any instrumented function can exceed the default soft limit.
+  const size_t num_functions_to_open = RaiseMaxOpenFilesForPerfEvents(cpuset_cpus.size());
+
   bool perf_event_open_errors = false;
 
   perf_event_open_errors |= !OpenMmapTask(all_cpus);
+  const uint64_t mmap_task_duration_ns = end_phase();
 
   bool uprobes_event_open_errors = false;
   if (!instrumented_functions_.empty()) {
-    uprobes_event_open_errors = !OpenUserSpaceProbes(cpuset_cpus);
+    uprobes_event_open_errors = !OpenUserSpaceProbes(cpuset_cpus, num_functions_to_open);
     perf_event_open_errors |= uprobes_event_open_errors;
   }
 
@@ -544,12 +720,16 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
   // to enable the file descriptor) causes a new [uprobes] map entry, and we
   // want to catch it.
   InitUprobesEventVisitor();
+  const uint64_t uprobes_duration_ns = end_phase();
 
   if (unwinding_method_ == CaptureOptions::kFramePointers ||
-      unwinding_method_ == CaptureOptions::kDwarf) {
+      unwinding_method_ == CaptureOptions::kDwarf ||
+      unwinding_method_ == CaptureOptions::kHybrid) {
     perf_event_open_errors |= !OpenSampling(cpuset_cpus);
   }
+  const uint64_t sampling_duration_ns = end_phase();
 
+  ORBIT_START("Open tracepoints");
   perf_event_open_errors |= !OpenThreadNameTracepoints(all_cpus);
 
   if (trace_context_switches_ || trace_thread_state_) {
@@ -574,6 +754,8 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
   }
 
   perf_event_open_errors |= !OpenInstrumentedTracepoints(all_cpus);
+  ORBIT_STOP();
+  const uint64_t tracepoints_duration_ns = end_phase();
 
   if (uprobes_event_open_errors) {
     LOG("There were errors with perf_event_open, including for uprobes: did "
@@ -583,26 +765,27 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
         "or to set /proc/sys/kernel/perf_event_paranoid to -1?");
   }
 
-  // Start recording events.
-  for (int fd : tracing_fds_) {
-    perf_event_enable(fd);
+  // Start recording events. All file descriptors were opened disabled, so that they are enabled
+  // here in a single pass, as close as possible to each other.
+  {
+    ORBIT_SCOPE("Enable perf_event_open file descriptors");
+    for (int fd : tracing_fds_) {
+      perf_event_enable(fd);
+    }
   }
+  const uint64_t enable_duration_ns = end_phase();
 
   effective_capture_start_timestamp_ns_ = MonotonicTimestampNs();
+  LOG("Opened and enabled %u perf_event_open file descriptors in %.3f ms: mmap/task %.3f ms, "
+      "uprobes and uretprobes (%u functions) %.3f ms, sampling %.3f ms, tracepoints %.3f ms, "
+      "enabling %.3f ms",
+      tracing_fds_.size(), NsToMs(effective_capture_start_timestamp_ns_ - capture_start_begin_ns),
+      NsToMs(mmap_task_duration_ns), instrumented_functions_.size(), NsToMs(uprobes_duration_ns),
+      NsToMs(sampling_duration_ns), NsToMs(tracepoints_duration_ns), NsToMs(enable_duration_ns));
 
-  // Get the initial thread names and notify the listener_.
-  RetrieveThreadNamesSystemWide();
-
-  if (trace_context_switches_ || trace_thread_state_) {
-    // Get the initial association of tids to pids and
-    // pass it to context_switch_and_thread_state_visitor_.
-    RetrieveTidToPidAssociationSystemWide();
-  }
-
-  if (trace_thread_state_) {
-    // Get the initial thread states and pass them to context_switch_and_thread_state_visitor_.
-    RetrieveThreadStatesOfTarget();
-  }
+  // Get the initial thread names, association of tids to pids and thread states with a single
+  // pass over /proc.
+  RetrieveInitialThreadsFromProc();
 
   stats_.Reset();
 
@@ -697,10 +880,12 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
         }
       }
     }
+
+    HandOffDeferredEvents();
   }
 
   // Finish processing all deferred events.
-  stop_deferred_thread_ = true;
+  StopProcessingDeferredEvents();
   deferred_events_thread.join();
   event_processor_.ProcessAllEvents();
 
@@ -713,6 +898,11 @@ void TracerThread::Run(const std::shared_ptr<std::atomic<bool>>& exit_requested)
     perf_event_disable(fd);
   }
 
+  PrintRingBufferPeakFillLevels();
+  if (stack_dump_usage_tracker_ != nullptr) {
+    stack_dump_usage_tracker_->PrintSummary();
+  }
+
   // Close the ring buffers.
   {
     ORBIT_SCOPE("ring_buffers_.clear()");
@@ -842,8 +1032,7 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
 
   } else if (is_stack_sample) {
     pid_t pid = ReadSampleRecordPid(ring_buffer);
-    constexpr size_t size_of_stack_sample = sizeof(perf_event_stack_sample);
-    if (header.size != size_of_stack_sample) {
+    if (header.size != GetStackSampleRecordSize(stack_dump_size_)) {
       // Skip stack samples that have an unexpected size. These normally have
       // abi == PERF_SAMPLE_REGS_ABI_NONE and no registers, and size == 0 and
       // no stack. Usually, these samples have pid == tid == 0, but that's not
@@ -861,7 +1050,9 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
     // e.g., with header.misc == PERF_RECORD_MISC_KERNEL,
     // in general they seem to produce valid callstacks.
 
-    auto event = ConsumeStackSamplePerfEvent(ring_buffer, header);
+    uint64_t max_stack_size_to_copy =
+        stack_dump_usage_tracker_->GetMaxStackSizeToCopy(ReadSampleRecordTid(ring_buffer));
+    auto event = ConsumeStackSamplePerfEvent(ring_buffer, header, max_stack_size_to_copy);
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
     ++stats_.sample_count;
@@ -885,6 +1076,12 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
     thread_name.set_name(event->GetComm());
     thread_name.set_timestamp_ns(event->GetTimestamp());
     listener_->OnThreadName(std::move(thread_name));
+    if (scheduler_events_filter_last_allocated_tid_.has_value() &&
+        event->GetCreatorPid() == target_pid_ && (event->GetCloneFlags() & CLONE_THREAD) != 0 &&
+        event->GetTid() <= scheduler_events_filter_last_allocated_tid_.value()) {
+      // Tids have wrapped around: this new thread of the target isn't let through by the filters.
+      ++stats_.new_target_threads_not_in_scheduler_events_filter_count;
+    }
     if (trace_thread_state_) {
       // task:task_newtask is also used by ThreadStateVisitor for thread states.
       event->SetOriginFileDescriptor(fd);
@@ -907,6 +1104,7 @@ void TracerThread::ProcessSampleEvent(const perf_event_header& header,
     auto event = ConsumeTracepointPerfEvent<SchedWakeupPerfEvent>(ring_buffer, header);
     event->SetOriginFileDescriptor(fd);
     DeferEvent(std::move(event));
+    ++stats_.sched_wakeup_count;
 
   } else if (is_amdgpu_cs_ioctl_event) {
     // TODO: Consider deferring GPU events.
@@ -960,77 +1158,120 @@ void TracerThread::ProcessLostEvent(const perf_event_header& header,
 }
 
 void TracerThread::DeferEvent(std::unique_ptr<PerfEvent> event) {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  deferred_events_.emplace_back(std::move(event));
+  deferred_events_to_hand_off_.emplace_back(std::move(event));
+}
+
+void TracerThread::HandOffDeferredEvents() {
+  if (deferred_events_to_hand_off_.empty()) {
+    return;
+  }
+  ORBIT_SCOPE_FUNCTION;
+  deferred_events_queue_.enqueue_bulk(std::make_move_iterator(deferred_events_to_hand_off_.begin()),
+                                      deferred_events_to_hand_off_.size());
+  deferred_events_to_hand_off_.clear();
+
+  // Only wake up ProcessDeferredEvents once per batch of events.
+  absl::MutexLock lock(&deferred_events_mutex_);
+  deferred_events_available_ = true;
 }
 
-std::vector<std::unique_ptr<PerfEvent>> TracerThread::ConsumeDeferredEvents() {
-  std::lock_guard<std::mutex> lock(deferred_events_mutex_);
-  std::vector<std::unique_ptr<PerfEvent>> events(std::move(deferred_events_));
-  deferred_events_.clear();
-  return events;
+void TracerThread::StopProcessingDeferredEvents() {
+  HandOffDeferredEvents();
+  absl::MutexLock lock(&deferred_events_mutex_);
+  stop_deferred_thread_ = true;
 }
 
 void TracerThread::ProcessDeferredEvents() {
   pthread_setname_np(pthread_self(), "Proc.Def.Events");
+  std::vector<std::unique_ptr<PerfEvent>> events;
+  events.reserve(DEFERRED_EVENTS_DEQUEUE_BATCH_SIZE);
   bool should_exit = false;
   while (!should_exit) {
+    {
+      // Only event_processor_'s own events can become ready to be processed without a
+      // notification, so sleep indefinitely if it is empty.
+      std::optional<uint64_t> next_processing_timestamp_ns =
+          event_processor_.GetNextProcessingTimestampNs();
+      absl::MutexLock lock(&deferred_events_mutex_);
+      auto new_events_or_stop = +[](TracerThread* tracer_thread) {
+        tracer_thread->deferred_events_mutex_.AssertHeld();
+        return tracer_thread->deferred_events_available_ || tracer_thread->stop_deferred_thread_;
+      };
+      if (!next_processing_timestamp_ns.has_value()) {
+        ORBIT_SCOPE("Wait");
+        deferred_events_mutex_.Await(absl::Condition(new_events_or_stop, this));
+      } else if (uint64_t current_timestamp_ns = MonotonicTimestampNs();
+                 next_processing_timestamp_ns.value() > current_timestamp_ns) {
+        ORBIT_SCOPE("Wait");
+        deferred_events_mutex_.AwaitWithTimeout(
+            absl::Condition(new_events_or_stop, this),
+            absl::Nanoseconds(next_processing_timestamp_ns.value() - current_timestamp_ns));
+      }
+      // When "should_exit" becomes true, we know that all deferred events have already been
+      // handed off. This last iteration will consume all remaining events.
+      should_exit = stop_deferred_thread_;
+      deferred_events_available_ = false;
+    }
+
     ORBIT_SCOPE("ProcessDeferredEvents iteration");
-    // When "should_exit" becomes true, we know that we have stopped generating
-    // deferred events. The last iteration will consume all remaining events.
-    should_exit = stop_deferred_thread_;
-    std::vector<std::unique_ptr<PerfEvent>> events = ConsumeDeferredEvents();
-    if (events.empty()) {
-      // TODO: use a wait/notify mechanism instead of check/sleep.
-      ORBIT_SCOPE("Sleep");
-      usleep(IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US);
-    } else {
-      {
-        ORBIT_SCOPE("AddEvents");
+    {
+      ORBIT_SCOPE("AddEvents");
+      while (deferred_events_queue_.try_dequeue_bulk(std::back_inserter(events),
+                                                     DEFERRED_EVENTS_DEQUEUE_BATCH_SIZE) > 0) {
         for (auto& event : events) {
           event_processor_.AddEvent(std::move(event));
         }
-      }
-      {
-        ORBIT_SCOPE("ProcessOldEvents");
-        event_processor_.ProcessOldEvents();
+        events.clear();
       }
     }
+    {
+      ORBIT_SCOPE("ProcessOldEvents");
+      event_processor_.ProcessOldEvents();
+    }
   }
 }
 
-void TracerThread::RetrieveThreadNamesSystemWide() {
+void TracerThread::RetrieveInitialThreadsFromProc() {
+  ORBIT_SCOPE_FUNCTION;
   uint64_t timestamp_ns = MonotonicTimestampNs();
-  for (pid_t tid : GetAllTids()) {
-    std::string name = orbit_base::GetThreadName(tid);
-    if (name.empty()) {
+  std::optional<pid_t> pid_to_read_thread_states_of;
+  if (trace_thread_state_) {
+    pid_to_read_thread_states_of = target_pid_;
+  }
+  std::vector<ProcThread> threads =
+      ScanProcThreads(pid_to_read_thread_states_of, PROC_SCANNING_MAX_THREADS);
+  LOG("Found %u threads in /proc in %.3f ms", threads.size(),
+      NsToMs(MonotonicTimestampNs() - timestamp_ns));
+
+  // Notify listener_ of the initial thread names.
+  for (ProcThread& thread : threads) {
+    if (thread.name.empty()) {
       continue;
     }
-
     ThreadName thread_name;
-    thread_name.set_tid(tid);
-    thread_name.set_name(std::move(name));
+    thread_name.set_tid(thread.tid);
+    thread_name.set_name(std::move(thread.name));
     thread_name.set_timestamp_ns(timestamp_ns);
     listener_->OnThreadName(std::move(thread_name));
   }
-}
 
-void TracerThread::RetrieveTidToPidAssociationSystemWide() {
-  for (pid_t pid : GetAllPids()) {
-    for (pid_t tid : GetTidsOfProcess(pid)) {
-      context_switch_and_thread_state_visitor_->ProcessInitialTidToPidAssociation(tid, pid);
+  if (trace_context_switches_ || trace_thread_state_) {
+    // Pass the initial association of tids to pids to context_switch_and_thread_state_visitor_.
+    for (const ProcThread& thread : threads) {
+      context_switch_and_thread_state_visitor_->ProcessInitialTidToPidAssociation(thread.tid,
+                                                                                  thread.pid);
     }
   }
-}
 
-void TracerThread::RetrieveThreadStatesOfTarget() {
-  for (pid_t tid : GetTidsOfProcess(target_pid_)) {
-    uint64_t timestamp_ns = MonotonicTimestampNs();
-    std::optional<char> state = GetThreadState(tid);
-    if (!state.has_value()) {
-      continue;
+  if (trace_thread_state_) {
+    // Pass the initial thread states of the target to context_switch_and_thread_state_visitor_.
+    for (const ProcThread& thread : threads) {
+      if (thread.pid != target_pid_ || !thread.state.has_value()) {
+        continue;
+      }
+      context_switch_and_thread_state_visitor_->ProcessInitialState(
+          thread.state_timestamp_ns, thread.tid, thread.state.value());
     }
-    context_switch_and_thread_state_visitor_->ProcessInitialState(timestamp_ns, tid, state.value());
   }
 }
 
@@ -1054,15 +1295,98 @@ void TracerThread::Reset() {
   ids_to_tracepoint_info_.clear();
 
   effective_capture_start_timestamp_ns_ = 0;
+  scheduler_events_filter_last_allocated_tid_.reset();
 
-  stop_deferred_thread_ = false;
-  deferred_events_.clear();
+  deferred_events_to_hand_off_.clear();
+  {
+    absl::MutexLock lock(&deferred_events_mutex_);
+    deferred_events_available_ = false;
+    stop_deferred_thread_ = false;
+  }
   uprobes_unwinding_visitor_.reset();
+  stack_dump_usage_tracker_.reset();
   context_switch_and_thread_state_visitor_.reset();
   event_processor_.ClearVisitors();
   gpu_event_processor_.reset();
 }
 
+void TracerThread::ComputeRingBufferSizes(size_t num_cpus) {
+  ORBIT_SCOPE_FUNCTION;
+  RingBufferSizingParameters parameters;
+  parameters.num_cpus = num_cpus;
+  if (unwinding_method_ == CaptureOptions::kDwarf) {
+    parameters.sample_record_size = GetStackSampleRecordSize(stack_dump_size_);
+  } else if (unwinding_method_ == CaptureOptions::kFramePointers ||
+             unwinding_method_ == CaptureOptions::kHybrid) {
+    parameters.sample_record_size =
+        sizeof(perf_event_callchain_sample_fixed) + SAMPLE_MAX_STACK * sizeof(uint64_t);
+    if (unwinding_method_ == CaptureOptions::kHybrid || repair_leaf_frames_) {
+      // The registers, the stack dump, and its size before and after it.
+      parameters.sample_record_size +=
+          sizeof(perf_event_sample_regs_user_all) + 2 * sizeof(uint64_t) + stack_dump_size_;
+    }
+  }
+  if (parameters.sample_record_size > 0) {
+    parameters.sampling_rate = static_cast<double>(NS_PER_SECOND) / sampling_period_ns_;
+  }
+  parameters.num_instrumented_functions = instrumented_functions_.size();
+  parameters.trace_scheduler_events = trace_context_switches_ || trace_thread_state_;
+  parameters.scheduler_events_limited_to_target = limit_scheduler_events_to_target_;
+  parameters.trace_gpu_driver = trace_gpu_driver_;
+  parameters.num_instrumented_tracepoints = instrumented_tracepoints_.size();
+
+  // The ring buffers are locked in memory, so mmap fails if they exceed the memory that can be
+  // locked. The budget requested in the CaptureOptions can only be lower.
+  parameters.budget_kb = GetPerfEventLockableMemoryKb(num_cpus);
+  if (max_ring_buffers_memory_mb_ > 0) {
+    parameters.budget_kb =
+        std::min(parameters.budget_kb.value_or(std::numeric_limits<uint64_t>::max()),
+                 max_ring_buffers_memory_mb_ * 1024);
+  }
+
+  ring_buffer_sizes_kb_ = ComputeRingBufferSizesKb(parameters);
+  const uint64_t total_kb = ring_buffer_sizes_kb_.GetLockedPerCpuKb() * num_cpus;
+  LOG("Ring buffer sizes per cpu: mmap/task %lu KB, uprobes and uretprobes %lu KB, "
+      "sampling %lu KB, thread names %lu KB, context switches and thread state %lu KB, "
+      "GPU tracing %lu KB, instrumented tracepoints %lu KB; at most %lu MB in total (budget: %s)",
+      ring_buffer_sizes_kb_.mmap_task, ring_buffer_sizes_kb_.uprobes,
+      ring_buffer_sizes_kb_.sampling, ring_buffer_sizes_kb_.thread_names,
+      ring_buffer_sizes_kb_.context_switches_and_thread_state, ring_buffer_sizes_kb_.gpu_tracing,
+      ring_buffer_sizes_kb_.instrumented_tracepoints, total_kb / 1024,
+      parameters.budget_kb.has_value() ? absl::StrFormat("%lu MB", *parameters.budget_kb / 1024)
+                                       : "none");
+  if (parameters.budget_kb.has_value() && total_kb > parameters.budget_kb.value()) {
+    ERROR("Ring buffers exceed the memory budget even with their minimum sizes");
+  }
+}
+
+void TracerThread::PrintRingBufferPeakFillLevels() {
+  // Ring buffers are named after their kind and their cpu: report them by kind.
+  struct PeakFillLevels {
+    uint64_t size = 0;
+    size_t num_ring_buffers = 0;
+    double max_percent = 0.0;
+    double sum_percent = 0.0;
+  };
+  std::map<std::string, PeakFillLevels> peak_fill_levels_by_kind;
+  for (const PerfEventRingBuffer& ring_buffer : ring_buffers_) {
+    if (!ring_buffer.IsOpen()) continue;
+    const std::string& name = ring_buffer.GetName();
+    PeakFillLevels& levels = peak_fill_levels_by_kind[name.substr(0, name.find_last_of('_'))];
+    const double percent = 100.0 * ring_buffer.GetPeakFillBytes() / ring_buffer.GetSize();
+    levels.size = ring_buffer.GetSize();
+    ++levels.num_ring_buffers;
+    levels.max_percent = std::max(levels.max_percent, percent);
+    levels.sum_percent += percent;
+  }
+
+  LOG("Ring buffer peak fill levels:");
+  for (const auto& [kind, levels] : peak_fill_levels_by_kind) {
+    LOG("  %s: %u x %lu KB, max %.1f%%, average %.1f%%", kind, levels.num_ring_buffers,
+        levels.size / 1024, levels.max_percent, levels.sum_percent / levels.num_ring_buffers);
+  }
+}
+
 void TracerThread::PrintStatsIfTimerElapsed() {
   ORBIT_SCOPE_FUNCTION;
   uint64_t timestamp_ns = MonotonicTimestampNs();
@@ -1072,8 +1396,16 @@ void TracerThread::PrintStatsIfTimerElapsed() {
     CHECK(actual_window_s > 0.0);
 
     LOG("Events per second (and total) last %.3f s:", actual_window_s);
-    LOG("  sched switches: %.0f/s (%lu)", stats_.sched_switch_count / actual_window_s,
-        stats_.sched_switch_count);
+    // When the scheduler events are filtered in the kernel, these counts (and the events lost from
+    // the sched:sched_switch ring buffers) only include the events involving the target.
+    const char* scheduler_events_filter_note =
+        scheduler_events_filter_last_allocated_tid_.has_value() ? " (target only)" : "";
+    LOG("  sched switches%s: %.0f/s (%lu)", scheduler_events_filter_note,
+        stats_.sched_switch_count / actual_window_s, stats_.sched_switch_count);
+    if (trace_thread_state_) {
+      LOG("  sched wakeups%s: %.0f/s (%lu)", scheduler_events_filter_note,
+          stats_.sched_wakeup_count / actual_window_s, stats_.sched_wakeup_count);
+    }
     LOG("  samples: %.0f/s (%lu)", stats_.sample_count / actual_window_s, stats_.sample_count);
     LOG("  u(ret)probes: %.0f/s (%lu)", stats_.uprobes_count / actual_window_s,
         stats_.uprobes_count);
@@ -1106,11 +1438,31 @@ void TracerThread::PrintStatsIfTimerElapsed() {
           discarded_samples_in_uretprobes_count / actual_window_s,
           discarded_samples_in_uretprobes_count,
           100.0 * discarded_samples_in_uretprobes_count / stats_.sample_count);
+      if (unwinding_method_ == CaptureOptions::kHybrid) {
+        uint64_t samples_unwound_with_dwarf_count = stats_.samples_unwound_with_dwarf_count;
+        LOG("  samples unwound with DWARF: %.0f/s (%lu) [%.1f%%]",
+            samples_unwound_with_dwarf_count / actual_window_s, samples_unwound_with_dwarf_count,
+            100.0 * samples_unwound_with_dwarf_count / stats_.sample_count);
+        uint64_t truncated_hybrid_callstack_count = stats_.truncated_hybrid_callstack_count;
+        LOG("  truncated hybrid callstacks: %.0f/s (%lu) [%.1f%%]",
+            truncated_hybrid_callstack_count / actual_window_s, truncated_hybrid_callstack_count,
+            100.0 * truncated_hybrid_callstack_count / stats_.sample_count);
+      }
+      if (repair_leaf_frames_) {
+        uint64_t repaired_leaf_frame_count = stats_.repaired_leaf_frame_count;
+        LOG("  repaired leaf frames: %.0f/s (%lu) [%.1f%%]",
+            repaired_leaf_frame_count / actual_window_s, repaired_leaf_frame_count,
+            100.0 * repaired_leaf_frame_count / stats_.sample_count);
+      }
     }
 
     uint64_t thread_state_count = stats_.thread_state_count;
     LOG("  target's thread states: %.0f/s (%lu)", thread_state_count / actual_window_s,
         thread_state_count);
+    if (stats_.new_target_threads_not_in_scheduler_events_filter_count > 0) {
+      LOG("  NEW TARGET'S THREADS MISSED BY SCHEDULER EVENTS FILTER: %lu",
+          stats_.new_target_threads_not_in_scheduler_events_filter_count);
+    }
     stats_.Reset();
   }
 }
@@ -7,6 +7,7 @@
 
 #include <absl/container/flat_hash_map.h>
 #include <absl/container/flat_hash_set.h>
+#include <absl/synchronization/mutex.h>
 #include <linux/perf_event.h>
 #include <sys/types.h>
 #include <tracepoint.pb.h>
@@ -15,8 +16,8 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
-#include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "ContextSwitchAndThreadStateVisitor.h"
@@ -29,8 +30,11 @@
 #include "PerfEvent.h"
 #include "PerfEventProcessor.h"
 #include "PerfEventRingBuffer.h"
+#include "RingBufferSizes.h"
+#include "StackDumpUsageTracker.h"
 #include "UprobesUnwindingVisitor.h"
 #include "capture.pb.h"
+#include "concurrentqueue.h"
 
 namespace orbit_linux_tracing {
 
@@ -58,7 +62,13 @@ class TracerThread {
   }
 
   void InitUprobesEventVisitor();
-  bool OpenUserSpaceProbes(const std::vector<int32_t>& cpus);
+  // Opens the uprobes and uretprobes of the first num_functions_to_open instrumented functions.
+  bool OpenUserSpaceProbes(const std::vector<int32_t>& cpus, size_t num_functions_to_open);
+  // Raises the soft limit on open files enough to open all perf_event_open file descriptors of the
+  // capture, including the uprobes and uretprobes of the instrumented functions on
+  // num_user_space_probes_cpus cpus. Returns how many functions (the first ones in
+  // instrumented_functions_) fit within the hard limit.
+  size_t RaiseMaxOpenFilesForPerfEvents(size_t num_user_space_probes_cpus);
   bool OpenUprobes(const orbit_linux_tracing::Function& function, const std::vector<int32_t>& cpus,
                    absl::flat_hash_map<int32_t, int>* fds_per_cpu);
   bool OpenUretprobes(const orbit_linux_tracing::Function& function,
@@ -91,12 +101,14 @@ class TracerThread {
   void ProcessLostEvent(const perf_event_header& header, PerfEventRingBuffer* ring_buffer);
 
   void DeferEvent(std::unique_ptr<PerfEvent> event);
-  std::vector<std::unique_ptr<PerfEvent>> ConsumeDeferredEvents();
+  void HandOffDeferredEvents();
+  void StopProcessingDeferredEvents();
   void ProcessDeferredEvents();
 
-  void RetrieveThreadNamesSystemWide();
-  void RetrieveTidToPidAssociationSystemWide();
-  void RetrieveThreadStatesOfTarget();
+  void RetrieveInitialThreadsFromProc();
+
+  void ComputeRingBufferSizes(size_t num_cpus);
+  void PrintRingBufferPeakFillLevels();
 
   void PrintStatsIfTimerElapsed();
 
@@ -106,29 +118,38 @@ class TracerThread {
   // before switching to another one.
   static constexpr int32_t ROUND_ROBIN_POLLING_BATCH_SIZE = 5;
 
-  // These values are supposed to be large enough to accommodate enough events
-  // in case TracerThread::Run's thread is not scheduled for a few tens of
-  // milliseconds.
-  static constexpr uint64_t UPROBES_RING_BUFFER_SIZE_KB = 8 * 1024;
-  static constexpr uint64_t MMAP_TASK_RING_BUFFER_SIZE_KB = 64;
-  static constexpr uint64_t SAMPLING_RING_BUFFER_SIZE_KB = 16 * 1024;
-  static constexpr uint64_t THREAD_NAMES_RING_BUFFER_SIZE_KB = 64;
-  static constexpr uint64_t CONTEXT_SWITCHES_AND_THREAD_STATE_RING_BUFFER_SIZE_KB = 2 * 1024;
-  static constexpr uint64_t GPU_TRACING_RING_BUFFER_SIZE_KB = 256;
-  static constexpr uint64_t INSTRUMENTED_TRACEPOINTS_RING_BUFFER_SIZE_KB = 8 * 1024;
+  // Maximum number of threads used to open (and redirect) uprobes and uretprobes. perf_event_open
+  // for uprobes partly serializes in the kernel, so more threads don't help much.
+  static constexpr size_t USER_SPACE_PROBES_OPENING_MAX_THREADS = 16;
+  // Maximum number of threads used to read the initial threads of all processes from /proc.
+  static constexpr size_t PROC_SCANNING_MAX_THREADS = 8;
+  // Upper bound of the number of perf_event_open file descriptors opened per cpu for everything
+  // but uprobes, uretprobes and instrumented tracepoints (mmap/task, sampling, and tracepoints).
+  static constexpr uint64_t OTHER_PERF_EVENT_FDS_PER_CPU = 16;
 
   static constexpr uint32_t IDLE_TIME_ON_EMPTY_RING_BUFFERS_US = 100;
-  static constexpr uint32_t IDLE_TIME_ON_EMPTY_DEFERRED_EVENTS_US = 1000;
+  // Maximum number of deferred events moved out of deferred_events_queue_ at once.
+  static constexpr size_t DEFERRED_EVENTS_DEQUEUE_BATCH_SIZE = 1024;
 
   bool trace_context_switches_;
   pid_t target_pid_;
   uint64_t sampling_period_ns_;
   orbit_grpc_protos::CaptureOptions::UnwindingMethod unwinding_method_;
+  // Bytes of the user stack dumped with each sample when unwinding with DWARF information, in
+  // hybrid mode, or when repairing leaf frames.
+  uint16_t stack_dump_size_;
+  bool adaptive_stack_dump_copy_;
+  bool repair_leaf_frames_;
+  absl::flat_hash_set<std::string> modules_without_frame_pointers_;
   std::vector<Function> instrumented_functions_;
   ManualInstrumentationConfig manual_instrumentation_config_;
   bool trace_thread_state_;
+  bool limit_scheduler_events_to_target_;
   bool trace_gpu_driver_;
   std::vector<orbit_grpc_protos::TracepointInfo> instrumented_tracepoints_;
+  // 0 means that the ring buffers are only limited by the memory that can be locked.
+  uint64_t max_ring_buffers_memory_mb_;
+  RingBufferSizesKb ring_buffer_sizes_kb_;
 
   TracerListener* listener_ = nullptr;
 
@@ -150,11 +171,23 @@ class TracerThread {
   absl::flat_hash_map<uint64_t, orbit_grpc_protos::TracepointInfo> ids_to_tracepoint_info_;
 
   uint64_t effective_capture_start_timestamp_ns_ = 0;
-
-  std::atomic<bool> stop_deferred_thread_ = false;
-  std::vector<std::unique_ptr<PerfEvent>> deferred_events_;
-  std::mutex deferred_events_mutex_;
+  // Set when the scheduler tracepoints are filtered in the kernel to the target: threads with a
+  // higher tid are let through the filters.
+  std::optional<pid_t> scheduler_events_filter_last_allocated_tid_;
+
+  // Events are deferred by the thread running Run, which collects them in
+  // deferred_events_to_hand_off_ and moves them to deferred_events_queue_ once per iteration. The
+  // thread running ProcessDeferredEvents sleeps until it is notified of new events through
+  // deferred_events_available_, or until the oldest event held by event_processor_ can be
+  // processed.
+  std::vector<std::unique_ptr<PerfEvent>> deferred_events_to_hand_off_;
+  moodycamel::ConcurrentQueue<std::unique_ptr<PerfEvent>> deferred_events_queue_;
+  absl::Mutex deferred_events_mutex_;
+  bool deferred_events_available_ ABSL_GUARDED_BY(deferred_events_mutex_) = false;
+  bool stop_deferred_thread_ ABSL_GUARDED_BY(deferred_events_mutex_) = false;
   std::unique_ptr<UprobesUnwindingVisitor> uprobes_unwinding_visitor_;
+  // Only used when unwinding with DWARF information.
+  std::unique_ptr<StackDumpUsageTracker> stack_dump_usage_tracker_;
   std::unique_ptr<ContextSwitchAndThreadStateVisitor> context_switch_and_thread_state_visitor_;
   PerfEventProcessor event_processor_;
   std::unique_ptr<GpuTracepointEventProcessor> gpu_event_processor_;
@@ -163,6 +196,7 @@ class TracerThread {
     void Reset() {
       event_count_begin_ns = MonotonicTimestampNs();
       sched_switch_count = 0;
+      sched_wakeup_count = 0;
       sample_count = 0;
       uprobes_count = 0;
       gpu_events_count = 0;
@@ -171,11 +205,16 @@ class TracerThread {
       discarded_out_of_order_count = 0;
       unwind_error_count = 0;
       discarded_samples_in_uretprobes_count = 0;
+      samples_unwound_with_dwarf_count = 0;
+      truncated_hybrid_callstack_count = 0;
+      repaired_leaf_frame_count = 0;
       thread_state_count = 0;
+      new_target_threads_not_in_scheduler_events_filter_count = 0;
     }
 
     uint64_t event_count_begin_ns = 0;
     uint64_t sched_switch_count = 0;
+    uint64_t sched_wakeup_count = 0;
     uint64_t sample_count = 0;
     uint64_t uprobes_count = 0;
     uint64_t gpu_events_count = 0;
@@ -184,7 +223,11 @@ class TracerThread {
     std::atomic<uint64_t> discarded_out_of_order_count = 0;
     std::atomic<uint64_t> unwind_error_count = 0;
     std::atomic<uint64_t> discarded_samples_in_uretprobes_count = 0;
+    std::atomic<uint64_t> samples_unwound_with_dwarf_count = 0;
+    std::atomic<uint64_t> truncated_hybrid_callstack_count = 0;
+    std::atomic<uint64_t> repaired_leaf_frame_count = 0;
     std::atomic<uint64_t> thread_state_count = 0;
+    uint64_t new_target_threads_not_in_scheduler_events_filter_count = 0;
   };
 
   static constexpr uint64_t EVENT_STATS_WINDOW_S = 5;
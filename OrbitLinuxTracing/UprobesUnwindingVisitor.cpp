@@ -10,8 +10,10 @@
 #include <unwindstack/Unwinder.h>
 
 #include <algorithm>
+#include <array>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "ElfUtils/LinuxMap.h"
 #include "Function.h"
@@ -35,10 +37,20 @@ void UprobesUnwindingVisitor::visit(StackSamplePerfEvent* event) {
   return_address_manager_.PatchSample(event->GetTid(), event->GetRegisters()[PERF_REG_X86_SP],
                                       event->GetStackData(), event->GetStackSize());
 
+  StackDumpUsage stack_dump_usage;
   const std::vector<unwindstack::FrameData>& libunwindstack_callstack = unwinder_.Unwind(
-      current_maps_.get(), event->GetRegisters(), event->GetStackData(), event->GetStackSize());
+      current_maps_.get(), event->GetRegisters(), event->GetStackData(), event->GetStackSize(),
+      stack_dump_usage_tracker_ != nullptr ? &stack_dump_usage : nullptr);
+  if (stack_dump_usage_tracker_ != nullptr) {
+    stack_dump_usage_tracker_->OnStackSampleUnwound(event->GetTid(), event->GetDumpedStackSize(),
+                                                    event->GetStackSize(), stack_dump_usage);
+  }
 
-  if (libunwindstack_callstack.empty()) {
+  // When unwinding needed more of the stack than was copied, the callstack is truncated even
+  // though the kernel dumped enough: report it as an unwinding error instead.
+  const bool read_beyond_copied_stack = stack_dump_usage.read_beyond_stack_dump &&
+                                        event->GetStackSize() < event->GetDumpedStackSize();
+  if (libunwindstack_callstack.empty() || read_beyond_copied_stack) {
     if (unwind_error_counter_ != nullptr) {
       ++(*unwind_error_counter_);
     }
@@ -106,11 +118,12 @@ void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
   sample.set_tid(event->GetTid());
   sample.set_timestamp_ns(event->GetTimestamp());
 
-  Callstack* callstack = sample.mutable_callstack();
   uint64_t* raw_callchain = event->GetCallchain();
+  std::vector<uint64_t> callchain_pcs;
+  callchain_pcs.reserve(event->GetCallchainSize() - 1);
   // Skip the first frame as the top of a perf_event_open callchain is always
   // inside kernel code.
-  callstack->add_pcs(raw_callchain[1]);
+  callchain_pcs.push_back(raw_callchain[1]);
   // Only the address of the top of the stack is correct. Frame-based unwinding
   // uses the return address of a function call as the caller's address.
   // However, the actual address of the call instruction is before that.
@@ -118,12 +131,82 @@ void UprobesUnwindingVisitor::visit(CallchainSamplePerfEvent* event) {
   // return address. This way we fall into the range of the call instruction.
   // Note: This is also done the same way in Libunwindstack.
   for (uint64_t frame_index = 2; frame_index < event->GetCallchainSize(); ++frame_index) {
-    callstack->add_pcs(raw_callchain[frame_index] - 1);
+    callchain_pcs.push_back(raw_callchain[frame_index] - 1);
+  }
+
+  if (event->HasRegistersAndStack()) {
+    return_address_manager_.PatchSample(event->GetTid(), event->GetRegisters()[PERF_REG_X86_SP],
+                                        event->GetStackData(), event->GetStackSize());
+    if (leaf_frame_repairer_ != nullptr) {
+      RepairLeafFrame(event, &callchain_pcs);
+    }
+    if (!modules_without_frame_pointers_.empty()) {
+      RepairCallchainWithDwarfFrames(event, &callchain_pcs);
+    }
+  }
+
+  Callstack* callstack = sample.mutable_callstack();
+  for (uint64_t pc : callchain_pcs) {
+    callstack->add_pcs(pc);
   }
 
   listener_->OnCallstackSample(std::move(sample));
 }
 
+FramePointerSupport UprobesUnwindingVisitor::GetFramePointerSupport(uint64_t pc) const {
+  unwindstack::MapInfo* map_info = current_maps_->Find(pc);
+  // Anonymous executable memory, e.g., with JIT-compiled code, is not a module.
+  if (map_info == nullptr || map_info->name.empty() || map_info->name == "[uprobes]") {
+    return FramePointerSupport::kUnknownModule;
+  }
+  return modules_without_frame_pointers_.contains(map_info->name)
+             ? FramePointerSupport::kWithoutFramePointers
+             : FramePointerSupport::kWithFramePointers;
+}
+
+void UprobesUnwindingVisitor::RepairLeafFrame(CallchainSamplePerfEvent* event,
+                                              std::vector<uint64_t>* callchain_pcs) {
+  std::optional<uint64_t> return_address = leaf_frame_repairer_->GetSkippedReturnAddress(
+      current_maps_.get(), callchain_pcs->front(), event->GetStackData(), event->GetStackSize());
+  if (!return_address.has_value()) {
+    return;
+  }
+  // As for the rest of the callchain, subtract 1 to fall into the call instruction.
+  callchain_pcs->insert(callchain_pcs->begin() + 1, return_address.value() - 1);
+  if (repaired_leaf_frames_counter_ != nullptr) {
+    ++(*repaired_leaf_frames_counter_);
+  }
+}
+
+void UprobesUnwindingVisitor::RepairCallchainWithDwarfFrames(CallchainSamplePerfEvent* event,
+                                                             std::vector<uint64_t>* callchain_pcs) {
+  auto get_frame_pointer_support = [this](uint64_t pc) { return GetFramePointerSupport(pc); };
+  if (!CallchainNeedsDwarfUnwinding(*callchain_pcs, get_frame_pointer_support)) {
+    return;
+  }
+
+  const std::array<uint64_t, PERF_REG_X86_64_MAX> registers = event->GetRegisters();
+  bool dwarf_unwinding_is_complete = false;
+  const std::vector<unwindstack::FrameData> frames =
+      unwinder_.UnwindAsFarAsPossible(current_maps_.get(), registers, event->GetStackData(),
+                                      event->GetStackSize(), &dwarf_unwinding_is_complete);
+  std::vector<uint64_t> dwarf_pcs;
+  dwarf_pcs.reserve(frames.size());
+  for (const unwindstack::FrameData& frame : frames) {
+    dwarf_pcs.push_back(frame.pc);
+  }
+
+  HybridCallstack hybrid_callstack = JoinCallchainWithDwarfFrames(
+      *callchain_pcs, dwarf_pcs, dwarf_unwinding_is_complete, get_frame_pointer_support);
+  if (samples_unwound_with_dwarf_counter_ != nullptr) {
+    ++(*samples_unwound_with_dwarf_counter_);
+  }
+  if (hybrid_callstack.is_truncated && truncated_hybrid_callstacks_counter_ != nullptr) {
+    ++(*truncated_hybrid_callstacks_counter_);
+  }
+  *callchain_pcs = std::move(hybrid_callstack.pcs);
+}
+
 void UprobesUnwindingVisitor::visit(UprobesPerfEvent* event) {
   CHECK(listener_ != nullptr);
 
@@ -187,6 +270,9 @@ void UprobesUnwindingVisitor::visit(UretprobesPerfEvent* event) {
 void UprobesUnwindingVisitor::visit(MapsPerfEvent* event) {
   CHECK(listener_ != nullptr);
   current_maps_ = LibunwindstackUnwinder::ParseMaps(event->GetMaps());
+  if (leaf_frame_repairer_ != nullptr) {
+    leaf_frame_repairer_->OnMapsChanged();
+  }
 
   auto result_or_error = orbit_elf_utils::ParseMaps(event->GetMaps());
   if (!result_or_error) {
@@ -6,6 +6,7 @@
 #define ORBIT_LINUX_TRACING_UPROBES_UNWINDING_VISITOR_H_
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/container/flat_hash_set.h>
 #include <absl/hash/hash.h>
 #include <sys/types.h>
 #include <unwindstack/Maps.h>
@@ -15,12 +16,16 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
+#include "HybridUnwinding.h"
+#include "LeafFrameRepairer.h"
 #include "LibunwindstackUnwinder.h"
 #include "OrbitLinuxTracing/TracerListener.h"
 #include "PerfEvent.h"
 #include "PerfEventVisitor.h"
+#include "StackDumpUsageTracker.h"
 #include "UprobesFunctionCallManager.h"
 #include "UprobesReturnAddressManager.h"
 
@@ -62,6 +67,34 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
     discarded_samples_in_uretprobes_counter_ = discarded_samples_in_uretprobes_counter;
   }
 
+  // If set, receives how much of the stack dump of each StackSamplePerfEvent unwinding used.
+  void SetStackDumpUsageTracker(StackDumpUsageTracker* stack_dump_usage_tracker) {
+    stack_dump_usage_tracker_ = stack_dump_usage_tracker;
+  }
+
+  // In hybrid unwinding mode, the callchains that go through these modules are repaired with the
+  // frames unwound using DWARF information from the registers and the stack of the samples.
+  void SetModulesWithoutFramePointers(absl::flat_hash_set<std::string> modules) {
+    modules_without_frame_pointers_ = std::move(modules);
+  }
+
+  void SetHybridUnwindingCounters(std::atomic<uint64_t>* samples_unwound_with_dwarf_counter,
+                                  std::atomic<uint64_t>* truncated_hybrid_callstacks_counter) {
+    samples_unwound_with_dwarf_counter_ = samples_unwound_with_dwarf_counter;
+    truncated_hybrid_callstacks_counter_ = truncated_hybrid_callstacks_counter;
+  }
+
+  // Adds the caller that callchains miss when samples of process pid fall into code where the
+  // innermost function has not set up its frame, using the registers and the stack of the samples.
+  // Starts loading the modules of the current maps right away.
+  void EnableLeafFrameRepair(pid_t pid, std::atomic<uint64_t>* repaired_leaf_frames_counter) {
+    leaf_frame_repairer_ = std::make_unique<LeafFrameRepairer>(pid);
+    if (current_maps_ != nullptr) {
+      leaf_frame_repairer_->PreloadModules(current_maps_.get());
+    }
+    repaired_leaf_frames_counter_ = repaired_leaf_frames_counter;
+  }
+
   void visit(StackSamplePerfEvent* event) override;
   void visit(CallchainSamplePerfEvent* event) override;
   void visit(UprobesPerfEvent* event) override;
@@ -69,6 +102,11 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
   void visit(MapsPerfEvent* event) override;
 
  private:
+  [[nodiscard]] FramePointerSupport GetFramePointerSupport(uint64_t pc) const;
+  void RepairLeafFrame(CallchainSamplePerfEvent* event, std::vector<uint64_t>* callchain_pcs);
+  void RepairCallchainWithDwarfFrames(CallchainSamplePerfEvent* event,
+                                      std::vector<uint64_t>* callchain_pcs);
+
   UprobesFunctionCallManager function_call_manager_{};
   UprobesReturnAddressManager return_address_manager_{};
   std::unique_ptr<unwindstack::BufferMaps> current_maps_;
@@ -79,6 +117,15 @@ class UprobesUnwindingVisitor : public PerfEventVisitor {
   std::atomic<uint64_t>* unwind_error_counter_ = nullptr;
   std::atomic<uint64_t>* discarded_samples_in_uretprobes_counter_ = nullptr;
 
+  StackDumpUsageTracker* stack_dump_usage_tracker_ = nullptr;
+
+  absl::flat_hash_set<std::string> modules_without_frame_pointers_;
+  std::atomic<uint64_t>* samples_unwound_with_dwarf_counter_ = nullptr;
+  std::atomic<uint64_t>* truncated_hybrid_callstacks_counter_ = nullptr;
+
+  std::unique_ptr<LeafFrameRepairer> leaf_frame_repairer_;
+  std::atomic<uint64_t>* repaired_leaf_frames_counter_ = nullptr;
+
   absl::flat_hash_map<pid_t, std::vector<std::tuple<uint64_t, uint64_t, uint32_t>>>
       uprobe_sps_ips_cpus_per_thread_{};
 };
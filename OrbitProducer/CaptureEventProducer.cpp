@@ -4,6 +4,10 @@
 
 #include "OrbitProducer/CaptureEventProducer.h"
 
+#include <unistd.h>
+
+#include <utility>
+
 #include "OrbitBase/Logging.h"
 
 using orbit_grpc_protos::ProducerSideService;
@@ -61,6 +65,19 @@ bool CaptureEventProducer::SendCaptureEvents(
     CHECK(!shutdown_requested_);
   }
 
+  {
+    absl::MutexLock lock{&shared_memory_ring_writer_mutex_};
+    if (shared_memory_ring_writer_ != nullptr) {
+      if (shared_memory_ring_writer_->TryWriteMessage(
+              send_events_request.buffered_capture_events())) {
+        return true;
+      }
+      // The following batches are also sent on the stream until ProducerSideService has received
+      // this one, so that they can't overtake it through the ring.
+      shared_memory_ring_writer_->OnMessageSentOutsideRing();
+    }
+  }
+
   bool write_succeeded;
   {
     absl::ReaderMutexLock lock{&context_and_stream_mutex_};
@@ -102,6 +119,33 @@ bool CaptureEventProducer::NotifyAllEventsSent() {
   return write_succeeded;
 }
 
+void CaptureEventProducer::CreateAndAnnounceSharedMemoryRing() {
+  auto writer_or_error = orbit_producer_side_channel::SharedMemoryRingWriter::Create();
+  if (writer_or_error.has_error()) {
+    ERROR("Creating SharedMemoryRing: %s", writer_or_error.error().message());
+    return;
+  }
+
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest shared_memory_ring_created_request;
+  shared_memory_ring_created_request.mutable_shared_memory_ring_created()->set_pid(getpid());
+  shared_memory_ring_created_request.mutable_shared_memory_ring_created()->set_fd(
+      writer_or_error.value()->GetFd());
+  bool write_succeeded;
+  {
+    absl::ReaderMutexLock lock{&context_and_stream_mutex_};
+    write_succeeded = stream_->Write(shared_memory_ring_created_request);
+  }
+  if (!write_succeeded) {
+    // The following Read will also fail and cause a reconnection.
+    ERROR("Sending SharedMemoryRingCreated to ProducerSideService");
+    return;
+  }
+
+  // Until ProducerSideService has attached to the ring, CaptureEvents are still sent on the stream.
+  absl::MutexLock lock{&shared_memory_ring_writer_mutex_};
+  shared_memory_ring_writer_ = std::move(writer_or_error.value());
+}
+
 void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
   CHECK(producer_side_service_stub_ != nullptr);
 
@@ -138,6 +182,9 @@ void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
       continue;
     }
     LOG("Called ReceiveCommandsAndSendEvents on ProducerSideService");
+    if (use_shared_memory_ring_) {
+      CreateAndAnnounceSharedMemoryRing();
+    }
 
     while (true) {
       ReceiveCommandsAndSendEventsResponse response;
@@ -158,6 +205,10 @@ void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
           OnCaptureFinished();
         }
         LOG("Terminating call to ReceiveCommandsAndSendEvents");
+        {
+          absl::MutexLock lock{&shared_memory_ring_writer_mutex_};
+          shared_memory_ring_writer_.reset();
+        }
         {
           absl::WriterMutexLock lock{&context_and_stream_mutex_};
           stream_->Finish();
@@ -180,12 +231,12 @@ void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
           LOG("ProducerSideService sent StartCaptureCommand");
           if (last_command_ == ReceiveCommandsAndSendEventsResponse::kCaptureFinishedCommand) {
             last_command_ = ReceiveCommandsAndSendEventsResponse::kStartCaptureCommand;
-            OnCaptureStart();
+            OnCaptureStart(response.start_capture_command().capture_options());
           } else if (last_command_ == ReceiveCommandsAndSendEventsResponse::kStopCaptureCommand) {
             last_command_ = ReceiveCommandsAndSendEventsResponse::kCaptureFinishedCommand;
             OnCaptureFinished();
             last_command_ = ReceiveCommandsAndSendEventsResponse::kStartCaptureCommand;
-            OnCaptureStart();
+            OnCaptureStart(response.start_capture_command().capture_options());
           }
         } break;
 
@@ -197,7 +248,8 @@ void CaptureEventProducer::ConnectAndReceiveCommandsThread() {
           } else if (last_command_ ==
                      ReceiveCommandsAndSendEventsResponse::kCaptureFinishedCommand) {
             last_command_ = ReceiveCommandsAndSendEventsResponse::kStartCaptureCommand;
-            OnCaptureStart();
+            // The StartCaptureCommand was missed, and with it the CaptureOptions.
+            OnCaptureStart(orbit_grpc_protos::CaptureOptions{});
             last_command_ = ReceiveCommandsAndSendEventsResponse::kStopCaptureCommand;
             OnCaptureStop();
           }
@@ -34,7 +34,7 @@ class CaptureEventProducerImpl : public CaptureEventProducer {
 
   [[nodiscard]] bool NotifyAllEventsSent() { return CaptureEventProducer::NotifyAllEventsSent(); }
 
-  MOCK_METHOD(void, OnCaptureStart, (), (override));
+  MOCK_METHOD(void, OnCaptureStart, (orbit_grpc_protos::CaptureOptions), (override));
   MOCK_METHOD(void, OnCaptureStop, (), (override));
   MOCK_METHOD(void, OnCaptureFinished, (), (override));
 };
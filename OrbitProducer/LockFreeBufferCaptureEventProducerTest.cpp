@@ -394,4 +394,141 @@ TEST_F(LockFreeBufferCaptureEventProducerTest, DisconnectAndReconnect) {
   EXPECT_FALSE(buffer_producer_->IsCapturing());
 }
 
+TEST_F(LockFreeBufferCaptureEventProducerTest, DropsEventsWhenQueueIsFull) {
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  buffer_producer_->SetMaxQueuedEvents(0);
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(0);
+  EXPECT_FALSE(buffer_producer_->EnqueueIntermediateEventIfCapturing([] { return ""; }));
+  EXPECT_FALSE(buffer_producer_->EnqueueIntermediateEvent(""));
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(buffer_producer_->GetNumDroppedEvents(), 2);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  buffer_producer_->SetMaxQueuedEvents(
+      LockFreeBufferCaptureEventProducerImpl::kDefaultMaxQueuedEvents);
+  int32_t capture_events_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&capture_events_received_count](
+                         const std::vector<orbit_grpc_protos::CaptureEvent>& events) {
+        capture_events_received_count += events.size();
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::Between(1, 2));
+  EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEventIfCapturing([] { return ""; }));
+  EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEvent(""));
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(capture_events_received_count, 2);
+  EXPECT_EQ(buffer_producer_->GetNumDroppedEvents(), 2);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(LockFreeBufferCaptureEventProducerTest, EnqueueIntermediateEventsIfCapturing) {
+  std::vector<std::string> events{"", "", ""};
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
+  EXPECT_FALSE(
+      buffer_producer_->EnqueueIntermediateEventsIfCapturing(events.begin(), events.size()));
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  int32_t capture_events_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&capture_events_received_count](
+                         const std::vector<orbit_grpc_protos::CaptureEvent>& events) {
+        capture_events_received_count += events.size();
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::Between(1, 3));
+  EXPECT_TRUE(buffer_producer_->EnqueueIntermediateEventsIfCapturing(
+      std::make_move_iterator(events.begin()), events.size()));
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(capture_events_received_count, 3);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  // The events are only enqueued if there is room for all of them.
+  buffer_producer_->SetMaxQueuedEvents(2);
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
+  EXPECT_FALSE(
+      buffer_producer_->EnqueueIntermediateEventsIfCapturing(events.begin(), events.size()));
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(buffer_producer_->GetNumDroppedEvents(), 3);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(LockFreeBufferCaptureEventProducerTest, SendsStatsEventsOnlyWhenIntrospectionIsEnabled) {
+  buffer_producer_->EnableStatsEvents("Test");
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
+  std::this_thread::sleep_for(LockFreeBufferCaptureEventProducerImpl::kStatsEventsPeriod +
+                              kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_enable_introspection(true);
+  fake_service_->SendStartCaptureCommand(capture_options);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(buffer_producer_->IsCapturing());
+
+  std::vector<std::string> track_names;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&track_names](const std::vector<orbit_grpc_protos::CaptureEvent>& events) {
+        for (const orbit_grpc_protos::CaptureEvent& event : events) {
+          if (event.event_case() != orbit_grpc_protos::CaptureEvent::kIntrospectionScope) {
+            continue;
+          }
+          const orbit_grpc_protos::IntrospectionScope& scope = event.introspection_scope();
+          ASSERT_EQ(scope.registers_size(), 6);
+          orbit_api::EncodedEvent encoded_event(orbit_api::kNone);
+          for (int i = 0; i < scope.registers_size(); ++i) {
+            encoded_event.args[i] = scope.registers(i);
+          }
+          EXPECT_EQ(encoded_event.event.type, orbit_api::kTrackUint64);
+          track_names.emplace_back(encoded_event.event.name);
+        }
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AtLeast(1));
+  std::this_thread::sleep_for(LockFreeBufferCaptureEventProducerImpl::kStatsEventsPeriod +
+                              kWaitMessagesSentDuration);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+  EXPECT_THAT(track_names, ::testing::IsSupersetOf(
+                               {"Test queue depth", "Test bytes sent", "Test dropped events"}));
+
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
 }  // namespace orbit_producer
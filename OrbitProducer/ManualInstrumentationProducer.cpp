@@ -0,0 +1,145 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OrbitProducer/ManualInstrumentationProducer.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/Profiling.h"
+#include "OrbitBase/ThreadUtils.h"
+
+namespace orbit_producer {
+
+namespace {
+
+std::atomic<ManualInstrumentationProducer*> producer_instance = nullptr;
+
+// Incremented at every capture start, so that threads can discard the scopes left open by the
+// previous capture.
+std::atomic<uint64_t> capture_generation = 0;
+
+struct OpenScope {
+  uint64_t begin_timestamp_ns;
+  orbit_api::EncodedEvent encoded_event;
+};
+
+struct ThreadState {
+  int32_t tid = orbit_base::GetCurrentThreadId();
+  uint64_t capture_generation = 0;
+  std::vector<OpenScope> open_scopes;
+};
+
+ThreadState& GetThreadState() {
+  thread_local ThreadState thread_state;
+  const uint64_t current_generation = capture_generation.load(std::memory_order_relaxed);
+  if (thread_state.capture_generation != current_generation) {
+    thread_state.capture_generation = current_generation;
+    thread_state.open_scopes.clear();
+  }
+  return thread_state;
+}
+
+int32_t GetCachedProcessId() {
+  static const int32_t pid = getpid();
+  return pid;
+}
+
+}  // namespace
+
+const orbit_api::InProcessProducerCallbacks ManualInstrumentationProducer::kCallbacks{
+    &ManualInstrumentationProducer::OnStart, &ManualInstrumentationProducer::OnStop,
+    &ManualInstrumentationProducer::OnRecord};
+
+ManualInstrumentationProducer::ManualInstrumentationProducer() {
+  ManualInstrumentationProducer* expected = nullptr;
+  CHECK(producer_instance.compare_exchange_strong(expected, this));
+  EnableStatsEvents("Orbit API");
+}
+
+ManualInstrumentationProducer::~ManualInstrumentationProducer() {
+  orbit_api::in_process_producer_callbacks.store(nullptr, std::memory_order_release);
+  producer_instance.store(nullptr);
+}
+
+void ManualInstrumentationProducer::OnCaptureStart(
+    orbit_grpc_protos::CaptureOptions capture_options) {
+  LockFreeBufferCaptureEventProducer::OnCaptureStart(std::move(capture_options));
+  ++capture_generation;
+  orbit_api::in_process_producer_callbacks.store(&kCallbacks, std::memory_order_release);
+}
+
+void ManualInstrumentationProducer::OnCaptureStop() {
+  // Uninstall the callbacks first: events recorded after the producer started notifying that all
+  // events have been sent would be dropped anyway.
+  orbit_api::in_process_producer_callbacks.store(nullptr, std::memory_order_release);
+  LockFreeBufferCaptureEventProducer::OnCaptureStop();
+}
+
+void ManualInstrumentationProducer::OnCaptureFinished() {
+  orbit_api::in_process_producer_callbacks.store(nullptr, std::memory_order_release);
+  LockFreeBufferCaptureEventProducer::OnCaptureFinished();
+}
+
+orbit_grpc_protos::CaptureEvent ManualInstrumentationProducer::TranslateIntermediateEvent(
+    ManualInstrumentationEvent&& intermediate_event) {
+  orbit_grpc_protos::CaptureEvent capture_event;
+  orbit_grpc_protos::IntrospectionScope* introspection_scope =
+      capture_event.mutable_introspection_scope();
+  introspection_scope->set_pid(GetCachedProcessId());
+  introspection_scope->set_tid(intermediate_event.tid);
+  introspection_scope->set_begin_timestamp_ns(intermediate_event.begin_timestamp_ns);
+  introspection_scope->set_end_timestamp_ns(intermediate_event.end_timestamp_ns);
+  introspection_scope->set_depth(intermediate_event.depth);
+  introspection_scope->mutable_registers()->Reserve(6);
+  for (uint64_t arg : intermediate_event.encoded_event.args) {
+    introspection_scope->add_registers(arg);
+  }
+  return capture_event;
+}
+
+void ManualInstrumentationProducer::OnStart(const orbit_api::EncodedEvent& event) {
+  GetThreadState().open_scopes.push_back(OpenScope{MonotonicTimestampNs(), event});
+}
+
+void ManualInstrumentationProducer::OnStop() {
+  const uint64_t end_timestamp_ns = MonotonicTimestampNs();
+  ThreadState& thread_state = GetThreadState();
+  // The matching Start happened before the capture started.
+  if (thread_state.open_scopes.empty()) return;
+
+  ManualInstrumentationProducer* producer = producer_instance.load(std::memory_order_relaxed);
+  if (producer == nullptr) return;
+
+  const OpenScope& scope = thread_state.open_scopes.back();
+  ManualInstrumentationEvent intermediate_event;
+  intermediate_event.tid = thread_state.tid;
+  intermediate_event.begin_timestamp_ns = scope.begin_timestamp_ns;
+  intermediate_event.end_timestamp_ns = end_timestamp_ns;
+  intermediate_event.depth = static_cast<int32_t>(thread_state.open_scopes.size() - 1);
+  intermediate_event.encoded_event = scope.encoded_event;
+  thread_state.open_scopes.pop_back();
+  producer->EnqueueIntermediateEvent(intermediate_event);
+}
+
+void ManualInstrumentationProducer::OnRecord(const orbit_api::EncodedEvent& event) {
+  const uint64_t timestamp_ns = MonotonicTimestampNs();
+  ManualInstrumentationProducer* producer = producer_instance.load(std::memory_order_relaxed);
+  if (producer == nullptr) return;
+
+  ThreadState& thread_state = GetThreadState();
+  ManualInstrumentationEvent intermediate_event;
+  intermediate_event.tid = thread_state.tid;
+  intermediate_event.begin_timestamp_ns = timestamp_ns;
+  intermediate_event.end_timestamp_ns = timestamp_ns;
+  intermediate_event.depth = static_cast<int32_t>(thread_state.open_scopes.size());
+  intermediate_event.encoded_event = event;
+  producer->EnqueueIntermediateEvent(intermediate_event);
+}
+
+}  // namespace orbit_producer
@@ -0,0 +1,207 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "../Orbit.h"
+#include "OrbitBase/ThreadUtils.h"
+#include "OrbitProducer/FakeProducerSideService.h"
+#include "OrbitProducer/ManualInstrumentationProducer.h"
+#include "grpcpp/grpcpp.h"
+
+namespace orbit_producer {
+
+namespace {
+
+class ManualInstrumentationProducerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fake_service_.emplace();
+
+    grpc::ServerBuilder builder;
+    builder.RegisterService(&fake_service_.value());
+    fake_server_ = builder.BuildAndStart();
+    ASSERT_NE(fake_server_, nullptr);
+
+    std::shared_ptr<grpc::Channel> channel =
+        fake_server_->InProcessChannel(grpc::ChannelArguments{});
+
+    producer_.emplace();
+    producer_->BuildAndStart(channel);
+
+    // Leave some time for the ReceiveCommandsAndSendEvents RPC to actually happen.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+
+  void TearDown() override {
+    // Leave some time for all pending communication to finish.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    producer_->ShutdownAndWait();
+    producer_.reset();
+
+    fake_service_->FinishAndDisallowRpc();
+    fake_server_->Shutdown();
+    fake_server_->Wait();
+
+    fake_service_.reset();
+    fake_server_.reset();
+  }
+
+  std::optional<FakeProducerSideService> fake_service_;
+  std::unique_ptr<grpc::Server> fake_server_;
+  std::optional<ManualInstrumentationProducer> producer_;
+};
+
+constexpr std::chrono::duration kWaitMessagesSentDuration = std::chrono::milliseconds(25);
+
+orbit_api::Event GetEvent(const orbit_grpc_protos::IntrospectionScope& scope) {
+  orbit_api::EncodedEvent encoded_event(orbit_api::kNone);
+  for (int i = 0; i < scope.registers_size(); ++i) {
+    encoded_event.args[i] = scope.registers(i);
+  }
+  return encoded_event.event;
+}
+
+orbit_api::EventType GetEventType(const orbit_grpc_protos::IntrospectionScope& scope) {
+  return static_cast<orbit_api::EventType>(GetEvent(scope).type);
+}
+
+}  // namespace
+
+TEST_F(ManualInstrumentationProducerTest, CallbacksAreInstalledOnlyWhileCapturing) {
+  EXPECT_EQ(orbit_api::in_process_producer_callbacks.load(), nullptr);
+
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_NE(orbit_api::in_process_producer_callbacks.load(), nullptr);
+
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(orbit_api::in_process_producer_callbacks.load(), nullptr);
+
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_EQ(orbit_api::in_process_producer_callbacks.load(), nullptr);
+}
+
+TEST_F(ManualInstrumentationProducerTest, SendsIntrospectionScopes) {
+  // Not capturing: the stubs are called and nothing is sent.
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
+  { ORBIT_SCOPE("Not captured"); }
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  std::vector<orbit_grpc_protos::CaptureEvent> events;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&events](const std::vector<orbit_grpc_protos::CaptureEvent>& new_events) {
+        events.insert(events.end(), new_events.begin(), new_events.end());
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::Between(1, 3));
+  {
+    ORBIT_SCOPE("Outer");
+    {
+      ORBIT_SCOPE("Inner");
+      ORBIT_INT("Value", 42);
+    }
+  }
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  // Scopes are sent when they end.
+  ASSERT_EQ(events.size(), 3);
+  for (const orbit_grpc_protos::CaptureEvent& event : events) {
+    ASSERT_EQ(event.event_case(), orbit_grpc_protos::CaptureEvent::kIntrospectionScope);
+    EXPECT_EQ(event.introspection_scope().pid(), getpid());
+    EXPECT_EQ(event.introspection_scope().tid(), orbit_base::GetCurrentThreadId());
+    EXPECT_EQ(event.introspection_scope().registers_size(), 6);
+  }
+
+  const orbit_grpc_protos::IntrospectionScope& value = events[0].introspection_scope();
+  const orbit_grpc_protos::IntrospectionScope& inner = events[1].introspection_scope();
+  const orbit_grpc_protos::IntrospectionScope& outer = events[2].introspection_scope();
+  EXPECT_EQ(GetEventType(value), orbit_api::kTrackInt);
+  EXPECT_EQ(value.depth(), 2);
+  EXPECT_EQ(value.begin_timestamp_ns(), value.end_timestamp_ns());
+  EXPECT_EQ(GetEventType(inner), orbit_api::kScopeStart);
+  EXPECT_EQ(inner.depth(), 1);
+  EXPECT_EQ(GetEventType(outer), orbit_api::kScopeStart);
+  EXPECT_EQ(outer.depth(), 0);
+  EXPECT_LE(outer.begin_timestamp_ns(), inner.begin_timestamp_ns());
+  EXPECT_LE(inner.begin_timestamp_ns(), value.begin_timestamp_ns());
+  EXPECT_LE(value.end_timestamp_ns(), inner.end_timestamp_ns());
+  EXPECT_LE(inner.end_timestamp_ns(), outer.end_timestamp_ns());
+
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(ManualInstrumentationProducerTest, DropsScopesOpenedBeforeCaptureStart) {
+  fake_service_->SendStartCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  std::vector<orbit_grpc_protos::CaptureEvent> events;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&events](const std::vector<orbit_grpc_protos::CaptureEvent>& new_events) {
+        events.insert(events.end(), new_events.begin(), new_events.end());
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::Between(1, 3));
+  // This Stop has no matching Start recorded by the producer.
+  ORBIT_STOP();
+  { ORBIT_SCOPE("Captured"); }
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_EQ(events[0].introspection_scope().depth(), 0);
+
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+TEST_F(ManualInstrumentationProducerTest, SendsStatsEventsWhenIntrospectionIsEnabled) {
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_enable_introspection(true);
+
+  std::vector<std::string> track_names;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&track_names](const std::vector<orbit_grpc_protos::CaptureEvent>& events) {
+        for (const orbit_grpc_protos::CaptureEvent& event : events) {
+          ASSERT_EQ(event.event_case(), orbit_grpc_protos::CaptureEvent::kIntrospectionScope);
+          orbit_api::Event api_event = GetEvent(event.introspection_scope());
+          if (api_event.type == orbit_api::kTrackUint64) {
+            track_names.emplace_back(api_event.name);
+          }
+        }
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AtLeast(1));
+  fake_service_->SendStartCaptureCommand(capture_options);
+  std::this_thread::sleep_for(ManualInstrumentationProducer::kStatsEventsPeriod +
+                              kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+
+  EXPECT_THAT(track_names, ::testing::IsSupersetOf({"Orbit API queue depth", "Orbit API bytes sent",
+                                                    "Orbit API dropped events"}));
+
+  // The last stats events can still be sent before AllEventsSent.
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AnyNumber());
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  fake_service_->SendCaptureFinishedCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
+}  // namespace orbit_producer
@@ -5,8 +5,10 @@
 #ifndef ORBIT_PRODUCER_CAPTURE_EVENT_PRODUCER_H_
 #define ORBIT_PRODUCER_CAPTURE_EVENT_PRODUCER_H_
 
+#include <memory>
 #include <thread>
 
+#include "OrbitProducerSideChannel/SharedMemoryRing.h"
 #include "absl/synchronization/mutex.h"
 #include "grpcpp/grpcpp.h"
 #include "producer_side_services.grpc.pb.h"
@@ -28,6 +30,13 @@ class CaptureEventProducer {
   // be attempted when the connection fails or is interrupted. The default is 5 seconds.
   void SetReconnectionDelayMs(uint64_t ms) { reconnection_delay_ms_ = ms; }
 
+  // On every connection, a SharedMemoryRing is offered to ProducerSideService, through which
+  // CaptureEvents are then sent. This method allows to disable that, so that all CaptureEvents are
+  // sent on the gRPC stream. The change applies from the next connection.
+  void SetUseSharedMemoryRing(bool use_shared_memory_ring) {
+    use_shared_memory_ring_ = use_shared_memory_ring;
+  }
+
  protected:
   // This method establishes the connection with ProducerSideService. If a connection fails or
   // is interrupted, the class will keep trying to (re)connect, until ShutdownAndWait is called.
@@ -37,8 +46,9 @@ class CaptureEventProducer {
   // Subclasses that extend this method by overriding it must also call the overridden method.
   virtual void ShutdownAndWait();
 
-  // Subclasses need to override this method to be notified of a request to start a capture.
-  virtual void OnCaptureStart() = 0;
+  // Subclasses need to override this method to be notified of a request to start a capture,
+  // together with the CaptureOptions of the capture.
+  virtual void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) = 0;
   // Subclasses need to override this method to be notified of a request to stop the capture.
   virtual void OnCaptureStop() = 0;
   // Subclasses need to override this method to be notified that the current capture has finished.
@@ -47,6 +57,9 @@ class CaptureEventProducer {
   // Subclasses can use this method to send a batch of CaptureEvents to the ProducerSideService.
   // A full ReceiveCommandsAndSendEventsRequest with event_case() == kBufferedCaptureEvents
   // needs to be passed to avoid an extra copy from a BufferedCaptureEvents message.
+  // If the ProducerSideService has attached to the SharedMemoryRing, the BufferedCaptureEvents
+  // are written there, unless the ring is full, in which case they are sent on the stream, and so
+  // are the following ones until ProducerSideService has received them.
   [[nodiscard]] bool SendCaptureEvents(
       const orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest& send_events_request);
   // Subclasses should use this method to notify the ProducerSideService that
@@ -55,6 +68,7 @@ class CaptureEventProducer {
 
  private:
   void ConnectAndReceiveCommandsThread();
+  void CreateAndAnnounceSharedMemoryRing();
 
  private:
   std::unique_ptr<orbit_grpc_protos::ProducerSideService::Stub> producer_side_service_stub_;
@@ -66,6 +80,10 @@ class CaptureEventProducer {
       stream_;
   absl::Mutex context_and_stream_mutex_;
 
+  std::unique_ptr<orbit_producer_side_channel::SharedMemoryRingWriter> shared_memory_ring_writer_;
+  absl::Mutex shared_memory_ring_writer_mutex_;
+  std::atomic<bool> use_shared_memory_ring_ = true;
+
   std::atomic<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse::CommandCase> last_command_ =
       orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse::kCaptureFinishedCommand;
 
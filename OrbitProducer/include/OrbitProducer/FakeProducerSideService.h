@@ -5,6 +5,8 @@
 #ifndef ORBIT_PRODUCER_FAKE_PRODUCER_SIDE_SERVICE_H_
 #define ORBIT_PRODUCER_FAKE_PRODUCER_SIDE_SERVICE_H_
 
+#include <utility>
+
 #include "grpcpp/grpcpp.h"
 #include "producer_side_services.grpc.pb.h"
 
@@ -40,6 +42,9 @@ class FakeProducerSideService : public orbit_grpc_protos::ProducerSideService::S
         case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kAllEventsSent:
           OnAllEventsSentReceived();
           break;
+        case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kSharedMemoryRingCreated:
+          // Don't attach to the ring, so that the producer keeps sending events on the stream.
+          break;
         case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::EVENT_NOT_SET:
           break;
       }
@@ -50,10 +55,11 @@ class FakeProducerSideService : public orbit_grpc_protos::ProducerSideService::S
     return grpc::Status::OK;
   }
 
-  void SendStartCaptureCommand() {
+  void SendStartCaptureCommand(orbit_grpc_protos::CaptureOptions capture_options = {}) {
     ASSERT_NE(stream_, nullptr);
     orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse command;
-    command.mutable_start_capture_command();
+    *command.mutable_start_capture_command()->mutable_capture_options() =
+        std::move(capture_options);
     bool written = stream_->Write(command);
     EXPECT_TRUE(written);
   }
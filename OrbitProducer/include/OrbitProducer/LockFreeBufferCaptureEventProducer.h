@@ -5,7 +5,17 @@
 #ifndef ORBIT_PRODUCER_LOCK_FREE_BUFFER_CAPTURE_EVENT_PRODUCER_H_
 #define ORBIT_PRODUCER_LOCK_FREE_BUFFER_CAPTURE_EVENT_PRODUCER_H_
 
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../../../OrbitApiEvents.h"
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/Profiling.h"
+#include "OrbitBase/ThreadUtils.h"
 #include "OrbitProducer/CaptureEventProducer.h"
 #include "concurrentqueue.h"
 
@@ -17,6 +27,12 @@ namespace orbit_producer {
 //
 // Internally, a thread reads from the lock-free queue and sends CaptureEvents
 // to ProducerSideService using the methods provided by the superclass.
+// CaptureEvents are sent in batches: a batch is sent when it reaches kMaxBytesPerRequest or
+// kMaxEventsPerRequest, or when its oldest event has waited for kMaxBatchLatency.
+//
+// The number of events in the lock-free queue is capped (see SetMaxQueuedEvents): when
+// OrbitService can't keep up, new events are dropped and counted instead of letting the queue grow
+// unboundedly.
 //
 // Note that the events stored in the lock-free queue, whose type is specified by the
 // type parameter IntermediateEventT, don't need to be CaptureEvents, nor protobufs at all.
@@ -26,6 +42,15 @@ namespace orbit_producer {
 template <typename IntermediateEventT>
 class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
  public:
+  static constexpr uint64_t kMaxEventsPerRequest = 10'000;
+  // Stay well below the default maximum size of gRPC messages (4 MB).
+  static constexpr uint64_t kMaxBytesPerRequest = 2 * 1024 * 1024;
+  static constexpr std::chrono::milliseconds kMaxBatchLatency{5};
+  static constexpr uint64_t kDefaultMaxQueuedEvents = 1'000'000;
+  static constexpr std::chrono::milliseconds kStatsEventsPeriod{100};
+  // Leaves room for the longest suffix, " dropped events", and for the terminating null character.
+  static constexpr size_t kMaxStatsEventsNameLength = orbit_api::kMaxEventStringSize - 16;
+
   void BuildAndStart(const std::shared_ptr<grpc::Channel>& channel) override {
     CaptureEventProducer::BuildAndStart(channel);
 
@@ -41,27 +66,74 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
     CaptureEventProducer::ShutdownAndWait();
   }
 
-  void EnqueueIntermediateEvent(const IntermediateEventT& event) {
+  // Returns false if the event was dropped because the lock-free queue is full.
+  bool EnqueueIntermediateEvent(const IntermediateEventT& event) {
+    if (!TryReserveQueueSlot()) return false;
     lock_free_queue_.enqueue(event);
+    return true;
   }
 
-  void EnqueueIntermediateEvent(IntermediateEventT&& event) {
+  bool EnqueueIntermediateEvent(IntermediateEventT&& event) {
+    if (!TryReserveQueueSlot()) return false;
     lock_free_queue_.enqueue(std::move(event));
+    return true;
   }
 
+  // Returns true if the event was enqueued, i.e., if a capture is in progress and the lock-free
+  // queue is not full.
   bool EnqueueIntermediateEventIfCapturing(
       const std::function<IntermediateEventT()>& event_builder_if_capturing) {
     if (IsCapturing()) {
+      if (!TryReserveQueueSlot()) return false;
       lock_free_queue_.enqueue(event_builder_if_capturing());
       return true;
     }
     return false;
   }
 
+  // Enqueues the count events starting at first (e.g., a std::move_iterator) all at once, which is
+  // cheaper than enqueuing them one by one. Returns true if the events were enqueued, i.e., if a
+  // capture is in progress and the lock-free queue has room for all of them. Otherwise, none of
+  // them is enqueued.
+  template <typename InputIterator>
+  bool EnqueueIntermediateEventsIfCapturing(InputIterator first, size_t count) {
+    if (count == 0) {
+      return IsCapturing();
+    }
+    if (IsCapturing()) {
+      if (!TryReserveQueueSlots(count)) return false;
+      lock_free_queue_.enqueue_bulk(first, count);
+      return true;
+    }
+    return false;
+  }
+
+  // Caps the number of events waiting in the lock-free queue. This only approximately bounds the
+  // memory used by the queue, as the size of an event, including the memory it owns, varies.
+  void SetMaxQueuedEvents(uint64_t max_queued_events) { max_queued_events_ = max_queued_events; }
+
+  // Number of events dropped during the current (or last) capture because the queue was full.
+  [[nodiscard]] uint64_t GetNumDroppedEvents() const { return num_dropped_events_; }
+
+  // When enabled, the producer periodically sends, as part of the captures with
+  // CaptureOptions::enable_introspection, the number of events in its queue, the number of bytes it
+  // sent and the number of events it dropped. These are sent as IntrospectionScopes encoding manual
+  // instrumentation track values (see Orbit.h), so they appear as tracks of the target process
+  // named "<name> queue depth" and so on. As the encoded events carry the track names, name can
+  // have at most kMaxStatsEventsNameLength characters.
+  void EnableStatsEvents(const std::string& name) {
+    CHECK(name.size() <= kMaxStatsEventsNameLength);
+    absl::MutexLock lock{&status_mutex_};
+    stats_events_name_ = name;
+  }
+
  protected:
-  void OnCaptureStart() override {
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override {
+    num_dropped_events_ = 0;
+    num_bytes_sent_ = 0;
     absl::MutexLock lock{&status_mutex_};
     status_ = ProducerStatus::kShouldSendEvents;
+    introspection_enabled_ = capture_options.enable_introspection();
   }
 
   void OnCaptureStop() override {
@@ -80,42 +152,140 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
       IntermediateEventT&& intermediate_event) = 0;
 
  private:
+  [[nodiscard]] bool TryReserveQueueSlot() { return TryReserveQueueSlots(1); }
+
+  [[nodiscard]] bool TryReserveQueueSlots(uint64_t count) {
+    if (queued_event_count_.fetch_add(count, std::memory_order_relaxed) + count >
+        max_queued_events_.load(std::memory_order_relaxed)) {
+      queued_event_count_.fetch_sub(count, std::memory_order_relaxed);
+      num_dropped_events_.fetch_add(count, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  void AddStatsEvents(
+      google::protobuf::RepeatedPtrField<orbit_grpc_protos::CaptureEvent>* capture_events,
+      int32_t pid, int32_t tid, uint64_t timestamp_ns) {
+    std::string stats_events_name;
+    {
+      absl::MutexLock lock{&status_mutex_};
+      stats_events_name = stats_events_name_;
+    }
+    auto add_track_value = [&](const std::string& name_suffix, uint64_t value) {
+      const std::string name = stats_events_name + name_suffix;
+      orbit_api::EncodedEvent encoded_event(orbit_api::kTrackUint64, name.c_str(), value);
+      orbit_grpc_protos::IntrospectionScope* scope =
+          capture_events->Add()->mutable_introspection_scope();
+      scope->set_pid(pid);
+      scope->set_tid(tid);
+      scope->set_begin_timestamp_ns(timestamp_ns);
+      scope->set_end_timestamp_ns(timestamp_ns);
+      scope->mutable_registers()->Reserve(6);
+      for (uint64_t arg : encoded_event.args) {
+        scope->add_registers(arg);
+      }
+    };
+    add_track_value(" queue depth", queued_event_count_.load(std::memory_order_relaxed));
+    add_track_value(" bytes sent", num_bytes_sent_.load(std::memory_order_relaxed));
+    add_track_value(" dropped events", num_dropped_events_.load(std::memory_order_relaxed));
+  }
+
   void ForwarderThread() {
-    constexpr uint64_t kMaxEventsPerRequest = 10'000;
+    constexpr uint64_t kMaxBatchLatencyNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(kMaxBatchLatency).count();
+    constexpr uint64_t kStatsEventsPeriodNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(kStatsEventsPeriod).count();
+
+    const int32_t pid = getpid();
+    const int32_t tid = orbit_base::GetCurrentThreadId();
+
     std::vector<IntermediateEventT> dequeued_events(kMaxEventsPerRequest);
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest send_request;
+    auto* capture_events = send_request.mutable_buffered_capture_events()->mutable_capture_events();
+    uint64_t batch_size_bytes = 0;
+    uint64_t batch_start_timestamp_ns = 0;
+    uint64_t last_stats_events_timestamp_ns = 0;
+
+    // Returns false if sending failed, in which case the batch is dropped.
+    auto send_batch = [&]() {
+      if (capture_events->empty()) return true;
+      bool sent = SendCaptureEvents(send_request);
+      if (sent) {
+        num_bytes_sent_.fetch_add(batch_size_bytes, std::memory_order_relaxed);
+      } else {
+        ERROR("Forwarding %d CaptureEvents", capture_events->size());
+      }
+      // Clear() keeps the CaptureEvents allocated, so that they can be reused by the next batch.
+      capture_events->Clear();
+      batch_size_bytes = 0;
+      return sent;
+    };
+
     while (!shutdown_requested_) {
       while (true) {
         size_t dequeued_event_count =
             lock_free_queue_.try_dequeue_bulk(dequeued_events.begin(), kMaxEventsPerRequest);
+        queued_event_count_.fetch_sub(dequeued_event_count, std::memory_order_relaxed);
         bool queue_was_emptied = dequeued_event_count < kMaxEventsPerRequest;
 
         ProducerStatus current_status;
+        bool stats_events_enabled;
         {
           absl::MutexLock lock{&status_mutex_};
           current_status = status_;
+          stats_events_enabled = introspection_enabled_ && !stats_events_name_.empty();
           if (status_ == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied) {
             // We are about to send AllEventsSent: update status_ while we hold the mutex.
             status_ = ProducerStatus::kShouldDropEvents;
           }
         }
 
-        if ((current_status == ProducerStatus::kShouldSendEvents ||
-             current_status == ProducerStatus::kShouldNotifyAllEventsSent) &&
-            dequeued_event_count > 0) {
-          orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest send_request;
-          auto* capture_events =
-              send_request.mutable_buffered_capture_events()->mutable_capture_events();
-          for (size_t i = 0; i < dequeued_event_count; ++i) {
-            orbit_grpc_protos::CaptureEvent* event = capture_events->Add();
-            *event = TranslateIntermediateEvent(std::move(dequeued_events[i]));
+        if (current_status == ProducerStatus::kShouldDropEvents) {
+          // The events extracted from the lock_free_queue_ are just dropped, together with the
+          // events of the current batch that haven't been sent.
+          capture_events->Clear();
+          batch_size_bytes = 0;
+          if (queue_was_emptied) {
+            break;
+          }
+          continue;
+        }
+
+        const uint64_t now_ns = MonotonicTimestampNs();
+        if (capture_events->empty()) {
+          batch_start_timestamp_ns = now_ns;
+        }
+        bool send_failed = false;
+        for (size_t i = 0; i < dequeued_event_count && !send_failed; ++i) {
+          orbit_grpc_protos::CaptureEvent* event = capture_events->Add();
+          *event = TranslateIntermediateEvent(std::move(dequeued_events[i]));
+          batch_size_bytes += event->ByteSizeLong();
+          if (batch_size_bytes >= kMaxBytesPerRequest ||
+              static_cast<uint64_t>(capture_events->size()) >= kMaxEventsPerRequest) {
+            send_failed = !send_batch();
+            batch_start_timestamp_ns = now_ns;
           }
-          if (!SendCaptureEvents(send_request)) {
-            ERROR("Forwarding %lu CaptureEvents", dequeued_event_count);
+        }
+        if (send_failed) {
+          break;
+        }
+
+        if (stats_events_enabled && current_status == ProducerStatus::kShouldSendEvents &&
+            now_ns - last_stats_events_timestamp_ns >= kStatsEventsPeriodNs) {
+          AddStatsEvents(capture_events, pid, tid, now_ns);
+          last_stats_events_timestamp_ns = now_ns;
+        }
+
+        const bool notify_all_events_sent =
+            current_status == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied;
+        if (notify_all_events_sent || now_ns - batch_start_timestamp_ns >= kMaxBatchLatencyNs) {
+          if (!send_batch()) {
             break;
           }
         }
 
-        if (current_status == ProducerStatus::kShouldNotifyAllEventsSent && queue_was_emptied) {
+        if (notify_all_events_sent) {
           // lock_free_queue_ is now empty and status_ == kShouldNotifyAllEventsSent,
           // send AllEventsSent. status_ has already been changed to kShouldDropEvents.
           if (!NotifyAllEventsSent()) {
@@ -124,9 +294,6 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
           break;
         }
 
-        // Note that if current_status == ProducerStatus::kShouldDropEvents
-        // the events extracted from the lock_free_queue_ will just be dropped.
-
         if (queue_was_emptied) {
           break;
         }
@@ -140,12 +307,18 @@ class LockFreeBufferCaptureEventProducer : public CaptureEventProducer {
 
  private:
   moodycamel::ConcurrentQueue<IntermediateEventT> lock_free_queue_;
+  std::atomic<uint64_t> queued_event_count_ = 0;
+  std::atomic<uint64_t> max_queued_events_ = kDefaultMaxQueuedEvents;
+  std::atomic<uint64_t> num_dropped_events_ = 0;
+  std::atomic<uint64_t> num_bytes_sent_ = 0;
 
   std::thread forwarder_thread_;
   std::atomic<bool> shutdown_requested_ = false;
 
   enum class ProducerStatus { kShouldSendEvents, kShouldNotifyAllEventsSent, kShouldDropEvents };
   ProducerStatus status_ = ProducerStatus::kShouldDropEvents;
+  std::string stats_events_name_;
+  bool introspection_enabled_ = false;
   absl::Mutex status_mutex_;
 };
 
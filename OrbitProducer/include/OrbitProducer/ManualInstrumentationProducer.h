@@ -0,0 +1,67 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_PRODUCER_MANUAL_INSTRUMENTATION_PRODUCER_H_
+#define ORBIT_PRODUCER_MANUAL_INSTRUMENTATION_PRODUCER_H_
+
+#include <cstdint>
+
+#include "../../../OrbitApiEvents.h"
+#include "OrbitProducer/LockFreeBufferCaptureEventProducer.h"
+
+namespace orbit_producer {
+
+// Manual instrumentation event as recorded by the instrumented thread. Scopes (Start/Stop) are
+// recorded once, when they end.
+struct ManualInstrumentationEvent {
+  int32_t tid = 0;
+  uint64_t begin_timestamp_ns = 0;
+  uint64_t end_timestamp_ns = 0;
+  int32_t depth = 0;
+  orbit_api::EncodedEvent encoded_event{orbit_api::kNone};
+};
+
+// Producer that records the events of the manual instrumentation API (Orbit.h) in-process and
+// sends them to OrbitService as IntrospectionScopes. The client turns these into kIntrospection
+// TimerInfos and decodes the encoded event they carry, as it does for the introspection of
+// OrbitService, instead of matching them to the "ORBIT_STUB" functions like the events of uprobes.
+// While a capture is running, the producer installs itself as the in-process producer of Orbit.h
+// (see OrbitApiEvents.h), so that instrumented code calls into it instead of calling the stubs.
+// Events are then written to the lock-free queue of LockFreeBufferCaptureEventProducer, which keeps
+// a sub-queue per producing thread, so recording an event costs tens of nanoseconds instead of the
+// several microseconds of a uprobe.
+//
+// The target process needs to link OrbitProducer and to bring up a single instance of this class
+// (usually a global) before instrumented code runs. The instance must outlive all instrumented
+// threads.
+class ManualInstrumentationProducer
+    : public LockFreeBufferCaptureEventProducer<ManualInstrumentationEvent> {
+ public:
+  ManualInstrumentationProducer();
+  ~ManualInstrumentationProducer() override;
+
+  ManualInstrumentationProducer(const ManualInstrumentationProducer&) = delete;
+  ManualInstrumentationProducer& operator=(const ManualInstrumentationProducer&) = delete;
+  ManualInstrumentationProducer(ManualInstrumentationProducer&&) = delete;
+  ManualInstrumentationProducer& operator=(ManualInstrumentationProducer&&) = delete;
+
+ protected:
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override;
+  void OnCaptureStop() override;
+  void OnCaptureFinished() override;
+
+  [[nodiscard]] orbit_grpc_protos::CaptureEvent TranslateIntermediateEvent(
+      ManualInstrumentationEvent&& intermediate_event) override;
+
+ private:
+  static void OnStart(const orbit_api::EncodedEvent& event);
+  static void OnStop();
+  static void OnRecord(const orbit_api::EncodedEvent& event);
+
+  static const orbit_api::InProcessProducerCallbacks kCallbacks;
+};
+
+}  // namespace orbit_producer
+
+#endif  // ORBIT_PRODUCER_MANUAL_INSTRUMENTATION_PRODUCER_H_
@@ -0,0 +1,277 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "OrbitProducerSideChannel/SharedMemoryRing.h"
+
+#include <absl/strings/str_format.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+
+namespace orbit_producer_side_channel {
+
+namespace {
+
+constexpr uint64_t kSharedMemoryRingMagic = 0x4f5242495452494e;  // "ORBITRIN"
+constexpr const char* kSharedMemoryRingMemfdName = "orbit-producer-side-ring";
+// The size can neither change nor be unsealed.
+constexpr int kSharedMemoryRingSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// Each message in the ring is preceded by its size.
+using MessageSizeT = uint32_t;
+
+uint64_t GetMetadataPageSize() { return static_cast<uint64_t>(sysconf(_SC_PAGESIZE)); }
+
+// Copies count bytes starting at index, possibly wrapping around the end of the ring.
+void CopyToRing(char* ring_buffer, uint64_t ring_buffer_size, uint64_t index, const void* source,
+                uint64_t count) {
+  const uint64_t index_mod_size = index & (ring_buffer_size - 1);
+  const uint64_t first_count = std::min(count, ring_buffer_size - index_mod_size);
+  memcpy(ring_buffer + index_mod_size, source, first_count);
+  memcpy(ring_buffer, static_cast<const char*>(source) + first_count, count - first_count);
+}
+
+void CopyFromRing(const char* ring_buffer, uint64_t ring_buffer_size, uint64_t index, void* dest,
+                  uint64_t count) {
+  const uint64_t index_mod_size = index & (ring_buffer_size - 1);
+  const uint64_t first_count = std::min(count, ring_buffer_size - index_mod_size);
+  memcpy(dest, ring_buffer + index_mod_size, first_count);
+  memcpy(static_cast<char*>(dest) + first_count, ring_buffer, count - first_count);
+}
+
+}  // namespace
+
+SharedMemoryRingWriter::SharedMemoryRingWriter(int fd, void* mmap_address, uint64_t mmap_length)
+    : fd_{fd},
+      mmap_address_{mmap_address},
+      mmap_length_{mmap_length},
+      metadata_{static_cast<SharedMemoryRingMetadata*>(mmap_address)},
+      ring_buffer_{static_cast<char*>(mmap_address) + GetMetadataPageSize()},
+      ring_buffer_size_{mmap_length - GetMetadataPageSize()} {}
+
+SharedMemoryRingWriter::~SharedMemoryRingWriter() {
+  if (munmap(mmap_address_, mmap_length_) != 0) {
+    ERROR("munmap: %s", SafeStrerror(errno));
+  }
+  close(fd_);
+}
+
+ErrorMessageOr<std::unique_ptr<SharedMemoryRingWriter>> SharedMemoryRingWriter::Create(
+    uint64_t data_size) {
+  if (data_size == 0 || __builtin_popcountl(data_size) != 1) {
+    return ErrorMessage(absl::StrFormat("Size of shared memory ring %u is not a power of two",
+                                        data_size));
+  }
+
+  int fd = memfd_create(kSharedMemoryRingMemfdName, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd == -1) {
+    return ErrorMessage(absl::StrFormat("memfd_create: %s", SafeStrerror(errno)));
+  }
+
+  // Seal the size before the reader can map the object, so that it can rely on it.
+  const uint64_t mmap_length = GetMetadataPageSize() + data_size;
+  void* mmap_address = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(mmap_length)) == 0 &&
+      fcntl(fd, F_ADD_SEALS, kSharedMemoryRingSeals) == 0) {
+    mmap_address = mmap(nullptr, mmap_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (mmap_address == MAP_FAILED) {
+    int saved_errno = errno;
+    close(fd);
+    return ErrorMessage(
+        absl::StrFormat("Creating shared memory ring: %s", SafeStrerror(saved_errno)));
+  }
+
+  // ftruncate zero-fills the object, so the atomics already hold zero.
+  auto* metadata = static_cast<SharedMemoryRingMetadata*>(mmap_address);
+  metadata->data_size = data_size;
+  metadata->magic = kSharedMemoryRingMagic;
+
+  return std::unique_ptr<SharedMemoryRingWriter>(
+      new SharedMemoryRingWriter(fd, mmap_address, mmap_length));
+}
+
+bool SharedMemoryRingWriter::IsReaderAttached() const {
+  return metadata_->reader_attached.load(std::memory_order_acquire) != 0;
+}
+
+bool SharedMemoryRingWriter::TryWriteMessage(const google::protobuf::MessageLite& message) {
+  if (!IsReaderAttached()) {
+    return false;
+  }
+  if (metadata_->num_messages_received_outside_ring.load(std::memory_order_acquire) !=
+      num_messages_sent_outside_ring_) {
+    return false;
+  }
+
+  const size_t message_size = message.ByteSizeLong();
+  const uint64_t record_size = sizeof(MessageSizeT) + message_size;
+  if (message_size > std::numeric_limits<MessageSizeT>::max() || record_size > ring_buffer_size_) {
+    return false;
+  }
+
+  // Only this class writes data_head, while the reader concurrently advances data_tail.
+  const uint64_t head = metadata_->data_head.load(std::memory_order_relaxed);
+  const uint64_t tail = metadata_->data_tail.load(std::memory_order_acquire);
+  if (head + record_size - tail > ring_buffer_size_) {
+    return false;
+  }
+
+  const auto message_size_to_write = static_cast<MessageSizeT>(message_size);
+  CopyToRing(ring_buffer_, ring_buffer_size_, head, &message_size_to_write, sizeof(MessageSizeT));
+
+  const uint64_t message_index_mod_size = (head + sizeof(MessageSizeT)) & (ring_buffer_size_ - 1);
+  if (message_index_mod_size + message_size <= ring_buffer_size_) {
+    // This is the common case, in which the message is serialized directly into the ring.
+    message.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t*>(ring_buffer_ + message_index_mod_size));
+  } else {
+    serialization_buffer_.resize(message_size);
+    message.SerializeWithCachedSizesToArray(
+        reinterpret_cast<uint8_t*>(serialization_buffer_.data()));
+    CopyToRing(ring_buffer_, ring_buffer_size_, head + sizeof(MessageSizeT),
+               serialization_buffer_.data(), message_size);
+  }
+
+  metadata_->data_head.store(head + record_size, std::memory_order_release);
+  return true;
+}
+
+SharedMemoryRingReader::SharedMemoryRingReader(void* mmap_address, uint64_t mmap_length)
+    : mmap_address_{mmap_address},
+      mmap_length_{mmap_length},
+      metadata_{static_cast<SharedMemoryRingMetadata*>(mmap_address)},
+      ring_buffer_{static_cast<const char*>(mmap_address) + GetMetadataPageSize()},
+      ring_buffer_size_{mmap_length - GetMetadataPageSize()} {}
+
+SharedMemoryRingReader::~SharedMemoryRingReader() {
+  metadata_->reader_attached.store(0, std::memory_order_release);
+  if (munmap(mmap_address_, mmap_length_) != 0) {
+    ERROR("munmap: %s", SafeStrerror(errno));
+  }
+}
+
+ErrorMessageOr<std::unique_ptr<SharedMemoryRingReader>> SharedMemoryRingReader::Attach(
+    int32_t writer_pid, int32_t writer_fd) {
+  if (writer_pid <= 0 || writer_fd < 0) {
+    return ErrorMessage(absl::StrFormat("Invalid shared memory ring %d of process %d", writer_fd,
+                                        writer_pid));
+  }
+  const std::string name = absl::StrFormat("/proc/%d/fd/%d", writer_pid, writer_fd);
+
+  // The path is chosen by the producer: don't let it make us a controlling terminal or block on a
+  // FIFO, and only map a regular file (which a memfd is).
+  int fd = open(name.c_str(), O_RDWR | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+  if (fd == -1) {
+    return ErrorMessage(absl::StrFormat("open \"%s\": %s", name, SafeStrerror(errno)));
+  }
+
+  // The writer is another process: if it could shrink the object while it is mapped here, reading
+  // the ring would cause SIGBUS. The seals can't be removed, so the size read below is final.
+  const int seals = fcntl(fd, F_GET_SEALS);
+  if (seals == -1 || (seals & kSharedMemoryRingSeals) != kSharedMemoryRingSeals) {
+    close(fd);
+    return ErrorMessage(
+        absl::StrFormat("\"%s\" is not a shared memory object with a sealed size", name));
+  }
+
+  struct stat stat_buf {};
+  if (fstat(fd, &stat_buf) != 0) {
+    int saved_errno = errno;
+    close(fd);
+    return ErrorMessage(absl::StrFormat("fstat \"%s\": %s", name, SafeStrerror(saved_errno)));
+  }
+  if (!S_ISREG(stat_buf.st_mode)) {
+    close(fd);
+    return ErrorMessage(absl::StrFormat("\"%s\" is not a regular file", name));
+  }
+
+  const auto mmap_length = static_cast<uint64_t>(stat_buf.st_size);
+  const uint64_t data_size = mmap_length - GetMetadataPageSize();
+  if (mmap_length <= GetMetadataPageSize() || __builtin_popcountl(data_size) != 1) {
+    close(fd);
+    return ErrorMessage(
+        absl::StrFormat("Shared memory ring \"%s\" has invalid size %u", name, mmap_length));
+  }
+
+  void* mmap_address = mmap(nullptr, mmap_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int saved_errno = errno;
+  close(fd);
+  if (mmap_address == MAP_FAILED) {
+    return ErrorMessage(absl::StrFormat("Mapping shared memory ring \"%s\": %s", name,
+                                        SafeStrerror(saved_errno)));
+  }
+
+  auto* metadata = static_cast<SharedMemoryRingMetadata*>(mmap_address);
+  if (metadata->magic != kSharedMemoryRingMagic || metadata->data_size != data_size) {
+    munmap(mmap_address, mmap_length);
+    return ErrorMessage(absl::StrFormat("\"%s\" is not a valid shared memory ring", name));
+  }
+
+  auto reader =
+      std::unique_ptr<SharedMemoryRingReader>(new SharedMemoryRingReader(mmap_address, mmap_length));
+  metadata->reader_attached.store(1, std::memory_order_release);
+  return reader;
+}
+
+void SharedMemoryRingReader::OnMessageReceivedOutsideRing() {
+  metadata_->num_messages_received_outside_ring.fetch_add(1, std::memory_order_release);
+}
+
+bool SharedMemoryRingReader::HasNewData() const {
+  return metadata_->data_head.load(std::memory_order_acquire) !=
+         metadata_->data_tail.load(std::memory_order_relaxed);
+}
+
+bool SharedMemoryRingReader::TryReadMessage(google::protobuf::MessageLite* message) {
+  const uint64_t head = metadata_->data_head.load(std::memory_order_acquire);
+  // Only this class writes data_tail.
+  const uint64_t tail = metadata_->data_tail.load(std::memory_order_relaxed);
+  if (head == tail) {
+    return false;
+  }
+
+  const uint64_t available = head - tail;
+  MessageSizeT message_size = 0;
+  if (available >= sizeof(MessageSizeT) && available <= ring_buffer_size_) {
+    CopyFromRing(ring_buffer_, ring_buffer_size_, tail, &message_size, sizeof(MessageSizeT));
+  }
+  if (available < sizeof(MessageSizeT) || available > ring_buffer_size_ ||
+      sizeof(MessageSizeT) + message_size > available) {
+    ERROR("Shared memory ring is inconsistent (head %u, tail %u): dropping its content", head,
+          tail);
+    metadata_->data_tail.store(head, std::memory_order_release);
+    return false;
+  }
+
+  const uint64_t message_index_mod_size = (tail + sizeof(MessageSizeT)) & (ring_buffer_size_ - 1);
+  bool parsed;
+  if (message_index_mod_size + message_size <= ring_buffer_size_) {
+    parsed = message->ParseFromArray(ring_buffer_ + message_index_mod_size,
+                                     static_cast<int>(message_size));
+  } else {
+    parse_buffer_.resize(message_size);
+    CopyFromRing(ring_buffer_, ring_buffer_size_, tail + sizeof(MessageSizeT), parse_buffer_.data(),
+                 message_size);
+    parsed = message->ParseFromString(parse_buffer_);
+  }
+
+  metadata_->data_tail.store(tail + sizeof(MessageSizeT) + message_size,
+                             std::memory_order_release);
+  if (!parsed) {
+    ERROR("Parsing message from shared memory ring");
+  }
+  return parsed;
+}
+
+}  // namespace orbit_producer_side_channel
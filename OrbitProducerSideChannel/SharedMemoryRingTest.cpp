@@ -0,0 +1,164 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "OrbitProducerSideChannel/SharedMemoryRing.h"
+#include "capture.pb.h"
+#include "producer_side_services.pb.h"
+
+namespace orbit_producer_side_channel {
+
+namespace {
+
+constexpr uint64_t kSmallRingSize = 4096;
+
+orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents CreateEvents(
+    int32_t num_events, uint64_t first_timestamp_ns) {
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents events;
+  for (int32_t i = 0; i < num_events; ++i) {
+    orbit_grpc_protos::SchedulingSlice* scheduling_slice =
+        events.add_capture_events()->mutable_scheduling_slice();
+    scheduling_slice->set_pid(42);
+    scheduling_slice->set_tid(43 + i);
+    scheduling_slice->set_out_timestamp_ns(first_timestamp_ns + i);
+  }
+  return events;
+}
+
+std::unique_ptr<SharedMemoryRingWriter> CreateWriter(uint64_t data_size) {
+  auto writer_or_error = SharedMemoryRingWriter::Create(data_size);
+  EXPECT_FALSE(writer_or_error.has_error());
+  if (writer_or_error.has_error()) return nullptr;
+  return std::move(writer_or_error.value());
+}
+
+std::unique_ptr<SharedMemoryRingReader> AttachReader(const SharedMemoryRingWriter& writer) {
+  auto reader_or_error = SharedMemoryRingReader::Attach(getpid(), writer.GetFd());
+  EXPECT_FALSE(reader_or_error.has_error());
+  if (reader_or_error.has_error()) return nullptr;
+  return std::move(reader_or_error.value());
+}
+
+}  // namespace
+
+TEST(SharedMemoryRing, WriteFailsUntilReaderIsAttached) {
+  std::unique_ptr<SharedMemoryRingWriter> writer = CreateWriter(kSmallRingSize);
+  ASSERT_NE(writer, nullptr);
+  EXPECT_FALSE(writer->IsReaderAttached());
+  EXPECT_FALSE(writer->TryWriteMessage(CreateEvents(1, 0)));
+
+  std::unique_ptr<SharedMemoryRingReader> reader = AttachReader(*writer);
+  ASSERT_NE(reader, nullptr);
+  EXPECT_TRUE(writer->IsReaderAttached());
+  EXPECT_TRUE(writer->TryWriteMessage(CreateEvents(1, 0)));
+
+  reader.reset();
+  EXPECT_FALSE(writer->IsReaderAttached());
+}
+
+TEST(SharedMemoryRing, MessagesAreReadInOrderAcrossWrapAround) {
+  std::unique_ptr<SharedMemoryRingWriter> writer = CreateWriter(kSmallRingSize);
+  ASSERT_NE(writer, nullptr);
+  std::unique_ptr<SharedMemoryRingReader> reader = AttachReader(*writer);
+  ASSERT_NE(reader, nullptr);
+
+  // Messages of varying sizes, so that both message sizes and messages wrap around the ring.
+  uint64_t next_timestamp_written = 0;
+  uint64_t next_timestamp_read = 0;
+  for (int32_t iteration = 0; iteration < 200; ++iteration) {
+    const int32_t num_events = 1 + iteration % 13;
+    ASSERT_TRUE(writer->TryWriteMessage(CreateEvents(num_events, next_timestamp_written)));
+    next_timestamp_written += num_events;
+
+    ASSERT_TRUE(reader->HasNewData());
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents events;
+    ASSERT_TRUE(reader->TryReadMessage(&events));
+    ASSERT_EQ(events.capture_events_size(), num_events);
+    for (const orbit_grpc_protos::CaptureEvent& event : events.capture_events()) {
+      EXPECT_EQ(event.scheduling_slice().out_timestamp_ns(), next_timestamp_read);
+      ++next_timestamp_read;
+    }
+    EXPECT_FALSE(reader->HasNewData());
+  }
+
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents events;
+  EXPECT_FALSE(reader->TryReadMessage(&events));
+}
+
+TEST(SharedMemoryRing, WriteFailsWhenRingIsFull) {
+  std::unique_ptr<SharedMemoryRingWriter> writer = CreateWriter(kSmallRingSize);
+  ASSERT_NE(writer, nullptr);
+  std::unique_ptr<SharedMemoryRingReader> reader = AttachReader(*writer);
+  ASSERT_NE(reader, nullptr);
+
+  // Larger than the whole ring.
+  EXPECT_FALSE(writer->TryWriteMessage(CreateEvents(1000, 0)));
+
+  int num_written = 0;
+  while (writer->TryWriteMessage(CreateEvents(10, 0))) {
+    ++num_written;
+  }
+  ASSERT_GT(num_written, 0);
+
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents events;
+  ASSERT_TRUE(reader->TryReadMessage(&events));
+  EXPECT_TRUE(writer->TryWriteMessage(CreateEvents(10, 0)));
+
+  int num_read = 1;
+  while (reader->TryReadMessage(&events)) {
+    ++num_read;
+  }
+  EXPECT_EQ(num_read, num_written + 1);
+}
+
+TEST(SharedMemoryRing, WriteFailsUntilMessagesSentOutsideRingAreReceived) {
+  std::unique_ptr<SharedMemoryRingWriter> writer = CreateWriter(kSmallRingSize);
+  ASSERT_NE(writer, nullptr);
+  std::unique_ptr<SharedMemoryRingReader> reader = AttachReader(*writer);
+  ASSERT_NE(reader, nullptr);
+
+  writer->OnMessageSentOutsideRing();
+  writer->OnMessageSentOutsideRing();
+  EXPECT_FALSE(writer->TryWriteMessage(CreateEvents(1, 0)));
+  reader->OnMessageReceivedOutsideRing();
+  EXPECT_FALSE(writer->TryWriteMessage(CreateEvents(1, 0)));
+  reader->OnMessageReceivedOutsideRing();
+  EXPECT_TRUE(writer->TryWriteMessage(CreateEvents(1, 0)));
+}
+
+TEST(SharedMemoryRing, InvalidArguments) {
+  EXPECT_TRUE(SharedMemoryRingWriter::Create(3000).has_error());
+  EXPECT_TRUE(SharedMemoryRingReader::Attach(0, 0).has_error());
+  EXPECT_TRUE(SharedMemoryRingReader::Attach(getpid(), -1).has_error());
+
+  // A shared memory object whose size is not sealed.
+  int fd = memfd_create("not-sealed", MFD_CLOEXEC);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(ftruncate(fd, 2 * kSmallRingSize), 0);
+  EXPECT_TRUE(SharedMemoryRingReader::Attach(getpid(), fd).has_error());
+  close(fd);
+
+  // A shared memory object whose seals could still be changed.
+  fd = memfd_create("not-sealed-for-good", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(ftruncate(fd, 2 * kSmallRingSize), 0);
+  ASSERT_EQ(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW), 0);
+  EXPECT_TRUE(SharedMemoryRingReader::Attach(getpid(), fd).has_error());
+  close(fd);
+
+  // Not a regular file.
+  int pipe_fds[2];
+  ASSERT_EQ(pipe2(pipe_fds, O_CLOEXEC), 0);
+  EXPECT_TRUE(SharedMemoryRingReader::Attach(getpid(), pipe_fds[0]).has_error());
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+}  // namespace orbit_producer_side_channel
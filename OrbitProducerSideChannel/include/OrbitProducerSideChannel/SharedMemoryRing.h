@@ -0,0 +1,122 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_PRODUCER_SIDE_CHANNEL_SHARED_MEMORY_RING_H_
+#define ORBIT_PRODUCER_SIDE_CHANNEL_SHARED_MEMORY_RING_H_
+
+#include <google/protobuf/message_lite.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "OrbitBase/Result.h"
+
+namespace orbit_producer_side_channel {
+
+// The first page of a shared memory ring, followed by the ring itself. As with perf_event_open
+// ring buffers, head and tail only ever increase, and the position in the ring is obtained by
+// masking them with the (power of two) size of the ring.
+struct SharedMemoryRingMetadata {
+  uint64_t magic;
+  uint64_t data_size;
+  // Written by the writer, read by the reader.
+  alignas(64) std::atomic<uint64_t> data_head;
+  // Written by the reader, read by the writer.
+  alignas(64) std::atomic<uint64_t> data_tail;
+  alignas(64) std::atomic<uint32_t> reader_attached;
+  // Written by the reader, read by the writer.
+  alignas(64) std::atomic<uint64_t> num_messages_received_outside_ring;
+};
+
+// Default size of the ring created by producers. It needs to be a power of two and comfortably
+// larger than the batches of CaptureEvents that LockFreeBufferCaptureEventProducer sends at once.
+constexpr uint64_t kDefaultSharedMemoryRingSize = 8 * 1024 * 1024;
+
+// The writing end of a single-producer single-consumer ring of length-prefixed protobuf messages in
+// shared memory. A producer of CaptureEvents creates one per connection to OrbitService, announces
+// its pid and file descriptor on the gRPC stream, and, once OrbitService has attached to it, writes
+// its serialized BufferedCaptureEvents there instead of to the stream. Messages are serialized
+// directly into the shared memory, so that they are copied exactly once on the way to OrbitService.
+// The shared memory is a memfd sealed against shrinking and growing, so that the writer can't cause
+// accesses beyond the end of the object (and SIGBUS) in the reader.
+// TryWriteMessage is not thread safe.
+class SharedMemoryRingWriter {
+ public:
+  ~SharedMemoryRingWriter();
+
+  SharedMemoryRingWriter(const SharedMemoryRingWriter&) = delete;
+  SharedMemoryRingWriter& operator=(const SharedMemoryRingWriter&) = delete;
+
+  // Creates a new shared memory object with a ring of data_size bytes (a power of two).
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<SharedMemoryRingWriter>> Create(
+      uint64_t data_size = kDefaultSharedMemoryRingSize);
+
+  // The file descriptor of the shared memory object, which the reader opens through
+  // /proc/<pid>/fd/<fd>. It stays open as long as this object exists.
+  [[nodiscard]] int GetFd() const { return fd_; }
+  [[nodiscard]] bool IsReaderAttached() const;
+
+  // Returns false, without writing anything, if the reader is not attached, if there is not enough
+  // free space in the ring, or if the reader hasn't yet received all the messages sent outside the
+  // ring. The caller is then expected to send the message in another way, and to call
+  // OnMessageSentOutsideRing.
+  [[nodiscard]] bool TryWriteMessage(const google::protobuf::MessageLite& message);
+  // Until the reader has received a message sent outside the ring (see
+  // SharedMemoryRingReader::OnMessageReceivedOutsideRing), TryWriteMessage fails, as messages
+  // written to the ring in the meantime could otherwise overtake it.
+  void OnMessageSentOutsideRing() { ++num_messages_sent_outside_ring_; }
+
+ private:
+  SharedMemoryRingWriter(int fd, void* mmap_address, uint64_t mmap_length);
+
+  int fd_;
+  void* mmap_address_;
+  uint64_t mmap_length_;
+  SharedMemoryRingMetadata* metadata_;
+  char* ring_buffer_;
+  uint64_t ring_buffer_size_;
+  uint64_t num_messages_sent_outside_ring_ = 0;
+  std::string serialization_buffer_;
+};
+
+// The reading end of the ring, used by OrbitService.
+class SharedMemoryRingReader {
+ public:
+  ~SharedMemoryRingReader();
+
+  SharedMemoryRingReader(const SharedMemoryRingReader&) = delete;
+  SharedMemoryRingReader& operator=(const SharedMemoryRingReader&) = delete;
+
+  // Maps the ring created by a SharedMemoryRingWriter in process writer_pid, with file descriptor
+  // writer_fd in that process, and marks the ring as attached, after which the writer starts using
+  // it. Fails unless writer_fd is a shared memory object whose size is sealed for good. The caller
+  // must have checked that writer_pid is the process it is talking to.
+  [[nodiscard]] static ErrorMessageOr<std::unique_ptr<SharedMemoryRingReader>> Attach(
+      int32_t writer_pid, int32_t writer_fd);
+
+  [[nodiscard]] bool HasNewData() const;
+  // Consumes the next message and parses it into *message. Returns false if the ring was empty or
+  // if the message could not be parsed. As the content of the ring comes from another process, it
+  // is validated: if it is inconsistent, ERROR is logged and all the data in the ring is dropped.
+  [[nodiscard]] bool TryReadMessage(google::protobuf::MessageLite* message);
+  // To be called once a message that the writer sent outside the ring has been processed, after
+  // which the writer can go back to the ring.
+  void OnMessageReceivedOutsideRing();
+
+ private:
+  SharedMemoryRingReader(void* mmap_address, uint64_t mmap_length);
+
+  void* mmap_address_;
+  uint64_t mmap_length_;
+  SharedMemoryRingMetadata* metadata_;
+  const char* ring_buffer_;
+  uint64_t ring_buffer_size_;
+  std::string parse_buffer_;
+};
+
+}  // namespace orbit_producer_side_channel
+
+#endif  // ORBIT_PRODUCER_SIDE_CHANNEL_SHARED_MEMORY_RING_H_
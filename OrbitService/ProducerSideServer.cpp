@@ -4,7 +4,14 @@
 
 #include "ProducerSideServer.h"
 
+#include <grpcpp/server_posix.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <utility>
 
 #include "OrbitBase/SafeStrerror.h"
 
@@ -13,38 +20,95 @@ namespace orbit_service {
 bool ProducerSideServer::BuildAndStart(std::string_view unix_domain_socket_path) {
   CHECK(server_ == nullptr);
 
-  grpc::ServerBuilder builder;
-  builder.AddListeningPort(absl::StrFormat("unix:%s", unix_domain_socket_path),
-                           grpc::InsecureServerCredentials());
-
-  builder.RegisterService(&producer_side_service_);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (unix_domain_socket_path.size() >= sizeof(address.sun_path)) {
+    ERROR("Unix domain socket path \"%s\" is too long", unix_domain_socket_path);
+    return false;
+  }
+  std::memcpy(address.sun_path, unix_domain_socket_path.data(), unix_domain_socket_path.size());
+  unix_domain_socket_path_ = std::string{unix_domain_socket_path};
 
-  server_ = builder.BuildAndStart();
-  if (server_ == nullptr) {
+  // The producers connect to this socket, and their calls are then handled by the grpc::Server
+  // through grpc::AddInsecureChannelFromFd, which is why the server itself has no listening port.
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ == -1) {
+    ERROR("Creating Unix domain socket: %s", SafeStrerror(errno));
+    return false;
+  }
+  // Like gRPC does, replace the socket left by an earlier instance.
+  unlink(unix_domain_socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    ERROR("Listening on \"%s\": %s", unix_domain_socket_path, SafeStrerror(errno));
+    close(listen_fd_);
+    listen_fd_ = -1;
     return false;
   }
 
   // When OrbitService runs as root, also allow non-root producers
   // (e.g., the game) to communicate over the Unix domain socket.
-  if (chmod(std::string{unix_domain_socket_path}.c_str(), 0777) != 0) {
+  if (chmod(unix_domain_socket_path_.c_str(), 0777) != 0) {
     ERROR("Changing mode bits to 777 of \"%s\": %s", unix_domain_socket_path, SafeStrerror(errno));
-    server_->Shutdown();
-    server_->Wait();
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(unix_domain_socket_path_.c_str());
+    return false;
+  }
+
+  grpc::ServerBuilder builder;
+  builder.RegisterService(&producer_side_service_);
+
+  server_ = builder.BuildAndStart();
+  if (server_ == nullptr) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(unix_domain_socket_path_.c_str());
     return false;
   }
 
+  accept_thread_ = std::thread{[this] { AcceptThread(); }};
   return true;
 }
 
+void ProducerSideServer::AcceptThread() {
+  while (true) {
+    // gRPC expects the file descriptors of its connections to be non-blocking.
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd == -1) {
+      if (shutdown_requested_) {
+        return;
+      }
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      ERROR("Accepting connection on \"%s\": %s", unix_domain_socket_path_, SafeStrerror(errno));
+      return;
+    }
+    producer_side_service_.OnProducerConnected(fd);
+    // The grpc::Server takes ownership of fd.
+    grpc::AddInsecureChannelFromFd(server_.get(), fd);
+  }
+}
+
 void ProducerSideServer::ShutdownAndWait() {
   CHECK(server_ != nullptr);
+  // Stop accepting connections: shutdown makes the blocking accept4 in AcceptThread fail.
+  shutdown_requested_ = true;
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+  unlink(unix_domain_socket_path_.c_str());
+
   producer_side_service_.OnExitRequest();
   server_->Shutdown();
   server_->Wait();
 }
 
-void ProducerSideServer::OnCaptureStartRequested(CaptureEventBuffer* capture_event_buffer) {
-  producer_side_service_.OnCaptureStartRequested(capture_event_buffer);
+void ProducerSideServer::OnCaptureStartRequested(orbit_grpc_protos::CaptureOptions capture_options,
+                                                 CaptureEventBuffer* capture_event_buffer) {
+  producer_side_service_.OnCaptureStartRequested(std::move(capture_options), capture_event_buffer);
 }
 
 void ProducerSideServer::OnCaptureStopRequested() {
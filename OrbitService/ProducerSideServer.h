@@ -5,6 +5,10 @@
 #ifndef ORBIT_SERVICE_TARGET_SIDE_SERVER_H_
 #define ORBIT_SERVICE_TARGET_SIDE_SERVER_H_
 
+#include <atomic>
+#include <string>
+#include <thread>
+
 #include "CaptureStartStopListener.h"
 #include "OrbitBase/Logging.h"
 #include "ProducerSideServiceImpl.h"
@@ -13,18 +17,26 @@
 namespace orbit_service {
 
 // Wrapper around a grpc::Server that registers the service ProducerSideServiceImpl
-// and listens on a Unix domain socket.
+// and listens on a Unix domain socket. Connections are accepted here rather than by gRPC, so that
+// ProducerSideServiceImpl knows the process of each producer from the credentials of its socket.
 class ProducerSideServer final : public CaptureStartStopListener {
  public:
   bool BuildAndStart(std::string_view unix_domain_socket_path);
   void ShutdownAndWait();
 
-  void OnCaptureStartRequested(CaptureEventBuffer* capture_event_buffer) override;
+  void OnCaptureStartRequested(orbit_grpc_protos::CaptureOptions capture_options,
+                               CaptureEventBuffer* capture_event_buffer) override;
   void OnCaptureStopRequested() override;
 
  private:
+  void AcceptThread();
+
   ProducerSideServiceImpl producer_side_service_;
   std::unique_ptr<grpc::Server> server_;
+  std::string unix_domain_socket_path_;
+  int listen_fd_ = -1;
+  std::thread accept_thread_;
+  std::atomic<bool> shutdown_requested_ = false;
 };
 
 }  // namespace orbit_service
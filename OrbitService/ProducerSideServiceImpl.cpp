@@ -4,13 +4,20 @@
 
 #include "ProducerSideServiceImpl.h"
 
+#include <sys/socket.h>
+
+#include <string>
 #include <thread>
+#include <utility>
 
 #include "OrbitBase/Logging.h"
+#include "OrbitBase/SafeStrerror.h"
+#include "absl/strings/str_format.h"
 
 namespace orbit_service {
 
-void ProducerSideServiceImpl::OnCaptureStartRequested(CaptureEventBuffer* capture_event_buffer) {
+void ProducerSideServiceImpl::OnCaptureStartRequested(
+    orbit_grpc_protos::CaptureOptions capture_options, CaptureEventBuffer* capture_event_buffer) {
   CHECK(capture_event_buffer != nullptr);
   LOG("About to send StartCaptureCommand to CaptureEventProducers (if any)");
   {
@@ -20,6 +27,7 @@ void ProducerSideServiceImpl::OnCaptureStartRequested(CaptureEventBuffer* captur
   {
     absl::MutexLock lock{&service_state_mutex_};
     service_state_.capture_status = CaptureStatus::kCaptureStarted;
+    service_state_.capture_options = std::move(capture_options);
   }
 }
 
@@ -104,15 +112,31 @@ grpc::Status ProducerSideServiceImpl::ReceiveCommandsAndSendEvents(
                                    &all_events_sent_received,
                                    &receive_events_thread_exited};
 
+  SharedMemoryRingState shared_memory_ring_state;
+
   // This thread is responsible for reading from stream, and specifically for
   // receiving CaptureEvents and AllEventsSent messages.
-  std::thread receive_events_thread{&ProducerSideServiceImpl::ReceiveEventsThread, this, context,
-                                    stream, &all_events_sent_received};
+  std::thread receive_events_thread{&ProducerSideServiceImpl::ReceiveEventsThread,
+                                    this,
+                                    context,
+                                    stream,
+                                    &all_events_sent_received,
+                                    &shared_memory_ring_state};
+
+  // This thread is responsible for reading CaptureEvents from the SharedMemoryRing, if the
+  // producer announces one.
+  std::thread read_shared_memory_ring_thread{&ProducerSideServiceImpl::ReadSharedMemoryRingThread,
+                                             this, &shared_memory_ring_state};
   receive_events_thread.join();
 
   // When receive_events_thread exits because stream->Read(&request) fails,
   // it means that the producer has disconnected: ask send_commands_thread to exit, too.
   receive_events_thread_exited = true;
+  {
+    absl::MutexLock lock{&shared_memory_ring_state.mutex};
+    shared_memory_ring_state.exit_requested = true;
+  }
+  read_shared_memory_ring_thread.join();
   send_commands_thread.join();
 
   {
@@ -127,9 +151,10 @@ grpc::Status ProducerSideServiceImpl::ReceiveCommandsAndSendEvents(
 static bool SendStartCaptureCommand(
     grpc::ServerContext* context,
     grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
-                             orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream) {
+                             orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream,
+    const orbit_grpc_protos::CaptureOptions& capture_options) {
   orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse command;
-  command.mutable_start_capture_command();
+  *command.mutable_start_capture_command()->mutable_capture_options() = capture_options;
   if (!stream->Write(command)) {
     ERROR("Sending StartCaptureCommand to CaptureEventProducer");
     LOG("Terminating call to ReceiveCommandsAndSendEvents as Write failed");
@@ -199,6 +224,7 @@ void ProducerSideServiceImpl::SendCommandsThread(
     }
 
     CaptureStatus curr_capture_status;
+    orbit_grpc_protos::CaptureOptions capture_options;
     {
       absl::MutexLock lock{&service_state_mutex_};
       if (service_state_.exit_requested) {
@@ -270,6 +296,7 @@ void ProducerSideServiceImpl::SendCommandsThread(
         } break;
       }
       curr_capture_status = service_state_.capture_status;
+      capture_options = service_state_.capture_options;
     }  // absl::MutexLock lock{&service_state_mutex_}
 
     // curr_capture_status now holds the new service_state_.capture_status. Send commands
@@ -278,12 +305,12 @@ void ProducerSideServiceImpl::SendCommandsThread(
     switch (curr_capture_status) {
       case CaptureStatus::kCaptureStarted: {
         if (prev_capture_status == CaptureStatus::kCaptureFinished) {
-          if (!SendStartCaptureCommand(context, stream)) {
+          if (!SendStartCaptureCommand(context, stream, capture_options)) {
             return;
           }
         } else if (prev_capture_status == CaptureStatus::kCaptureStopping) {
           if (!SendCaptureFinishedCommand(context, stream) ||
-              !SendStartCaptureCommand(context, stream)) {
+              !SendStartCaptureCommand(context, stream, capture_options)) {
             return;
           }
         } else {
@@ -297,7 +324,7 @@ void ProducerSideServiceImpl::SendCommandsThread(
             return;
           }
         } else if (prev_capture_status == CaptureStatus::kCaptureFinished) {
-          if (!SendStartCaptureCommand(context, stream) ||
+          if (!SendStartCaptureCommand(context, stream, capture_options) ||
               !SendStopCaptureCommand(context, stream)) {
             return;
           }
@@ -326,11 +353,35 @@ void ProducerSideServiceImpl::SendCommandsThread(
   }
 }
 
+void ProducerSideServiceImpl::OnProducerConnected(int fd) {
+  const std::string peer = absl::StrFormat("fd:%d", fd);
+  struct ucred credentials {};
+  socklen_t credentials_size = sizeof(credentials);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentials_size) != 0) {
+    ERROR("Getting credentials of CaptureEventProducer %s: %s", peer, SafeStrerror(errno));
+    // The entry could be left from an earlier connection with the same file descriptor.
+    absl::MutexLock lock{&producer_pids_by_peer_mutex_};
+    producer_pids_by_peer_.erase(peer);
+    return;
+  }
+  absl::MutexLock lock{&producer_pids_by_peer_mutex_};
+  producer_pids_by_peer_.insert_or_assign(peer, credentials.pid);
+}
+
+std::optional<pid_t> ProducerSideServiceImpl::GetProducerPid(const std::string& peer) {
+  absl::MutexLock lock{&producer_pids_by_peer_mutex_};
+  auto it = producer_pids_by_peer_.find(peer);
+  if (it == producer_pids_by_peer_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
 void ProducerSideServiceImpl::ReceiveEventsThread(
-    grpc::ServerContext* /*context*/,
+    grpc::ServerContext* context,
     grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
                              orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream,
-    bool* all_events_sent_received) {
+    bool* all_events_sent_received, SharedMemoryRingState* shared_memory_ring_state) {
   orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest request;
   while (stream->Read(&request)) {
     {
@@ -342,19 +393,44 @@ void ProducerSideServiceImpl::ReceiveEventsThread(
 
     switch (request.event_case()) {
       case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kBufferedCaptureEvents: {
-        absl::MutexLock lock{&capture_event_buffer_mutex_};
-        // capture_event_buffer_ can be nullptr if a producer sends events while not capturing.
-        // Don't log an error in such a case as it could easily spam the logs.
-        if (capture_event_buffer_ != nullptr) {
-          for (orbit_grpc_protos::CaptureEvent event :
-               request.buffered_capture_events().capture_events()) {
-            capture_event_buffer_->AddEvent(std::move(event));
-          }
+        // A producer using a SharedMemoryRing only sends BufferedCaptureEvents on the stream when
+        // they don't fit in the ring. Keep the order in which they were produced: the events
+        // already in the ring come first, and the producer only goes back to the ring once these
+        // events have been added.
+        DrainSharedMemoryRing(shared_memory_ring_state);
+        AddCaptureEvents(request.mutable_buffered_capture_events());
+        absl::MutexLock lock{&shared_memory_ring_state->mutex};
+        if (shared_memory_ring_state->reader != nullptr) {
+          shared_memory_ring_state->reader->OnMessageReceivedOutsideRing();
         }
       } break;
 
+      case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kSharedMemoryRingCreated: {
+        const int32_t pid = request.shared_memory_ring_created().pid();
+        const int32_t fd = request.shared_memory_ring_created().fd();
+        // Otherwise a producer could make OrbitService map the files of another process.
+        if (GetProducerPid(context->peer()) != pid) {
+          ERROR("CaptureEventProducer %s announced a SharedMemoryRing of another process (%d)",
+                context->peer(), pid);
+          break;
+        }
+        auto reader_or_error = orbit_producer_side_channel::SharedMemoryRingReader::Attach(pid, fd);
+        if (reader_or_error.has_error()) {
+          // The producer keeps sending its CaptureEvents on the stream.
+          ERROR("Attaching to SharedMemoryRing of CaptureEventProducer: %s",
+                reader_or_error.error().message());
+          break;
+        }
+        LOG("Attached to SharedMemoryRing of CaptureEventProducer %d", pid);
+        absl::MutexLock lock{&shared_memory_ring_state->mutex};
+        shared_memory_ring_state->reader = std::move(reader_or_error.value());
+      } break;
+
       case orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::kAllEventsSent: {
         LOG("Received AllEventsSent from CaptureEventProducer");
+        // The producer wrote all its CaptureEvents to the SharedMemoryRing before sending
+        // AllEventsSent: read them before the capture can be considered finished.
+        DrainSharedMemoryRing(shared_memory_ring_state);
         absl::MutexLock lock{&service_state_mutex_};
         switch (service_state_.capture_status) {
           case CaptureStatus::kCaptureStarted: {
@@ -400,4 +476,70 @@ void ProducerSideServiceImpl::ReceiveEventsThread(
   }
 }
 
+void ProducerSideServiceImpl::ReadSharedMemoryRingThread(
+    SharedMemoryRingState* shared_memory_ring_state) {
+  // Polling is cheap as it only reads the head of the ring, and the interval is much shorter than
+  // the time producers take to accumulate a batch of CaptureEvents.
+  static constexpr absl::Duration kPollSharedMemoryRingInterval = absl::Milliseconds(1);
+
+  while (true) {
+    {
+      absl::MutexLock lock{&shared_memory_ring_state->mutex};
+      if (shared_memory_ring_state->exit_requested) {
+        return;
+      }
+      if (shared_memory_ring_state->reader == nullptr) {
+        // Wait for the producer to announce a SharedMemoryRing, or for the connection to end.
+        shared_memory_ring_state->mutex.Await(absl::Condition(
+            +[](SharedMemoryRingState* state) {
+              return state->exit_requested || state->reader != nullptr;
+            },
+            shared_memory_ring_state));
+        continue;
+      }
+    }
+
+    DrainSharedMemoryRing(shared_memory_ring_state);
+
+    absl::MutexLock lock{&shared_memory_ring_state->mutex};
+    shared_memory_ring_state->mutex.AwaitWithTimeout(
+        absl::Condition(
+            +[](SharedMemoryRingState* state) { return state->exit_requested; },
+            shared_memory_ring_state),
+        kPollSharedMemoryRingInterval);
+  }
+}
+
+void ProducerSideServiceImpl::DrainSharedMemoryRing(
+    SharedMemoryRingState* shared_memory_ring_state) {
+  absl::MutexLock lock{&shared_memory_ring_state->mutex};
+  orbit_producer_side_channel::SharedMemoryRingReader* reader =
+      shared_memory_ring_state->reader.get();
+  if (reader == nullptr) {
+    return;
+  }
+
+  orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents
+      buffered_capture_events;
+  while (reader->HasNewData()) {
+    if (reader->TryReadMessage(&buffered_capture_events)) {
+      AddCaptureEvents(&buffered_capture_events);
+    }
+  }
+}
+
+void ProducerSideServiceImpl::AddCaptureEvents(
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents*
+        buffered_capture_events) {
+  absl::MutexLock lock{&capture_event_buffer_mutex_};
+  // capture_event_buffer_ can be nullptr if a producer sends events while not capturing.
+  // Don't log an error in such a case as it could easily spam the logs.
+  if (capture_event_buffer_ != nullptr) {
+    for (orbit_grpc_protos::CaptureEvent& event :
+         *buffered_capture_events->mutable_capture_events()) {
+      capture_event_buffer_->AddEvent(std::move(event));
+    }
+  }
+}
+
 }  // namespace orbit_service
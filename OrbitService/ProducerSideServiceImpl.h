@@ -5,7 +5,15 @@
 #ifndef ORBIT_SERVICE_PRODUCER_SIDE_SERVICE_IMPL_H_
 #define ORBIT_SERVICE_PRODUCER_SIDE_SERVICE_IMPL_H_
 
+#include <sys/types.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
 #include "CaptureStartStopListener.h"
+#include "OrbitProducerSideChannel/SharedMemoryRing.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "producer_side_services.grpc.pb.h"
@@ -20,13 +28,17 @@ namespace orbit_service {
 // As OnCaptureStopRequested waits for the remaining CaptureEvents, SetMaxWaitForAllCaptureEventsMs
 // allows to specify a timeout for that method.
 // OnExitRequest disconnects all producers, preparing this service for shutdown.
+// Producers on the same machine can announce a SharedMemoryRing on the stream, in which case their
+// BufferedCaptureEvents are read from the ring instead, and the stream is only used for commands,
+// for AllEventsSent, and for batches that didn't fit in the ring.
 class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideService::Service,
                                       public CaptureStartStopListener {
  public:
-  // This method causes the StartCaptureCommand to be sent to connected producers
-  // (but if it's called multiple times in a row, the command will only be sent once).
+  // This method causes the StartCaptureCommand, carrying capture_options, to be sent to connected
+  // producers (but if it's called multiple times in a row, the command will only be sent once).
   // CaptureEvents received from producers will be added to capture_event_buffer.
-  void OnCaptureStartRequested(CaptureEventBuffer* capture_event_buffer) override;
+  void OnCaptureStartRequested(orbit_grpc_protos::CaptureOptions capture_options,
+                               CaptureEventBuffer* capture_event_buffer) override;
 
   // This method causes the StopCaptureCommand to be sent to connected producers
   // (but if it's called multiple times in a row, the command will only be sent once).
@@ -45,6 +57,12 @@ class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideServ
   // No OnCaptureStartRequested or OnCaptureStopRequested should be called afterwards.
   void OnExitRequest();
 
+  // A producer can only announce a SharedMemoryRing of its own process, which is the process at
+  // the other end of its connection. This method records that process, from the credentials of
+  // fd, a connected Unix domain socket that is about to be added to the grpc::Server with
+  // grpc::AddInsecureChannelFromFd (whose calls then have "fd:<fd>" as peer).
+  void OnProducerConnected(int fd);
+
   grpc::Status ReceiveCommandsAndSendEvents(
       ::grpc::ServerContext* context,
       ::grpc::ServerReaderWriter< ::orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
@@ -52,6 +70,14 @@ class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideServ
       override;
 
  private:
+  // The SharedMemoryRing announced by a producer, if any, shared between the thread reading the
+  // stream and the thread polling the ring, which read from the ring while holding mutex.
+  struct SharedMemoryRingState {
+    std::unique_ptr<orbit_producer_side_channel::SharedMemoryRingReader> reader;
+    bool exit_requested = false;
+    absl::Mutex mutex;
+  };
+
   void SendCommandsThread(
       grpc::ServerContext* context,
       grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
@@ -62,15 +88,27 @@ class ProducerSideServiceImpl final : public orbit_grpc_protos::ProducerSideServ
       grpc::ServerContext* context,
       grpc::ServerReaderWriter<orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse,
                                orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest>* stream,
-      bool* all_events_sent_received);
+      bool* all_events_sent_received, SharedMemoryRingState* shared_memory_ring_state);
+
+  [[nodiscard]] std::optional<pid_t> GetProducerPid(const std::string& peer);
+
+  void ReadSharedMemoryRingThread(SharedMemoryRingState* shared_memory_ring_state);
+  void DrainSharedMemoryRing(SharedMemoryRingState* shared_memory_ring_state);
+  void AddCaptureEvents(
+      orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents*
+          buffered_capture_events);
 
  private:
   absl::flat_hash_set<grpc::ServerContext*> server_contexts_;
   absl::Mutex server_contexts_mutex_;
 
+  absl::flat_hash_map<std::string, pid_t> producer_pids_by_peer_;
+  absl::Mutex producer_pids_by_peer_mutex_;
+
   enum class CaptureStatus { kCaptureStarted, kCaptureStopping, kCaptureFinished };
   struct ServiceState {
     CaptureStatus capture_status = CaptureStatus::kCaptureFinished;
+    orbit_grpc_protos::CaptureOptions capture_options;
     int32_t producers_remaining = 0;
     bool exit_requested = false;
   } service_state_;
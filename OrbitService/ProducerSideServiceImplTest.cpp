@@ -3,10 +3,14 @@
 // found in the LICENSE file.
 
 #include <gmock/gmock.h>
+#include <grpcpp/server_posix.h>
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <thread>
 
+#include "OrbitProducerSideChannel/SharedMemoryRing.h"
 #include "ProducerSideServiceImpl.h"
 #include "absl/strings/str_format.h"
 #include "grpcpp/grpcpp.h"
@@ -38,7 +42,7 @@ class FakeProducer {
                   orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse::COMMAND_NOT_SET);
         switch (response.command_case()) {
           case orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse::kStartCaptureCommand:
-            OnStartCaptureCommandReceived();
+            OnStartCaptureCommandReceived(response.start_capture_command().capture_options());
             break;
           case orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse::kStopCaptureCommand:
             OnStopCaptureCommandReceived();
@@ -60,10 +64,41 @@ class FakeProducer {
     for (int32_t i = 0; i < num_to_send; ++i) {
       request.mutable_buffered_capture_events()->mutable_capture_events()->Add();
     }
+    // Like CaptureEventProducer, keep the ring in order with the batches sent on the stream.
+    if (shared_memory_ring_writer_ != nullptr) {
+      shared_memory_ring_writer_->OnMessageSentOutsideRing();
+    }
     bool written = stream_->Write(request);
     EXPECT_TRUE(written);
   }
 
+  // The ring is announced as belonging to pid, which is not this process if it's overridden.
+  void CreateAndAnnounceSharedMemoryRing(pid_t pid = getpid()) {
+    ASSERT_NE(stream_, nullptr);
+    auto writer_or_error = orbit_producer_side_channel::SharedMemoryRingWriter::Create();
+    ASSERT_FALSE(writer_or_error.has_error());
+    shared_memory_ring_writer_ = std::move(writer_or_error.value());
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest request;
+    request.mutable_shared_memory_ring_created()->set_pid(pid);
+    request.mutable_shared_memory_ring_created()->set_fd(shared_memory_ring_writer_->GetFd());
+    bool written = stream_->Write(request);
+    EXPECT_TRUE(written);
+  }
+
+  [[nodiscard]] bool IsSharedMemoryRingAttached() const {
+    return shared_memory_ring_writer_ != nullptr && shared_memory_ring_writer_->IsReaderAttached();
+  }
+
+  void WriteBufferedCaptureEventsToSharedMemoryRing(int32_t num_to_send) {
+    ASSERT_NE(shared_memory_ring_writer_, nullptr);
+    orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest::BufferedCaptureEvents events;
+    for (int32_t i = 0; i < num_to_send; ++i) {
+      events.mutable_capture_events()->Add();
+    }
+    bool written = shared_memory_ring_writer_->TryWriteMessage(events);
+    EXPECT_TRUE(written);
+  }
+
   void SendAllEventsSent() {
     ASSERT_NE(stream_, nullptr);
     orbit_grpc_protos::ReceiveCommandsAndSendEventsRequest request;
@@ -83,9 +118,10 @@ class FakeProducer {
     if (read_thread_.joinable()) {
       read_thread_.join();
     }
+    shared_memory_ring_writer_.reset();
   }
 
-  MOCK_METHOD(void, OnStartCaptureCommandReceived, (), ());
+  MOCK_METHOD(void, OnStartCaptureCommandReceived, (const orbit_grpc_protos::CaptureOptions&), ());
   MOCK_METHOD(void, OnStopCaptureCommandReceived, (), ());
   MOCK_METHOD(void, OnCaptureFinishedCommandReceived, (), ());
 
@@ -95,6 +131,7 @@ class FakeProducer {
                                            orbit_grpc_protos::ReceiveCommandsAndSendEventsResponse>>
       stream_;
   std::thread read_thread_;
+  std::unique_ptr<orbit_producer_side_channel::SharedMemoryRingWriter> shared_memory_ring_writer_;
 };
 
 class MockCaptureEventBuffer : public CaptureEventBuffer {
@@ -111,8 +148,13 @@ class ProducerSideServiceImplTest : public ::testing::Test {
     builder.RegisterService(&*service_);
     fake_server_ = builder.BuildAndStart();
 
+    // Connect like ProducerSideServer does, so that the service knows the process of the producer.
+    int socket_fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, socket_fds), 0);
+    service_->OnProducerConnected(socket_fds[0]);
+    grpc::AddInsecureChannelFromFd(fake_server_.get(), socket_fds[0]);
     std::shared_ptr<grpc::Channel> channel =
-        fake_server_->InProcessChannel(grpc::ChannelArguments{});
+        grpc::CreateInsecureChannelFromFd("fake_producer", socket_fds[1]);
 
     fake_producer_.emplace();
     fake_producer_->RunRpc(channel);
@@ -158,7 +200,7 @@ TEST_F(ProducerSideServiceImplTest, OneCapture) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -184,11 +226,96 @@ TEST_F(ProducerSideServiceImplTest, OneCapture) {
                           2 * kSendAllEventsDelayMs);
 }
 
+TEST_F(ProducerSideServiceImplTest, StartCaptureCommandCarriesCaptureOptions) {
+  MockCaptureEventBuffer mock_buffer;
+
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_gpu_command_buffer_sampling_period_frames(4);
+  capture_options.set_max_gpu_timestamps_per_frame(256);
+  orbit_grpc_protos::CaptureOptions received_capture_options;
+  EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived)
+      .Times(1)
+      .WillOnce(::testing::SaveArg<0>(&received_capture_options));
+  service_->OnCaptureStartRequested(capture_options, &mock_buffer);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
+  EXPECT_EQ(received_capture_options.gpu_command_buffer_sampling_period_frames(), 4);
+  EXPECT_EQ(received_capture_options.max_gpu_timestamps_per_frame(), 256);
+
+  ON_CALL(*fake_producer_, OnStopCaptureCommandReceived).WillByDefault([this] {
+    fake_producer_->SendAllEventsSent();
+  });
+  EXPECT_CALL(*fake_producer_, OnStopCaptureCommandReceived).Times(1);
+  EXPECT_CALL(*fake_producer_, OnCaptureFinishedCommandReceived).Times(1);
+  service_->OnCaptureStopRequested();
+}
+
+TEST_F(ProducerSideServiceImplTest, OneCaptureWithSharedMemoryRing) {
+  MockCaptureEventBuffer mock_buffer;
+
+  fake_producer_->CreateAndAnnounceSharedMemoryRing();
+  EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_TRUE(fake_producer_->IsSharedMemoryRingAttached());
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
+
+  // Events from the ring and from the stream are both added, the former without a request.
+  EXPECT_CALL(mock_buffer, AddEvent).Times(6);
+  fake_producer_->WriteBufferedCaptureEventsToSharedMemoryRing(3);
+  fake_producer_->SendBufferedCaptureEvents(3);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  ::testing::Mock::VerifyAndClearExpectations(&mock_buffer);
+
+  // Events still in the ring when AllEventsSent is received are added before the capture stops.
+  EXPECT_CALL(mock_buffer, AddEvent).Times(2);
+  ON_CALL(*fake_producer_, OnStopCaptureCommandReceived).WillByDefault([this] {
+    fake_producer_->WriteBufferedCaptureEventsToSharedMemoryRing(2);
+    fake_producer_->SendAllEventsSent();
+  });
+  {
+    ::testing::InSequence in_sequence;
+    EXPECT_CALL(*fake_producer_, OnStopCaptureCommandReceived).Times(1);
+    EXPECT_CALL(*fake_producer_, OnCaptureFinishedCommandReceived).Times(1);
+  }
+  service_->OnCaptureStopRequested();
+  ::testing::Mock::VerifyAndClearExpectations(&mock_buffer);
+}
+
+TEST_F(ProducerSideServiceImplTest, SharedMemoryRingOfAnotherProcessIsNotAttached) {
+  MockCaptureEventBuffer mock_buffer;
+
+  fake_producer_->CreateAndAnnounceSharedMemoryRing(getppid());
+  EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  EXPECT_FALSE(fake_producer_->IsSharedMemoryRingAttached());
+
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
+
+  // The producer keeps sending its events on the stream.
+  EXPECT_CALL(mock_buffer, AddEvent).Times(3);
+  fake_producer_->SendBufferedCaptureEvents(3);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+
+  ::testing::Mock::VerifyAndClearExpectations(&mock_buffer);
+
+  ON_CALL(*fake_producer_, OnStopCaptureCommandReceived).WillByDefault([this] {
+    fake_producer_->SendAllEventsSent();
+  });
+  EXPECT_CALL(*fake_producer_, OnStopCaptureCommandReceived).Times(1);
+  EXPECT_CALL(*fake_producer_, OnCaptureFinishedCommandReceived).Times(1);
+  service_->OnCaptureStopRequested();
+}
+
 TEST_F(ProducerSideServiceImplTest, TwoCaptures) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -215,7 +342,7 @@ TEST_F(ProducerSideServiceImplTest, TwoCaptures) {
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -246,7 +373,7 @@ TEST_F(ProducerSideServiceImplTest, NoCaptureEvents) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -274,7 +401,7 @@ TEST_F(ProducerSideServiceImplTest, NoAllEventsSent) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -306,7 +433,7 @@ TEST_F(ProducerSideServiceImplTest, RedundantAllEventsSent) {
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -338,7 +465,7 @@ TEST_F(ProducerSideServiceImplTest, AllEventsSentBeforeStopCaptureCommand) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -361,14 +488,14 @@ TEST_F(ProducerSideServiceImplTest, MultipleOnCaptureStartStop) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(0);
   // This should *not* cause StartCaptureCommand to be sent again.
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -413,7 +540,7 @@ TEST_F(ProducerSideServiceImplTest, NoOnCaptureStopRequested) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
@@ -433,7 +560,7 @@ TEST_F(ProducerSideServiceImplTest, ProducerDisconnectsMidCapture) {
   MockCaptureEventBuffer mock_buffer;
 
   EXPECT_CALL(*fake_producer_, OnStartCaptureCommandReceived).Times(1);
-  service_->OnCaptureStartRequested(&mock_buffer);
+  service_->OnCaptureStartRequested({}, &mock_buffer);
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_producer_);
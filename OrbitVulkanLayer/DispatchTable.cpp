@@ -4,8 +4,93 @@
 
 #include "DispatchTable.h"
 
+#include <algorithm>
+#include <utility>
+
 namespace orbit_vulkan_layer {
 
+namespace {
+
+// The hazard pointer of a thread. Slots are shared by all DispatchTables: a thread reads from one
+// DispatchTables at a time.
+struct HazardPointerSlot {
+  std::atomic<const void*> hazard_pointer = nullptr;
+  std::atomic<bool> in_use = false;
+  HazardPointerSlot* next = nullptr;
+};
+
+// Slots are never freed, they are reused once their thread has exited. The list only grows up to
+// the maximum number of threads that called into a DispatchTable at the same time.
+std::atomic<HazardPointerSlot*> hazard_pointer_slots = nullptr;
+
+HazardPointerSlot* AcquireHazardPointerSlot() {
+  for (HazardPointerSlot* slot = hazard_pointer_slots.load(std::memory_order_acquire);
+       slot != nullptr; slot = slot->next) {
+    bool in_use = false;
+    if (slot->in_use.compare_exchange_strong(in_use, true)) {
+      return slot;
+    }
+  }
+  auto* slot = new HazardPointerSlot();
+  slot->in_use = true;
+  slot->next = hazard_pointer_slots.load(std::memory_order_relaxed);
+  while (!hazard_pointer_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release,
+                                                     std::memory_order_relaxed)) {
+  }
+  return slot;
+}
+
+class ThreadHazardPointerSlot {
+ public:
+  ThreadHazardPointerSlot() : slot_{AcquireHazardPointerSlot()} {}
+  ~ThreadHazardPointerSlot() {
+    slot_->hazard_pointer = nullptr;
+    slot_->in_use.store(false, std::memory_order_release);
+  }
+
+  [[nodiscard]] HazardPointerSlot* Get() const { return slot_; }
+
+ private:
+  HazardPointerSlot* slot_;
+};
+
+}  // namespace
+
+DispatchTable::DispatchTable() {
+  absl::MutexLock lock(&mutex_);
+  owned_current_tables_ = std::make_unique<DispatchTables>();
+  current_tables_.store(owned_current_tables_.get());
+}
+
+std::atomic<const void*>* DispatchTable::GetThreadHazardPointer() {
+  thread_local ThreadHazardPointerSlot slot;
+  return &slot.Get()->hazard_pointer;
+}
+
+void DispatchTable::UpdateDispatchTables(const std::function<void(DispatchTables*)>& update) {
+  absl::MutexLock lock(&mutex_);
+  auto new_tables = std::make_unique<DispatchTables>(*owned_current_tables_);
+  update(new_tables.get());
+  // Readers only use tables after checking, with their hazard pointer set, that the tables are
+  // still current. So every reader that can still use the replaced tables is seen by the scan
+  // below.
+  current_tables_.store(new_tables.get());
+  retired_tables_.emplace_back(std::move(owned_current_tables_));
+  owned_current_tables_ = std::move(new_tables);
+
+  absl::flat_hash_set<const void*> hazard_pointers;
+  for (HazardPointerSlot* slot = hazard_pointer_slots.load(std::memory_order_acquire);
+       slot != nullptr; slot = slot->next) {
+    hazard_pointers.insert(slot->hazard_pointer.load());
+  }
+  retired_tables_.erase(
+      std::remove_if(retired_tables_.begin(), retired_tables_.end(),
+                     [&hazard_pointers](const std::unique_ptr<const DispatchTables>& tables) {
+                       return !hazard_pointers.contains(tables.get());
+                     }),
+      retired_tables_.end());
+}
+
 void DispatchTable::CreateInstanceDispatchTable(
     VkInstance instance, PFN_vkGetInstanceProcAddr next_get_instance_proc_addr_function) {
   VkLayerInstanceDispatchTable dispatch_table;
@@ -20,20 +105,18 @@ void DispatchTable::CreateInstanceDispatchTable(
       next_get_instance_proc_addr_function(instance, "vkGetPhysicalDeviceProperties"));
 
   void* key = GetDispatchTableKey(instance);
-  {
-    absl::WriterMutexLock lock(&mutex_);
-    CHECK(!instance_dispatch_table_.contains(key));
-    instance_dispatch_table_[key] = dispatch_table;
-  }
+  UpdateDispatchTables([key, &dispatch_table](DispatchTables* tables) {
+    CHECK(!tables->instance_dispatch_tables.contains(key));
+    tables->instance_dispatch_tables[key] = dispatch_table;
+  });
 }
 
 void DispatchTable::RemoveInstanceDispatchTable(VkInstance instance) {
   void* key = GetDispatchTableKey(instance);
-  {
-    absl::WriterMutexLock lock(&mutex_);
-    CHECK(instance_dispatch_table_.contains(key));
-    instance_dispatch_table_.erase(key);
-  }
+  UpdateDispatchTables([key](DispatchTables* tables) {
+    CHECK(tables->instance_dispatch_tables.contains(key));
+    tables->instance_dispatch_tables.erase(key);
+  });
 }
 
 void DispatchTable::CreateDeviceDispatchTable(
@@ -90,38 +173,28 @@ void DispatchTable::CreateDeviceDispatchTable(
   dispatch_table.CmdDebugMarkerEndEXT = absl::bit_cast<PFN_vkCmdDebugMarkerEndEXT>(
       next_get_device_proc_addr_function(device, "vkCmdDebugMarkerEndEXT"));
 
+  DeviceDispatchTables device_dispatch_tables;
+  device_dispatch_tables.dispatch_table = dispatch_table;
+  device_dispatch_tables.supports_debug_utils_extension =
+      dispatch_table.CmdBeginDebugUtilsLabelEXT != nullptr &&
+      dispatch_table.CmdEndDebugUtilsLabelEXT != nullptr;
+  device_dispatch_tables.supports_debug_marker_extension =
+      dispatch_table.CmdDebugMarkerBeginEXT != nullptr &&
+      dispatch_table.CmdDebugMarkerEndEXT != nullptr;
+
   void* key = GetDispatchTableKey(device);
-  {
-    absl::WriterMutexLock lock(&mutex_);
-    CHECK(!device_dispatch_table_.contains(key));
-    device_dispatch_table_[key] = dispatch_table;
-
-    CHECK(!device_supports_debug_utils_extension_.contains(key));
-    device_supports_debug_utils_extension_[key] =
-        dispatch_table.CmdBeginDebugUtilsLabelEXT != nullptr &&
-        dispatch_table.CmdEndDebugUtilsLabelEXT != nullptr;
-
-    CHECK(!device_supports_debug_marker_extension_.contains(key));
-    device_supports_debug_marker_extension_[key] =
-        dispatch_table.CmdDebugMarkerBeginEXT != nullptr &&
-        dispatch_table.CmdDebugMarkerEndEXT != nullptr;
-  }
+  UpdateDispatchTables([key, &device_dispatch_tables](DispatchTables* tables) {
+    CHECK(!tables->device_dispatch_tables.contains(key));
+    tables->device_dispatch_tables[key] = device_dispatch_tables;
+  });
 }
 
 void DispatchTable::RemoveDeviceDispatchTable(VkDevice device) {
   void* key = GetDispatchTableKey(device);
-  {
-    absl::WriterMutexLock lock(&mutex_);
-
-    CHECK(device_dispatch_table_.contains(key));
-    device_dispatch_table_.erase(key);
-
-    CHECK(device_supports_debug_utils_extension_.contains(key));
-    device_supports_debug_utils_extension_.erase(key);
-
-    CHECK(device_supports_debug_marker_extension_.contains(key));
-    device_supports_debug_marker_extension_.erase(key);
-  }
+  UpdateDispatchTables([key](DispatchTables* tables) {
+    CHECK(tables->device_dispatch_tables.contains(key));
+    tables->device_dispatch_tables.erase(key);
+  });
 }
 
 }  // namespace orbit_vulkan_layer
\ No newline at end of file
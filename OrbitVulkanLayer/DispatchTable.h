@@ -5,6 +5,11 @@
 #ifndef ORBIT_VULKAN_LAYER_DISPATCH_TABLE_H_
 #define ORBIT_VULKAN_LAYER_DISPATCH_TABLE_H_
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "OrbitBase/Logging.h"
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
@@ -27,12 +32,12 @@ namespace orbit_vulkan_layer {
  * For functions provided by extensions it also provides predicate functions to check if the
  * extension is available.
  *
- * Thread-Safety: This class is internally synchronized (using read/write locks) and can be safely
- * accessed from different threads.
+ * Thread-Safety: This class is internally synchronized and can be safely accessed from different
+ * threads. Accessors are lock-free, while creating and removing dispatch tables takes a lock.
  */
 class DispatchTable {
  public:
-  DispatchTable() = default;
+  DispatchTable();
 
   void CreateInstanceDispatchTable(VkInstance instance,
                                    PFN_vkGetInstanceProcAddr next_get_instance_proc_addr_function);
@@ -44,289 +49,209 @@ class DispatchTable {
 
   template <typename DispatchableType>
   PFN_vkDestroyDevice DestroyDevice(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).DestroyDevice != nullptr);
-      return device_dispatch_table_.at(key).DestroyDevice;
-    }
+    PFN_vkDestroyDevice function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::DestroyDevice);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkDestroyInstance DestroyInstance(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(instance_dispatch_table_.contains(key));
-      CHECK(instance_dispatch_table_.at(key).DestroyInstance != nullptr);
-      return instance_dispatch_table_.at(key).DestroyInstance;
-    }
+    PFN_vkDestroyInstance function = ReadInstanceDispatchTable(
+        dispatchable_object, &VkLayerInstanceDispatchTable::DestroyInstance);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkEnumerateDeviceExtensionProperties EnumerateDeviceExtensionProperties(
       DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(instance_dispatch_table_.contains(key));
-      CHECK(instance_dispatch_table_.at(key).EnumerateDeviceExtensionProperties != nullptr);
-      return instance_dispatch_table_.at(key).EnumerateDeviceExtensionProperties;
-    }
+    PFN_vkEnumerateDeviceExtensionProperties function = ReadInstanceDispatchTable(
+        dispatchable_object, &VkLayerInstanceDispatchTable::EnumerateDeviceExtensionProperties);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetPhysicalDeviceProperties GetPhysicalDeviceProperties(
       DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(instance_dispatch_table_.contains(key));
-      CHECK(instance_dispatch_table_.at(key).GetPhysicalDeviceProperties != nullptr);
-      return instance_dispatch_table_.at(key).GetPhysicalDeviceProperties;
-    }
+    PFN_vkGetPhysicalDeviceProperties function = ReadInstanceDispatchTable(
+        dispatchable_object, &VkLayerInstanceDispatchTable::GetPhysicalDeviceProperties);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetInstanceProcAddr GetInstanceProcAddr(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(instance_dispatch_table_.contains(key));
-      CHECK(instance_dispatch_table_.at(key).GetInstanceProcAddr != nullptr);
-      return instance_dispatch_table_.at(key).GetInstanceProcAddr;
-    }
+    PFN_vkGetInstanceProcAddr function = ReadInstanceDispatchTable(
+        dispatchable_object, &VkLayerInstanceDispatchTable::GetInstanceProcAddr);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetDeviceProcAddr GetDeviceProcAddr(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).GetDeviceProcAddr != nullptr);
-      return device_dispatch_table_.at(key).GetDeviceProcAddr;
-    }
+    PFN_vkGetDeviceProcAddr function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::GetDeviceProcAddr);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkResetCommandPool ResetCommandPool(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).ResetCommandPool != nullptr);
-      return device_dispatch_table_.at(key).ResetCommandPool;
-    }
+    PFN_vkResetCommandPool function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::ResetCommandPool);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkAllocateCommandBuffers AllocateCommandBuffers(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).AllocateCommandBuffers != nullptr);
-      return device_dispatch_table_.at(key).AllocateCommandBuffers;
-    }
+    PFN_vkAllocateCommandBuffers function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::AllocateCommandBuffers);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkFreeCommandBuffers FreeCommandBuffers(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).FreeCommandBuffers != nullptr);
-      return device_dispatch_table_.at(key).FreeCommandBuffers;
-    }
+    PFN_vkFreeCommandBuffers function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::FreeCommandBuffers);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkBeginCommandBuffer BeginCommandBuffer(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).BeginCommandBuffer != nullptr);
-      return device_dispatch_table_.at(key).BeginCommandBuffer;
-    }
+    PFN_vkBeginCommandBuffer function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::BeginCommandBuffer);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkEndCommandBuffer EndCommandBuffer(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).EndCommandBuffer != nullptr);
-      return device_dispatch_table_.at(key).EndCommandBuffer;
-    }
+    PFN_vkEndCommandBuffer function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::EndCommandBuffer);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkResetCommandBuffer ResetCommandBuffer(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).ResetCommandBuffer != nullptr);
-      return device_dispatch_table_.at(key).ResetCommandBuffer;
-    }
+    PFN_vkResetCommandBuffer function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::ResetCommandBuffer);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetDeviceQueue GetDeviceQueue(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).GetDeviceQueue != nullptr);
-      return device_dispatch_table_.at(key).GetDeviceQueue;
-    }
+    PFN_vkGetDeviceQueue function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::GetDeviceQueue);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetDeviceQueue2 GetDeviceQueue2(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).GetDeviceQueue2 != nullptr);
-      return device_dispatch_table_.at(key).GetDeviceQueue2;
-    }
+    PFN_vkGetDeviceQueue2 function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::GetDeviceQueue2);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkQueueSubmit QueueSubmit(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).QueueSubmit != nullptr);
-      return device_dispatch_table_.at(key).QueueSubmit;
-    }
+    PFN_vkQueueSubmit function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::QueueSubmit);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkQueuePresentKHR QueuePresentKHR(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).QueuePresentKHR != nullptr);
-      return device_dispatch_table_.at(key).QueuePresentKHR;
-    }
+    PFN_vkQueuePresentKHR function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::QueuePresentKHR);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCreateQueryPool CreateQueryPool(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CreateQueryPool != nullptr);
-      return device_dispatch_table_.at(key).CreateQueryPool;
-    }
+    PFN_vkCreateQueryPool function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CreateQueryPool);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkResetQueryPoolEXT ResetQueryPoolEXT(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).ResetQueryPoolEXT != nullptr);
-      return device_dispatch_table_.at(key).ResetQueryPoolEXT;
-    }
+    PFN_vkResetQueryPoolEXT function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::ResetQueryPoolEXT);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkGetQueryPoolResults GetQueryPoolResults(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).GetQueryPoolResults != nullptr);
-      return device_dispatch_table_.at(key).GetQueryPoolResults;
-    }
+    PFN_vkGetQueryPoolResults function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::GetQueryPoolResults);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCmdWriteTimestamp CmdWriteTimestamp(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CmdWriteTimestamp != nullptr);
-      return device_dispatch_table_.at(key).CmdWriteTimestamp;
-    }
+    PFN_vkCmdWriteTimestamp function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CmdWriteTimestamp);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCmdBeginDebugUtilsLabelEXT CmdBeginDebugUtilsLabelEXT(
       DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CmdBeginDebugUtilsLabelEXT != nullptr);
-      return device_dispatch_table_.at(key).CmdBeginDebugUtilsLabelEXT;
-    }
+    PFN_vkCmdBeginDebugUtilsLabelEXT function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CmdBeginDebugUtilsLabelEXT);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCmdEndDebugUtilsLabelEXT CmdEndDebugUtilsLabelEXT(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CmdEndDebugUtilsLabelEXT != nullptr);
-      return device_dispatch_table_.at(key).CmdEndDebugUtilsLabelEXT;
-    }
+    PFN_vkCmdEndDebugUtilsLabelEXT function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CmdEndDebugUtilsLabelEXT);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCmdDebugMarkerBeginEXT CmdDebugMarkerBeginEXT(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CmdDebugMarkerBeginEXT != nullptr);
-      return device_dispatch_table_.at(key).CmdDebugMarkerBeginEXT;
-    }
+    PFN_vkCmdDebugMarkerBeginEXT function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CmdDebugMarkerBeginEXT);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   PFN_vkCmdDebugMarkerEndEXT CmdDebugMarkerEndEXT(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_dispatch_table_.contains(key));
-      CHECK(device_dispatch_table_.at(key).CmdDebugMarkerEndEXT != nullptr);
-      return device_dispatch_table_.at(key).CmdDebugMarkerEndEXT;
-    }
+    PFN_vkCmdDebugMarkerEndEXT function = ReadDeviceDispatchTable(
+        dispatchable_object, &VkLayerDispatchTable::CmdDebugMarkerEndEXT);
+    CHECK(function != nullptr);
+    return function;
   }
 
   template <typename DispatchableType>
   bool IsDebugMarkerExtensionSupported(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_supports_debug_marker_extension_.contains(key));
-      return device_supports_debug_marker_extension_.at(key);
-    }
+    return ReadDeviceDispatchTables(
+        dispatchable_object, &DeviceDispatchTables::supports_debug_marker_extension);
   }
 
   template <typename DispatchableType>
   bool IsDebugUtilsExtensionSupported(DispatchableType dispatchable_object) {
-    void* key = GetDispatchTableKey(dispatchable_object);
-    {
-      absl::ReaderMutexLock lock(&mutex_);
-      CHECK(device_supports_debug_utils_extension_.contains(key));
-      return device_supports_debug_utils_extension_.at(key);
-    }
+    return ReadDeviceDispatchTables(
+        dispatchable_object, &DeviceDispatchTables::supports_debug_utils_extension);
   }
 
  private:
@@ -344,18 +269,94 @@ class DispatchTable {
     return dispatch;
   }
 
+  struct DeviceDispatchTables {
+    VkLayerDispatchTable dispatch_table;
+    bool supports_debug_marker_extension;
+    bool supports_debug_utils_extension;
+  };
+
   // Dispatch tables required for routing instance and device calls onto the next
   // layer in the dispatch chain among our handling of functions we intercept.
-  absl::flat_hash_map<void*, VkLayerInstanceDispatchTable> instance_dispatch_table_;
-  absl::flat_hash_map<void*, VkLayerDispatchTable> device_dispatch_table_;
-  absl::flat_hash_map<void*, bool> device_supports_debug_marker_extension_;
-  absl::flat_hash_map<void*, bool> device_supports_debug_utils_extension_;
-
-  // Must protect access to dispatch tables above by mutex since the Vulkan
-  // application may be calling these functions from different threads.
-  // However, they are usually filled once (per device/instance) at the beginning
-  // and afterwards we only read that data. So we use read/write locks.
+  struct DispatchTables {
+    absl::flat_hash_map<void*, VkLayerInstanceDispatchTable> instance_dispatch_tables;
+    absl::flat_hash_map<void*, DeviceDispatchTables> device_dispatch_tables;
+  };
+
+  // Protects the current DispatchTables from being freed while it is read, using the hazard
+  // pointer of the calling thread. Only one can exist per thread at a time.
+  class DispatchTablesReader {
+   public:
+    explicit DispatchTablesReader(const DispatchTable* dispatch_table)
+        : hazard_pointer_{GetThreadHazardPointer()} {
+      const DispatchTables* tables = dispatch_table->current_tables_.load();
+      while (true) {
+        // Once the hazard pointer is visible, a modification that replaces tables will not free
+        // it. Check that tables was not replaced before that.
+        hazard_pointer_->store(tables);
+        const DispatchTables* current_tables = dispatch_table->current_tables_.load();
+        if (current_tables == tables) break;
+        tables = current_tables;
+      }
+      tables_ = tables;
+    }
+    ~DispatchTablesReader() { hazard_pointer_->store(nullptr, std::memory_order_release); }
+
+    DispatchTablesReader(const DispatchTablesReader&) = delete;
+    DispatchTablesReader& operator=(const DispatchTablesReader&) = delete;
+
+    const DispatchTables* operator->() const { return tables_; }
+
+   private:
+    std::atomic<const void*>* hazard_pointer_;
+    const DispatchTables* tables_;
+  };
+
+  template <typename DispatchableType, typename Field>
+  Field ReadInstanceDispatchTable(DispatchableType dispatchable_object,
+                                  Field VkLayerInstanceDispatchTable::*field) {
+    DispatchTablesReader tables(this);
+    auto it = tables->instance_dispatch_tables.find(GetDispatchTableKey(dispatchable_object));
+    CHECK(it != tables->instance_dispatch_tables.end());
+    return it->second.*field;
+  }
+
+  template <typename DispatchableType, typename Field>
+  Field ReadDeviceDispatchTables(DispatchableType dispatchable_object,
+                                 Field DeviceDispatchTables::*field) {
+    DispatchTablesReader tables(this);
+    auto it = tables->device_dispatch_tables.find(GetDispatchTableKey(dispatchable_object));
+    CHECK(it != tables->device_dispatch_tables.end());
+    return it->second.*field;
+  }
+
+  template <typename DispatchableType, typename Field>
+  Field ReadDeviceDispatchTable(DispatchableType dispatchable_object,
+                                Field VkLayerDispatchTable::*field) {
+    DispatchTablesReader tables(this);
+    auto it = tables->device_dispatch_tables.find(GetDispatchTableKey(dispatchable_object));
+    CHECK(it != tables->device_dispatch_tables.end());
+    return it->second.dispatch_table.*field;
+  }
+
+  // Returns the hazard pointer of the calling thread, which holds the DispatchTables that the
+  // thread is reading, or nullptr.
+  [[nodiscard]] static std::atomic<const void*>* GetThreadHazardPointer();
+
+  // Copies the current DispatchTables, applies update to the copy, and publishes it. The replaced
+  // tables are freed as soon as no hazard pointer refers to them anymore.
+  void UpdateDispatchTables(const std::function<void(DispatchTables*)>& update);
+
+  // The Vulkan application may be calling the accessors from different threads, on every
+  // intercepted call. However, the tables are only modified when an instance or device is created
+  // or destroyed. So every modification publishes a new immutable copy of all the tables, and the
+  // accessors only need to atomically load the pointer to the current one: they never block.
+  // Readers announce which copy they are reading through their hazard pointer, so that replaced
+  // copies can be freed once no reader uses them.
+  std::atomic<const DispatchTables*> current_tables_;
+  // Serializes modifications.
   absl::Mutex mutex_;
+  std::unique_ptr<const DispatchTables> owned_current_tables_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<const DispatchTables>> retired_tables_ ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace orbit_vulkan_layer
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <string.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DispatchTable.h"
+
+namespace orbit_vulkan_layer {
+
+namespace {
+
+constexpr size_t kNumDevices = 4;
+
+// As in DispatchTableTest, devices are faked by objects that only contain a pointer to a
+// VkLayerDispatchTable, as the first bytes of any dispatchable Vulkan object are a pointer to the
+// loader's dispatch table. The DispatchTable is shared by all the threads of a benchmark, like by
+// the threads of a Vulkan application.
+class FakeDevices {
+ public:
+  FakeDevices() {
+    PFN_vkGetDeviceProcAddr next_get_device_proc_addr_function =
+        +[](VkDevice /*device*/, const char* name) -> PFN_vkVoidFunction {
+      if (strcmp(name, "vkQueueSubmit") == 0) {
+        PFN_vkQueueSubmit function =
+            +[](VkQueue /*queue*/, uint32_t /*submit_count*/, const VkSubmitInfo* /*submit_info*/,
+                VkFence /*fence*/) -> VkResult { return VK_SUCCESS; };
+        return absl::bit_cast<PFN_vkVoidFunction>(function);
+      }
+      return nullptr;
+    };
+
+    for (size_t i = 0; i < kNumDevices; ++i) {
+      loader_dispatch_tables_.push_back(std::make_unique<VkLayerDispatchTable>());
+      devices_.push_back(std::make_unique<void*>(loader_dispatch_tables_.back().get()));
+      dispatch_table_.CreateDeviceDispatchTable(GetDevice(i), next_get_device_proc_addr_function);
+    }
+  }
+
+  [[nodiscard]] DispatchTable* GetDispatchTable() { return &dispatch_table_; }
+  [[nodiscard]] VkDevice GetDevice(size_t index) const {
+    return absl::bit_cast<VkDevice>(devices_[index % kNumDevices].get());
+  }
+
+ private:
+  DispatchTable dispatch_table_;
+  std::vector<std::unique_ptr<VkLayerDispatchTable>> loader_dispatch_tables_;
+  std::vector<std::unique_ptr<void*>> devices_;
+};
+
+FakeDevices* GetFakeDevices() {
+  static auto* fake_devices = new FakeDevices();
+  return fake_devices;
+}
+
+// The lookup every intercepted vkQueueSubmit (and similarly every vkCmd*) goes through.
+void BM_QueueSubmitLookup(benchmark::State& state) {
+  DispatchTable* dispatch_table = GetFakeDevices()->GetDispatchTable();
+  VkDevice device = GetFakeDevices()->GetDevice(state.thread_index);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dispatch_table->QueueSubmit(device));
+  }
+}
+
+BENCHMARK(BM_QueueSubmitLookup)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_IsDebugUtilsExtensionSupported(benchmark::State& state) {
+  DispatchTable* dispatch_table = GetFakeDevices()->GetDispatchTable();
+  VkDevice device = GetFakeDevices()->GetDevice(state.thread_index);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(dispatch_table->IsDebugUtilsExtensionSupported(device));
+  }
+}
+
+BENCHMARK(BM_IsDebugUtilsExtensionSupported)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace
+
+}  // namespace orbit_vulkan_layer
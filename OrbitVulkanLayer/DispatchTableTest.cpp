@@ -2,6 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <array>
+#include <atomic>
+#include <thread>
+
 #include "DispatchTable.h"
 #include "gtest/gtest.h"
 
@@ -721,4 +725,54 @@ TEST(DispatchTable, CanCallCmdDebugMarkerEndEXT) {
   was_called = false;
 }
 
-}  // namespace orbit_vulkan_layer
\ No newline at end of file
+TEST(DispatchTable, CanCallQueueSubmitWhileOtherDevicesAreCreatedAndRemoved) {
+  VkLayerDispatchTable some_dispatch_table = {};
+  auto device = absl::bit_cast<VkDevice>(&some_dispatch_table);
+
+  PFN_vkGetDeviceProcAddr next_get_device_proc_addr_function =
+      +[](VkDevice /*device*/, const char* name) -> PFN_vkVoidFunction {
+    if (strcmp(name, "vkQueueSubmit") == 0) {
+      PFN_vkQueueSubmit function =
+          +[](VkQueue /*queue*/, uint32_t /*submit_count*/, const VkSubmitInfo* /*submit_info*/,
+              VkFence /*fence*/) -> VkResult { return VK_SUCCESS; };
+      return absl::bit_cast<PFN_vkVoidFunction>(function);
+    }
+    return nullptr;
+  };
+
+  DispatchTable dispatch_table = {};
+  dispatch_table.CreateDeviceDispatchTable(device, next_get_device_proc_addr_function);
+
+  // Every change to the tables replaces them while QueueSubmit reads them on this thread.
+  std::atomic<bool> done = false;
+  std::thread create_and_remove_thread{[&dispatch_table, &done] {
+    // The devices need distinct pointers to dispatch tables as their first bytes.
+    std::array<VkLayerDispatchTable, 4> other_dispatch_tables = {};
+    std::array<VkLayerDispatchTable*, 4> other_devices = {};
+    for (size_t i = 0; i < other_devices.size(); ++i) {
+      other_devices[i] = &other_dispatch_tables[i];
+    }
+    PFN_vkGetDeviceProcAddr other_next_get_device_proc_addr_function =
+        +[](VkDevice /*device*/, const char* /*name*/) -> PFN_vkVoidFunction { return nullptr; };
+    for (size_t i = 0; i < 100; ++i) {
+      for (VkLayerDispatchTable*& other_device : other_devices) {
+        dispatch_table.CreateDeviceDispatchTable(absl::bit_cast<VkDevice>(&other_device),
+                                                 other_next_get_device_proc_addr_function);
+      }
+      for (VkLayerDispatchTable*& other_device : other_devices) {
+        dispatch_table.RemoveDeviceDispatchTable(absl::bit_cast<VkDevice>(&other_device));
+      }
+    }
+    done = true;
+  }};
+
+  VkQueue queue = {};
+  VkFence fence = {};
+  while (!done) {
+    VkResult result = dispatch_table.QueueSubmit(device)(queue, 0, nullptr, fence);
+    EXPECT_EQ(result, VK_SUCCESS);
+  }
+  create_and_remove_thread.join();
+}
+
+}  // namespace orbit_vulkan_layer
@@ -5,7 +5,10 @@
 #ifndef ORBIT_VULKAN_LAYER_SUBMISSION_TRACKER_H_
 #define ORBIT_VULKAN_LAYER_SUBMISSION_TRACKER_H_
 
+#include <algorithm>
+#include <atomic>
 #include <stack>
+#include <vector>
 
 #include "OrbitBase/Logging.h"
 #include "OrbitBase/Profiling.h"
@@ -30,6 +33,16 @@ namespace orbit_vulkan_layer {
  * already available, and if so, it will assume that all timestamps are available and it will send
  * the results over to the `VulkanLayerProducer`.
  *
+ * To bound the overhead on applications that record many command buffers, the timings can be
+ * sampled: only command buffers recorded in one frame out of N are timed, and/or only as many
+ * command buffers per frame as fit in a budget of timestamps. Command buffers that are not sampled
+ * (and their debug markers) get no timestamps at all. How much was skipped is counted, see
+ * `GetSamplingStatistics`.
+ *
+ * When the `TimerQueryPool` has no free slot, the timestamp is not written, and neither is the
+ * other timestamp of the same command buffer or debug marker, so that the application keeps running
+ * with fewer GPU timings.
+ *
  * See also `DispatchTable` (for vulkan dispatch), `TimerQueryPool` (to manage the timestamp slots),
  * and `DeviceManager` (to retrieve device properties).
  *
@@ -146,6 +159,31 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     max_local_marker_depth_per_command_buffer_ = max_local_marker_depth_per_command_buffer;
   }
 
+  // Sets that the timings of command buffers are only recorded in one frame out of
+  // `sampling_period_frames`. 0 and 1 both mean that all frames are sampled.
+  void SetCommandBufferSamplingPeriodFrames(uint32_t sampling_period_frames) {
+    sampling_period_frames_ = sampling_period_frames;
+  }
+
+  // Sets the maximum number of timestamps written per frame: once it has been reached, command
+  // buffers begun in the same frame are not timed. The budget is checked when a command buffer is
+  // begun, so its debug markers can still exceed it slightly. 0 means no limit.
+  void SetMaxTimestampsPerFrame(uint32_t max_timestamps_per_frame) {
+    max_timestamps_per_frame_ = max_timestamps_per_frame;
+  }
+
+  struct SamplingStatistics {
+    uint64_t num_skipped_command_buffers;
+    uint64_t num_skipped_timestamps;
+  };
+
+  // Returns how many command buffers, and how many timestamps including those of debug markers,
+  // were not recorded in the current (or last) capture because of sampling.
+  [[nodiscard]] SamplingStatistics GetSamplingStatistics() const {
+    return {num_skipped_command_buffers_.load(std::memory_order_relaxed),
+            num_skipped_timestamps_.load(std::memory_order_relaxed)};
+  }
+
   void TrackCommandBuffers(VkDevice device, VkCommandPool pool,
                            const VkCommandBuffer* command_buffers, uint32_t count) {
     absl::WriterMutexLock lock(&mutex_);
@@ -195,22 +233,42 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     if (!IsCapturing()) {
       return;
     }
+    // Both the begin and the end timestamp count towards the budget of the frame.
+    if (!IsCommandBufferSampled(command_buffer, 2)) {
+      return;
+    }
 
-    uint32_t slot_index = RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    std::optional<uint32_t> slot_index =
+        RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
     {
       absl::WriterMutexLock lock(&mutex_);
       CHECK(command_buffer_to_state_.contains(command_buffer));
-      command_buffer_to_state_.at(command_buffer).command_buffer_begin_slot_index =
-          std::make_optional(slot_index);
+      CommandBufferState& state = command_buffer_to_state_.at(command_buffer);
+      state.command_buffer_begin_slot_index = slot_index;
+      state.begin_timestamp_lost = !slot_index.has_value();
     }
   }
 
   void MarkCommandBufferEnd(VkCommandBuffer command_buffer) {
-    if (!IsCapturing()) {
+    if (!IsCapturing() || !IsCommandBufferSampled(command_buffer, 1)) {
       return;
     }
 
-    uint32_t slot_index = RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      CHECK(command_buffer_to_state_.contains(command_buffer));
+      // Without its begin, the command buffer can't be shown, so don't take another slot.
+      if (command_buffer_to_state_.at(command_buffer).begin_timestamp_lost) {
+        return;
+      }
+    }
+
+    std::optional<uint32_t> slot_index =
+        RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    if (!slot_index.has_value()) {
+      // The slot of the begin, if any, is reset on submission (see `PersistDebugMarkersOnSubmit`).
+      return;
+    }
 
     {
       absl::ReaderMutexLock lock(&mutex_);
@@ -220,7 +278,7 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
       CommandBufferState& command_buffer_state = command_buffer_to_state_.at(command_buffer);
       // Writing to this field is safe, as there can't be any operation on this command buffer
       // in parallel.
-      command_buffer_state.command_buffer_end_slot_index = std::make_optional(slot_index);
+      command_buffer_state.command_buffer_end_slot_index = slot_index;
     }
   }
 
@@ -242,17 +300,20 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
       state.markers.emplace_back(std::move(marker));
     }
 
-    if (!IsCapturing() || marker_depth_exceeds_maximum) {
+    if (!IsCapturing() || marker_depth_exceeds_maximum ||
+        !IsCommandBufferSampled(command_buffer, 1)) {
       return;
     }
 
-    uint32_t slot_index = RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    std::optional<uint32_t> slot_index =
+        RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
     {
       absl::WriterMutexLock lock(&mutex_);
       CHECK(command_buffer_to_state_.contains(command_buffer));
       CommandBufferState& state = command_buffer_to_state_.at(command_buffer);
-      state.markers.back().slot_index = std::make_optional(slot_index);
+      state.markers.back().slot_index = slot_index;
+      state.markers.back().timestamp_lost = !slot_index.has_value();
     }
   }
 
@@ -273,16 +334,20 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
       }
     }
 
-    if (!IsCapturing() || marker_depth_exceeds_maximum) {
+    if (!IsCapturing() || marker_depth_exceeds_maximum ||
+        !IsCommandBufferSampled(command_buffer, 1)) {
       return;
     }
 
-    uint32_t slot_index = RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    // If the pool is full, the marker is handled like an end marker in a command buffer that is
+    // not sampled, and the slot of its begin is reset on submission.
+    std::optional<uint32_t> slot_index =
+        RecordTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
     {
       absl::WriterMutexLock lock(&mutex_);
       CHECK(command_buffer_to_state_.contains(command_buffer));
       CommandBufferState& state = command_buffer_to_state_.at(command_buffer);
-      state.markers.back().slot_index = std::make_optional(slot_index);
+      state.markers.back().slot_index = slot_index;
     }
   }
 
@@ -400,7 +465,8 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
                                        .color = marker.color.value(),
                                        .begin_info = submitted_marker,
                                        .depth = markers.marker_stack.size(),
-                                       .depth_exceeds_maximum = marker.cut_off};
+                                       .depth_exceeds_maximum = marker.cut_off,
+                                       .begin_timestamp_lost = marker.timestamp_lost};
               markers.marker_stack.push(std::move(marker_state));
               break;
             }
@@ -415,14 +481,24 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
                 marker_slots_to_reset.push_back(marker_state.begin_info.value().slot_index);
               }
 
-              // If the begin marker was discarded for exceeding the maximum depth, but the end
-              // marker was not (as it is in a different submission), we reset the slot.
-              if (marker_state.depth_exceeds_maximum && marker.slot_index.has_value()) {
+              // If the begin marker was timed, but the end marker was not because its command
+              // buffer was not sampled, the begin marker slot will never be read: reset it.
+              if (marker_state.begin_info.has_value() && queue_submission_optional.has_value() &&
+                  !marker.slot_index.has_value()) {
+                marker_slots_to_reset.push_back(marker_state.begin_info.value().slot_index);
+              }
+
+              // If the begin marker was discarded for exceeding the maximum depth, or its timestamp
+              // was lost because the pool was full, but the end marker was timed (it might be in a
+              // different submission), we reset the slot.
+              const bool begin_discarded =
+                  marker_state.depth_exceeds_maximum || marker_state.begin_timestamp_lost;
+              if (begin_discarded && marker.slot_index.has_value()) {
                 marker_slots_to_reset.push_back(marker.slot_index.value());
               }
 
               if (queue_submission_optional.has_value() && marker.slot_index.has_value() &&
-                  !marker_state.depth_exceeds_maximum) {
+                  !begin_discarded) {
                 CHECK(submitted_marker.has_value());
                 queue_submission_optional->completed_markers.emplace_back(
                     SubmittedMarkerSlice{.begin_info = marker_state.begin_info,
@@ -436,6 +512,15 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
             }
           }
         }
+
+        // The slots of the command buffer that are still in its state will never be read, e.g.,
+        // the slot of its begin when the pool was full at its end: reset them.
+        if (state.command_buffer_begin_slot_index.has_value()) {
+          marker_slots_to_reset.push_back(state.command_buffer_begin_slot_index.value());
+        }
+        if (state.command_buffer_end_slot_index.has_value()) {
+          marker_slots_to_reset.push_back(state.command_buffer_end_slot_index.value());
+        }
         command_buffer_to_state_.erase(command_buffer);
       }
     }
@@ -457,16 +542,24 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
 
   // This method is responsible for retrieving all the timestamps for the "completed" submissions,
   // for transforming the information of those submissions (in particlular about the command buffers
-  // and debug markers) into the `GpuQueueSubmission` proto, and for sending it to the
-  // `VulkanLayerProducer`. We consider a submission to be "completed" if its last command buffer
-  // timestamp is ready (see `PullCompletedSubmissions`).
-  // Beside the timestamps of command buffers and the meta information of the submission, the proto
+  // and debug markers) into a `GpuQueueSubmission` event, and for sending these events to the
+  // `VulkanLayerProducer` as a single batch. We consider a submission to be "completed" if its last
+  // command buffer timestamp is ready (see `PullCompletedSubmissions`).
+  // Beside the timestamps of command buffers and the meta information of the submission, the event
   // also contains the debug markers, "begin" (even if submitted in a different submission) and
   // "end", that got completed in this submission.
+  // Note that `GpuQueueSubmission` is a compact, protobuf-free struct: the producer only builds the
+  // corresponding CaptureEvent on its own thread, not on the thread presenting.
+  // The timestamps of all these submissions are read together, with as few calls to
+  // `vkGetQueryPoolResults` as possible (see `QueryGpuTimestampsNs`).
   // See also `WriteMetaInfo`, `WriteCommandBufferTimings` and `WriteDebugMarkers`.
   // This method also resets all the timer slots that have been read.
-  // It is assumed to be called periodically, e.g. on `vkQueuePresentKHR`.
+  // It is assumed to be called periodically, e.g. on `vkQueuePresentKHR`, and so it also marks the
+  // beginning of a new frame for the sampling of command buffers.
   void CompleteSubmits(VkDevice device) {
+    current_frame_.fetch_add(1, std::memory_order_relaxed);
+    num_timestamps_in_current_frame_.store(0, std::memory_order_relaxed);
+
     VkQueryPool query_pool = timer_query_pool_->GetQueryPool(device);
     std::vector<QueueSubmission> completed_submissions =
         PullCompletedSubmissions(device, query_pool);
@@ -479,22 +572,29 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     const float timestamp_period =
         device_manager_->GetPhysicalDeviceProperties(physical_device).limits.timestampPeriod;
 
+    // Read the timestamps of all completed submissions at once, with one call to Vulkan per range
+    // of consecutive slots, rather than one call per slot.
     std::vector<uint32_t> query_slots_to_reset = {};
     for (const auto& completed_submission : completed_submissions) {
-      orbit_grpc_protos::CaptureEvent capture_event;
-      orbit_grpc_protos::GpuQueueSubmission* submission_proto =
-          capture_event.mutable_gpu_queue_submission();
-      WriteMetaInfo(completed_submission.meta_information, submission_proto->mutable_meta_info());
+      CollectQuerySlots(completed_submission, &query_slots_to_reset);
+    }
+    const absl::flat_hash_map<uint32_t, uint64_t> slot_to_gpu_timestamp_ns =
+        QueryGpuTimestampsNs(device, query_pool, query_slots_to_reset, timestamp_period);
 
-      WriteCommandBufferTimings(completed_submission, submission_proto, &query_slots_to_reset,
-                                device, query_pool, timestamp_period);
+    std::vector<GpuQueueSubmission> gpu_queue_submissions;
+    gpu_queue_submissions.reserve(completed_submissions.size());
+    for (const auto& completed_submission : completed_submissions) {
+      GpuQueueSubmission& gpu_queue_submission = gpu_queue_submissions.emplace_back();
+      WriteMetaInfo(completed_submission.meta_information, &gpu_queue_submission.meta_info);
 
-      WriteDebugMarkers(completed_submission, submission_proto, &query_slots_to_reset, device,
-                        query_pool, timestamp_period);
+      WriteCommandBufferTimings(completed_submission, &gpu_queue_submission,
+                                slot_to_gpu_timestamp_ns);
 
-      if (vulkan_layer_producer_ != nullptr) {
-        vulkan_layer_producer_->EnqueueCaptureEvent(std::move(capture_event));
-      }
+      WriteDebugMarkers(completed_submission, &gpu_queue_submission, slot_to_gpu_timestamp_ns);
+    }
+
+    if (vulkan_layer_producer_ != nullptr) {
+      vulkan_layer_producer_->EnqueueGpuQueueSubmissions(std::move(gpu_queue_submissions));
     }
 
     timer_query_pool_->ResetQuerySlots(device, query_slots_to_reset);
@@ -541,9 +641,22 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     }
   }
 
-  void OnCaptureStart() override {}
+  void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override {
+    SetCommandBufferSamplingPeriodFrames(
+        capture_options.gpu_command_buffer_sampling_period_frames());
+    SetMaxTimestampsPerFrame(capture_options.max_gpu_timestamps_per_frame());
+    num_skipped_command_buffers_ = 0;
+    num_skipped_timestamps_ = 0;
+  }
 
-  void OnCaptureStop() override {}
+  void OnCaptureStop() override {
+    SamplingStatistics statistics = GetSamplingStatistics();
+    if (statistics.num_skipped_command_buffers > 0) {
+      LOG("Sampling of GPU command buffers skipped %u command buffers (%u timestamps)",
+          statistics.num_skipped_command_buffers, statistics.num_skipped_timestamps);
+    }
+    LogTimerQueryPoolStatistics();
+  }
 
   void OnCaptureFinished() override {
     absl::WriterMutexLock lock(&mutex_);
@@ -556,6 +669,7 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
         CHECK(command_buffer_to_device_.contains(command_buffer));
         device = command_buffer_to_device_.at(command_buffer);
       }
+      command_buffer_state.is_sampled.reset();
       if (command_buffer_state.command_buffer_begin_slot_index.has_value()) {
         slots_to_reset.push_back(command_buffer_state.command_buffer_begin_slot_index.value());
         command_buffer_state.command_buffer_begin_slot_index.reset();
@@ -587,6 +701,8 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     std::optional<std::string> label_name;
     std::optional<Color> color;
     bool cut_off;
+    // Whether the marker would have been timed, but the pool had no free slot.
+    bool timestamp_lost = false;
   };
 
   // We have a stack of all markers of a queue that gets updated upon a submission (VkQueueSubmit).
@@ -595,6 +711,7 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
   // completed markers of a `QueueSubmission`.
   // If a debug marker begin was discarded because of its depth, `depth_exceeds_maximum` is set to
   // true. This allows end markers on a different submission to also throw the end marker away.
+  // The same holds for `begin_timestamp_lost`, set if the pool had no free slot for the begin.
   //
   // Example: Max Depth = 1
   // Submission 1: Begin("Foo"), Begin("Bar) -- For "Bar" we set `depth_exceeds_maximum` to true.
@@ -605,6 +722,7 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     Color color;
     size_t depth;
     bool depth_exceeds_maximum;
+    bool begin_timestamp_lost;
   };
 
   struct QueueMarkerState {
@@ -616,10 +734,97 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     std::optional<uint32_t> command_buffer_end_slot_index;
     std::vector<Marker> markers;
     uint32_t local_marker_stack_size;
+    // Whether the begin would have been timed, but the pool had no free slot. The end is then not
+    // timed either.
+    bool begin_timestamp_lost = false;
+    // Whether the timings of this command buffer are recorded, decided the first time a timestamp
+    // would be written into it during a capture.
+    std::optional<bool> is_sampled;
   };
 
-  uint32_t RecordTimestamp(VkCommandBuffer command_buffer,
-                           VkPipelineStageFlagBits pipeline_stage_flags) {
+  // Returns whether timestamps are to be written into this command buffer, which is only decided
+  // the first time this is called for the command buffer (normally on its begin). Timestamps that
+  // are not written are counted as skipped. `num_timestamps` is the number of timestamps the
+  // command buffer is expected to need, which is checked against the budget of the frame.
+  [[nodiscard]] bool IsCommandBufferSampled(VkCommandBuffer command_buffer,
+                                            uint32_t num_timestamps) {
+    // Sampling is only configured at the start of a capture, so when it is disabled every command
+    // buffer is sampled and there is no state to look at.
+    if (!IsSamplingEnabled()) {
+      return true;
+    }
+
+    absl::WriterMutexLock lock(&mutex_);
+    CHECK(command_buffer_to_state_.contains(command_buffer));
+    CommandBufferState& state = command_buffer_to_state_.at(command_buffer);
+    if (!state.is_sampled.has_value()) {
+      state.is_sampled = ShouldSampleCommandBuffer(num_timestamps);
+      if (!state.is_sampled.value()) {
+        num_skipped_command_buffers_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (!state.is_sampled.value()) {
+      num_skipped_timestamps_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return state.is_sampled.value();
+  }
+
+  // Logs how the timer query pools of the devices that have command buffers have been used since
+  // the last time this was called, i.e., during the capture that is stopping, as slots are only
+  // allocated while capturing. This tells whether the pools are large enough.
+  void LogTimerQueryPoolStatistics() {
+    absl::flat_hash_set<VkDevice> devices;
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      for (const auto& [unused_command_buffer, device] : command_buffer_to_device_) {
+        devices.insert(device);
+      }
+    }
+    for (VkDevice device : devices) {
+      const TimerQueryPoolStatistics statistics = timer_query_pool_->GetStatistics(device);
+      // The counters of the pool are cumulative since its creation.
+      const TimerQueryPoolStatistics& logged_statistics =
+          logged_timer_query_pool_statistics_[device];
+      const uint64_t num_allocations =
+          statistics.num_allocations - logged_statistics.num_allocations;
+      const uint64_t num_failed_allocations =
+          statistics.num_failed_allocations - logged_statistics.num_failed_allocations;
+      logged_timer_query_pool_statistics_[device] = statistics;
+      if (num_failed_allocations > 0) {
+        ERROR("Timer query pool of device %p was full %u times (%u slots allocated, at most %u "
+              "slots in use at once since its creation): GPU timestamps were lost",
+              static_cast<void*>(device), num_failed_allocations, num_allocations,
+              statistics.max_num_slots_in_use);
+      } else {
+        LOG("Timer query pool of device %p: %u slots allocated, at most %u slots in use at once "
+            "since its creation",
+            static_cast<void*>(device), num_allocations, statistics.max_num_slots_in_use);
+      }
+    }
+  }
+
+  [[nodiscard]] bool IsSamplingEnabled() const {
+    return sampling_period_frames_.load(std::memory_order_relaxed) > 1 ||
+           max_timestamps_per_frame_.load(std::memory_order_relaxed) != 0;
+  }
+
+  [[nodiscard]] bool ShouldSampleCommandBuffer(uint32_t num_timestamps) const {
+    const uint32_t sampling_period_frames = sampling_period_frames_.load(std::memory_order_relaxed);
+    if (sampling_period_frames > 1 &&
+        current_frame_.load(std::memory_order_relaxed) % sampling_period_frames != 0) {
+      return false;
+    }
+    const uint32_t max_timestamps_per_frame =
+        max_timestamps_per_frame_.load(std::memory_order_relaxed);
+    return max_timestamps_per_frame == 0 ||
+           num_timestamps_in_current_frame_.load(std::memory_order_relaxed) + num_timestamps <=
+               max_timestamps_per_frame;
+  }
+
+  // Writes a timestamp into a free slot of the pool and returns the slot, or returns `nullopt` if
+  // there is no free slot. This is counted in the statistics of the pool.
+  [[nodiscard]] std::optional<uint32_t> RecordTimestamp(
+      VkCommandBuffer command_buffer, VkPipelineStageFlagBits pipeline_stage_flags) {
     VkDevice device;
     {
       absl::ReaderMutexLock lock(&mutex_);
@@ -630,8 +835,10 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     VkQueryPool query_pool = timer_query_pool_->GetQueryPool(device);
 
     uint32_t slot_index;
-    bool found_slot = timer_query_pool_->NextReadyQuerySlot(device, &slot_index);
-    CHECK(found_slot);
+    if (!timer_query_pool_->NextReadyQuerySlot(device, &slot_index)) {
+      return std::nullopt;
+    }
+    num_timestamps_in_current_frame_.fetch_add(1, std::memory_order_relaxed);
     dispatch_table_->CmdWriteTimestamp(command_buffer)(command_buffer, pipeline_stage_flags,
                                                        query_pool, slot_index);
 
@@ -697,95 +904,127 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
     return completed_submissions;
   }
 
-  uint64_t QueryGpuTimestampNs(VkDevice device, VkQueryPool query_pool, uint32_t slot_index,
-                               float timestamp_period) {
+  // Appends all the slots whose timestamps are needed for the `GpuQueueSubmission` corresponding to
+  // this submission.
+  static void CollectQuerySlots(const QueueSubmission& completed_submission,
+                                std::vector<uint32_t>* query_slots) {
+    for (const auto& completed_submit : completed_submission.submit_infos) {
+      for (const auto& completed_command_buffer : completed_submit.command_buffers) {
+        if (completed_command_buffer.command_buffer_begin_slot_index.has_value()) {
+          query_slots->push_back(completed_command_buffer.command_buffer_begin_slot_index.value());
+        }
+        query_slots->push_back(completed_command_buffer.command_buffer_end_slot_index);
+      }
+    }
+    for (const auto& marker_state : completed_submission.completed_markers) {
+      query_slots->push_back(marker_state.end_info.slot_index);
+      if (marker_state.begin_info.has_value()) {
+        query_slots->push_back(marker_state.begin_info->slot_index);
+      }
+    }
+  }
+
+  // Retrieves the timestamps of all the given slots, which must all be available, and converts
+  // them to nanoseconds. Slots with consecutive indices are read with a single call to
+  // `vkGetQueryPoolResults`.
+  absl::flat_hash_map<uint32_t, uint64_t> QueryGpuTimestampsNs(
+      VkDevice device, VkQueryPool query_pool, const std::vector<uint32_t>& slot_indices,
+      float timestamp_period) {
     static constexpr VkDeviceSize kResultStride = sizeof(uint64_t);
 
-    uint64_t timestamp = 0;
-    VkResult result_status = dispatch_table_->GetQueryPoolResults(device)(
-        device, query_pool, slot_index, 1, sizeof(timestamp), &timestamp, kResultStride,
-        VK_QUERY_RESULT_64_BIT);
-    CHECK(result_status == VK_SUCCESS);
+    std::vector<uint32_t> sorted_slot_indices = slot_indices;
+    std::sort(sorted_slot_indices.begin(), sorted_slot_indices.end());
+    sorted_slot_indices.erase(std::unique(sorted_slot_indices.begin(), sorted_slot_indices.end()),
+                              sorted_slot_indices.end());
+
+    std::vector<uint64_t> timestamps(sorted_slot_indices.size());
+    PFN_vkGetQueryPoolResults get_query_pool_results_function =
+        dispatch_table_->GetQueryPoolResults(device);
+    size_t range_begin = 0;
+    for (size_t i = 1; i <= sorted_slot_indices.size(); ++i) {
+      if (i < sorted_slot_indices.size() &&
+          sorted_slot_indices[i] == sorted_slot_indices[i - 1] + 1) {
+        continue;
+      }
+      const size_t range_size = i - range_begin;
+      VkResult result_status = get_query_pool_results_function(
+          device, query_pool, sorted_slot_indices[range_begin], static_cast<uint32_t>(range_size),
+          range_size * sizeof(uint64_t), timestamps.data() + range_begin, kResultStride,
+          VK_QUERY_RESULT_64_BIT);
+      CHECK(result_status == VK_SUCCESS);
+      range_begin = i;
+    }
 
-    return static_cast<uint64_t>(static_cast<double>(timestamp) * timestamp_period);
+    absl::flat_hash_map<uint32_t, uint64_t> slot_to_timestamp_ns;
+    slot_to_timestamp_ns.reserve(sorted_slot_indices.size());
+    for (size_t i = 0; i < sorted_slot_indices.size(); ++i) {
+      slot_to_timestamp_ns.emplace(
+          sorted_slot_indices[i],
+          static_cast<uint64_t>(static_cast<double>(timestamps[i]) * timestamp_period));
+    }
+    return slot_to_timestamp_ns;
   }
 
   static void WriteMetaInfo(const SubmissionMetaInformation& meta_info,
-                            orbit_grpc_protos::GpuQueueSubmissionMetaInfo* target_proto) {
-    target_proto->set_tid(meta_info.thread_id);
-    target_proto->set_pre_submission_cpu_timestamp(meta_info.pre_submission_cpu_timestamp);
-    target_proto->set_post_submission_cpu_timestamp(meta_info.post_submission_cpu_timestamp);
+                            GpuQueueSubmissionMetaInfo* target_meta_info) {
+    target_meta_info->tid = meta_info.thread_id;
+    target_meta_info->pre_submission_cpu_timestamp = meta_info.pre_submission_cpu_timestamp;
+    target_meta_info->post_submission_cpu_timestamp = meta_info.post_submission_cpu_timestamp;
   }
 
-  void WriteCommandBufferTimings(const QueueSubmission& completed_submission,
-                                 orbit_grpc_protos::GpuQueueSubmission* submission_proto,
-                                 std::vector<uint32_t>* query_slots_to_reset, VkDevice device,
-                                 VkQueryPool query_pool, float timestamp_period) {
+  static void WriteCommandBufferTimings(
+      const QueueSubmission& completed_submission, GpuQueueSubmission* gpu_queue_submission,
+      const absl::flat_hash_map<uint32_t, uint64_t>& slot_to_gpu_timestamp_ns) {
+    gpu_queue_submission->num_command_buffers_per_submit_info.reserve(
+        completed_submission.submit_infos.size());
     for (const auto& completed_submit : completed_submission.submit_infos) {
-      orbit_grpc_protos::GpuSubmitInfo* submit_info_proto = submission_proto->add_submit_infos();
+      gpu_queue_submission->num_command_buffers_per_submit_info.push_back(
+          static_cast<uint32_t>(completed_submit.command_buffers.size()));
       for (const auto& completed_command_buffer : completed_submit.command_buffers) {
-        orbit_grpc_protos::GpuCommandBuffer* command_buffer_proto =
-            submit_info_proto->add_command_buffers();
+        GpuCommandBuffer& command_buffer =
+            gpu_queue_submission->command_buffers.emplace_back();
 
         if (completed_command_buffer.command_buffer_begin_slot_index.has_value()) {
-          uint32_t slot_index = completed_command_buffer.command_buffer_begin_slot_index.value();
-          uint64_t begin_timestamp =
-              QueryGpuTimestampNs(device, query_pool, slot_index, timestamp_period);
-          command_buffer_proto->set_begin_gpu_timestamp_ns(begin_timestamp);
-
-          query_slots_to_reset->push_back(slot_index);
+          command_buffer.begin_gpu_timestamp_ns = slot_to_gpu_timestamp_ns.at(
+              completed_command_buffer.command_buffer_begin_slot_index.value());
         }
 
-        uint32_t slot_index = completed_command_buffer.command_buffer_end_slot_index;
-        uint64_t end_timestamp =
-            QueryGpuTimestampNs(device, query_pool, slot_index, timestamp_period);
-
-        command_buffer_proto->set_end_gpu_timestamp_ns(end_timestamp);
-        query_slots_to_reset->push_back(slot_index);
+        command_buffer.end_gpu_timestamp_ns =
+            slot_to_gpu_timestamp_ns.at(completed_command_buffer.command_buffer_end_slot_index);
       }
     }
   }
 
   void WriteDebugMarkers(const QueueSubmission& completed_submission,
-                         orbit_grpc_protos::GpuQueueSubmission* submission_proto,
-                         std::vector<uint32_t>* query_slots_to_reset, VkDevice device,
-                         VkQueryPool query_pool, const float timestamp_period) {
-    submission_proto->set_num_begin_markers(completed_submission.num_begin_markers);
+                         GpuQueueSubmission* gpu_queue_submission,
+                         const absl::flat_hash_map<uint32_t, uint64_t>& slot_to_gpu_timestamp_ns) {
+    gpu_queue_submission->num_begin_markers =
+        static_cast<int32_t>(completed_submission.num_begin_markers);
+    gpu_queue_submission->completed_markers.reserve(completed_submission.completed_markers.size());
     for (const auto& marker_state : completed_submission.completed_markers) {
-      uint64_t end_timestamp = QueryGpuTimestampNs(
-          device, query_pool, marker_state.end_info.slot_index, timestamp_period);
-      query_slots_to_reset->push_back(marker_state.end_info.slot_index);
+      GpuDebugMarker& marker = gpu_queue_submission->completed_markers.emplace_back();
+      marker.end_gpu_timestamp_ns = slot_to_gpu_timestamp_ns.at(marker_state.end_info.slot_index);
 
-      orbit_grpc_protos::GpuDebugMarker* marker_proto = submission_proto->add_completed_markers();
       if (vulkan_layer_producer_ != nullptr) {
-        marker_proto->set_text_key(
-            vulkan_layer_producer_->InternStringIfNecessaryAndGetKey(marker_state.label_name));
+        marker.text_key =
+            vulkan_layer_producer_->InternStringIfNecessaryAndGetKey(marker_state.label_name);
       }
       if (marker_state.color.red != 0.0f || marker_state.color.green != 0.0f ||
           marker_state.color.blue != 0.0f || marker_state.color.alpha != 0.0f) {
-        auto color = marker_proto->mutable_color();
-        color->set_red(marker_state.color.red);
-        color->set_green(marker_state.color.green);
-        color->set_blue(marker_state.color.blue);
-        color->set_alpha(marker_state.color.alpha);
+        marker.color = GpuDebugMarkerColor{marker_state.color.red, marker_state.color.green,
+                                           marker_state.color.blue, marker_state.color.alpha};
       }
-      marker_proto->set_depth(marker_state.depth);
-      marker_proto->set_end_gpu_timestamp_ns(end_timestamp);
+      marker.depth = static_cast<int32_t>(marker_state.depth);
 
       // If we haven't captured the begin marker, we'll leave the optional begin_marker empty.
       if (!marker_state.begin_info.has_value()) {
         continue;
       }
-      orbit_grpc_protos::GpuDebugMarkerBeginInfo* begin_debug_marker_proto =
-          marker_proto->mutable_begin_marker();
-      WriteMetaInfo(marker_state.begin_info->meta_information,
-                    begin_debug_marker_proto->mutable_meta_info());
+      GpuDebugMarkerBeginInfo& begin_marker = marker.begin_marker.emplace();
+      WriteMetaInfo(marker_state.begin_info->meta_information, &begin_marker.meta_info);
 
-      uint64_t begin_timestamp = QueryGpuTimestampNs(
-          device, query_pool, marker_state.begin_info->slot_index, timestamp_period);
-      query_slots_to_reset->push_back(marker_state.begin_info->slot_index);
-
-      begin_debug_marker_proto->set_gpu_timestamp_ns(begin_timestamp);
+      begin_marker.gpu_timestamp_ns =
+          slot_to_gpu_timestamp_ns.at(marker_state.begin_info->slot_index);
     }
   }
 
@@ -805,6 +1044,18 @@ class SubmissionTracker : public VulkanLayerProducer::CaptureStatusListener {
   // all debug markers.
   uint32_t max_local_marker_depth_per_command_buffer_ = std::numeric_limits<uint32_t>::max();
 
+  std::atomic<uint32_t> sampling_period_frames_ = 1;
+  std::atomic<uint32_t> max_timestamps_per_frame_ = 0;
+  std::atomic<uint64_t> current_frame_ = 0;
+  std::atomic<uint32_t> num_timestamps_in_current_frame_ = 0;
+  std::atomic<uint64_t> num_skipped_command_buffers_ = 0;
+  std::atomic<uint64_t> num_skipped_timestamps_ = 0;
+
+  using TimerQueryPoolStatistics = typename TimerQueryPool::Statistics;
+  // The statistics of the timer query pools as of the last capture stop. Only accessed in
+  // `OnCaptureStop`.
+  absl::flat_hash_map<VkDevice, TimerQueryPoolStatistics> logged_timer_query_pool_statistics_;
+
   [[nodiscard]] bool IsCapturing() {
     return vulkan_layer_producer_ != nullptr && vulkan_layer_producer_->IsCapturing();
   }
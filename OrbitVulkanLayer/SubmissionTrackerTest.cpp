@@ -29,10 +29,17 @@ PFN_vkCmdWriteTimestamp dummy_write_timestamp_function =
 
 class MockTimerQueryPool {
  public:
+  struct Statistics {
+    uint64_t num_allocations = 0;
+    uint64_t num_failed_allocations = 0;
+    uint32_t max_num_slots_in_use = 0;
+  };
+
   MOCK_METHOD(VkQueryPool, GetQueryPool, (VkDevice), ());
   MOCK_METHOD(void, ResetQuerySlots, (VkDevice, const std::vector<uint32_t>&), ());
   MOCK_METHOD(void, RollbackPendingQuerySlots, (VkDevice, const std::vector<uint32_t>&), ());
   MOCK_METHOD(bool, NextReadyQuerySlot, (VkDevice, uint32_t*), ());
+  MOCK_METHOD(Statistics, GetStatistics, (VkDevice), ());
 };
 
 class MockDeviceManager {
@@ -45,18 +52,18 @@ class MockVulkanLayerProducer : public VulkanLayerProducer {
  public:
   MOCK_METHOD(bool, IsCapturing, (), (override));
   MOCK_METHOD(uint64_t, InternStringIfNecessaryAndGetKey, (std::string), (override));
-  MOCK_METHOD(bool, EnqueueCaptureEvent, (orbit_grpc_protos::CaptureEvent && capture_event),
-              (override));
+  MOCK_METHOD(bool, EnqueueGpuQueueSubmissions,
+              (std::vector<GpuQueueSubmission> && gpu_queue_submissions), (override));
 
   MOCK_METHOD(void, BringUp, (const std::shared_ptr<grpc::Channel>& channel), (override));
   MOCK_METHOD(void, TakeDown, (), (override));
 
   MOCK_METHOD(void, SetCaptureStatusListener, (CaptureStatusListener*), (override));
 
-  void StartCapture() {
+  void StartCapture(orbit_grpc_protos::CaptureOptions capture_options = {}) {
     is_capturing_ = true;
     ASSERT_NE(listener_, nullptr);
-    listener_->OnCaptureStart();
+    listener_->OnCaptureStart(std::move(capture_options));
   }
 
   void StopCapture() {
@@ -97,6 +104,8 @@ class SubmissionTrackerTest : public ::testing::Test {
     auto is_capturing_function = [this]() -> bool { return producer_->is_capturing_; };
     EXPECT_CALL(*producer_, IsCapturing).WillRepeatedly(Invoke(is_capturing_function));
     EXPECT_CALL(timer_query_pool_, GetQueryPool).WillRepeatedly(Return(query_pool_));
+    EXPECT_CALL(timer_query_pool_, GetStatistics)
+        .WillRepeatedly(Return(MockTimerQueryPool::Statistics{}));
     EXPECT_CALL(device_manager_, GetPhysicalDeviceOfLogicalDevice)
         .WillRepeatedly(Return(physical_device_));
     EXPECT_CALL(device_manager_, GetPhysicalDeviceProperties)
@@ -178,39 +187,44 @@ class SubmissionTrackerTest : public ::testing::Test {
   static constexpr uint64_t kTimestamp6 = 16;
   static constexpr uint64_t kTimestamp7 = 17;
 
-  const PFN_vkGetQueryPoolResults mock_get_query_pool_results_function_all_ready_ =
-      +[](VkDevice /*device*/, VkQueryPool /*queryPool*/, uint32_t first_query,
-          uint32_t query_count, size_t /*dataSize*/, void* data, VkDeviceSize /*stride*/,
-          VkQueryResultFlags flags) -> VkResult {
-    EXPECT_EQ(query_count, 1);
-    EXPECT_NE((flags & VK_QUERY_RESULT_64_BIT), 0);
-    switch (first_query) {
+  static uint64_t GetTimestampOfSlot(uint32_t slot_index) {
+    switch (slot_index) {
       case kSlotIndex1:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp1;
-        break;
+        return kTimestamp1;
       case kSlotIndex2:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp2;
-        break;
+        return kTimestamp2;
       case kSlotIndex3:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp3;
-        break;
+        return kTimestamp3;
       case kSlotIndex4:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp4;
-        break;
+        return kTimestamp4;
       case kSlotIndex5:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp5;
-        break;
+        return kTimestamp5;
       case kSlotIndex6:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp6;
-        break;
+        return kTimestamp6;
       case kSlotIndex7:
-        *absl::bit_cast<uint64_t*>(data) = kTimestamp7;
-        break;
+        return kTimestamp7;
       default:
         UNREACHABLE();
     }
+  }
+
+  // Consecutive slots can be queried at once.
+  static VkResult MockGetQueryPoolResultsAllReady(VkDevice /*device*/, VkQueryPool /*queryPool*/,
+                                                  uint32_t first_query, uint32_t query_count,
+                                                  size_t data_size, void* data,
+                                                  VkDeviceSize stride, VkQueryResultFlags flags) {
+    EXPECT_GE(query_count, 1);
+    EXPECT_NE((flags & VK_QUERY_RESULT_64_BIT), 0);
+    EXPECT_EQ(stride, sizeof(uint64_t));
+    EXPECT_GE(data_size, query_count * sizeof(uint64_t));
+    for (uint32_t i = 0; i < query_count; ++i) {
+      absl::bit_cast<uint64_t*>(data)[i] = GetTimestampOfSlot(first_query + i);
+    }
     return VK_SUCCESS;
-  };
+  }
+
+  const PFN_vkGetQueryPoolResults mock_get_query_pool_results_function_all_ready_ =
+      MockGetQueryPoolResultsAllReady;
 
   const PFN_vkGetQueryPoolResults mock_get_query_pool_results_function_not_ready_ =
       +[](VkDevice /*device*/, VkQueryPool /*queryPool*/, uint32_t /*first_query*/,
@@ -468,14 +482,15 @@ TEST_F(SubmissionTrackerTest, CanRetrieveCommandBufferTimestampsForACompleteSubm
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -505,14 +520,15 @@ TEST_F(SubmissionTrackerTest,
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -532,6 +548,66 @@ TEST_F(SubmissionTrackerTest,
                                         pid, kTimestamp1, kTimestamp2);
 }
 
+TEST_F(SubmissionTrackerTest, CompletedSubmissionsAreReadAndEnqueuedTogether) {
+  ExpectFourNextReadyQuerySlotCalls();
+  static std::vector<std::pair<uint32_t, uint32_t>> actual_queried_ranges;
+  actual_queried_ranges.clear();
+  PFN_vkGetQueryPoolResults mock_get_query_pool_results_function =
+      +[](VkDevice device, VkQueryPool query_pool, uint32_t first_query, uint32_t query_count,
+          size_t data_size, void* data, VkDeviceSize stride, VkQueryResultFlags flags) -> VkResult {
+    actual_queried_ranges.emplace_back(first_query, query_count);
+    return MockGetQueryPoolResultsAllReady(device, query_pool, first_query, query_count,
+                                           data_size, data, stride, flags);
+  };
+  EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
+      .WillRepeatedly(Return(mock_get_query_pool_results_function));
+  std::vector<uint32_t> actual_reset_slots;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(1)
+      .WillOnce(SaveArg<1>(&actual_reset_slots));
+  std::vector<orbit_grpc_protos::CaptureEvent> actual_capture_events;
+  auto mock_enqueue_capture_events =
+      [&actual_capture_events](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        for (const GpuQueueSubmission& gpu_queue_submission : gpu_queue_submissions) {
+          actual_capture_events.emplace_back(CreateCaptureEvent(gpu_queue_submission));
+        }
+        return true;
+      };
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
+      .Times(1)
+      .WillOnce(Invoke(mock_enqueue_capture_events));
+
+  producer_->StartCapture();
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  pid_t pid = orbit_base::GetCurrentThreadId();
+  uint64_t pre_submit_time = MonotonicTimestampNs();
+  std::optional<QueueSubmission> queue_submission_optional_1 =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional_1);
+  tracker_.ResetCommandBuffer(command_buffer_);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional_2 =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional_2);
+  uint64_t post_submit_time = MonotonicTimestampNs();
+  tracker_.CompleteSubmits(device_);
+
+  // One query per submission to check that it is complete, then one for all the timestamps.
+  EXPECT_THAT(actual_queried_ranges,
+              ElementsAre(std::make_pair(kSlotIndex2, 1u), std::make_pair(kSlotIndex4, 1u),
+                          std::make_pair(kSlotIndex1, 4u)));
+  EXPECT_THAT(actual_reset_slots,
+              UnorderedElementsAre(kSlotIndex1, kSlotIndex2, kSlotIndex3, kSlotIndex4));
+  ASSERT_EQ(actual_capture_events.size(), 2);
+  ExpectSingleCommandBufferSubmissionEq(actual_capture_events[0], pre_submit_time,
+                                        post_submit_time, pid, kTimestamp1, kTimestamp2);
+  ExpectSingleCommandBufferSubmissionEq(actual_capture_events[1], pre_submit_time,
+                                        post_submit_time, pid, kTimestamp3, kTimestamp4);
+}
+
 TEST_F(SubmissionTrackerTest, StopCaptureBeforeSubmissionWillResetTheSlots) {
   ExpectTwoNextReadyQuerySlotCalls();
   EXPECT_CALL(dispatch_table_, GetQueryPoolResults).Times(0);
@@ -540,7 +616,7 @@ TEST_F(SubmissionTrackerTest, StopCaptureBeforeSubmissionWillResetTheSlots) {
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
 
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -565,14 +641,15 @@ TEST_F(SubmissionTrackerTest,
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -601,14 +678,15 @@ TEST_F(SubmissionTrackerTest, StopCaptureDuringSubmissionWillStillYieldResults)
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -632,7 +710,7 @@ TEST_F(SubmissionTrackerTest, StartCaptureJustBeforeSubmissionWontWriteData) {
   EXPECT_CALL(timer_query_pool_, NextReadyQuerySlot).Times(0);
   EXPECT_CALL(dispatch_table_, GetQueryPoolResults).Times(0);
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots).Times(0);
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
 
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
   tracker_.MarkCommandBufferBegin(command_buffer_);
@@ -648,7 +726,7 @@ TEST_F(SubmissionTrackerTest, StartCaptureDuringSubmissionWontWriteData) {
   EXPECT_CALL(timer_query_pool_, NextReadyQuerySlot).Times(0);
   EXPECT_CALL(dispatch_table_, GetQueryPoolResults).Times(0);
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots).Times(0);
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
 
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
   tracker_.MarkCommandBufferBegin(command_buffer_);
@@ -669,7 +747,7 @@ TEST_F(SubmissionTrackerTest, WillResetProperlyWhenStartStopAndStartACaptureWith
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
 
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
   producer_->StartCapture();
@@ -687,19 +765,11 @@ TEST_F(SubmissionTrackerTest, WillResetProperlyWhenStartStopAndStartACaptureWith
 
 TEST_F(SubmissionTrackerTest, CannotReuseCommandBufferWithoutReset) {
   ExpectTwoNextReadyQuerySlotCalls();
-  EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
-      .WillRepeatedly(Return(mock_get_query_pool_results_function_all_ready_));
-  EXPECT_CALL(timer_query_pool_, ResetQuerySlots).Times(1);
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(1);
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
   tracker_.MarkCommandBufferBegin(command_buffer_);
   tracker_.MarkCommandBufferEnd(command_buffer_);
-  std::optional<QueueSubmission> queue_submission_optional =
-      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
-  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
-  tracker_.CompleteSubmits(device_);
 
   EXPECT_DEATH({ tracker_.MarkCommandBufferBegin(command_buffer_); }, "");
 }
@@ -709,7 +779,7 @@ TEST_F(SubmissionTrackerTest, CanReuseCommandBufferAfterReset) {
   EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
       .WillRepeatedly(Return(mock_get_query_pool_results_function_all_ready_));
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots).Times(1);
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(1);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(1);
 
   producer_->StartCapture();
   tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
@@ -793,9 +863,10 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerTimestampsForACompleteSubmis
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
@@ -808,9 +879,9 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerTimestampsForACompleteSubmis
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -852,9 +923,10 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerEndEvenWhenBeginNotCaptured)
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
@@ -867,9 +939,9 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerEndEvenWhenBeginNotCaptured)
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -906,9 +978,10 @@ TEST_F(SubmissionTrackerTest, CanRetrieveNestedDebugMarkerTimestampsForAComplete
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
@@ -928,9 +1001,9 @@ TEST_F(SubmissionTrackerTest, CanRetrieveNestedDebugMarkerTimestampsForAComplete
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(2)
       .WillRepeatedly(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -983,9 +1056,10 @@ TEST_F(SubmissionTrackerTest,
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
@@ -1005,9 +1079,9 @@ TEST_F(SubmissionTrackerTest,
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(2)
       .WillRepeatedly(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1060,9 +1134,11 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerAcrossTwoSubmissions) {
       .WillOnce(SaveArg<1>(&actual_reset_slots_1))
       .WillOnce(SaveArg<1>(&actual_reset_slots_2));
   std::vector<orbit_grpc_protos::CaptureEvent> actual_capture_events;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_events](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_events.emplace_back(std::move(capture_event));
+  auto mock_enqueue_capture_events =
+      [&actual_capture_events](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        for (const GpuQueueSubmission& gpu_queue_submission : gpu_queue_submissions) {
+          actual_capture_events.emplace_back(CreateCaptureEvent(gpu_queue_submission));
+        }
         return true;
       };
 
@@ -1075,9 +1151,9 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerAcrossTwoSubmissions) {
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(2)
-      .WillRepeatedly(Invoke(mock_enqueue_capture_event));
+      .WillRepeatedly(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1140,9 +1216,11 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerAcrossTwoSubmissionsEvenWhen
       .WillOnce(SaveArg<1>(&actual_reset_slots_1))
       .WillOnce(SaveArg<1>(&actual_reset_slots_2));
   std::vector<orbit_grpc_protos::CaptureEvent> actual_capture_events;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_events](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_events.emplace_back(std::move(capture_event));
+  auto mock_enqueue_capture_events =
+      [&actual_capture_events](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        for (const GpuQueueSubmission& gpu_queue_submission : gpu_queue_submissions) {
+          actual_capture_events.emplace_back(CreateCaptureEvent(gpu_queue_submission));
+        }
         return true;
       };
 
@@ -1155,9 +1233,9 @@ TEST_F(SubmissionTrackerTest, CanRetrieveDebugMarkerAcrossTwoSubmissionsEvenWhen
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(2)
-      .WillRepeatedly(Invoke(mock_enqueue_capture_event));
+      .WillRepeatedly(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1214,17 +1292,18 @@ TEST_F(SubmissionTrackerTest, ResetSlotsOnDebugMarkerAcrossTwoSubmissionsWhenEnd
       .WillOnce(SaveArg<1>(&actual_reset_slots_1))
       .WillOnce(SaveArg<1>(&actual_reset_slots_2));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
   const char* text = "Text";
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey).Times(0);
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1265,7 +1344,7 @@ TEST_F(SubmissionTrackerTest, ResetDebugMarkerSlotsWhenStopBeforeASubmission) {
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
   const char* text = "Text";
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
@@ -1297,9 +1376,10 @@ TEST_F(SubmissionTrackerTest, CanLimitNestedDebugMarkerDepthPerCommandBuffer) {
       .Times(1)
       .WillOnce(SaveArg<1>(&actual_reset_slots));
   orbit_grpc_protos::CaptureEvent actual_capture_event;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_event](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_event = std::move(capture_event);
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
         return true;
       };
 
@@ -1315,9 +1395,9 @@ TEST_F(SubmissionTrackerTest, CanLimitNestedDebugMarkerDepthPerCommandBuffer) {
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(1)
-      .WillOnce(Invoke(mock_enqueue_capture_event));
+      .WillOnce(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1369,9 +1449,11 @@ TEST_F(SubmissionTrackerTest, CanLimitNestedDebugMarkerDepthPerCommandBufferAcro
   EXPECT_CALL(timer_query_pool_, ResetQuerySlots).WillRepeatedly(Invoke(mock_reset_query_slots));
 
   std::vector<orbit_grpc_protos::CaptureEvent> actual_capture_events;
-  auto mock_enqueue_capture_event =
-      [&actual_capture_events](orbit_grpc_protos::CaptureEvent&& capture_event) {
-        actual_capture_events.emplace_back(std::move(capture_event));
+  auto mock_enqueue_capture_events =
+      [&actual_capture_events](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        for (const GpuQueueSubmission& gpu_queue_submission : gpu_queue_submissions) {
+          actual_capture_events.emplace_back(CreateCaptureEvent(gpu_queue_submission));
+        }
         return true;
       };
 
@@ -1385,9 +1467,9 @@ TEST_F(SubmissionTrackerTest, CanLimitNestedDebugMarkerDepthPerCommandBufferAcro
   EXPECT_CALL(*producer_, InternStringIfNecessaryAndGetKey)
       .Times(1)
       .WillOnce(Invoke(mock_intern_string_if_necessary_and_get_key));
-  EXPECT_CALL(*producer_, EnqueueCaptureEvent)
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
       .Times(2)
-      .WillRepeatedly(Invoke(mock_enqueue_capture_event));
+      .WillRepeatedly(Invoke(mock_enqueue_capture_events));
 
   Color expected_color{1.f, 0.8f, 0.6f, 0.4f};
 
@@ -1444,4 +1526,190 @@ TEST_F(SubmissionTrackerTest, CanLimitNestedDebugMarkerDepthPerCommandBufferAcro
                            tid);
 }
 
+TEST_F(SubmissionTrackerTest, CommandBuffersAreOnlyTimedInSampledFrames) {
+  ExpectTwoNextReadyQuerySlotCalls();
+  EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
+      .WillRepeatedly(Return(mock_get_query_pool_results_function_all_ready_));
+  std::vector<uint32_t> actual_reset_slots;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(1)
+      .WillOnce(SaveArg<1>(&actual_reset_slots));
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(1);
+
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_gpu_command_buffer_sampling_period_frames(2);
+  producer_->StartCapture(capture_options);
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+
+  // Frame 0 is sampled, frame 1 is not.
+  for (int frame = 0; frame < 2; ++frame) {
+    tracker_.MarkCommandBufferBegin(command_buffer_);
+    tracker_.MarkCommandBufferEnd(command_buffer_);
+    std::optional<QueueSubmission> queue_submission_optional =
+        tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+    tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+    tracker_.CompleteSubmits(device_);
+  }
+
+  EXPECT_THAT(actual_reset_slots, UnorderedElementsAre(kSlotIndex1, kSlotIndex2));
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_command_buffers, 1);
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_timestamps, 2);
+}
+
+TEST_F(SubmissionTrackerTest, TimestampBudgetLimitsTimedCommandBuffersPerFrame) {
+  ExpectFourNextReadyQuerySlotCalls();
+  EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
+      .WillRepeatedly(Return(mock_get_query_pool_results_function_all_ready_));
+  std::vector<uint32_t> actual_reset_slots_1;
+  std::vector<uint32_t> actual_reset_slots_2;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(2)
+      .WillOnce(SaveArg<1>(&actual_reset_slots_1))
+      .WillOnce(SaveArg<1>(&actual_reset_slots_2));
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(2);
+
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_max_gpu_timestamps_per_frame(2);
+  producer_->StartCapture(capture_options);
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+
+  // The second command buffer of the first frame exceeds the budget.
+  for (int command_buffer_in_frame = 0; command_buffer_in_frame < 2; ++command_buffer_in_frame) {
+    tracker_.MarkCommandBufferBegin(command_buffer_);
+    tracker_.MarkCommandBufferEnd(command_buffer_);
+    std::optional<QueueSubmission> queue_submission_optional =
+        tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+    tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+  }
+  tracker_.CompleteSubmits(device_);
+
+  // The budget is renewed in the next frame.
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+  tracker_.CompleteSubmits(device_);
+
+  EXPECT_THAT(actual_reset_slots_1, UnorderedElementsAre(kSlotIndex1, kSlotIndex2));
+  EXPECT_THAT(actual_reset_slots_2, UnorderedElementsAre(kSlotIndex3, kSlotIndex4));
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_command_buffers, 1);
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_timestamps, 2);
+}
+
+TEST_F(SubmissionTrackerTest, ResetDebugMarkerBeginSlotWhenEndIsInACommandBufferNotSampled) {
+  ExpectThreeNextReadyQuerySlotCalls();
+  std::vector<uint32_t> actual_reset_slots;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(1)
+      .WillOnce(SaveArg<1>(&actual_reset_slots));
+
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_max_gpu_timestamps_per_frame(3);
+  producer_->StartCapture(capture_options);
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkDebugMarkerBegin(command_buffer_, "Marker", {});
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional_1 =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional_1);
+
+  // The budget of the frame is exhausted, so this command buffer is not timed.
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkDebugMarkerEnd(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional_2 =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional_2);
+
+  EXPECT_THAT(actual_reset_slots, ElementsAre(kSlotIndex2));
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_command_buffers, 1);
+  EXPECT_EQ(tracker_.GetSamplingStatistics().num_skipped_timestamps, 3);
+}
+
+TEST_F(SubmissionTrackerTest, CommandBufferIsNotTimedWhenThePoolIsFullAtItsBegin) {
+  EXPECT_CALL(timer_query_pool_, NextReadyQuerySlot).Times(1).WillOnce(Return(false));
+  EXPECT_CALL(dispatch_table_, CmdWriteTimestamp).Times(0);
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots).Times(0);
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
+
+  producer_->StartCapture();
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+  tracker_.CompleteSubmits(device_);
+}
+
+TEST_F(SubmissionTrackerTest, ResetCommandBufferBeginSlotWhenThePoolIsFullAtItsEnd) {
+  EXPECT_CALL(timer_query_pool_, NextReadyQuerySlot)
+      .Times(2)
+      .WillOnce(Invoke(MockNextReadyQuerySlot1))
+      .WillOnce(Return(false));
+  std::vector<uint32_t> actual_reset_slots;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(1)
+      .WillOnce(SaveArg<1>(&actual_reset_slots));
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions).Times(0);
+
+  producer_->StartCapture();
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+  tracker_.CompleteSubmits(device_);
+
+  EXPECT_THAT(actual_reset_slots, ElementsAre(kSlotIndex1));
+}
+
+TEST_F(SubmissionTrackerTest, DebugMarkerIsNotTimedWhenThePoolIsFullAtItsBegin) {
+  EXPECT_CALL(timer_query_pool_, NextReadyQuerySlot)
+      .Times(4)
+      .WillOnce(Invoke(MockNextReadyQuerySlot1))
+      .WillOnce(Return(false))
+      .WillOnce(Invoke(MockNextReadyQuerySlot2))
+      .WillOnce(Invoke(MockNextReadyQuerySlot3));
+  EXPECT_CALL(dispatch_table_, GetQueryPoolResults)
+      .WillRepeatedly(Return(mock_get_query_pool_results_function_all_ready_));
+  std::vector<uint32_t> actual_reset_slots_on_submit;
+  std::vector<uint32_t> actual_reset_slots_on_complete;
+  EXPECT_CALL(timer_query_pool_, ResetQuerySlots)
+      .Times(2)
+      .WillOnce(SaveArg<1>(&actual_reset_slots_on_submit))
+      .WillOnce(SaveArg<1>(&actual_reset_slots_on_complete));
+  orbit_grpc_protos::CaptureEvent actual_capture_event;
+  auto mock_enqueue_capture_events =
+      [&actual_capture_event](std::vector<GpuQueueSubmission>&& gpu_queue_submissions) {
+        EXPECT_EQ(gpu_queue_submissions.size(), 1);
+        actual_capture_event = CreateCaptureEvent(gpu_queue_submissions.front());
+        return true;
+      };
+  EXPECT_CALL(*producer_, EnqueueGpuQueueSubmissions)
+      .Times(1)
+      .WillOnce(Invoke(mock_enqueue_capture_events));
+
+  producer_->StartCapture();
+  tracker_.TrackCommandBuffers(device_, command_pool_, &command_buffer_, 1);
+  tracker_.MarkCommandBufferBegin(command_buffer_);
+  tracker_.MarkDebugMarkerBegin(command_buffer_, "Marker", {});
+  tracker_.MarkDebugMarkerEnd(command_buffer_);
+  tracker_.MarkCommandBufferEnd(command_buffer_);
+  std::optional<QueueSubmission> queue_submission_optional =
+      tracker_.PersistCommandBuffersOnSubmit(1, &submit_info_);
+  tracker_.PersistDebugMarkersOnSubmit(queue_, 1, &submit_info_, queue_submission_optional);
+  tracker_.CompleteSubmits(device_);
+
+  // The end of the marker was timed, but its slot is reset without being read.
+  EXPECT_THAT(actual_reset_slots_on_submit, ElementsAre(kSlotIndex2));
+  EXPECT_THAT(actual_reset_slots_on_complete, UnorderedElementsAre(kSlotIndex1, kSlotIndex3));
+  ASSERT_TRUE(actual_capture_event.has_gpu_queue_submission());
+  EXPECT_EQ(actual_capture_event.gpu_queue_submission().completed_markers_size(), 0);
+  EXPECT_EQ(actual_capture_event.gpu_queue_submission().num_begin_markers(), 0);
+}
+
 }  // namespace orbit_vulkan_layer
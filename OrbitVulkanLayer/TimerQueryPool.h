@@ -5,6 +5,11 @@
 #ifndef ORBIT_VULKAN_LAYER_TIMER_QUERY_POOL_H_
 #define ORBIT_VULKAN_LAYER_TIMER_QUERY_POOL_H_
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "OrbitBase/Logging.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
@@ -18,14 +23,32 @@ namespace orbit_vulkan_layer {
  * indices.
  * In order to do so, it stores the internal `SlotState` for each index.
  *
- * Thread-Safety: This class is internally synchronized (using read/write locks) and can be safely
- * accessed from different threads.
+ * Slots are handed out by a ring allocator: a cursor walks around the slots of a device's pool, and
+ * a slot is claimed by atomically switching its state from `kReadyForQueryIssue` to
+ * `kQueryPendingOnGpu`. As slots are reset roughly in the order they were allocated, the slot at
+ * the cursor is almost always free.
+ *
+ * Thread-Safety: This class is internally synchronized and can be safely accessed from different
+ * threads. Retrieving, resetting and rolling back slots is lock-free, while initializing a pool
+ * takes a lock.
  */
 template <class DispatchTable>
 class TimerQueryPool {
  public:
+  // Counters about the usage of the slots of a device's pool. In particular,
+  // `num_failed_allocations` and `max_num_slots_in_use` tell if the pool is too small.
+  struct Statistics {
+    uint64_t num_allocations = 0;
+    uint64_t num_failed_allocations = 0;
+    uint32_t max_num_slots_in_use = 0;
+  };
+
   explicit TimerQueryPool(DispatchTable* dispatch_table, uint32_t num_timer_query_slots)
-      : dispatch_table_(dispatch_table), num_timer_query_slots_(num_timer_query_slots) {}
+      : dispatch_table_(dispatch_table), num_timer_query_slots_(num_timer_query_slots) {
+    all_device_query_pools_.push_back(std::make_unique<const DeviceQueryPools>());
+    current_device_query_pools_.store(all_device_query_pools_.back().get(),
+                                      std::memory_order_release);
+  }
 
   // Creates and resets a vulkan `VkQueryPool`, ready to use for timestamp queries.
   void InitializeTimerQueryPool(VkDevice device) {
@@ -44,23 +67,24 @@ class TimerQueryPool {
 
     dispatch_table_->ResetQueryPoolEXT(device)(device, query_pool, 0, num_timer_query_slots_);
 
+    auto device_query_pool = std::make_unique<DeviceQueryPool>(query_pool, num_timer_query_slots_);
+
     {
-      absl::WriterMutexLock lock(&mutex_);
-      CHECK(!device_to_query_pool_.contains(device));
-      device_to_query_pool_[device] = query_pool;
-      std::vector<SlotState> slots{num_timer_query_slots_};
-      std::fill(slots.begin(), slots.end(), SlotState::kReadyForQueryIssue);
-      device_to_query_slots_[device] = slots;
-      device_to_potential_next_free_index_[device] = 0;
+      absl::MutexLock lock(&mutex_);
+      const DeviceQueryPools* current = current_device_query_pools_.load(std::memory_order_relaxed);
+      CHECK(!current->contains(device));
+      auto updated = std::make_unique<DeviceQueryPools>(*current);
+      updated->emplace(device, device_query_pool.get());
+      current_device_query_pools_.store(updated.get(), std::memory_order_release);
+      all_device_query_pools_.push_back(std::move(updated));
+      device_query_pools_.push_back(std::move(device_query_pool));
     }
   }
 
   // Retrieves the query pool for a given device. Note that the pool must be initialized using
   // `InitializeTimerQueryPool` before.
   [[nodiscard]] VkQueryPool GetQueryPool(VkDevice device) {
-    absl::ReaderMutexLock lock(&mutex_);
-    CHECK(device_to_query_pool_.contains(device));
-    return device_to_query_pool_.at(device);
+    return GetDeviceQueryPool(device)->query_pool;
   }
 
   // Tries to find a free query slot in the device's pool. It returns `false` if no slot was found
@@ -70,30 +94,46 @@ class TimerQueryPool {
   // Note that the pool must be initialized using `InitializeTimerQueryPool` before.
   // See also `ResetQuerySlots` to make occupied slots available again.
   [[nodiscard]] bool NextReadyQuerySlot(VkDevice device, uint32_t* allocated_index) {
-    absl::WriterMutexLock lock(&mutex_);
-    CHECK(device_to_potential_next_free_index_.contains(device));
-    CHECK(device_to_query_slots_.contains(device));
-    uint32_t potential_next_free_slot = device_to_potential_next_free_index_.at(device);
-    std::vector<SlotState>& slots = device_to_query_slots_.at(device);
-    uint32_t current_slot = potential_next_free_slot;
+    DeviceQueryPool* pool = GetDeviceQueryPool(device);
+
+    // Once all slots are in use, fail without walking around the whole ring.
+    uint32_t num_slots_in_use = pool->num_slots_in_use.load(std::memory_order_relaxed);
     do {
-      if (slots.at(current_slot) == SlotState::kReadyForQueryIssue) {
-        device_to_potential_next_free_index_[device] = (current_slot + 1) % num_timer_query_slots_;
-        slots.at(current_slot) = SlotState::kQueryPendingOnGpu;
-        *allocated_index = current_slot;
-        return true;
+      if (num_slots_in_use >= num_timer_query_slots_) {
+        pool->num_failed_allocations.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!pool->num_slots_in_use.compare_exchange_weak(num_slots_in_use, num_slots_in_use + 1,
+                                                           std::memory_order_relaxed));
+    // Having reserved one of the free slots, we are guaranteed to find one. Other threads might
+    // claim the ones we pass by, but only as many as they have reserved themselves.
+    while (true) {
+      const uint32_t slot_index =
+          pool->next_slot_index.fetch_add(1, std::memory_order_relaxed) % num_timer_query_slots_;
+      SlotState expected_state = SlotState::kReadyForQueryIssue;
+      if (pool->slot_states[slot_index].compare_exchange_strong(
+              expected_state, SlotState::kQueryPendingOnGpu, std::memory_order_acquire,
+              std::memory_order_relaxed)) {
+        *allocated_index = slot_index;
+        break;
       }
-      current_slot = (current_slot + 1) % num_timer_query_slots_;
-    } while (current_slot != potential_next_free_slot);
+    }
 
-    return false;
+    pool->num_allocations.fetch_add(1, std::memory_order_relaxed);
+    uint32_t max_num_slots_in_use = pool->max_num_slots_in_use.load(std::memory_order_relaxed);
+    while (num_slots_in_use + 1 > max_num_slots_in_use &&
+           !pool->max_num_slots_in_use.compare_exchange_weak(
+               max_num_slots_in_use, num_slots_in_use + 1, std::memory_order_relaxed)) {
+    }
+    return true;
   }
 
   // Resets an occupied slot to be ready for queries again. It will also call to Vulkan to reset the
-  // content of that slot (in contrast to `RollbackPendingQuerySlots`).
+  // content of that slot (in contrast to `RollbackPendingQuerySlots`). Consecutive slot indices
+  // are reset with a single call to Vulkan.
   //
   // Note that the pool must be initialized using `InitializeTimerQueryPool` before.
-  // Further, the given slots must be in the `kReadyForQueryIssue` state, i.e. must be a result
+  // Further, the given slots must be in the `kQueryPendingOnGpu` state, i.e. must be a result
   // of `NextReadyQuerySlot` and must not have been reset yet.
   void ResetQuerySlots(VkDevice device, const std::vector<uint32_t>& slot_indices) {
     ResetQuerySlotsInternal(device, slot_indices, false);
@@ -105,52 +145,113 @@ class TimerQueryPool {
   // Vulkan (e.g. if on resetting the command buffer).
   //
   // Note that the pool must be initialized using `InitializeTimerQueryPool` before.
-  // Further, the given slots must be in the `kReadyForQueryIssue` state, i.e. must be a result
+  // Further, the given slots must be in the `kQueryPendingOnGpu` state, i.e. must be a result
   // of `NextReadyQuerySlot` and must not have been reset yet.
   void RollbackPendingQuerySlots(VkDevice device, const std::vector<uint32_t>& slot_indices) {
     ResetQuerySlotsInternal(device, slot_indices, true);
   }
 
+  // Note that the pool must be initialized using `InitializeTimerQueryPool` before.
+  [[nodiscard]] Statistics GetStatistics(VkDevice device) {
+    const DeviceQueryPool* pool = GetDeviceQueryPool(device);
+    return Statistics{
+        .num_allocations = pool->num_allocations.load(std::memory_order_relaxed),
+        .num_failed_allocations = pool->num_failed_allocations.load(std::memory_order_relaxed),
+        .max_num_slots_in_use = pool->max_num_slots_in_use.load(std::memory_order_relaxed)};
+  }
+
  private:
   enum class SlotState { kReadyForQueryIssue = 0, kQueryPendingOnGpu };
 
+  struct DeviceQueryPool {
+    DeviceQueryPool(VkQueryPool query_pool, uint32_t num_slots)
+        : query_pool(query_pool), slot_states(new std::atomic<SlotState>[num_slots]) {
+      for (uint32_t i = 0; i < num_slots; ++i) {
+        slot_states[i].store(SlotState::kReadyForQueryIssue, std::memory_order_relaxed);
+      }
+    }
+
+    const VkQueryPool query_pool;
+    const std::unique_ptr<std::atomic<SlotState>[]> slot_states;
+    // The ring cursor. It only ever increases; the slot it points to is obtained modulo the
+    // number of slots.
+    std::atomic<uint32_t> next_slot_index = 0;
+    std::atomic<uint32_t> num_slots_in_use = 0;
+
+    std::atomic<uint64_t> num_allocations = 0;
+    std::atomic<uint64_t> num_failed_allocations = 0;
+    std::atomic<uint32_t> max_num_slots_in_use = 0;
+  };
+
+  using DeviceQueryPools = absl::flat_hash_map<VkDevice, DeviceQueryPool*>;
+
+  [[nodiscard]] DeviceQueryPool* GetDeviceQueryPool(VkDevice device) {
+    const DeviceQueryPools* pools = current_device_query_pools_.load(std::memory_order_acquire);
+    auto it = pools->find(device);
+    CHECK(it != pools->end());
+    return it->second;
+  }
+
   // Resets an occupied slot to be ready for queries again.
   // If `rollback_only` is set, it will not call to Vulkan to reset the content of that slot.
   // This is useful, if the slot was retrieved, but the actual query was not yet submitted to
   // Vulkan (e.g. if on resetting the command buffer).
   //
   // Note that the pool must be initialized using `InitializeTimerQueryPool` before.
-  // Further, the given slots must be in the `kReadyForQueryIssue` state, i.e. must be a result
+  // Further, the given slots must be in the `kQueryPendingOnGpu` state, i.e. must be a result
   // of `NextReadyQuerySlot` and must not have been reset yet.
   void ResetQuerySlotsInternal(VkDevice device, const std::vector<uint32_t>& slot_indices,
                                bool rollback_only) {
     if (slot_indices.empty()) {
       return;
     }
-    absl::WriterMutexLock lock(&mutex_);
-    CHECK(device_to_query_slots_.contains(device));
-    std::vector<SlotState>& slot_states = device_to_query_slots_.at(device);
+    DeviceQueryPool* pool = GetDeviceQueryPool(device);
     for (uint32_t physical_slot_index : slot_indices) {
       CHECK(physical_slot_index < num_timer_query_slots_);
-      const SlotState& current_state = slot_states.at(physical_slot_index);
-      CHECK(current_state == SlotState::kQueryPendingOnGpu);
-      slot_states.at(physical_slot_index) = SlotState::kReadyForQueryIssue;
-      if (rollback_only) {
-        continue;
+      CHECK(pool->slot_states[physical_slot_index].load(std::memory_order_relaxed) ==
+            SlotState::kQueryPendingOnGpu);
+    }
+
+    // The slots need to be reset on Vulkan before they are marked as ready, as from then on they
+    // can be handed out again.
+    if (!rollback_only) {
+      std::vector<uint32_t> sorted_slot_indices = slot_indices;
+      std::sort(sorted_slot_indices.begin(), sorted_slot_indices.end());
+      PFN_vkResetQueryPoolEXT reset_query_pool_function =
+          dispatch_table_->ResetQueryPoolEXT(device);
+      size_t range_begin = 0;
+      for (size_t i = 1; i <= sorted_slot_indices.size(); ++i) {
+        if (i < sorted_slot_indices.size() &&
+            sorted_slot_indices[i] == sorted_slot_indices[i - 1] + 1) {
+          continue;
+        }
+        reset_query_pool_function(device, pool->query_pool, sorted_slot_indices[range_begin],
+                                  static_cast<uint32_t>(i - range_begin));
+        range_begin = i;
       }
-      VkQueryPool query_pool = device_to_query_pool_.at(device);
-      dispatch_table_->ResetQueryPoolEXT(device)(device, query_pool, physical_slot_index, 1);
     }
+
+    for (uint32_t physical_slot_index : slot_indices) {
+      SlotState expected_state = SlotState::kQueryPendingOnGpu;
+      CHECK(pool->slot_states[physical_slot_index].compare_exchange_strong(
+          expected_state, SlotState::kReadyForQueryIssue, std::memory_order_release,
+          std::memory_order_relaxed));
+    }
+    pool->num_slots_in_use.fetch_sub(static_cast<uint32_t>(slot_indices.size()),
+                                     std::memory_order_release);
   }
 
   DispatchTable* dispatch_table_;
   const uint32_t num_timer_query_slots_;
 
+  // As for `DispatchTable`, every initialization publishes a new immutable copy of the map from
+  // devices to their pools, so that looking up a pool never blocks. Old copies are only freed
+  // together with this object.
+  std::atomic<const DeviceQueryPools*> current_device_query_pools_;
+  std::vector<std::unique_ptr<const DeviceQueryPools>> all_device_query_pools_;
+  std::vector<std::unique_ptr<DeviceQueryPool>> device_query_pools_;
+  // Serializes initializations.
   absl::Mutex mutex_;
-
-  absl::flat_hash_map<VkDevice, VkQueryPool> device_to_query_pool_;
-  absl::flat_hash_map<VkDevice, std::vector<SlotState>> device_to_query_slots_;
-  absl::flat_hash_map<VkDevice, uint32_t> device_to_potential_next_free_index_;
 };
 }  // namespace orbit_vulkan_layer
 
@@ -2,6 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "TimerQueryPool.h"
 #include "absl/container/flat_hash_set.h"
 #include "gmock/gmock.h"
@@ -321,4 +325,131 @@ TEST(TimerQueryPool, CanRepeatadlyRetrieveAndResetSlots) {
   }
 }
 
+TEST(TimerQueryPool, ResettingConsecutiveSlotsResetsRangesOnVulkan) {
+  MockDispatchTable dispatch_table;
+  static constexpr uint32_t kNumSlots = 8;
+  TimerQueryPool<MockDispatchTable> query_pool(&dispatch_table, kNumSlots);
+  VkDevice device = {};
+  EXPECT_CALL(dispatch_table, CreateQueryPool)
+      .WillRepeatedly(Return(dummy_create_query_pool_function));
+
+  static std::vector<std::pair<uint32_t, uint32_t>> actual_reset_ranges;
+  actual_reset_ranges.clear();
+  PFN_vkResetQueryPoolEXT mock_reset_query_pool_function =
+      +[](VkDevice /*device*/, VkQueryPool /*query_pool*/, uint32_t first_query,
+          uint32_t query_count) { actual_reset_ranges.emplace_back(first_query, query_count); };
+
+  EXPECT_CALL(dispatch_table, ResetQueryPoolEXT)
+      .Times(2)
+      .WillOnce(Return(dummy_reset_query_pool_function))
+      .WillOnce(Return(mock_reset_query_pool_function));
+
+  query_pool.InitializeTimerQueryPool(device);
+  for (uint32_t i = 0; i < kNumSlots; ++i) {
+    uint32_t slot_index;
+    ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+    EXPECT_EQ(slot_index, i);
+  }
+
+  std::vector<uint32_t> reset_slots = {5, 1, 2, 7, 0, 4};
+  query_pool.ResetQuerySlots(device, reset_slots);
+
+  std::vector<std::pair<uint32_t, uint32_t>> expected_reset_ranges = {{0, 3}, {4, 2}, {7, 1}};
+  EXPECT_EQ(actual_reset_ranges, expected_reset_ranges);
+}
+
+TEST(TimerQueryPool, SlotsAreAllocatedAroundTheRing) {
+  MockDispatchTable dispatch_table;
+  static constexpr uint32_t kNumSlots = 4;
+  TimerQueryPool<MockDispatchTable> query_pool(&dispatch_table, kNumSlots);
+  VkDevice device = {};
+  EXPECT_CALL(dispatch_table, CreateQueryPool)
+      .WillRepeatedly(Return(dummy_create_query_pool_function));
+  EXPECT_CALL(dispatch_table, ResetQueryPoolEXT)
+      .WillRepeatedly(Return(dummy_reset_query_pool_function));
+
+  query_pool.InitializeTimerQueryPool(device);
+  uint32_t slot_index;
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+  EXPECT_EQ(slot_index, 0);
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+  EXPECT_EQ(slot_index, 1);
+  query_pool.ResetQuerySlots(device, {0});
+
+  // Slot 0 is free again, but the allocation continues where it stopped, skipping occupied slots.
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+  EXPECT_EQ(slot_index, 2);
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+  EXPECT_EQ(slot_index, 3);
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+  EXPECT_EQ(slot_index, 0);
+  EXPECT_FALSE(query_pool.NextReadyQuerySlot(device, &slot_index));
+}
+
+TEST(TimerQueryPool, StatisticsCountAllocationsAndExhaustion) {
+  MockDispatchTable dispatch_table;
+  static constexpr uint32_t kNumSlots = 4;
+  TimerQueryPool<MockDispatchTable> query_pool(&dispatch_table, kNumSlots);
+  VkDevice device = {};
+  EXPECT_CALL(dispatch_table, CreateQueryPool)
+      .WillRepeatedly(Return(dummy_create_query_pool_function));
+  EXPECT_CALL(dispatch_table, ResetQueryPoolEXT)
+      .WillRepeatedly(Return(dummy_reset_query_pool_function));
+
+  query_pool.InitializeTimerQueryPool(device);
+  std::vector<uint32_t> slots;
+  for (uint32_t i = 0; i < kNumSlots + 2; ++i) {
+    uint32_t slot_index;
+    if (query_pool.NextReadyQuerySlot(device, &slot_index)) {
+      slots.push_back(slot_index);
+    }
+  }
+  query_pool.ResetQuerySlots(device, slots);
+  uint32_t slot_index;
+  ASSERT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+
+  TimerQueryPool<MockDispatchTable>::Statistics statistics = query_pool.GetStatistics(device);
+  EXPECT_EQ(statistics.num_allocations, kNumSlots + 1);
+  EXPECT_EQ(statistics.num_failed_allocations, 2);
+  EXPECT_EQ(statistics.max_num_slots_in_use, kNumSlots);
+}
+
+TEST(TimerQueryPool, CanRetrieveAndResetSlotsFromDifferentThreads) {
+  MockDispatchTable dispatch_table;
+  static constexpr uint32_t kNumSlots = 16;
+  static constexpr uint32_t kNumThreads = 4;
+  TimerQueryPool<MockDispatchTable> query_pool(&dispatch_table, kNumSlots);
+  VkDevice device = {};
+  EXPECT_CALL(dispatch_table, CreateQueryPool)
+      .WillRepeatedly(Return(dummy_create_query_pool_function));
+  EXPECT_CALL(dispatch_table, ResetQueryPoolEXT)
+      .WillRepeatedly(Return(dummy_reset_query_pool_function));
+
+  query_pool.InitializeTimerQueryPool(device);
+
+  // Each thread holds at most kNumSlots / kNumThreads slots at once, so allocations never fail.
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&query_pool, device] {
+      for (int i = 0; i < 1000; ++i) {
+        std::vector<uint32_t> slots;
+        for (uint32_t j = 0; j < kNumSlots / kNumThreads; ++j) {
+          uint32_t slot_index;
+          EXPECT_TRUE(query_pool.NextReadyQuerySlot(device, &slot_index));
+          slots.push_back(slot_index);
+        }
+        query_pool.ResetQuerySlots(device, slots);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  TimerQueryPool<MockDispatchTable>::Statistics statistics = query_pool.GetStatistics(device);
+  EXPECT_EQ(statistics.num_allocations, 1000 * kNumSlots);
+  EXPECT_EQ(statistics.num_failed_allocations, 0);
+  EXPECT_LE(statistics.max_num_slots_in_use, kNumSlots);
+}
+
 }  // namespace orbit_vulkan_layer
@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "VulkanLayerEvents.h"
+
+#include "OrbitBase/Logging.h"
+
+namespace orbit_vulkan_layer {
+
+namespace {
+
+void WriteMetaInfo(const GpuQueueSubmissionMetaInfo& meta_info,
+                   orbit_grpc_protos::GpuQueueSubmissionMetaInfo* target_proto) {
+  target_proto->set_tid(meta_info.tid);
+  target_proto->set_pre_submission_cpu_timestamp(meta_info.pre_submission_cpu_timestamp);
+  target_proto->set_post_submission_cpu_timestamp(meta_info.post_submission_cpu_timestamp);
+}
+
+}  // namespace
+
+orbit_grpc_protos::CaptureEvent CreateCaptureEvent(const GpuQueueSubmission& gpu_queue_submission) {
+  orbit_grpc_protos::CaptureEvent capture_event;
+  orbit_grpc_protos::GpuQueueSubmission* submission_proto =
+      capture_event.mutable_gpu_queue_submission();
+  WriteMetaInfo(gpu_queue_submission.meta_info, submission_proto->mutable_meta_info());
+
+  auto command_buffer_it = gpu_queue_submission.command_buffers.begin();
+  for (uint32_t num_command_buffers : gpu_queue_submission.num_command_buffers_per_submit_info) {
+    orbit_grpc_protos::GpuSubmitInfo* submit_info_proto = submission_proto->add_submit_infos();
+    submit_info_proto->mutable_command_buffers()->Reserve(num_command_buffers);
+    for (uint32_t i = 0; i < num_command_buffers; ++i) {
+      CHECK(command_buffer_it != gpu_queue_submission.command_buffers.end());
+      orbit_grpc_protos::GpuCommandBuffer* command_buffer_proto =
+          submit_info_proto->add_command_buffers();
+      command_buffer_proto->set_begin_gpu_timestamp_ns(command_buffer_it->begin_gpu_timestamp_ns);
+      command_buffer_proto->set_end_gpu_timestamp_ns(command_buffer_it->end_gpu_timestamp_ns);
+      ++command_buffer_it;
+    }
+  }
+  CHECK(command_buffer_it == gpu_queue_submission.command_buffers.end());
+
+  submission_proto->set_num_begin_markers(gpu_queue_submission.num_begin_markers);
+  submission_proto->mutable_completed_markers()->Reserve(
+      gpu_queue_submission.completed_markers.size());
+  for (const GpuDebugMarker& marker : gpu_queue_submission.completed_markers) {
+    orbit_grpc_protos::GpuDebugMarker* marker_proto = submission_proto->add_completed_markers();
+    marker_proto->set_text_key(marker.text_key);
+    if (marker.color.has_value()) {
+      orbit_grpc_protos::Color* color = marker_proto->mutable_color();
+      color->set_red(marker.color->red);
+      color->set_green(marker.color->green);
+      color->set_blue(marker.color->blue);
+      color->set_alpha(marker.color->alpha);
+    }
+    marker_proto->set_depth(marker.depth);
+    marker_proto->set_end_gpu_timestamp_ns(marker.end_gpu_timestamp_ns);
+
+    if (!marker.begin_marker.has_value()) {
+      continue;
+    }
+    orbit_grpc_protos::GpuDebugMarkerBeginInfo* begin_marker_proto =
+        marker_proto->mutable_begin_marker();
+    WriteMetaInfo(marker.begin_marker->meta_info, begin_marker_proto->mutable_meta_info());
+    begin_marker_proto->set_gpu_timestamp_ns(marker.begin_marker->gpu_timestamp_ns);
+  }
+
+  return capture_event;
+}
+
+orbit_grpc_protos::CaptureEvent CreateCaptureEvent(InternedString&& interned_string) {
+  orbit_grpc_protos::CaptureEvent capture_event;
+  capture_event.mutable_interned_string()->set_key(interned_string.key);
+  capture_event.mutable_interned_string()->set_intern(std::move(interned_string.intern));
+  return capture_event;
+}
+
+orbit_grpc_protos::CaptureEvent CreateCaptureEvent(VulkanLayerEvent&& event) {
+  if (std::holds_alternative<GpuQueueSubmission>(event)) {
+    return CreateCaptureEvent(std::get<GpuQueueSubmission>(event));
+  }
+  return CreateCaptureEvent(std::get<InternedString>(std::move(event)));
+}
+
+}  // namespace orbit_vulkan_layer
@@ -0,0 +1,80 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ORBIT_VULKAN_LAYER_VULKAN_LAYER_EVENTS_H_
+#define ORBIT_VULKAN_LAYER_VULKAN_LAYER_EVENTS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "capture.pb.h"
+
+namespace orbit_vulkan_layer {
+
+// The structs in this file are compact representations of the CaptureEvents sent by the Vulkan
+// layer. They are built on the application's threads (e.g. on vkQueuePresentKHR) and enqueued by
+// VulkanLayerProducer, which only translates them to protobufs on its forwarder thread. This keeps
+// the allocations and the serialization-related work of protobufs off the application's threads.
+
+struct GpuQueueSubmissionMetaInfo {
+  int32_t tid = 0;
+  uint64_t pre_submission_cpu_timestamp = 0;
+  uint64_t post_submission_cpu_timestamp = 0;
+};
+
+struct GpuCommandBuffer {
+  // Zero if the begin of the command buffer was not captured.
+  uint64_t begin_gpu_timestamp_ns = 0;
+  uint64_t end_gpu_timestamp_ns = 0;
+};
+
+struct GpuDebugMarkerBeginInfo {
+  GpuQueueSubmissionMetaInfo meta_info;
+  uint64_t gpu_timestamp_ns = 0;
+};
+
+// The values are all in range [0.f, 1.f].
+struct GpuDebugMarkerColor {
+  float red = 0.f;
+  float green = 0.f;
+  float blue = 0.f;
+  float alpha = 0.f;
+};
+
+struct GpuDebugMarker {
+  std::optional<GpuDebugMarkerBeginInfo> begin_marker;
+  uint64_t end_gpu_timestamp_ns = 0;
+  uint64_t text_key = 0;
+  int32_t depth = 0;
+  std::optional<GpuDebugMarkerColor> color;
+};
+
+// Compact version of orbit_grpc_protos::GpuQueueSubmission. The command buffers of all submit infos
+// are stored in a single vector, `num_command_buffers_per_submit_info` allows to split them again.
+struct GpuQueueSubmission {
+  GpuQueueSubmissionMetaInfo meta_info;
+  std::vector<uint32_t> num_command_buffers_per_submit_info;
+  std::vector<GpuCommandBuffer> command_buffers;
+  std::vector<GpuDebugMarker> completed_markers;
+  int32_t num_begin_markers = 0;
+};
+
+struct InternedString {
+  uint64_t key = 0;
+  std::string intern;
+};
+
+using VulkanLayerEvent = std::variant<GpuQueueSubmission, InternedString>;
+
+[[nodiscard]] orbit_grpc_protos::CaptureEvent CreateCaptureEvent(
+    const GpuQueueSubmission& gpu_queue_submission);
+[[nodiscard]] orbit_grpc_protos::CaptureEvent CreateCaptureEvent(InternedString&& interned_string);
+[[nodiscard]] orbit_grpc_protos::CaptureEvent CreateCaptureEvent(VulkanLayerEvent&& event);
+
+}  // namespace orbit_vulkan_layer
+
+#endif  // ORBIT_VULKAN_LAYER_VULKAN_LAYER_EVENTS_H_
@@ -0,0 +1,115 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "VulkanLayerEvents.h"
+#include "concurrentqueue.h"
+
+namespace orbit_vulkan_layer {
+
+namespace {
+
+// The events are drained from the queue every kDrainPeriod iterations (outside of the timing), so
+// that the queue doesn't grow unboundedly, like the forwarder thread of the producer would do.
+constexpr int64_t kDrainPeriod = 4096;
+
+// Builds a submission like the ones the layer produces on vkQueuePresentKHR. Arguments are the
+// number of submit infos, the number of command buffers per submit info and the number of
+// completed debug markers.
+GpuQueueSubmission CreateGpuQueueSubmission(const benchmark::State& state) {
+  const auto num_submit_infos = static_cast<uint32_t>(state.range(0));
+  const auto num_command_buffers_per_submit_info = static_cast<uint32_t>(state.range(1));
+  const auto num_markers = static_cast<uint32_t>(state.range(2));
+
+  GpuQueueSubmission submission;
+  submission.meta_info = {.tid = 42,
+                          .pre_submission_cpu_timestamp = 1000,
+                          .post_submission_cpu_timestamp = 2000};
+  submission.num_command_buffers_per_submit_info.assign(num_submit_infos,
+                                                         num_command_buffers_per_submit_info);
+  submission.command_buffers.reserve(num_submit_infos * num_command_buffers_per_submit_info);
+  uint64_t timestamp_ns = 10'000;
+  for (uint32_t i = 0; i < num_submit_infos * num_command_buffers_per_submit_info; ++i) {
+    submission.command_buffers.push_back(
+        {.begin_gpu_timestamp_ns = timestamp_ns, .end_gpu_timestamp_ns = timestamp_ns + 100});
+    timestamp_ns += 200;
+  }
+  submission.completed_markers.reserve(num_markers);
+  for (uint32_t i = 0; i < num_markers; ++i) {
+    GpuDebugMarker& marker = submission.completed_markers.emplace_back();
+    marker.begin_marker = GpuDebugMarkerBeginInfo{.meta_info = submission.meta_info,
+                                                  .gpu_timestamp_ns = 10'000 + i};
+    marker.end_gpu_timestamp_ns = timestamp_ns - i;
+    marker.text_key = i;
+    marker.depth = static_cast<int32_t>(i % 4);
+    marker.color = GpuDebugMarkerColor{1.f, 0.f, 0.f, 1.f};
+  }
+  submission.num_begin_markers = static_cast<int32_t>(num_markers);
+  return submission;
+}
+
+template <typename EventT>
+void DrainQueue(moodycamel::ConcurrentQueue<EventT>* queue) {
+  std::vector<EventT> events(kDrainPeriod);
+  while (queue->try_dequeue_bulk(events.begin(), events.size()) > 0) {
+  }
+}
+
+// What used to happen on the application's thread: building the protobuf before enqueuing it.
+void BM_EnqueueCaptureEvent(benchmark::State& state) {
+  const GpuQueueSubmission submission = CreateGpuQueueSubmission(state);
+  moodycamel::ConcurrentQueue<orbit_grpc_protos::CaptureEvent> queue;
+  for (auto _ : state) {
+    queue.enqueue(CreateCaptureEvent(submission));
+    if (state.iterations() % kDrainPeriod == 0) {
+      state.PauseTiming();
+      DrainQueue(&queue);
+      state.ResumeTiming();
+    }
+  }
+}
+
+// What now happens on the application's thread: only the compact event is built and enqueued.
+void BM_EnqueueGpuQueueSubmission(benchmark::State& state) {
+  const GpuQueueSubmission submission = CreateGpuQueueSubmission(state);
+  moodycamel::ConcurrentQueue<VulkanLayerEvent> queue;
+  for (auto _ : state) {
+    GpuQueueSubmission copy = submission;
+    queue.enqueue(VulkanLayerEvent{std::move(copy)});
+    if (state.iterations() % kDrainPeriod == 0) {
+      state.PauseTiming();
+      DrainQueue(&queue);
+      state.ResumeTiming();
+    }
+  }
+}
+
+// The work that moved to the forwarder thread.
+void BM_TranslateGpuQueueSubmission(benchmark::State& state) {
+  const GpuQueueSubmission submission = CreateGpuQueueSubmission(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CreateCaptureEvent(submission));
+  }
+}
+
+void SubmissionArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"submit_infos", "command_buffers", "markers"})
+      ->Args({1, 1, 0})
+      ->Args({1, 4, 8})
+      ->Args({4, 8, 32});
+}
+
+BENCHMARK(BM_EnqueueCaptureEvent)->Apply(SubmissionArguments);
+BENCHMARK(BM_EnqueueGpuQueueSubmission)->Apply(SubmissionArguments);
+BENCHMARK(BM_TranslateGpuQueueSubmission)->Apply(SubmissionArguments);
+
+}  // namespace
+
+}  // namespace orbit_vulkan_layer
+
+BENCHMARK_MAIN();
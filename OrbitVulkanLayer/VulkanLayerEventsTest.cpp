@@ -0,0 +1,85 @@
+// Copyright (c) 2020 The Orbit Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "VulkanLayerEvents.h"
+
+namespace orbit_vulkan_layer {
+
+TEST(VulkanLayerEvents, CreateCaptureEventFromGpuQueueSubmission) {
+  GpuQueueSubmission submission;
+  submission.meta_info = {.tid = 42,
+                          .pre_submission_cpu_timestamp = 1,
+                          .post_submission_cpu_timestamp = 2};
+  submission.num_command_buffers_per_submit_info = {2, 0, 1};
+  submission.command_buffers = {{.begin_gpu_timestamp_ns = 10, .end_gpu_timestamp_ns = 11},
+                                {.begin_gpu_timestamp_ns = 0, .end_gpu_timestamp_ns = 21},
+                                {.begin_gpu_timestamp_ns = 30, .end_gpu_timestamp_ns = 31}};
+  submission.num_begin_markers = 1;
+  GpuDebugMarker marker_with_begin;
+  marker_with_begin.begin_marker = GpuDebugMarkerBeginInfo{
+      .meta_info = {.tid = 43, .pre_submission_cpu_timestamp = 3, .post_submission_cpu_timestamp = 4},
+      .gpu_timestamp_ns = 12};
+  marker_with_begin.end_gpu_timestamp_ns = 13;
+  marker_with_begin.text_key = 100;
+  marker_with_begin.depth = 1;
+  marker_with_begin.color = GpuDebugMarkerColor{1.f, 0.5f, 0.25f, 1.f};
+  GpuDebugMarker marker_without_begin;
+  marker_without_begin.end_gpu_timestamp_ns = 14;
+  marker_without_begin.text_key = 101;
+  submission.completed_markers = {marker_with_begin, marker_without_begin};
+
+  orbit_grpc_protos::CaptureEvent capture_event = CreateCaptureEvent(submission);
+  ASSERT_EQ(capture_event.event_case(), orbit_grpc_protos::CaptureEvent::kGpuQueueSubmission);
+  const orbit_grpc_protos::GpuQueueSubmission& proto = capture_event.gpu_queue_submission();
+  EXPECT_EQ(proto.meta_info().tid(), 42);
+  EXPECT_EQ(proto.meta_info().pre_submission_cpu_timestamp(), 1);
+  EXPECT_EQ(proto.meta_info().post_submission_cpu_timestamp(), 2);
+
+  ASSERT_EQ(proto.submit_infos_size(), 3);
+  ASSERT_EQ(proto.submit_infos(0).command_buffers_size(), 2);
+  EXPECT_EQ(proto.submit_infos(0).command_buffers(0).begin_gpu_timestamp_ns(), 10);
+  EXPECT_EQ(proto.submit_infos(0).command_buffers(0).end_gpu_timestamp_ns(), 11);
+  EXPECT_EQ(proto.submit_infos(0).command_buffers(1).begin_gpu_timestamp_ns(), 0);
+  EXPECT_EQ(proto.submit_infos(0).command_buffers(1).end_gpu_timestamp_ns(), 21);
+  EXPECT_EQ(proto.submit_infos(1).command_buffers_size(), 0);
+  ASSERT_EQ(proto.submit_infos(2).command_buffers_size(), 1);
+  EXPECT_EQ(proto.submit_infos(2).command_buffers(0).begin_gpu_timestamp_ns(), 30);
+  EXPECT_EQ(proto.submit_infos(2).command_buffers(0).end_gpu_timestamp_ns(), 31);
+
+  EXPECT_EQ(proto.num_begin_markers(), 1);
+  ASSERT_EQ(proto.completed_markers_size(), 2);
+  const orbit_grpc_protos::GpuDebugMarker& marker_proto_0 = proto.completed_markers(0);
+  ASSERT_TRUE(marker_proto_0.has_begin_marker());
+  EXPECT_EQ(marker_proto_0.begin_marker().meta_info().tid(), 43);
+  EXPECT_EQ(marker_proto_0.begin_marker().meta_info().pre_submission_cpu_timestamp(), 3);
+  EXPECT_EQ(marker_proto_0.begin_marker().meta_info().post_submission_cpu_timestamp(), 4);
+  EXPECT_EQ(marker_proto_0.begin_marker().gpu_timestamp_ns(), 12);
+  EXPECT_EQ(marker_proto_0.end_gpu_timestamp_ns(), 13);
+  EXPECT_EQ(marker_proto_0.text_key(), 100);
+  EXPECT_EQ(marker_proto_0.depth(), 1);
+  ASSERT_TRUE(marker_proto_0.has_color());
+  EXPECT_EQ(marker_proto_0.color().red(), 1.f);
+  EXPECT_EQ(marker_proto_0.color().green(), 0.5f);
+  EXPECT_EQ(marker_proto_0.color().blue(), 0.25f);
+  EXPECT_EQ(marker_proto_0.color().alpha(), 1.f);
+
+  const orbit_grpc_protos::GpuDebugMarker& marker_proto_1 = proto.completed_markers(1);
+  EXPECT_FALSE(marker_proto_1.has_begin_marker());
+  EXPECT_FALSE(marker_proto_1.has_color());
+  EXPECT_EQ(marker_proto_1.end_gpu_timestamp_ns(), 14);
+  EXPECT_EQ(marker_proto_1.text_key(), 101);
+  EXPECT_EQ(marker_proto_1.depth(), 0);
+}
+
+TEST(VulkanLayerEvents, CreateCaptureEventFromInternedString) {
+  VulkanLayerEvent event = InternedString{.key = 7, .intern = "marker"};
+  orbit_grpc_protos::CaptureEvent capture_event = CreateCaptureEvent(std::move(event));
+  ASSERT_EQ(capture_event.event_case(), orbit_grpc_protos::CaptureEvent::kInternedString);
+  EXPECT_EQ(capture_event.interned_string().key(), 7);
+  EXPECT_EQ(capture_event.interned_string().intern(), "marker");
+}
+
+}  // namespace orbit_vulkan_layer
@@ -5,6 +5,7 @@
 #ifndef ORBIT_VULKAN_LAYER_VULKAN_LAYER_PRODUCER_H_
 #define ORBIT_VULKAN_LAYER_VULKAN_LAYER_PRODUCER_H_
 
+#include "VulkanLayerEvents.h"
 #include "capture.pb.h"
 #include "grpcpp/grpcpp.h"
 
@@ -28,11 +29,13 @@ class VulkanLayerProducer {
   // Use this method to query whether Orbit is currently capturing.
   [[nodiscard]] virtual bool IsCapturing() = 0;
 
-  // Use this method to enqueue a CaptureEvent to be sent to OrbitService.
-  // Returns true if the event was enqueued as the capture is in progress, false otherwise.
-  // Callers can use the return value to check if the event was actually enqueued as the capture
+  // Use this method to enqueue GpuQueueSubmissions to be sent to OrbitService, all at once. The
+  // corresponding CaptureEvents are only built later, off the calling thread.
+  // Returns true if the events were enqueued as the capture is in progress, false otherwise.
+  // Callers can use the return value to check if the events were actually enqueued as the capture
   // is in progress.
-  virtual bool EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent&& capture_event) = 0;
+  virtual bool EnqueueGpuQueueSubmissions(
+      std::vector<GpuQueueSubmission>&& gpu_queue_submissions) = 0;
 
   // This method enqueues an InternedString to be sent to OrbitService the first time the string
   // passed as argument is seen. In all cases, it returns the key corresponding to the string.
@@ -41,7 +44,7 @@ class VulkanLayerProducer {
   class CaptureStatusListener {
    public:
     virtual ~CaptureStatusListener() = default;
-    virtual void OnCaptureStart() = 0;
+    virtual void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) = 0;
     virtual void OnCaptureStop() = 0;
     virtual void OnCaptureFinished() = 0;
   };
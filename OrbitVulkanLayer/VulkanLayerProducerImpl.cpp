@@ -15,10 +15,9 @@ uint64_t VulkanLayerProducerImpl::InternStringIfNecessaryAndGetKey(std::string s
       return key;
     }
 
-    orbit_grpc_protos::CaptureEvent event;
-    event.mutable_interned_string()->set_key(key);
-    event.mutable_interned_string()->set_intern(std::move(str));
-    if (!EnqueueCaptureEvent(std::move(event))) {
+    bool enqueued = lock_free_producer_.EnqueueIntermediateEventIfCapturing(
+        [key, &str] { return InternedString{key, std::move(str)}; });
+    if (!enqueued) {
       // If the interned string wasn't actually sent because we are no longer capturing,
       // remove it from string_keys_sent_.
       string_keys_sent_.erase(key);
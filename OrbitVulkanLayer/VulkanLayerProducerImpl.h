@@ -6,6 +6,7 @@
 #define ORBIT_VULKAN_LAYER_VULKAN_LAYER_PRODUCER_IMPL_H_
 
 #include "OrbitProducer/LockFreeBufferCaptureEventProducer.h"
+#include "VulkanLayerEvents.h"
 #include "VulkanLayerProducer.h"
 #include "absl/container/flat_hash_set.h"
 
@@ -14,6 +15,8 @@ namespace orbit_vulkan_layer {
 // This class provides the implementation of VulkanLayerProducer,
 // delegating most methods to LockFreeBufferCaptureEventProducer
 // while also handling interning of strings.
+// The lock-free buffer stores the compact VulkanLayerEvents, which are only translated to
+// CaptureEvents on the forwarder thread of LockFreeBufferCaptureEventProducer.
 class VulkanLayerProducerImpl : public VulkanLayerProducer {
  public:
   void BringUp(const std::shared_ptr<grpc::Channel>& channel) override {
@@ -24,9 +27,10 @@ class VulkanLayerProducerImpl : public VulkanLayerProducer {
 
   [[nodiscard]] bool IsCapturing() override { return lock_free_producer_.IsCapturing(); }
 
-  bool EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent&& capture_event) override {
-    return lock_free_producer_.EnqueueIntermediateEventIfCapturing(
-        [&capture_event] { return capture_event; });
+  bool EnqueueGpuQueueSubmissions(
+      std::vector<GpuQueueSubmission>&& gpu_queue_submissions) override {
+    return lock_free_producer_.EnqueueIntermediateEventsIfCapturing(
+        std::make_move_iterator(gpu_queue_submissions.begin()), gpu_queue_submissions.size());
   }
 
   [[nodiscard]] uint64_t InternStringIfNecessaryAndGetKey(std::string str) override;
@@ -35,15 +39,17 @@ class VulkanLayerProducerImpl : public VulkanLayerProducer {
 
  private:
   class LockFreeBufferVulkanLayerProducer
-      : public orbit_producer::LockFreeBufferCaptureEventProducer<orbit_grpc_protos::CaptureEvent> {
+      : public orbit_producer::LockFreeBufferCaptureEventProducer<VulkanLayerEvent> {
    public:
-    explicit LockFreeBufferVulkanLayerProducer(VulkanLayerProducerImpl* outer) : outer_{outer} {}
+    explicit LockFreeBufferVulkanLayerProducer(VulkanLayerProducerImpl* outer) : outer_{outer} {
+      EnableStatsEvents("Vulkan layer");
+    }
 
    protected:
-    void OnCaptureStart() override {
-      LockFreeBufferCaptureEventProducer::OnCaptureStart();
+    void OnCaptureStart(orbit_grpc_protos::CaptureOptions capture_options) override {
+      LockFreeBufferCaptureEventProducer::OnCaptureStart(capture_options);
       if (outer_->listener_ != nullptr) {
-        outer_->listener_->OnCaptureStart();
+        outer_->listener_->OnCaptureStart(std::move(capture_options));
       }
     }
 
@@ -64,8 +70,8 @@ class VulkanLayerProducerImpl : public VulkanLayerProducer {
     }
 
     orbit_grpc_protos::CaptureEvent TranslateIntermediateEvent(
-        orbit_grpc_protos::CaptureEvent&& intermediate_event) override {
-      return std::move(intermediate_event);
+        VulkanLayerEvent&& intermediate_event) override {
+      return CreateCaptureEvent(std::move(intermediate_event));
     }
 
    private:
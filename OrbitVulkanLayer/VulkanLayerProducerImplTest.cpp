@@ -14,7 +14,7 @@ namespace {
 
 class MockCaptureStatusListener : public VulkanLayerProducer::CaptureStatusListener {
  public:
-  MOCK_METHOD(void, OnCaptureStart, (), (override));
+  MOCK_METHOD(void, OnCaptureStart, (orbit_grpc_protos::CaptureOptions), (override));
   MOCK_METHOD(void, OnCaptureStop, (), (override));
   MOCK_METHOD(void, OnCaptureFinished, (), (override));
 };
@@ -132,6 +132,26 @@ TEST_F(VulkanLayerProducerImplTest, IsCapturingAndListener) {
   EXPECT_FALSE(producer_->IsCapturing());
 }
 
+TEST_F(VulkanLayerProducerImplTest, ListenerReceivesCaptureOptions) {
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_gpu_command_buffer_sampling_period_frames(3);
+  capture_options.set_max_gpu_timestamps_per_frame(128);
+  orbit_grpc_protos::CaptureOptions received_capture_options;
+  EXPECT_CALL(mock_listener_, OnCaptureStart)
+      .Times(1)
+      .WillOnce(::testing::SaveArg<0>(&received_capture_options));
+  fake_service_->SendStartCaptureCommand(capture_options);
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+  ::testing::Mock::VerifyAndClearExpectations(&mock_listener_);
+  EXPECT_EQ(received_capture_options.gpu_command_buffer_sampling_period_frames(), 3);
+  EXPECT_EQ(received_capture_options.max_gpu_timestamps_per_frame(), 128);
+
+  EXPECT_CALL(mock_listener_, OnCaptureStop).Times(1);
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
+}
+
 TEST_F(VulkanLayerProducerImplTest, WorksWithNoListener) {
   EXPECT_CALL(mock_listener_, OnCaptureStart).Times(0);
   EXPECT_CALL(mock_listener_, OnCaptureStop).Times(0);
@@ -156,10 +176,10 @@ TEST_F(VulkanLayerProducerImplTest, WorksWithNoListener) {
   EXPECT_FALSE(producer_->IsCapturing());
 }
 
-TEST_F(VulkanLayerProducerImplTest, EnqueueCaptureEvent) {
+TEST_F(VulkanLayerProducerImplTest, EnqueueGpuQueueSubmissions) {
   EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
   EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(0);
-  EXPECT_FALSE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
+  EXPECT_FALSE(producer_->EnqueueGpuQueueSubmissions(std::vector<GpuQueueSubmission>(1)));
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
@@ -181,9 +201,8 @@ TEST_F(VulkanLayerProducerImplTest, EnqueueCaptureEvent) {
       });
   EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::Between(1, 3));
   EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(0);
-  EXPECT_TRUE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
-  EXPECT_TRUE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
-  EXPECT_TRUE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
+  EXPECT_TRUE(producer_->EnqueueGpuQueueSubmissions(std::vector<GpuQueueSubmission>(2)));
+  EXPECT_TRUE(producer_->EnqueueGpuQueueSubmissions(std::vector<GpuQueueSubmission>(1)));
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
   EXPECT_EQ(capture_events_received_count, 3);
 
@@ -200,7 +219,7 @@ TEST_F(VulkanLayerProducerImplTest, EnqueueCaptureEvent) {
 
   EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
   EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(0);
-  EXPECT_FALSE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
+  EXPECT_FALSE(producer_->EnqueueGpuQueueSubmissions(std::vector<GpuQueueSubmission>(1)));
   std::this_thread::sleep_for(kWaitMessagesSentDuration);
 
   ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
@@ -216,7 +235,40 @@ TEST_F(VulkanLayerProducerImplTest, EnqueueCaptureEvent) {
 
   EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(0);
   EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(0);
-  EXPECT_FALSE(producer_->EnqueueCaptureEvent(orbit_grpc_protos::CaptureEvent()));
+  EXPECT_FALSE(producer_->EnqueueGpuQueueSubmissions(std::vector<GpuQueueSubmission>(1)));
+}
+
+TEST_F(VulkanLayerProducerImplTest, SendsStatsEventsWhenIntrospectionIsEnabled) {
+  orbit_grpc_protos::CaptureOptions capture_options;
+  capture_options.set_enable_introspection(true);
+  int32_t introspection_scopes_received_count = 0;
+  ON_CALL(*fake_service_, OnCaptureEventsReceived)
+      .WillByDefault([&introspection_scopes_received_count](
+                         const std::vector<orbit_grpc_protos::CaptureEvent>& events) {
+        for (const orbit_grpc_protos::CaptureEvent& event : events) {
+          if (event.event_case() == orbit_grpc_protos::CaptureEvent::kIntrospectionScope) {
+            ++introspection_scopes_received_count;
+          }
+        }
+      });
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AtLeast(1));
+  EXPECT_CALL(mock_listener_, OnCaptureStart).Times(1);
+  fake_service_->SendStartCaptureCommand(capture_options);
+  std::this_thread::sleep_for(
+      orbit_producer::LockFreeBufferCaptureEventProducer<VulkanLayerEvent>::kStatsEventsPeriod +
+      kWaitMessagesSentDuration);
+
+  ::testing::Mock::VerifyAndClearExpectations(&mock_listener_);
+  ::testing::Mock::VerifyAndClearExpectations(&*fake_service_);
+  // The queue depth, the bytes sent and the dropped events.
+  EXPECT_GE(introspection_scopes_received_count, 3);
+
+  EXPECT_CALL(mock_listener_, OnCaptureStop).Times(1);
+  // The last stats events can still be sent before AllEventsSent.
+  EXPECT_CALL(*fake_service_, OnCaptureEventsReceived).Times(::testing::AnyNumber());
+  EXPECT_CALL(*fake_service_, OnAllEventsSentReceived).Times(1);
+  fake_service_->SendStopCaptureCommand();
+  std::this_thread::sleep_for(kWaitMessagesSentDuration);
 }
 
 static void ExpectInternedStrings(
@@ -0,0 +1,16 @@
+# Copyright (c) 2020 The Orbit Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+# Benchmarks are regular executables based on Google Benchmark. They are not
+# registered as tests as their results are only meaningful on a quiet machine
+# and in release builds.
+function(add_benchmark target_name)
+  add_executable(${target_name} ${ARGN})
+  target_compile_options(${target_name} PRIVATE ${STRICT_COMPILE_FLAGS})
+  target_link_libraries(${target_name} PRIVATE CONAN_PKG::benchmark)
+endfunction()
+
+# Usage example:
+# add_benchmark(ClassNameBenchmark ClassNameBenchmark.cpp)
+# target_link_libraries(ClassNameBenchmark PRIVATE ${PROJECT_NAME})
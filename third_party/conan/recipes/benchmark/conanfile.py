@@ -0,0 +1,54 @@
+import os
+from conans import ConanFile, CMake, tools
+
+
+class BenchmarkConan(ConanFile):
+    name = "benchmark"
+    description = "A microbenchmark support library."
+    topics = ("conan", "benchmark", "google", "microbenchmark")
+    url = "https://github.com/conan-io/conan-center-index"
+    homepage = "https://github.com/google/benchmark"
+    license = "Apache-2.0"
+    settings = "os", "compiler", "build_type", "arch"
+    generators = "cmake"
+    options = {"fPIC": [True, False]}
+    default_options = {"fPIC": True}
+
+    @property
+    def _source_subfolder(self):
+        return "source_subfolder"
+
+    def config_options(self):
+        if self.settings.os == "Windows":
+            del self.options.fPIC
+
+    def source(self):
+        tools.get(**self.conan_data["sources"][self.version])
+        os.rename("benchmark-{}".format(self.version), self._source_subfolder)
+
+    def _configure_cmake(self):
+        cmake = CMake(self)
+        cmake.definitions["BENCHMARK_ENABLE_TESTING"] = False
+        cmake.definitions["BENCHMARK_ENABLE_GTEST_TESTS"] = False
+        cmake.definitions["BENCHMARK_ENABLE_LTO"] = False
+        cmake.definitions["BENCHMARK_ENABLE_INSTALL"] = True
+        cmake.configure(source_folder=self._source_subfolder)
+        return cmake
+
+    def build(self):
+        cmake = self._configure_cmake()
+        cmake.build()
+
+    def package(self):
+        self.copy("LICENSE", dst="licenses", src=self._source_subfolder)
+        cmake = self._configure_cmake()
+        cmake.install()
+        tools.rmdir(os.path.join(self.package_folder, "lib", "cmake"))
+        tools.rmdir(os.path.join(self.package_folder, "lib", "pkgconfig"))
+
+    def package_info(self):
+        self.cpp_info.libs = ["benchmark"]
+        if self.settings.os == "Linux":
+            self.cpp_info.system_libs = ["pthread", "rt"]
+        elif self.settings.os == "Windows":
+            self.cpp_info.system_libs = ["shlwapi"]